@@ -14,6 +14,7 @@
 
 class CommandQueue;
 class DescriptorAllocator;
+class FramePacer;
 class Game;
 class Window;
 
@@ -23,8 +24,10 @@ public:
 
     /**
     * Create the application singleton with the application instance handle.
+    * If useWarp is true, the WARP (software) adapter is used instead of a
+    * hardware adapter. WARP is still a D3D12 device, on Windows.
     */
-    static void Create(HINSTANCE hInst);
+    static void Create(HINSTANCE hInst, bool useWarp = false);
 
     /**
     * Destroy the application instance and all windows created by this application instance.
@@ -96,6 +99,13 @@ public:
      */
     void Flush();
 
+    /**
+     * Get the frame pacer of the direct command queue. Use it to change the
+     * number of frames in flight or to release objects once the GPU has
+     * finished the current frame.
+     */
+    FramePacer& GetFramePacer() const;
+
     /**
      * Allocate a number of CPU visible descriptors.
      */
@@ -122,7 +132,7 @@ protected:
     virtual ~Application();
 
     // Initialize the application instance.
-    void Initialize();
+    void Initialize(bool useWarp);
 
     Microsoft::WRL::ComPtr<IDXGIAdapter4> GetAdapter(bool bUseWarp);
     Microsoft::WRL::ComPtr<ID3D12Device2> CreateDevice(Microsoft::WRL::ComPtr<IDXGIAdapter4> adapter);
@@ -143,6 +153,8 @@ private:
 
     std::unique_ptr<DescriptorAllocator> m_DescriptorAllocators[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
 
+    std::unique_ptr<FramePacer> m_FramePacer;
+
     bool m_TearingSupported;
 
     static uint64_t ms_FrameCount;
@@ -0,0 +1,77 @@
+/**
+ * The BlockModelBaker compiles the block model JSON files of a resource pack
+ * (assets/minecraft/blockstates and assets/minecraft/models/block) into the
+ * flat quad table that is read by the BlockModelTable.
+ *
+ * For every variant of every block state file the model is resolved
+ * (parent models, texture variables, elements), the element rotations and
+ * the x/y rotation of the variant are applied and the faces are written as
+ * quads with their cull face. Variants with uvlock get texture coordinates
+ * projected from their rotated positions. Multipart block states (fences,
+ * walls, panes) are expanded into one state per combination of the property
+ * values that appear in their conditions. Variants with several weighted
+ * models use the first model.
+ *
+ * The baked file is written to an output directory of the application and
+ * records the number of source files and a hash of their names, sizes and
+ * write times like the TextureArrayBaker, so it is rebuilt when any file of
+ * the resource pack is added, removed, renamed or rewritten. Later startups
+ * only map the baked file.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class BlockModelBaker
+{
+public:
+    /**
+     * @param assetDirectory The assets/minecraft directory of a resource pack.
+     * @param outputDirectory The directory the baked file is written to.
+     * It is created by Bake if it doesn't exist.
+     */
+    BlockModelBaker(const std::wstring& assetDirectory, const std::wstring& outputDirectory);
+    virtual ~BlockModelBaker();
+
+    /**
+     * The baked file of the asset directory
+     * (<outputDirectory>/<asset directory name>.blockmodels).
+     */
+    const std::wstring& GetBakedFileName() const
+    {
+        return m_BakedFileName;
+    }
+
+    /**
+     * Check if the baked file exists and is up to date with the source files.
+     */
+    bool IsBakeCurrent() const;
+
+    /**
+     * Compile all block state files and write the baked file.
+     * Block state files that can't be parsed and variants that reference
+     * missing models are skipped. Returns the number of baked block states.
+     */
+    uint32_t Bake();
+
+    /**
+     * Bake the models if the baked file is missing or out of date.
+     * Returns the baked file name.
+     */
+    const std::wstring& BakeIfNeeded();
+
+private:
+    struct SourceSignature
+    {
+        uint32_t NumFiles = 0;
+        // A hash of the name, size and write time of every source file, in name order.
+        uint64_t Hash = 0;
+    };
+
+    SourceSignature ScanSourceFiles() const;
+
+    std::wstring m_AssetDirectory;
+    std::wstring m_OutputDirectory;
+    std::wstring m_BakedFileName;
+};
@@ -0,0 +1,185 @@
+/**
+ * The baked block models: a flat table of pre-transformed quads for every
+ * block state, written by the BlockModelBaker and read through a memory
+ * mapping of the baked file.
+ *
+ * A block state is named like the model resource locations of the game,
+ * <block>#<variant>, for example "oak_stairs#facing=east,half=bottom,shape=straight".
+ * Variants list their properties sorted by name. Look the states up once by
+ * name with FindState and keep the index; the mesher then reads the quads of
+ * a state directly from the mapping without parsing or allocating.
+ *
+ * Quads are in block space (0..1 on each axis for a full block, x east, y up
+ * and z south), with parent models, texture variables, element rotations and
+ * the x/y rotations of the variant already applied. Textures are stored as
+ * an index into the texture name table of the file, use
+ * ResolveTextureLayers to map them to the layers of the block texture array.
+ */
+#pragma once
+
+#include <MappedFile.h>
+#include <TextureArrayBaker.h>
+#include <VoxelVertex.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#pragma pack(push, 4)
+struct BlockModelFileHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    // The source files the table was baked from, to detect when a rebake is needed.
+    uint32_t NumSourceFiles;
+    uint32_t Reserved;
+    // A hash of the name, size and write time of every source file, in name order.
+    uint64_t SourceHash;
+    // The offsets of the tables are in bytes from the start of the file.
+    uint32_t NumStates;
+    uint32_t StatesOffset;
+    uint32_t NumQuads;
+    uint32_t QuadsOffset;
+    uint32_t NumTextures;
+    uint32_t TexturesOffset;
+    uint32_t StringsSize;
+    uint32_t StringsOffset;
+};
+
+struct BakedBlockState
+{
+    // Offset of the null terminated name in the string table.
+    uint32_t NameOffset;
+    // The quads of the state. States with the same model share their quads.
+    uint32_t FirstQuad;
+    uint16_t NumQuads;
+    // One bit per VoxelFace for the faces of the block that are completely covered by a quad.
+    uint8_t FullFaces;
+    uint8_t Flags;
+};
+
+struct BakedQuad
+{
+    // The corners in block units, in the order of the UVs.
+    float Positions[4][3];
+    // The texture coordinates of the corners (0..1 across the texture).
+    float UVs[4][2];
+    // Index into the texture name table.
+    uint16_t Texture;
+    // The direction the quad faces (a VoxelFace), for lighting.
+    uint8_t Face;
+    // The neighbour (a VoxelFace) that hides the quad when it is opaque, or NoCullFace.
+    uint8_t CullFace;
+    // The tint index of the model face, -1 if the face is not tinted.
+    int8_t TintIndex;
+    uint8_t Flags;
+    uint16_t Reserved;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(BlockModelFileHeader) == 56, "The layout of the baked block model file has changed.");
+static_assert(sizeof(BakedBlockState) == 12, "The layout of the baked block model file has changed.");
+static_assert(sizeof(BakedQuad) == 88, "The layout of the baked block model file has changed.");
+
+class BlockModelTable
+{
+public:
+    static const uint32_t FileMagic = 0x4C444D42; // 'BMDL'
+    static const uint32_t FileVersion = 2;
+
+    static const uint32_t InvalidState = UINT32_MAX;
+    static const uint32_t InvalidLayer = UINT32_MAX;
+    static const uint8_t NoCullFace = 0xFF;
+
+    // BakedBlockState::Flags
+    static const uint8_t StateAmbientOcclusion = 0x1;
+    // BakedQuad::Flags
+    static const uint8_t QuadShade = 0x1;
+
+    BlockModelTable();
+    BlockModelTable(BlockModelTable&& other);
+    BlockModelTable& operator=(BlockModelTable&& other);
+    virtual ~BlockModelTable();
+
+    BlockModelTable(const BlockModelTable&) = delete;
+    BlockModelTable& operator=(const BlockModelTable&) = delete;
+
+    /**
+     * Map a baked block model file. Throws if the file can't be mapped or
+     * is not a valid baked file of the current version.
+     */
+    void Open(const std::wstring& fileName);
+    void Close();
+
+    bool IsOpen() const
+    {
+        return m_Header != nullptr;
+    }
+
+    /**
+     * Read the header of a baked file without mapping it.
+     * Returns false if the file does not exist or is not a baked file of the current version.
+     */
+    static bool ReadHeader(const std::wstring& fileName, BlockModelFileHeader& header);
+
+    uint32_t GetNumStates() const
+    {
+        return m_Header ? m_Header->NumStates : 0;
+    }
+
+    const BakedBlockState& GetState(uint32_t state) const
+    {
+        return m_States[state];
+    }
+
+    /**
+     * The first quad of a state. The state has GetState(state).NumQuads quads.
+     */
+    const BakedQuad* GetQuads(uint32_t state) const
+    {
+        return m_Quads + m_States[state].FirstQuad;
+    }
+
+    const char* GetStateName(uint32_t state) const
+    {
+        return m_Strings + m_States[state].NameOffset;
+    }
+
+    /**
+     * The index of a state by name, or InvalidState. States are sorted by
+     * name, so this is a binary search of the mapped table.
+     */
+    uint32_t FindState(const char* name) const;
+    uint32_t FindState(const std::string& block, const std::string& variant) const;
+
+    uint32_t GetNumTextures() const
+    {
+        return m_Header ? m_Header->NumTextures : 0;
+    }
+
+    // The name of a texture, like the names of the texture array layer table ("stone").
+    const char* GetTextureName(uint32_t texture) const
+    {
+        return m_Strings + m_TextureNames[texture];
+    }
+
+    /**
+     * The layer of every texture of the table in a baked texture array,
+     * indexed by BakedQuad::Texture. Textures that are not in the array get InvalidLayer.
+     */
+    std::vector<uint32_t> ResolveTextureLayers(const TextureArrayBaker::LayerTable& layers) const;
+
+    static bool HasFullFace(const BakedBlockState& state, VoxelFace face)
+    {
+        return (state.FullFaces & (1u << static_cast<uint32_t>(face))) != 0;
+    }
+
+private:
+    MappedFile m_File;
+
+    const BlockModelFileHeader* m_Header;
+    const BakedBlockState* m_States;
+    const BakedQuad* m_Quads;
+    const uint32_t* m_TextureNames;
+    const char* m_Strings;
+};
@@ -5,12 +5,17 @@
  */
 #pragma once
 
+#include "CommandRecorder.h"
+#include "TextureArrayBaker.h"
+
 #include <d3d12.h>
 #include <wrl.h>
 
+#include <condition_variable> // for std::condition_variable
 #include <map> // for std::map
 #include <memory> // for std::unique_ptr
 #include <mutex> // for std::mutex
+#include <set> // for std::set
 #include <vector> // for std::vector
 
 class Buffer;
@@ -133,6 +138,15 @@ public:
 	 */
 	void LoadTextureFromFile(Texture& texture, const std::wstring& fileName);
 
+	/**
+	 * Load the PNG files of a directory as a Texture2DArray.
+	 * The array is baked to a DDS file in the bake directory the first time
+	 * (and whenever the directory changes), later calls only load the baked file.
+	 *
+	 * @returns The layer of each texture in the array, by file name without extension.
+	 */
+	TextureArrayBaker::LayerTable LoadTextureArray(Texture& texture, const std::wstring& sourceDirectory, const std::wstring& bakeDirectory);
+
 	bool CreateCubeTexture(const wchar_t* name, Texture& texture);
 
 	//void CreateTexture(DXGI_FORMAT format, UINT width, UINT height, UINT arraySize = 1, UINT mipLevel = 1,
@@ -322,6 +336,12 @@ public:
 	// Just close the command list. This is useful for pending command lists.
 	void Close();
 
+	/**
+	 * Get the shards of the global resource state that must be locked while
+	 * the command list is closed (see ResourceStateTracker::LockGlobalState).
+	 */
+	uint32_t GetGlobalStateShards() const;
+
 	/**
 	 * Reset the command list. This should only be called by the CommandQueue
 	 * before the command list is returned from CommandQueue::GetCommandList.
@@ -333,6 +353,13 @@ public:
 	 */
 	void ReleaseTrackedObjects();
 
+	/**
+	 * Retire the upload memory used by the command list. It is reused once the
+	 * command queue has reached fenceValue.
+	 * Used by the command queue.
+	 */
+	void RetireUploadBuffer(uint64_t fenceValue);
+
 	/**
 	 * Set the currently bound descriptor heap.
 	 * Should only be called by the DynamicDescriptorHeap class.
@@ -346,6 +373,15 @@ public:
 
 	void SetName(const wchar_t* name);
 
+	/**
+	 * The recorder that counts (and optionally captures) the commands issued
+	 * on this command list since it was last reset.
+	 */
+	CommandRecorder& GetRecorder()
+	{
+		return m_Recorder;
+	}
+
 protected:
 
 private:
@@ -380,8 +416,9 @@ private:
 	ID3D12RootSignature* m_CurrentRootSignature;
 	ID3D12RootSignature* m_PreviousRootSignature;
 
-	// Resource created in an upload heap. Useful for drawing of dynamic geometry
-	// or for uploading constant buffer data that changes every draw call.
+	// Memory in an upload heap (from the command queue's upload ring buffer).
+	// Useful for drawing of dynamic geometry or for uploading constant buffer
+	// data that changes every draw call.
 	std::unique_ptr<UploadBuffer> m_UploadBuffer;
 
 	// Resource state tracker is used by the command list to track (per command list)
@@ -408,7 +445,14 @@ private:
 	// reset.
 	TrackedObjects m_TrackedObjects;
 
+	// Records the commands issued on this command list for profiling.
+	CommandRecorder m_Recorder;
+
 	// Keep track of loaded textures to avoid loading the same texture multiple times.
-	static std::map<std::wstring, ID3D12Resource* > ms_TextureCache;
+	// The cache holds a reference to the textures, so cached resources stay valid.
+	static std::map<std::wstring, Microsoft::WRL::ComPtr<ID3D12Resource> > ms_TextureCache;
+	// The files that are being loaded by a thread. Other threads wait for them on the condition.
+	static std::set<std::wstring> ms_TexturesLoading;
 	static std::mutex ms_TextureCacheMutex;
+	static std::condition_variable ms_TextureCacheCondition;
 };
\ No newline at end of file
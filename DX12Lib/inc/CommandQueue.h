@@ -3,13 +3,21 @@
  */
 #pragma once
 
-#include <d3d12.h>  // For ID3D12CommandQueue, ID3D12Device2, and ID3D12Fence
-#include <wrl.h>    // For Microsoft::WRL::ComPtr
+#include <d3d12.h>      // For ID3D12CommandQueue, ID3D12Device2, and ID3D12Fence
+#include <wrl.h>        // For Microsoft::WRL::ComPtr
 
-#include <cstdint>  // For uint64_t
-#include <queue>    // For std::queue
+#include <atomic>       // For std::atomic
+#include <cstdint>      // For uint64_t
+#include <functional>   // For std::function
+#include <memory>       // For std::unique_ptr
+#include <mutex>        // For std::mutex
+#include <queue>        // For std::queue
+#include <thread>       // For std::thread
+#include <vector>       // For std::vector
 
 class CommandList;
+class UploadRingBuffer;
+class WorkerPool;
 
 class CommandQueue
 {
@@ -17,14 +25,30 @@ public:
     CommandQueue(D3D12_COMMAND_LIST_TYPE type);
     virtual ~CommandQueue();
 
-    // Get an available command list from the command queue.
+    // Get an available command list from the command queue. Thread safe.
     std::shared_ptr<CommandList> GetCommandList();
 
+    // Records [first, last) of a range of work items on a command list.
+    using RecordFunction = std::function<void(CommandList& commandList, size_t first, size_t last)>;
+
+    // Record numItems work items on up to numWorkers command lists in parallel.
+    // The items are split into contiguous ranges, one per command list, and
+    // recordFunc is called for the ranges on the persistent recording threads
+    // of the queue and the calling thread. Every command list has its own
+    // dynamic descriptor heaps, upload buffer and resource state tracker, so
+    // recordFunc must set up all state it needs (render targets, root
+    // signature, pipeline state, etc.) on the command list it is given.
+    // The command lists are returned in the order of their ranges. Pass them to
+    // a single ExecuteCommandLists call to keep the resource states correct.
+    std::vector<std::shared_ptr<CommandList> > RecordCommandLists(size_t numItems, const RecordFunction& recordFunc,
+        uint32_t numWorkers = std::thread::hardware_concurrency());
+
     // Execute a command list.
     // Returns the fence value to wait for for this command list.
     uint64_t ExecuteCommandList(std::shared_ptr<CommandList> commandList);
     uint64_t ExecuteCommandLists( const std::vector<std::shared_ptr<CommandList> >& commandLists );
 
+    // Signal the next fence value. Thread safe.
     uint64_t Signal();
     bool IsFenceComplete(uint64_t fenceValue);
     void WaitForFenceValue(uint64_t fenceValue);
@@ -35,6 +59,12 @@ public:
 
     Microsoft::WRL::ComPtr<ID3D12CommandQueue> GetD3D12CommandQueue() const;
 
+    // The upload ring buffer shared by the command lists of this queue.
+    UploadRingBuffer& GetUploadRingBuffer() const
+    {
+        return *m_UploadRingBuffer;
+    }
+
 private:
     // Keep track of command allocators that are "in-flight"
     struct CommandListEntry
@@ -45,11 +75,27 @@ private:
 
     using CommandListQueue = std::queue<CommandListEntry>;
 
+    // Signal the next fence value with the submit mutex held.
+    uint64_t SignalLocked();
+
     D3D12_COMMAND_LIST_TYPE                     m_CommandListType;
     Microsoft::WRL::ComPtr<ID3D12CommandQueue>  m_d3d12CommandQueue;
     Microsoft::WRL::ComPtr<ID3D12Fence>         m_d3d12Fence;
     HANDLE                                      m_FenceEvent;
-    uint64_t                                    m_FenceValue;
+    // The last signaled fence value. Only written with the submit mutex held,
+    // so the values are signaled on the queue in increasing order.
+    std::atomic<uint64_t>                       m_FenceValue;
+
+    // Declared before the command list queue so it outlives the command lists.
+    std::unique_ptr<UploadRingBuffer>           m_UploadRingBuffer;
 
     CommandListQueue                            m_CommandListQueue;
+    std::mutex                                  m_CommandListQueueMutex;
+
+    // Serializes resolving resource barriers, submitting command lists and signaling the fence.
+    std::mutex                                  m_SubmitMutex;
+
+    // The threads that record command lists, created on first use.
+    std::unique_ptr<WorkerPool>                 m_RecordingPool;
+    std::once_flag                              m_RecordingPoolFlag;
 };
\ No newline at end of file
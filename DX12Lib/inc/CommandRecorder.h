@@ -0,0 +1,133 @@
+/**
+ * The CommandRecorder records the commands that a CommandList issues into an
+ * inspectable stream and counts the CPU-side work of a frame (draws, dispatches,
+ * barriers, state changes and bytes uploaded).
+ *
+ * Counters are always collected. The command stream is only captured when
+ * capturing is enabled with CommandRecorder::SetCaptureEnabled, so the
+ * recorder can be left in release builds.
+ *
+ * Every command list that is executed on a CommandQueue submits its counters
+ * to the frame statistics, which are closed with CommandRecorder::EndFrame
+ * (called by Window::Present).
+ *
+ * The recorder sits next to the real ID3D12GraphicsCommandList, it is not a
+ * null device: resources, fences and command lists are still created on the
+ * device of the Application, so recording a frame needs Windows and D3D12.
+ * There is no headless backend that runs OnRender without a device.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+enum class RecordedCommandType : uint8_t
+{
+    ResourceBarrier,    // Args[0] = number of barriers.
+    Draw,               // Args = vertex count, instance count.
+    DrawIndexed,        // Args = index count, instance count.
+    Dispatch,           // Args = number of groups in x, y, z.
+    CopyResource,
+    CopyBuffer,         // Bytes = size of the buffer.
+    CopyTexture,        // Args[0] = number of subresources, Bytes = upload size.
+    DynamicBuffer,      // Args[0] = root parameter or slot, Bytes = upload size.
+    SetPipelineState,
+    SetRootSignature,
+    SetDescriptorTables,// Args[0] = number of tables, Args[1] = number of descriptors copied, Args[2] = number of descriptors reused.
+    SetDescriptorHeaps,
+    Clear,
+};
+
+struct RecordedCommand
+{
+    RecordedCommandType Type;
+    uint32_t Args[3];
+    uint64_t Bytes;
+};
+
+struct FrameStatistics
+{
+    uint32_t NumCommandLists = 0;
+    uint32_t NumDraws = 0;
+    uint32_t NumDispatches = 0;
+    uint32_t NumBarriers = 0;
+    uint32_t NumCopies = 0;
+    uint32_t NumPipelineStateChanges = 0;
+    uint32_t NumRootSignatureChanges = 0;
+    uint32_t NumDescriptorTables = 0;
+    uint32_t NumDescriptorsCopied = 0;
+    // Descriptors of tables that were already in the GPU visible heap (not copied again).
+    uint32_t NumDescriptorsReused = 0;
+    uint64_t UploadBytes = 0;
+    // CPU time spent recording command lists (from reset to execute).
+    double RecordMilliseconds = 0.0;
+    // CPU time between the previous and this call to EndFrame.
+    double FrameMilliseconds = 0.0;
+
+    FrameStatistics& operator+=(const FrameStatistics& other);
+};
+
+class CommandRecorder
+{
+public:
+    CommandRecorder();
+
+    /**
+     * Record a command. Updates the counters and, if capturing is enabled,
+     * appends the command to the stream.
+     */
+    void Record(RecordedCommandType type, uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0, uint64_t bytes = 0);
+
+    /**
+     * Clear the stream and the counters and restart the record timer.
+     * Called when the command list is reset.
+     */
+    void Reset();
+
+    const std::vector<RecordedCommand>& GetCommands() const
+    {
+        return m_Commands;
+    }
+
+    /**
+     * The counters of the commands recorded since the last reset.
+     * RecordMilliseconds is the time since the last reset.
+     */
+    FrameStatistics GetStatistics() const;
+
+    /**
+     * Enable or disable capturing of the command stream for all command lists.
+     */
+    static void SetCaptureEnabled(bool enabled);
+    static bool IsCaptureEnabled();
+
+    /**
+     * Add the counters of an executed command list to the current frame.
+     * Thread safe.
+     */
+    static void Submit(const FrameStatistics& statistics);
+
+    /**
+     * Close the current frame. The statistics of the closed frame can be
+     * queried with GetLastFrameStatistics.
+     */
+    static void EndFrame();
+    static FrameStatistics GetLastFrameStatistics();
+
+private:
+    using Clock = std::chrono::high_resolution_clock;
+
+    std::vector<RecordedCommand> m_Commands;
+    FrameStatistics m_Statistics;
+    Clock::time_point m_ResetTime;
+
+    // Set on the main thread, read by every thread that records a command list.
+    static std::atomic<bool> ms_CaptureEnabled;
+    static std::mutex ms_FrameMutex;
+    static FrameStatistics ms_CurrentFrame;
+    static FrameStatistics ms_LastFrame;
+    static Clock::time_point ms_FrameStart;
+};
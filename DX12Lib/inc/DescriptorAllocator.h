@@ -7,6 +7,13 @@
  * Variable sized memory allocation strategy based on:
  * http://diligentgraphics.com/diligent-engine/architecture/d3d12/variable-size-memory-allocations-manager/
  * Date Accessed: May 9, 2018
+ *
+ * Every thread that allocates descriptors gets its own cache of descriptor
+ * heap pages. Whole pages are handed out to a thread at a time, so the shared
+ * allocator lock is only taken when a thread needs a new page, and threads
+ * never contend for the same page while allocating. When a thread exits, its
+ * pages are returned to a shared pool and handed to the next thread that
+ * needs a page.
  */
 #pragma once
 
@@ -14,10 +21,10 @@
 
 #include "d3dx12.h"
 
+#include <atomic>
 #include <cstdint>
 #include <mutex>
 #include <memory>
-#include <set>
 #include <vector>
 
 class DescriptorAllocatorPage;
@@ -30,6 +37,7 @@ public:
 
     /**
      * Allocate a number of contiguous descriptors from a CPU visible descriptor heap.
+     * The descriptors are allocated from the pages of the calling thread.
      * 
      * @param numDescriptors The number of contiguous descriptors to allocate. 
      * Cannot be more than the number of descriptors per descriptor heap.
@@ -38,23 +46,68 @@ public:
 
     /**
      * When the frame has completed, the stale descriptors can be released.
+     * Each thread cache is locked in turn; allocations on other threads are
+     * not blocked by a shared lock while the descriptors are released.
      */
     void ReleaseStaleDescriptors( uint64_t frameNumber );
 
+    /**
+     * The number of descriptor heap pages that were created.
+     */
+    size_t GetNumPages();
+
+    /**
+     * The number of pages returned by exited threads that no thread has taken yet.
+     */
+    size_t GetNumFreePages();
+
 protected:
 
 private:
     using DescriptorHeapPool = std::vector< std::shared_ptr<DescriptorAllocatorPage> >;
 
+    // The pages of threads that have exited. Shared with the thread caches,
+    // so an exiting thread can return its pages without the allocator.
+    struct FreePagePool
+    {
+        std::mutex Mutex;
+        DescriptorHeapPool Pages;
+    };
+
+    // The descriptor heap pages owned by one thread.
+    struct ThreadCache
+    {
+        // Only contended while stale descriptors are released.
+        std::mutex Mutex;
+        DescriptorHeapPool Pages;
+        // Where the pages go when the thread exits.
+        std::weak_ptr<FreePagePool> FreePages;
+        // Set when the thread has exited, the cache is removed by the allocator.
+        std::atomic<bool> Exited{ false };
+    };
+
+    // Get (or create) the cache of the calling thread.
+    std::shared_ptr<ThreadCache> GetThreadCache();
+
     // Create a new heap with a specific number of descriptors.
     std::shared_ptr<DescriptorAllocatorPage> CreateAllocatorPage();
 
+    // Take a page of an exited thread that can satisfy the request.
+    // Returns null if there is none.
+    std::shared_ptr<DescriptorAllocatorPage> TakeFreePage( uint32_t numDescriptors );
+
     D3D12_DESCRIPTOR_HEAP_TYPE m_HeapType;
     uint32_t m_NumDescriptorsPerHeap;
 
+    // Uniquely identifies this allocator in the thread local cache lookup.
+    uint64_t m_Id;
+
     DescriptorHeapPool m_HeapPool;
-    // Indices of available heaps in the heap pool.
-    std::set<size_t> m_AvailableHeaps;
+    std::vector< std::shared_ptr<ThreadCache> > m_ThreadCaches;
+    std::shared_ptr<FreePagePool> m_FreePages;
 
+    // Guards the heap pool and the thread cache list.
     std::mutex m_AllocationMutex;
+
+    static std::atomic<uint64_t> ms_NextId;
 };
\ No newline at end of file
@@ -1,22 +1,22 @@
 /**
  * A descriptor heap (page for the DescriptorAllocator class).
  *
- * Variable sized memory allocation strategy based on:
- * http://diligentgraphics.com/diligent-engine/architecture/d3d12/variable-size-memory-allocations-manager/
- * Date Accessed: May 9, 2018
+ * Descriptor ranges are allocated from the heap with a TLSF range allocator,
+ * which allocates and frees (with coalescing) in constant time.
  */
 #pragma  once;
 
 #include "DescriptorAllocation.h"
+#include "TLSFAllocator.h"
 
 #include "d3dx12.h"
 
 #include <wrl.h>
 
-#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 class DescriptorAllocatorPage : public std::enable_shared_from_this<DescriptorAllocatorPage>
 {
@@ -61,10 +61,8 @@ protected:
     // Compute the offset of the descriptor handle from the start of the heap.
     uint32_t ComputeOffset( D3D12_CPU_DESCRIPTOR_HANDLE handle );
 
-    // Adds a new block to the free list.
-    void AddNewBlock( uint32_t offset, uint32_t numDescriptors );
-
-    // Free a block of descriptors.
+    // Free a block of descriptors. numDescriptors must be the size the block
+    // was allocated with (checked in debug builds).
     // This will also merge free blocks in the free list to form larger blocks
     // that can be reused.
     void FreeBlock( uint32_t offset, uint32_t numDescriptors );
@@ -75,29 +73,11 @@ private:
     // The number of descriptors that are available.
     using SizeType = uint32_t;
 
-    struct FreeBlockInfo;
-    // A map that lists the free blocks by the offset within the descriptor heap.
-    using FreeListByOffset = std::map<OffsetType, FreeBlockInfo>;
-
-    // A map that lists the free blocks by size.
-    // Needs to be a multimap since multiple blocks can have the same size.
-    using FreeListBySize = std::multimap<SizeType, FreeListByOffset::iterator>;
-
     struct StaleDescriptorInfo;
     // Stale descriptors are queued for release until the frame that they were freed
     // has completed.
     using StaleDescriptorQueue = std::queue<StaleDescriptorInfo>;
 
-    struct FreeBlockInfo
-    {
-        FreeBlockInfo( SizeType size )
-            : Size( size )
-        {}
-
-        SizeType Size;
-        FreeListBySize::iterator FreeListBySizeIt;
-    };
-
     struct StaleDescriptorInfo
     {
         StaleDescriptorInfo( OffsetType offset, SizeType size, uint64_t frame )
@@ -114,8 +94,9 @@ private:
         uint64_t FrameNumber;
     };
 
-    FreeListByOffset m_FreeListByOffset;
-    FreeListBySize m_FreeListBySize;
+    TLSFAllocator<OffsetType> m_Allocator;
+    // The allocator node of each allocated block, indexed by the offset of the block.
+    std::vector<uint32_t> m_AllocationNodes;
     StaleDescriptorQueue m_StaleDescriptors;
 
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_d3d12DescriptorHeap;
@@ -123,7 +104,6 @@ private:
     CD3DX12_CPU_DESCRIPTOR_HANDLE m_BaseDescriptor;
     uint32_t m_DescriptorHandleIncrementSize;
     uint32_t m_NumDescriptorsInHeap;
-    uint32_t m_NumFreeHandles;
 
     std::mutex m_AllocationMutex;
 };
\ No newline at end of file
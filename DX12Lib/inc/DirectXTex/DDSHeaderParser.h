@@ -0,0 +1,96 @@
+//--------------------------------------------------------------------------------------
+// File: DDSHeaderParser.h
+//
+// Functions for parsing the header of a DDS file and locating its subresources,
+// separated from the creation of the Direct3D resource in DDSTextureLoader12.
+//
+// These functions only read memory: they do not use the device or the file system,
+// so a DDS file can be inspected (or mapped into memory and uploaded in place)
+// without a device. The header does not include d3d12.h: the resource dimension and
+// the subresources have their own types, with the values and the layout of the
+// Direct3D 12 ones.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248926
+// http://go.microsoft.com/fwlink/?LinkID=615561
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <windows.h>
+#include <dxgiformat.h>
+
+#include <vector>
+#include <stdint.h>
+
+
+namespace DirectX
+{
+    enum DDS_ALPHA_MODE
+    {
+        DDS_ALPHA_MODE_UNKNOWN       = 0,
+        DDS_ALPHA_MODE_STRAIGHT      = 1,
+        DDS_ALPHA_MODE_PREMULTIPLIED = 2,
+        DDS_ALPHA_MODE_OPAQUE        = 3,
+        DDS_ALPHA_MODE_CUSTOM        = 4,
+    };
+
+    // The values of D3D12_RESOURCE_DIMENSION (and of the DX10 header extension).
+    enum DDS_RESOURCE_DIMENSION
+    {
+        DDS_DIMENSION_UNKNOWN   = 0,
+        DDS_DIMENSION_TEXTURE1D = 2,
+        DDS_DIMENSION_TEXTURE2D = 3,
+        DDS_DIMENSION_TEXTURE3D = 4,
+    };
+
+    // Laid out like D3D12_SUBRESOURCE_DATA.
+    struct DDS_SUBRESOURCE_DATA
+    {
+        const void* pData;
+        intptr_t    RowPitch;
+        intptr_t    SlicePitch;
+    };
+
+    // The size of the magic number, the header and the DX10 header extension.
+    // Reading this many bytes is enough to parse the header of any DDS file.
+    const size_t DDS_MAX_HEADER_SIZE = sizeof(uint32_t) + 124 + 20;
+
+    struct DDS_TEXTURE_DESC
+    {
+        DDS_RESOURCE_DIMENSION      dimension;
+        DXGI_FORMAT                 format;
+        uint32_t                    width;
+        uint32_t                    height;
+        uint32_t                    depth;
+        uint32_t                    arraySize;  // Six slices per cube for cube maps.
+        uint32_t                    mipCount;
+        bool                        isCubeMap;
+        DDS_ALPHA_MODE              alphaMode;
+        size_t                      bitOffset;  // Offset of the surface data from the start of the file.
+    };
+
+    // Validate the header of a DDS file and describe the texture it contains.
+    // Only the first DDS_MAX_HEADER_SIZE bytes (or the whole file, if smaller) are read.
+    HRESULT __cdecl ParseDDSHeader(
+        _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+        size_t ddsDataSize,
+        DDS_TEXTURE_DESC& desc);
+
+    // Locate the subresources of a parsed DDS file in its surface data. The subresources
+    // point into bitData, nothing is copied. Mips larger than maxsize (if not 0) are skipped,
+    // the size of the largest remaining mip and the number of skipped mips are returned.
+    HRESULT __cdecl GetDDSSubresources(
+        const DDS_TEXTURE_DESC& desc,
+        size_t numberOfPlanes,
+        size_t maxsize,
+        _In_reads_bytes_(bitSize) const uint8_t* bitData,
+        size_t bitSize,
+        _Out_ size_t& width,
+        _Out_ size_t& height,
+        _Out_ size_t& depth,
+        _Out_ size_t& skipMip,
+        std::vector<DDS_SUBRESOURCE_DATA>& subresources);
+}
@@ -18,6 +18,10 @@
 
 #include <d3d12.h>
 
+#include "DDSHeaderParser.h"
+
+#include <MappedFile.h>
+
 #include <memory>
 #include <vector>
 #include <stdint.h>
@@ -25,15 +29,6 @@
 
 namespace DirectX
 {
-    enum DDS_ALPHA_MODE
-    {
-        DDS_ALPHA_MODE_UNKNOWN       = 0,
-        DDS_ALPHA_MODE_STRAIGHT      = 1,
-        DDS_ALPHA_MODE_PREMULTIPLIED = 2,
-        DDS_ALPHA_MODE_OPAQUE        = 3,
-        DDS_ALPHA_MODE_CUSTOM        = 4,
-    };
-
     enum DDS_LOADER_FLAGS
     {
         DDS_LOADER_DEFAULT = 0,
@@ -86,4 +81,32 @@ namespace DirectX
         std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
         _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
         _Out_opt_ bool* isCubeMap = nullptr);
+
+    // A read-only memory mapping of a whole DDS file, unmapped when destroyed.
+    class DDSFileMapping
+    {
+    public:
+        HRESULT __cdecl Open(_In_z_ const wchar_t* fileName);
+        void __cdecl Close() noexcept { m_file.Close(); }
+
+        const uint8_t* data() const { return m_file.GetData(); }
+        size_t size() const { return m_file.GetSize(); }
+
+    private:
+        MappedFile  m_file;
+    };
+
+    // Memory mapped version. The file is not read into memory: the subresources
+    // point into the mapping, which must be kept open until they have been copied.
+    HRESULT __cdecl LoadDDSTextureFromFileEx(
+        _In_ ID3D12Device* d3dDevice,
+        _In_z_ const wchar_t* szFileName,
+        size_t maxsize,
+        D3D12_RESOURCE_FLAGS resFlags,
+        unsigned int loadFlags,
+        _Outptr_ ID3D12Resource** texture,
+        DDSFileMapping& ddsFile,
+        std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+        _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+        _Out_opt_ bool* isCubeMap = nullptr);
 }
@@ -0,0 +1,60 @@
+//--------------------------------------------------------------------------------------
+// File: MipChainGenerator.h
+//
+// Functions for generating the mip chain of R8G8B8A8 images on the CPU, so mips can
+// be produced when textures are baked or loaded without a compute pass on the GPU.
+//
+// Filtering is done on DirectXMath vectors (SSE/AVX) in linear space: sRGB images
+// are linearized before filtering and encoded again afterwards. For cutout textures
+// (e.g. leaves) the alpha of each mip can be scaled so that the fraction of pixels
+// that pass the alpha test stays the same as in the top level.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <d3d12.h>
+#include <stdint.h>
+
+class WorkerPool;
+
+namespace DirectX
+{
+    enum MIP_FILTER_FLAGS
+    {
+        MIP_FILTER_BOX = 0,
+        MIP_FILTER_KAISER = 0x1,            // Kaiser windowed sinc instead of a 2x2 box.
+        MIP_FILTER_SRGB = 0x2,              // The pixels are sRGB encoded, filter in linear space.
+        MIP_FILTER_WRAP = 0x4,              // Wrap at the edges (tiling textures) instead of clamping.
+        MIP_FILTER_ALPHA_COVERAGE = 0x8,    // Preserve the alpha test coverage of the top level.
+    };
+
+    struct MipChainImage
+    {
+        // All mip levels, tightly packed one after the other (the layout of a DDS file).
+        // Level 0 is read, the other levels are written.
+        uint8_t* pixels;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipLevels;
+    };
+
+    // The number of mip levels of a full chain down to 1x1.
+    uint32_t __cdecl CountMipLevels(uint32_t width, uint32_t height);
+
+    // The size in bytes of the first mipLevels levels of an R8G8B8A8 image.
+    size_t __cdecl ComputeMipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels);
+
+    HRESULT __cdecl GenerateMipChain(
+        const MipChainImage& image,
+        unsigned int filterFlags,
+        float alphaReference = 0.5f);
+
+    // Generate the mip chains of many images, one task per image on the threads of the pool.
+    // Without a pool the images are processed on the calling thread.
+    HRESULT __cdecl GenerateMipChains(
+        _In_reads_(numImages) const MipChainImage* images,
+        size_t numImages,
+        unsigned int filterFlags,
+        float alphaReference = 0.5f,
+        _In_opt_ WorkerPool* pool = nullptr);
+}
@@ -4,6 +4,13 @@
  * or Dispatch command is executed.
  * The DynamicDescriptorHeap class is based on the one provided by the MiniEngine:
  * https://github.com/Microsoft/DirectX-Graphics-Samples
+ *
+ * Descriptor tables that have already been copied to the current GPU visible
+ * descriptor heap are remembered (keyed by a hash of the staged CPU handles),
+ * so committing the same table again, e.g. for many draws that share one
+ * texture, binds the existing copy instead of copying the descriptors again.
+ * This assumes the contents of a CPU descriptor do not change while the
+ * command list is being recorded.
  */
 #pragma once
 
@@ -12,8 +19,11 @@
 #include <wrl.h>
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <queue>
+#include <unordered_map>
+#include <vector>
 
 class CommandList;
 class RootSignature;
@@ -92,6 +102,14 @@ private:
     // to GPU visible descriptor heaps.
     uint32_t ComputeStaleDescriptorCount() const;
 
+    // Find a descriptor table with the same CPU handles that was already
+    // copied to the current descriptor heap.
+    bool FindCachedDescriptorTable(uint64_t hash, const D3D12_CPU_DESCRIPTOR_HANDLE* descriptors, uint32_t numDescriptors, D3D12_GPU_DESCRIPTOR_HANDLE& gpuDescriptor) const;
+    // Remember a descriptor table that was copied to the current descriptor heap.
+    void AddCachedDescriptorTable(uint64_t hash, const D3D12_CPU_DESCRIPTOR_HANDLE* descriptors, uint32_t numDescriptors, D3D12_GPU_DESCRIPTOR_HANDLE gpuDescriptor);
+    // Forget all cached descriptor tables (when the current descriptor heap changes).
+    void ClearDescriptorTableCache();
+
     /**
      * The maximum number of descriptor tables per root signature.
      * A 32-bit mask is used to keep track of the root parameter indices that
@@ -164,5 +182,17 @@ private:
     CD3DX12_CPU_DESCRIPTOR_HANDLE m_CurrentCPUDescriptorHandle;
 
     uint32_t m_NumFreeHandles;
-    
+
+    // A descriptor table that was copied to the current descriptor heap.
+    struct CachedDescriptorTable
+    {
+        // The range of the CPU handles in m_CachedDescriptorHandles.
+        uint32_t FirstHandle;
+        uint32_t NumDescriptors;
+        D3D12_GPU_DESCRIPTOR_HANDLE GPUDescriptor;
+    };
+
+    // Copied descriptor tables by the hash of their CPU handles.
+    std::unordered_map<uint64_t, CachedDescriptorTable> m_CachedDescriptorTables;
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_CachedDescriptorHandles;
 };
\ No newline at end of file
@@ -0,0 +1,80 @@
+/**
+ * The FramePacer limits how many frames the CPU may record ahead of the GPU.
+ *
+ * Every frame that is closed with EndFrame signals the command queue and is
+ * kept in flight until the GPU has reached that fence value. The CPU only
+ * waits when the configured number of frames is already in flight, so it
+ * never waits on the GPU unless it is genuinely that far ahead.
+ *
+ * Resources that are replaced while the GPU may still use them (like a
+ * resized depth buffer) need no deferred release here: the command lists
+ * that reference them keep them alive until they complete on the GPU.
+ */
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+class CommandQueue;
+
+class FramePacer
+{
+public:
+    static const uint32_t MaxFramesInFlight = 8;
+
+    /**
+     * @param commandQueue The queue that is signaled at the end of every frame.
+     * @param numFramesInFlight The number of frames the CPU may record ahead of the GPU.
+     */
+    FramePacer(std::shared_ptr<CommandQueue> commandQueue, uint32_t numFramesInFlight);
+    virtual ~FramePacer();
+
+    uint32_t GetNumFramesInFlight() const
+    {
+        return m_NumFramesInFlight;
+    }
+
+    /**
+     * Change the number of frames in flight (clamped to [1, MaxFramesInFlight]).
+     * Takes effect when the next frame is closed.
+     */
+    void SetNumFramesInFlight(uint32_t numFramesInFlight);
+
+    /**
+     * Close the current frame. Signals the command queue and, if more than
+     * the allowed number of frames are in flight, waits for the oldest ones.
+     * Completed frames are retired.
+     * @returns The number of the most recent frame that has completed on the GPU.
+     */
+    uint64_t EndFrame(uint64_t frameNumber);
+
+    /**
+     * Retire all frames that have completed on the GPU without waiting.
+     * Call after the command queue was flushed.
+     */
+    void RetireCompletedFrames();
+
+private:
+    struct Frame
+    {
+        uint64_t FenceValue;
+        uint64_t FrameNumber;
+    };
+
+    // Retire completed frames from the front of m_FramesInFlight.
+    // The mutex must be locked by the caller.
+    void RetireFrames();
+
+    std::shared_ptr<CommandQueue> m_CommandQueue;
+    uint32_t m_NumFramesInFlight;
+
+    // The frame that is being recorded.
+    Frame m_CurrentFrame;
+    // Closed frames in submission order.
+    std::deque<Frame> m_FramesInFlight;
+    uint64_t m_LastCompletedFrame;
+
+    std::mutex m_Mutex;
+};
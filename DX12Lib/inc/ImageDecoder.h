@@ -0,0 +1,114 @@
+/**
+ * Decoder-agnostic image loading.
+ *
+ * An ImageDecoder turns the contents of an image file into R8G8B8A8 rows,
+ * laid out like a D3D12_SUBRESOURCE_DATA (RowPitch, SlicePitch), so the
+ * result can be passed to CommandList::CopyTextureSubresource or fed to the
+ * CPU mip chain generator. Decoders do not depend on Windows or COM, so the
+ * same code runs in the offline asset pipeline on any platform.
+ *
+ * The ImageBatchDecoder picks a decoder for each file by its signature and
+ * decodes a list of files on a pool of worker threads. It is meant for the
+ * hundreds of small block textures that are baked into a texture array.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct DecodedImage
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    // The size of a row and of the whole image in bytes (4 bytes per pixel, tightly packed).
+    size_t RowPitch = 0;
+    size_t SlicePitch = 0;
+    // The R8G8B8A8 pixels, nullptr if the image could not be decoded.
+    std::unique_ptr<uint8_t[]> Pixels;
+
+    // Format metadata of the source image.
+    // The image declares that it is sRGB encoded.
+    bool IsSRGB = false;
+    // The image has an alpha channel or a transparent color.
+    bool HasAlpha = false;
+    // The number of bits per channel before conversion to 8 bits.
+    uint32_t SourceBitDepth = 0;
+};
+
+class ImageDecoder
+{
+public:
+    virtual ~ImageDecoder() {}
+
+    /**
+     * Check the signature of the data. Only the first bytes are read.
+     */
+    virtual bool CanDecode(const uint8_t* data, size_t size) const = 0;
+
+    /**
+     * Decode the data into R8G8B8A8 rows.
+     * Returns false if the data is invalid or uses an unsupported feature.
+     * Must be safe to call from several threads at once.
+     */
+    virtual bool Decode(const uint8_t* data, size_t size, DecodedImage& image) const = 0;
+};
+
+class ImageBatchDecoder
+{
+public:
+    struct Statistics
+    {
+        size_t NumImages;
+        size_t NumDecoded;
+        // The total size of the files that were read.
+        uint64_t NumBytesRead;
+        // The time the whole batch took, including reading the files.
+        double Seconds;
+        double ImagesPerSecond;
+    };
+
+    /**
+     * @param numWorkers The number of worker threads of a batch. If 0, one
+     * worker per hardware thread is used.
+     * The PNG decoder is registered by default.
+     */
+    ImageBatchDecoder(uint32_t numWorkers = 0);
+    virtual ~ImageBatchDecoder();
+
+    /**
+     * Register another decoder. Decoders are tried in the order they were added.
+     */
+    void AddDecoder(std::unique_ptr<ImageDecoder> decoder);
+
+    /**
+     * The decoder that accepts the data, or nullptr if there is none.
+     */
+    const ImageDecoder* FindDecoder(const uint8_t* data, size_t size) const;
+
+    bool Decode(const uint8_t* data, size_t size, DecodedImage& image) const;
+    bool DecodeFile(const std::string& fileName, DecodedImage& image) const;
+    bool DecodeFile(const std::wstring& fileName, DecodedImage& image) const;
+
+    /**
+     * Decode a list of files in parallel. images receives one entry per file,
+     * in the same order; files that can't be decoded have no pixels.
+     */
+    Statistics DecodeFiles(const std::vector<std::string>& fileNames, std::vector<DecodedImage>& images) const;
+    Statistics DecodeFiles(const std::vector<std::wstring>& fileNames, std::vector<DecodedImage>& images) const;
+
+    /**
+     * Read a whole file into memory.
+     */
+    static bool ReadFile(const std::string& fileName, std::vector<uint8_t>& data);
+    static bool ReadFile(const std::wstring& fileName, std::vector<uint8_t>& data);
+
+private:
+    template<typename FileName>
+    Statistics DecodeFileList(const std::vector<FileName>& fileNames, std::vector<DecodedImage>& images) const;
+
+    std::vector<std::unique_ptr<ImageDecoder> > m_Decoders;
+    uint32_t m_NumWorkers;
+};
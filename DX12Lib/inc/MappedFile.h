@@ -0,0 +1,121 @@
+/**
+ * A read-only memory mapping of a whole file, unmapped when destroyed.
+ *
+ * Used for the files that are read in place: baked block models, DDS files
+ * and the chunk cache of the viewer. The view keeps the file mapping alive,
+ * so neither the file handle nor the mapping handle is kept open.
+ *
+ * Header only, so projects that don't link DX12Lib can use it.
+ */
+#pragma once
+
+#include <windows.h>
+
+#include <cstddef>
+#include <cstdint>
+
+class MappedFile
+{
+public:
+    MappedFile() noexcept
+        : m_View(nullptr)
+        , m_Size(0)
+    {}
+
+    MappedFile(MappedFile&& other) noexcept
+        : m_View(other.m_View)
+        , m_Size(other.m_Size)
+    {
+        other.m_View = nullptr;
+        other.m_Size = 0;
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Close();
+
+            m_View = other.m_View;
+            m_Size = other.m_Size;
+
+            other.m_View = nullptr;
+            other.m_Size = 0;
+        }
+        return *this;
+    }
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * Map a file. Returns false if the file can't be opened or mapped (empty
+     * files can't be mapped), GetLastError tells why.
+     * @param shareMode The sharing mode of the file while it is mapped.
+     */
+    bool Open(const wchar_t* fileName, DWORD shareMode = FILE_SHARE_READ)
+    {
+        Close();
+
+        HANDLE file = CreateFileW(fileName, GENERIC_READ, shareMode, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize = {};
+        HANDLE mapping = GetFileSizeEx(file, &fileSize) ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+        void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+        // Closing the handles must not overwrite the error of a failed call.
+        DWORD error = GetLastError();
+        if (mapping)
+        {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        if (!view)
+        {
+            SetLastError(error);
+            return false;
+        }
+
+        m_View = view;
+        m_Size = static_cast<size_t>(fileSize.QuadPart);
+        return true;
+    }
+
+    void Close() noexcept
+    {
+        if (m_View)
+        {
+            UnmapViewOfFile(m_View);
+        }
+        m_View = nullptr;
+        m_Size = 0;
+    }
+
+    bool IsOpen() const
+    {
+        return m_View != nullptr;
+    }
+
+    const uint8_t* GetData() const
+    {
+        return static_cast<const uint8_t*>(m_View);
+    }
+
+    size_t GetSize() const
+    {
+        return m_Size;
+    }
+
+private:
+    void* m_View;
+    size_t m_Size;
+};
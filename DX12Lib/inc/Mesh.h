@@ -6,6 +6,7 @@
 #include <CommandList.h>
 #include <VertexBuffer.h>
 #include <IndexBuffer.h>
+#include <VoxelVertex.h>
 
 #include <DirectXMath.h>
 #include <d3d12.h>
@@ -80,12 +81,28 @@ public:
 	DirectX::XMMATRIX World;
 	void Draw(CommandList& commandList);
 
+	// Bind the vertex and index buffers without drawing, so several draws of
+	// the same mesh only bind it once.
+	void Bind(CommandList& commandList);
+	UINT GetIndexCount() const
+	{
+		return m_IndexCount;
+	}
+
 	static std::unique_ptr<Mesh> CreateCube(CommandList& commandList, float size = 1, bool rhcoords = false);
 	static std::unique_ptr<Mesh> CreateSphere(CommandList& commandList, float diameter = 1, size_t tessellation = 16, bool rhcoords = false);
 	static std::unique_ptr<Mesh> CreateCone(CommandList& commandList, float diameter = 1, float height = 1, size_t tessellation = 32, bool rhcoords = false);
 	static std::unique_ptr<Mesh> CreateTorus(CommandList& commandList, float diameter = 1, float thickness = 0.333f, size_t tessellation = 32, bool rhcoords = false);
 	static std::unique_ptr<Mesh> CreatePlane(CommandList& commandList, float width = 1, float height = 1, bool rhcoords = false);
 
+	// A chunk section mesh built by the VoxelMesher, the winding is used as is.
+	// The vertices and indices must not be empty.
+	static std::unique_ptr<Mesh> CreateVoxelMesh(CommandList& commandList, const VoxelVertexCollection& vertices, const std::vector<uint32_t>& indices);
+
+	// A mesh of block model quads, with the texture array layer in the third texture coordinate.
+	// The winding is used as is. The vertices and indices must not be empty.
+	static std::unique_ptr<Mesh> CreateBlockModelMesh(CommandList& commandList, const CubeVertexCollection& vertices, const std::vector<uint32_t>& indices);
+
 protected:
 
 private:
@@ -0,0 +1,208 @@
+/**
+ * The MeshingScheduler builds chunk section meshes on a pool of worker threads.
+ *
+ * Dirty sections are queued with Request and are meshed nearest-first, with
+ * sections in front of the camera preferred over those behind it. Finished
+ * meshes are handed back through a lock-free completion queue and are
+ * integrated on the render thread with Integrate, which respects a per-frame
+ * time budget.
+ *
+ * Each worker owns a scratch buffer that the mesher fills. The finished mesh
+ * is swapped into a result node taken from a free list, and Integrate returns
+ * the node with its buffers to the free list. Once there are enough nodes for
+ * the results in flight and their buffers have grown to the largest mesh,
+ * meshing a section and integrating it don't allocate.
+ */
+#pragma once
+
+#include <VoxelVertex.h>
+
+#include <DirectXMath.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class Camera;
+
+class MeshingScheduler
+{
+public:
+    // Section coordinates (in units of 16 blocks).
+    struct SectionKey
+    {
+        int32_t X, Y, Z;
+
+        bool operator==(const SectionKey& other) const
+        {
+            return X == other.X && Y == other.Y && Z == other.Z;
+        }
+    };
+
+    // Per-thread scratch memory that the mesher fills in.
+    struct ScratchBuffer
+    {
+        VoxelVertexCollection Vertices;
+        std::vector<uint32_t> Indices;
+    };
+
+    // A finished section mesh. Its buffers are reused after it is integrated.
+    struct MeshResult
+    {
+        SectionKey Key;
+        VoxelVertexCollection Vertices;
+        std::vector<uint32_t> Indices;
+    };
+
+    struct Statistics
+    {
+        uint64_t NumRequested;
+        uint64_t NumMeshed;
+        uint64_t NumIntegrated;
+        // Results dropped because the section was requested again before it was integrated.
+        uint64_t NumSuperseded;
+        uint64_t NumPending;
+        // Result nodes allocated so far. Stays flat once the free list covers the results in flight.
+        uint64_t NumResultNodes;
+        // Total time spent in the mesher across all workers.
+        double TotalMeshMilliseconds;
+        // Average time from Request to Integrate.
+        double AverageLatencyMilliseconds;
+    };
+
+    /**
+     * The mesher fills the scratch buffer for the given section. It is
+     * called concurrently from the worker threads.
+     */
+    using Mesher = std::function<void(const SectionKey& key, ScratchBuffer& scratch)>;
+
+    /**
+     * @param mesher The function that builds the mesh for a section.
+     * @param numThreads The number of worker threads. If 0, one less than the
+     * number of hardware threads is used.
+     */
+    MeshingScheduler(Mesher mesher, uint32_t numThreads = 0);
+    virtual ~MeshingScheduler();
+
+    /**
+     * Queue a section to be (re)meshed. Requesting a section that is already
+     * pending has no effect. Requesting a section that is currently being
+     * meshed causes the in-flight result to be discarded.
+     */
+    void Request(const SectionKey& key);
+
+    /**
+     * Update the priority of the pending requests.
+     * Call once per frame before Integrate.
+     */
+    void XM_CALLCONV SetView(DirectX::FXMVECTOR position, DirectX::FXMVECTOR direction);
+    void SetView(const Camera& camera);
+
+    /**
+     * Pass finished meshes to the integrate function (on the calling thread)
+     * until there are no more results or the time budget is exhausted. The
+     * result is only valid during the call; copy the vertices and indices
+     * instead of moving them out, so their capacity is kept for the next mesh.
+     * @returns The number of results that were integrated.
+     */
+    size_t Integrate(const std::function<void(MeshResult&)>& integrate, double budgetMilliseconds);
+
+    /**
+     * Block until all pending and in-flight requests have been meshed.
+     * Results still need to be integrated.
+     */
+    void Wait();
+
+    Statistics GetStatistics() const;
+
+protected:
+
+private:
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct SectionKeyHash
+    {
+        size_t operator()(const SectionKey& key) const
+        {
+            uint64_t h = (uint64_t(uint32_t(key.X)) * 0x9E3779B97F4A7C15ull) ^
+                (uint64_t(uint32_t(key.Z)) * 0xC2B2AE3D27D4EB4Full) ^
+                uint64_t(uint32_t(key.Y));
+            return static_cast<size_t>(h ^ (h >> 29));
+        }
+    };
+
+    struct MeshRequest
+    {
+        SectionKey Key;
+        uint64_t Generation;
+        Clock::time_point RequestTime;
+        float Priority;
+    };
+
+    // Node of the lock-free completion queue.
+    struct Completion
+    {
+        Completion* Next;
+        MeshResult Result;
+        uint64_t Generation;
+        Clock::time_point RequestTime;
+    };
+
+    void ProcessRequests();
+    float ComputePriority(const SectionKey& key) const;
+    void PushCompletion(Completion* completion);
+    // Take a node from the free list, or allocate one if it is empty.
+    Completion* AcquireCompletion();
+    void ReleaseCompletion(Completion* completion);
+
+    Mesher m_Mesher;
+    std::vector<std::thread> m_Threads;
+
+    struct SectionState
+    {
+        // The most recently requested generation.
+        uint64_t Generation;
+        // True while the request is waiting for a worker.
+        bool Queued;
+    };
+
+    // Pending requests, sorted so the highest priority request is at the back.
+    std::vector<MeshRequest> m_Requests;
+    // Every section that has been requested but not integrated yet.
+    std::unordered_map<SectionKey, SectionState, SectionKeyHash> m_Sections;
+    mutable std::mutex m_RequestMutex;
+    std::condition_variable m_RequestCondition;
+    std::condition_variable m_IdleCondition;
+    uint32_t m_NumInFlight;
+    uint64_t m_NextGeneration;
+    bool m_RequestsSorted;
+    bool m_Exit;
+
+    DirectX::XMFLOAT3 m_ViewPosition;
+    DirectX::XMFLOAT3 m_ViewDirection;
+
+    // Completed meshes pushed by the workers (lock-free, multiple producers, single consumer).
+    std::atomic<Completion*> m_Completions;
+    // Completions taken from the queue that did not fit into the last frame
+    // budget, linked through Next in completion order.
+    Completion* m_ReadyHead;
+    Completion* m_ReadyTail;
+
+    // Integrated and superseded completions, with their buffers, linked through Next.
+    Completion* m_FreeCompletions;
+    std::mutex m_FreeMutex;
+    std::atomic<uint64_t> m_NumResultNodes;
+
+    std::atomic<uint64_t> m_NumRequested;
+    std::atomic<uint64_t> m_NumMeshed;
+    std::atomic<uint64_t> m_MeshNanoseconds;
+    uint64_t m_NumIntegrated;
+    uint64_t m_NumSuperseded;
+    double m_TotalLatencyMilliseconds;
+};
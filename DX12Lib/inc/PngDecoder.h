@@ -0,0 +1,19 @@
+/**
+ * A portable PNG decoder. Decompression is done with zlib, everything else
+ * (unfiltering, Adam7 deinterlacing and the conversion of all color types
+ * and bit depths to R8G8B8A8) is plain C++ without any platform APIs.
+ *
+ * 16-bit channels are reduced to their most significant byte. Palette and
+ * color key transparency (tRNS) become alpha. The sRGB chunk is reported as
+ * DecodedImage::IsSRGB; gamma and color profile chunks are ignored.
+ */
+#pragma once
+
+#include "ImageDecoder.h"
+
+class PngDecoder : public ImageDecoder
+{
+public:
+    virtual bool CanDecode(const uint8_t* data, size_t size) const override;
+    virtual bool Decode(const uint8_t* data, size_t size, DecodedImage& image) const override;
+};
@@ -0,0 +1,130 @@
+/**
+ * The RenderQueue collects draw packets for a frame and records them on a
+ * command list in an order that minimizes state changes.
+ *
+ * Every packet gets a 64-bit sort key built from (most to least significant)
+ * the pipeline state, the root signature, the texture, the material, the mesh
+ * and the view depth of the draw. The packets are radix sorted by key and,
+ * while recording, a state is only bound on the command list if it differs
+ * from the state of the previous packet. Objects are identified by pointer,
+ * so the key only affects the order of the draws, never what is bound.
+ * The key layout, the sort and the state filter are in RenderQueueSort.h.
+ */
+#pragma once
+
+#include <Material.h>
+#include <RenderQueueSort.h>
+
+#include <d3d12.h>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class CommandList;
+class Mesh;
+class RootSignature;
+class Texture;
+
+class RenderQueue
+{
+public:
+    // The root parameters of the root signature(s) that the packets are bound to.
+    struct RootParameters
+    {
+        // Constant buffer with the per-draw constants of a packet (e.g. matrices).
+        uint32_t DrawConstants;
+        // Constant buffer with the material of a packet.
+        uint32_t Material;
+        // Descriptor table with the texture of a packet.
+        uint32_t Textures;
+    };
+
+    // The work done by the last call to Flush (or the ranges recorded since the last Sort).
+    using Statistics = DrawStatistics;
+
+    RenderQueue(const RootParameters& rootParameters);
+    virtual ~RenderQueue();
+
+    /**
+     * Add a draw packet to the queue. The pipeline state, root signature, mesh
+     * and texture must stay alive until the queue is flushed. The material and
+     * the draw constants are copied.
+     *
+     * @param depth The view space depth of the draw. Packets that share all
+     * state are drawn front to back.
+     */
+    void Submit(ID3D12PipelineState* pipelineState, const RootSignature& rootSignature,
+        Mesh& mesh, const Texture& texture, const Material& material, float depth,
+        size_t constantsSize, const void* constants);
+    template<typename T>
+    void Submit(ID3D12PipelineState* pipelineState, const RootSignature& rootSignature,
+        Mesh& mesh, const Texture& texture, const Material& material, float depth, const T& constants)
+    {
+        Submit(pipelineState, rootSignature, mesh, texture, material, depth, sizeof(T), &constants);
+    }
+
+    /**
+     * Sort the packets and record them on the command list. The render
+     * targets, viewport and scissor rectangle must already be set.
+     * The queue is empty afterwards.
+     */
+    void Flush(CommandList& commandList);
+
+    /**
+     * Sort the packets for recording with Record.
+     * @returns The number of packets.
+     */
+    size_t Sort();
+
+    /**
+     * Record the sorted packets [first, last) on the command list. Disjoint
+     * ranges can be recorded on different command lists concurrently (see
+     * CommandQueue::RecordCommandLists). Call Clear when all ranges are recorded.
+     */
+    void Record(CommandList& commandList, size_t first, size_t last);
+
+    /**
+     * Remove all packets without recording them.
+     */
+    void Clear();
+
+    const Statistics& GetStatistics() const
+    {
+        return m_Statistics;
+    }
+
+private:
+    struct DrawPacket
+    {
+        ID3D12PipelineState* pPipelineState;
+        const RootSignature* pRootSignature;
+        Mesh* pMesh;
+        const Texture* pTexture;
+        uint32_t MaterialIndex;
+        // The range of the draw constants in m_ConstantData.
+        uint32_t ConstantsOffset;
+        uint32_t ConstantsSize;
+    };
+
+    // A small, stable id for an object (wraps around at 2^bits).
+    uint64_t GetObjectId(const void* object, uint32_t bits);
+    // The index of the material in m_Materials (added if it is not there yet).
+    uint32_t GetMaterialIndex(const Material& material);
+
+    RootParameters m_RootParameters;
+
+    std::vector<DrawPacket> m_Packets;
+    std::vector<DrawSortEntry> m_SortEntries;
+    std::vector<DrawSortEntry> m_SortScratch;
+    std::vector<Material> m_Materials;
+    std::vector<uint8_t> m_ConstantData;
+
+    // Ids of the objects that have been submitted, so keys are stable between frames.
+    std::unordered_map<const void*, uint64_t> m_ObjectIds;
+
+    Statistics m_Statistics;
+    // Guards the statistics while ranges are recorded concurrently.
+    std::mutex m_StatisticsMutex;
+};
@@ -0,0 +1,123 @@
+/**
+ * The device-free part of the RenderQueue: the layout of the 64-bit sort
+ * key of a draw packet, the radix sort of the keys and the filter that
+ * decides which state a draw has to bind after the previous draw.
+ *
+ * None of it touches a device or a command list, objects are only compared
+ * by pointer, so the ordering and the counted state changes can be tested
+ * on their own.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// The layout of the sort key, from the most significant bits down: the
+// pipeline state, the root signature, the texture, the material, the mesh
+// and the view depth of the draw.
+class DrawSortKey
+{
+public:
+    static const uint32_t PipelineStateBits = 10;
+    static const uint32_t RootSignatureBits = 6;
+    static const uint32_t TextureBits = 12;
+    static const uint32_t MaterialBits = 10;
+    static const uint32_t MeshBits = 10;
+    static const uint32_t DepthBits = 16;
+
+    static const uint32_t DepthShift = 0;
+    static const uint32_t MeshShift = DepthShift + DepthBits;
+    static const uint32_t MaterialShift = MeshShift + MeshBits;
+    static const uint32_t TextureShift = MaterialShift + MaterialBits;
+    static const uint32_t RootSignatureShift = TextureShift + TextureBits;
+    static const uint32_t PipelineStateShift = RootSignatureShift + RootSignatureBits;
+
+    /**
+     * Pack the ids of the objects of a draw and its depth into a key. Ids
+     * wrap around at the number of bits of their field.
+     */
+    static uint64_t Pack(uint64_t pipelineState, uint64_t rootSignature, uint64_t texture,
+        uint64_t material, uint64_t mesh, float depth);
+
+    /**
+     * A depth key that increases with the depth. Negative depths are
+     * clamped to 0.
+     */
+    static uint64_t QuantizeDepth(float depth);
+
+    static uint64_t GetField(uint64_t key, uint32_t shift, uint32_t bits)
+    {
+        return (key >> shift) & ((1ull << bits) - 1);
+    }
+};
+
+struct DrawSortEntry
+{
+    uint64_t Key;
+    uint32_t PacketIndex;
+};
+
+/**
+ * Sort the entries by key. The sort is stable, so packets with the same key
+ * are recorded in the order they were submitted.
+ *
+ * @param scratch Storage of the same size as entries, kept by the caller so
+ * a sort doesn't allocate once the queue reached its size.
+ * @returns The number of 8-bit digits that were sorted. Digits that are the
+ * same in all keys are skipped.
+ */
+uint32_t RadixSortDrawKeys(std::vector<DrawSortEntry>& entries, std::vector<DrawSortEntry>& scratch);
+
+// The state changes of a range of draws.
+struct DrawStatistics
+{
+    uint32_t NumPackets = 0;
+    uint32_t NumDraws = 0;
+    uint32_t NumPipelineStateChanges = 0;
+    uint32_t NumRootSignatureChanges = 0;
+    uint32_t NumTextureChanges = 0;
+    uint32_t NumMaterialChanges = 0;
+    uint32_t NumMeshChanges = 0;
+
+    DrawStatistics& operator+=(const DrawStatistics& other);
+};
+
+/**
+ * The state bound by the previous draw of a range. Every range starts with
+ * nothing bound, it may be recorded on its own command list.
+ */
+class DrawStateFilter
+{
+public:
+    // The states a draw has to bind, returned by Draw.
+    static const uint32_t PipelineStateChange = 0x1;
+    static const uint32_t RootSignatureChange = 0x2;
+    static const uint32_t TextureChange = 0x4;
+    static const uint32_t MaterialChange = 0x8;
+    static const uint32_t MeshChange = 0x10;
+
+    DrawStateFilter();
+
+    /**
+     * Record a draw with the given state and count it in the statistics.
+     * Changing the root signature invalidates the root arguments, so the
+     * texture and the material are bound again after it.
+     * @returns The states that differ from the previous draw.
+     */
+    uint32_t Draw(const void* pipelineState, const void* rootSignature, const void* texture,
+        uint32_t material, const void* mesh);
+
+    const DrawStatistics& GetStatistics() const
+    {
+        return m_Statistics;
+    }
+
+private:
+    const void* m_PipelineState;
+    const void* m_RootSignature;
+    const void* m_Texture;
+    uint32_t m_Material;
+    const void* m_Mesh;
+
+    DrawStatistics m_Statistics;
+};
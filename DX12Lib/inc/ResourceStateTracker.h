@@ -10,6 +10,12 @@
  * The ResourceStateTracker class is intended to be used within a command list
  * to track the state of the resource as it is known within that command list.
  * 
+ * The global (between command list executions) state of the resources is kept
+ * in a hash table that is split in shards with a lock each. A command queue
+ * locks the shards of every resource used by the command lists it executes for
+ * the whole resolve, so the command lists on different command queues only
+ * contend when they use resources in the same shard.
+ *
  * See: https://youtu.be/nmB2XMasz2o
  * See: https://msdn.microsoft.com/en-us/library/dn899226(v=vs.85).aspx#implicit_state_transitions
  */
@@ -17,8 +23,8 @@
 
 #include "d3dx12.h"
 
+#include <cstdint>
 #include <mutex>
-#include <map>
 #include <unordered_map>
 #include <vector>
 
@@ -69,8 +75,17 @@ public:
      */
     void AliasBarrier(const Resource* resourceBefore = nullptr, const Resource* resourceAfter = nullptr);
 
+    /**
+     * Resolve the pending resource barriers against the global state of the
+     * resources. The shards of the resources must be locked (see LockGlobalState).
+     *
+     * @return The barriers that transition the resources from their global state.
+     */
+    std::vector<D3D12_RESOURCE_BARRIER> ResolvePendingResourceBarriers();
+
     /**
      * Flush any pending resource barriers to the command list.
+     * The shards of the resources must be locked (see LockGlobalState).
      * 
      * @return The number of resource barriers that were flushed to the command list.
      */
@@ -85,27 +100,34 @@ public:
     /**
      * Commit final resource states to the global resource state array (map)
      * This must be called when the command list is closed.
+     *
+     * Flushing the pending barriers and committing the final states of the
+     * command lists must happen in the same order as the command lists are
+     * executed; the command queue serializes this per queue. The shards of
+     * the resources must be locked (see LockGlobalState).
      */
     void CommitFinalResourceStates();
 
     /**
-     * Reset state tracking. This must be done when the command list is reset.
+     * Get the shards of the global resource state that are used by the pending
+     * barriers and the final states, as a bit mask.
      */
-    void Reset();
+    uint32_t GetGlobalStateShards() const;
 
     /**
-     * The global state must be locked before flushing pending resource barriers
-     * and committing the final resource state to the global resource state.
-     * This ensures consistency of the global resource state between command list
-     * executions.
+     * Lock the shards of the global resource state in the bit mask. The shards
+     * are locked in index order, so two queues that lock overlapping shards
+     * cannot deadlock. All command lists executed in one batch are resolved
+     * and committed under one lock, which makes the resolve atomic with
+     * respect to the other command queues.
      */
-    static void Lock();
+    static void LockGlobalState(uint32_t shards);
+    static void UnlockGlobalState(uint32_t shards);
 
     /**
-     * Unlocks the global resource state after the final states have been comitted
-     * to the global resource state array.
+     * Reset state tracking. This must be done when the command list is reset.
      */
-    static void Unlock();
+    void Reset();
 
     /**
      * Add a resource with a given state to the global resource state array (map).
@@ -126,26 +148,34 @@ private:
     using ResourceBarriers = std::vector<D3D12_RESOURCE_BARRIER>;
 
     // Tracks the state of a particular resource and all of its subresources.
+    // The states of individual subresources are kept in a small inline array,
+    // which switches to an array indexed by subresource for resources with
+    // many subresources in different states (such as texture arrays).
     struct ResourceState
     {
         // Initialize all of the subresources within a resource to the given state.
         ResourceState(D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON)
             : State(state)
+            , NumInlineSubresources(0)
         {}
 
         // Get the state of a (sub)resource within the resource.
-        // If the specified subresource is not found in the SubresourceState array (map)
-        // then the state of the resource (D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES) is
-        // returned.
+        // If the specified subresource has no state of its own then the state
+        // of the resource (D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES) is returned.
         D3D12_RESOURCE_STATES GetSubresourceState(UINT subresource) const
         {
-            D3D12_RESOURCE_STATES state = State;
-            const auto iter = SubresourceState.find(subresource);
-            if (iter != SubresourceState.end())
+            for (uint32_t i = 0; i < NumInlineSubresources; ++i)
+            {
+                if (InlineSubresources[i].Subresource == subresource)
+                {
+                    return InlineSubresources[i].State;
+                }
+            }
+            if (subresource < SubresourceStates.size() && SubresourceStates[subresource] != UnknownState)
             {
-                state = iter->second;
+                return SubresourceStates[subresource];
             }
-            return state;
+            return State;
         }
 
         // Set a subresource to a particular state.
@@ -154,18 +184,88 @@ private:
             if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
             {
                 State = state;
-                SubresourceState.clear();
+                NumInlineSubresources = 0;
+                SubresourceStates.clear();
+                return;
+            }
+
+            if (SubresourceStates.empty())
+            {
+                for (uint32_t i = 0; i < NumInlineSubresources; ++i)
+                {
+                    if (InlineSubresources[i].Subresource == subresource)
+                    {
+                        InlineSubresources[i].State = state;
+                        return;
+                    }
+                }
+                if (NumInlineSubresources < MaxInlineSubresources)
+                {
+                    InlineSubresources[NumInlineSubresources++] = { subresource, state };
+                    return;
+                }
+
+                // Move the inline states to the indexed array.
+                for (uint32_t i = 0; i < NumInlineSubresources; ++i)
+                {
+                    SetIndexedState(InlineSubresources[i].Subresource, InlineSubresources[i].State);
+                }
+                NumInlineSubresources = 0;
+            }
+
+            SetIndexedState(subresource, state);
+        }
+
+        // Returns true if any subresource has a state of its own.
+        bool HasSubresourceStates() const
+        {
+            return NumInlineSubresources > 0 || !SubresourceStates.empty();
+        }
+
+        // Call func(subresource, state) for every subresource with a state of its own.
+        template<typename Func>
+        void ForEachSubresourceState(Func func) const
+        {
+            for (uint32_t i = 0; i < NumInlineSubresources; ++i)
+            {
+                func(InlineSubresources[i].Subresource, InlineSubresources[i].State);
             }
-            else
+            for (UINT i = 0; i < SubresourceStates.size(); ++i)
             {
-                SubresourceState[subresource] = state;
+                if (SubresourceStates[i] != UnknownState)
+                {
+                    func(i, SubresourceStates[i]);
+                }
             }
         }
 
-        // If the SubresourceState array (map) is empty, then the State variable defines 
-        // the state of all of the subresources.
+        // If no subresource has a state of its own, then the State variable
+        // defines the state of all of the subresources.
         D3D12_RESOURCE_STATES State;
-        std::map<UINT, D3D12_RESOURCE_STATES> SubresourceState;
+
+    private:
+        static const uint32_t MaxInlineSubresources = 8;
+        static constexpr D3D12_RESOURCE_STATES UnknownState = static_cast<D3D12_RESOURCE_STATES>(-1);
+
+        struct SubresourceState
+        {
+            UINT Subresource;
+            D3D12_RESOURCE_STATES State;
+        };
+
+        void SetIndexedState(UINT subresource, D3D12_RESOURCE_STATES state)
+        {
+            if (subresource >= SubresourceStates.size())
+            {
+                SubresourceStates.resize(subresource + 1, UnknownState);
+            }
+            SubresourceStates[subresource] = state;
+        }
+
+        uint32_t NumInlineSubresources;
+        SubresourceState InlineSubresources[MaxInlineSubresources];
+        // Indexed by subresource, only used when the inline array is full.
+        std::vector<D3D12_RESOURCE_STATES> SubresourceStates;
     };
 
     // Pending resource transitions are committed before a command list
@@ -183,10 +283,22 @@ private:
     // command list is closed but before it is executed on the command queue.
     ResourceStateMap m_FinalResourceState;
 
-    // The mutex protects shared access to the GlobalResourceState map.
-    static std::mutex ms_GlobalMutex;
-    static bool ms_IsLocked;
+    // One shard of the global resource state. Aligned to a cache line so
+    // the locks of different shards do not share cache lines.
+    struct alignas(64) GlobalResourceStateShard
+    {
+        // The mutex protects shared access to the resource states of the shard.
+        std::mutex Mutex;
+        ResourceStateMap ResourceStates;
+    };
+
+    static const size_t NumGlobalResourceStateShards = 16;
+    static_assert(NumGlobalResourceStateShards <= 32, "The shards are locked by a 32 bit mask.");
+
+    static size_t GetGlobalResourceStateShardIndex(ID3D12Resource* resource);
+    static GlobalResourceStateShard& GetGlobalResourceStateShard(ID3D12Resource* resource);
+
     // The global resource state array (map) stores the state of a resource
     // between command list execution.
-    static ResourceStateMap ms_GlobalResourceState;
+    static GlobalResourceStateShard ms_GlobalResourceState[NumGlobalResourceStateShards];
 };
\ No newline at end of file
@@ -0,0 +1,399 @@
+/**
+ * A two-level segregated fit (TLSF) range allocator.
+ *
+ * Manages a range of [0, capacity) units (for example descriptors in a
+ * descriptor heap) and hands out contiguous sub-ranges. Allocate and Free are
+ * O(1): free blocks are kept in size classes (bins) indexed by a first level
+ * (power of two) and a second level (linear subdivision of that power of two),
+ * and a two-level bitmap finds a non-empty bin with a couple of bit scans.
+ * Freed blocks are immediately coalesced with their free physical neighbours.
+ *
+ * Block bookkeeping lives in a node pool that is reserved up front, so
+ * allocating and freeing do not touch the heap.
+ *
+ * The allocator is not thread safe.
+ *
+ * Based on:
+ * M. Masmano, I. Ripoll, A. Crespo, J. Real, "TLSF: a New Dynamic Memory
+ * Allocator for Real-Time Systems", ECRTS 2004.
+ */
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+template<typename OffsetType = uint32_t>
+class TLSFAllocator
+{
+public:
+    using SizeType = OffsetType;
+
+    static const uint32_t InvalidNode = 0xFFFFFFFF;
+
+    struct Allocation
+    {
+        // The offset of the allocated range.
+        OffsetType Offset;
+        // The handle that must be passed to Free.
+        uint32_t Node;
+
+        bool IsValid() const
+        {
+            return Node != InvalidNode;
+        }
+    };
+
+    /**
+     * @param capacity The number of units that can be allocated.
+     * @param reserveBlocks The number of blocks to reserve bookkeeping for.
+     * Each block is at least one unit, so reserving capacity blocks means the
+     * allocator never allocates memory after construction.
+     */
+    explicit TLSFAllocator(SizeType capacity, uint32_t reserveBlocks = 128)
+        : m_Capacity(capacity)
+    {
+        m_Nodes.reserve(reserveBlocks);
+        m_FreeNodes.reserve(reserveBlocks);
+        Reset();
+    }
+
+    /**
+     * Allocate a contiguous range of size units.
+     * Returns an invalid allocation if the request cannot be satisfied.
+     */
+    Allocation Allocate(SizeType size)
+    {
+        if (size == 0 || size > m_FreeSize)
+        {
+            return { 0, InvalidNode };
+        }
+
+        uint32_t node = FindFreeNode(size);
+        if (node == InvalidNode)
+        {
+            return { 0, InvalidNode };
+        }
+
+        RemoveFreeNode(node);
+
+        // Return the remainder of the block to the free lists.
+        SizeType remainder = m_Nodes[node].Size - size;
+        if (remainder > 0)
+        {
+            uint32_t next = NewNode();
+            Node& split = m_Nodes[next];
+            split.Offset = m_Nodes[node].Offset + size;
+            split.Size = remainder;
+            split.PrevPhysical = node;
+            split.NextPhysical = m_Nodes[node].NextPhysical;
+            split.Used = false;
+
+            if (split.NextPhysical != InvalidNode)
+            {
+                m_Nodes[split.NextPhysical].PrevPhysical = next;
+            }
+            m_Nodes[node].NextPhysical = next;
+            m_Nodes[node].Size = size;
+
+            InsertFreeNode(next);
+        }
+
+        m_Nodes[node].Used = true;
+        m_FreeSize -= size;
+
+        return { m_Nodes[node].Offset, node };
+    }
+
+    /**
+     * Return an allocation to the allocator.
+     */
+    void Free(const Allocation& allocation)
+    {
+        Free(allocation.Node);
+    }
+
+    void Free(uint32_t node)
+    {
+        assert(node < m_Nodes.size() && m_Nodes[node].Used && "Double free or invalid allocation.");
+
+        m_Nodes[node].Used = false;
+        m_FreeSize += m_Nodes[node].Size;
+
+        // Merge with the previous block.
+        uint32_t prev = m_Nodes[node].PrevPhysical;
+        if (prev != InvalidNode && !m_Nodes[prev].Used)
+        {
+            RemoveFreeNode(prev);
+            m_Nodes[prev].Size += m_Nodes[node].Size;
+            m_Nodes[prev].NextPhysical = m_Nodes[node].NextPhysical;
+            if (m_Nodes[node].NextPhysical != InvalidNode)
+            {
+                m_Nodes[m_Nodes[node].NextPhysical].PrevPhysical = prev;
+            }
+            ReleaseNode(node);
+            node = prev;
+        }
+
+        // Merge with the next block.
+        uint32_t next = m_Nodes[node].NextPhysical;
+        if (next != InvalidNode && !m_Nodes[next].Used)
+        {
+            RemoveFreeNode(next);
+            m_Nodes[node].Size += m_Nodes[next].Size;
+            m_Nodes[node].NextPhysical = m_Nodes[next].NextPhysical;
+            if (m_Nodes[next].NextPhysical != InvalidNode)
+            {
+                m_Nodes[m_Nodes[next].NextPhysical].PrevPhysical = node;
+            }
+            ReleaseNode(next);
+        }
+
+        InsertFreeNode(node);
+    }
+
+    /**
+     * Free all allocations.
+     */
+    void Reset()
+    {
+        m_Nodes.clear();
+        m_FreeNodes.clear();
+        m_FirstLevelBitmap = 0;
+        for (uint32_t i = 0; i < NumFirstLevels; ++i)
+        {
+            m_SecondLevelBitmaps[i] = 0;
+        }
+        for (uint32_t i = 0; i < NumBins; ++i)
+        {
+            m_BinHeads[i] = InvalidNode;
+        }
+
+        m_FreeSize = m_Capacity;
+        if (m_Capacity > 0)
+        {
+            uint32_t node = NewNode();
+            m_Nodes[node] = { 0, m_Capacity, InvalidNode, InvalidNode, InvalidNode, InvalidNode, false };
+            InsertFreeNode(node);
+        }
+    }
+
+    /**
+     * The size of a live allocation, by its node.
+     */
+    SizeType GetAllocationSize(uint32_t node) const
+    {
+        assert(node < m_Nodes.size() && m_Nodes[node].Used);
+        return m_Nodes[node].Size;
+    }
+
+    SizeType GetCapacity() const
+    {
+        return m_Capacity;
+    }
+
+    /**
+     * The total number of free units. Due to fragmentation, an allocation
+     * of this size may still fail.
+     */
+    SizeType GetFreeSize() const
+    {
+        return m_FreeSize;
+    }
+
+private:
+    // Each power of two is divided in 2^SecondLevelBits linear size classes.
+    static const uint32_t SecondLevelBits = 3;
+    static const uint32_t NumSecondLevels = 1u << SecondLevelBits;
+    // Sizes below NumSecondLevels all map to the first level 0 (one bin per size).
+    static const uint32_t NumFirstLevels = sizeof(SizeType) * 8 - SecondLevelBits + 1;
+    static const uint32_t NumBins = NumFirstLevels * NumSecondLevels;
+
+    static_assert(NumFirstLevels <= 64, "The first level bitmap is 64 bits.");
+
+    struct Node
+    {
+        OffsetType Offset;
+        SizeType Size;
+        // Neighbouring blocks in the range, for coalescing.
+        uint32_t PrevPhysical;
+        uint32_t NextPhysical;
+        // Neighbouring blocks in the same bin (free blocks only).
+        uint32_t PrevFree;
+        uint32_t NextFree;
+        bool Used;
+    };
+
+    static uint32_t BitScanForward(uint64_t mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, mask);
+        return index;
+#else
+        return static_cast<uint32_t>(__builtin_ctzll(mask));
+#endif
+    }
+
+    static uint32_t BitScanReverse(uint64_t mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, mask);
+        return index;
+#else
+        return 63 - static_cast<uint32_t>(__builtin_clzll(mask));
+#endif
+    }
+
+    // The bin that a free block of the given size is stored in.
+    static void MapInsert(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+    {
+        if (size < NumSecondLevels)
+        {
+            firstLevel = 0;
+            secondLevel = static_cast<uint32_t>(size);
+        }
+        else
+        {
+            uint32_t msb = BitScanReverse(size);
+            firstLevel = msb - SecondLevelBits + 1;
+            secondLevel = static_cast<uint32_t>(size >> (msb - SecondLevelBits)) & (NumSecondLevels - 1);
+        }
+    }
+
+    // The first bin in which every block is large enough for the given size.
+    static void MapSearch(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+    {
+        if (size >= NumSecondLevels)
+        {
+            uint32_t msb = BitScanReverse(size);
+            size += (uint64_t(1) << (msb - SecondLevelBits)) - 1;
+        }
+        MapInsert(size, firstLevel, secondLevel);
+    }
+
+    uint32_t FindFreeNode(SizeType size) const
+    {
+        uint32_t firstLevel, secondLevel;
+        MapSearch(size, firstLevel, secondLevel);
+
+        if (firstLevel < NumFirstLevels)
+        {
+            uint32_t secondLevelMap = m_SecondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+            if (secondLevelMap == 0)
+            {
+                uint64_t firstLevelMap = firstLevel + 1 < 64 ? m_FirstLevelBitmap & (~uint64_t(0) << (firstLevel + 1)) : 0;
+                if (firstLevelMap != 0)
+                {
+                    firstLevel = BitScanForward(firstLevelMap);
+                    secondLevelMap = m_SecondLevelBitmaps[firstLevel];
+                }
+            }
+
+            if (secondLevelMap != 0)
+            {
+                secondLevel = BitScanForward(secondLevelMap);
+                return m_BinHeads[firstLevel * NumSecondLevels + secondLevel];
+            }
+        }
+
+        // The bins above the request are empty, but the bin of the request
+        // itself may still hold a block that is large enough. Only its head is
+        // tested to keep the search O(1), so a fitting block further down
+        // that bin is not found. Such a block is less than size / 8 larger
+        // than the request.
+        MapInsert(size, firstLevel, secondLevel);
+        uint32_t head = m_BinHeads[firstLevel * NumSecondLevels + secondLevel];
+        if (head != InvalidNode && m_Nodes[head].Size >= size)
+        {
+            return head;
+        }
+
+        return InvalidNode;
+    }
+
+    void InsertFreeNode(uint32_t node)
+    {
+        uint32_t firstLevel, secondLevel;
+        MapInsert(m_Nodes[node].Size, firstLevel, secondLevel);
+        uint32_t bin = firstLevel * NumSecondLevels + secondLevel;
+
+        uint32_t head = m_BinHeads[bin];
+        m_Nodes[node].PrevFree = InvalidNode;
+        m_Nodes[node].NextFree = head;
+        if (head != InvalidNode)
+        {
+            m_Nodes[head].PrevFree = node;
+        }
+        m_BinHeads[bin] = node;
+
+        m_FirstLevelBitmap |= uint64_t(1) << firstLevel;
+        m_SecondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+    }
+
+    void RemoveFreeNode(uint32_t node)
+    {
+        Node& n = m_Nodes[node];
+        if (n.PrevFree != InvalidNode)
+        {
+            m_Nodes[n.PrevFree].NextFree = n.NextFree;
+        }
+        if (n.NextFree != InvalidNode)
+        {
+            m_Nodes[n.NextFree].PrevFree = n.PrevFree;
+        }
+
+        uint32_t firstLevel, secondLevel;
+        MapInsert(n.Size, firstLevel, secondLevel);
+        uint32_t bin = firstLevel * NumSecondLevels + secondLevel;
+
+        if (m_BinHeads[bin] == node)
+        {
+            m_BinHeads[bin] = n.NextFree;
+            if (n.NextFree == InvalidNode)
+            {
+                m_SecondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+                if (m_SecondLevelBitmaps[firstLevel] == 0)
+                {
+                    m_FirstLevelBitmap &= ~(uint64_t(1) << firstLevel);
+                }
+            }
+        }
+
+        n.PrevFree = n.NextFree = InvalidNode;
+    }
+
+    uint32_t NewNode()
+    {
+        if (!m_FreeNodes.empty())
+        {
+            uint32_t node = m_FreeNodes.back();
+            m_FreeNodes.pop_back();
+            return node;
+        }
+
+        m_Nodes.emplace_back();
+        return static_cast<uint32_t>(m_Nodes.size() - 1);
+    }
+
+    void ReleaseNode(uint32_t node)
+    {
+        m_FreeNodes.push_back(node);
+    }
+
+    SizeType m_Capacity;
+    SizeType m_FreeSize;
+
+    std::vector<Node> m_Nodes;
+    // Indices of unused entries in m_Nodes.
+    std::vector<uint32_t> m_FreeNodes;
+
+    uint64_t m_FirstLevelBitmap;
+    uint32_t m_SecondLevelBitmaps[NumFirstLevels];
+    uint32_t m_BinHeads[NumBins];
+};
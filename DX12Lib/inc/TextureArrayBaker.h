@@ -0,0 +1,117 @@
+/**
+ * The TextureArrayBaker packs a directory of small block textures (the 16x16
+ * PNGs in assets/minecraft/textures/blocks) into a single Texture2DArray with
+ * a full mip chain. Mips are filtered on the CPU in linear space and keep
+ * the alpha test coverage of cutout textures.
+ *
+ * The baked array is written to a DDS file next to an index file that maps
+ * the name of every texture (the file name without extension) to its layer
+ * in the array. Both are written to an output directory of the application,
+ * never into the source directory. The index also records a hash of the
+ * name, size and write time of every source image, so the baked files are
+ * rebuilt when any image is added, removed, replaced or edited. Later
+ * startups load the one DDS file instead of decoding every PNG.
+ *
+ * Images are decoded in parallel with the portable ImageBatchDecoder. Animated
+ * textures (vertical strips of frames) contribute their first frame. Images
+ * of any other size than the layer size are skipped.
+ */
+#pragma once
+
+#include <ImageDecoder.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+class TextureArrayBaker
+{
+public:
+    // The layer of each texture in the array, by texture name.
+    using LayerTable = std::map<std::wstring, uint32_t>;
+
+    /**
+     * @param sourceDirectory The directory that is scanned for PNG files.
+     * @param outputDirectory The directory the baked files are written to.
+     * It is created by Bake if it doesn't exist.
+     * @param layerSize The width and height of a layer of the array.
+     */
+    TextureArrayBaker(const std::wstring& sourceDirectory, const std::wstring& outputDirectory, uint32_t layerSize = 16);
+    virtual ~TextureArrayBaker();
+
+    /**
+     * The baked DDS file and index file of the source directory
+     * (<outputDirectory>/<source directory name>.dds and .index).
+     */
+    const std::wstring& GetTextureFileName() const
+    {
+        return m_TextureFileName;
+    }
+    const std::wstring& GetIndexFileName() const
+    {
+        return m_IndexFileName;
+    }
+
+    /**
+     * Check if the baked files exist and are up to date with the source directory.
+     */
+    bool IsBakeCurrent() const;
+
+    /**
+     * Decode all source images and write the DDS file and the index file.
+     * Returns the number of layers of the baked array.
+     */
+    uint32_t Bake(uint32_t numWorkers = 0);
+
+    /**
+     * Bake the source directory if the baked files are missing or out of date.
+     * Returns the layer table of the baked array.
+     */
+    LayerTable BakeIfNeeded();
+
+    /**
+     * Read the layer table from an index file.
+     */
+    static LayerTable LoadLayerTable(const std::wstring& indexFileName);
+
+    /**
+     * The number of images decoded by the last Bake and the time it took.
+     */
+    const ImageBatchDecoder::Statistics& GetDecodeStatistics() const
+    {
+        return m_DecodeStatistics;
+    }
+
+private:
+    struct SourceImage
+    {
+        std::wstring Name;
+        std::wstring FileName;
+        uint64_t FileSize;
+        uint64_t WriteTime;
+    };
+
+    struct SourceSignature
+    {
+        uint32_t NumImages = 0;
+        // A hash of the name, size and write time of every image, in name order.
+        uint64_t Hash = 0;
+    };
+
+    // The PNG files of the source directory, sorted by name.
+    std::vector<SourceImage> ScanSourceDirectory(SourceSignature& signature) const;
+
+    void WriteTextureFile(const std::vector<uint8_t>& layers, uint32_t numLayers) const;
+    void WriteIndexFile(const std::vector<std::wstring>& names, const SourceSignature& signature) const;
+
+    std::wstring m_SourceDirectory;
+    std::wstring m_OutputDirectory;
+    std::wstring m_TextureFileName;
+    std::wstring m_IndexFileName;
+    uint32_t m_LayerSize;
+    uint32_t m_MipLevels;
+    // The size of a layer including all of its mip levels.
+    size_t m_LayerBytes;
+    ImageBatchDecoder::Statistics m_DecodeStatistics;
+};
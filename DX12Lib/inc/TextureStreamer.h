@@ -0,0 +1,236 @@
+/**
+ * The TextureStreamer loads textures in the background.
+ *
+ * Request returns a handle immediately. The file is decoded on a pool of
+ * worker threads (DDS files are mapped, PNG files are decoded with the
+ * portable PngDecoder, other images with WIC; 8-bit images get their mips
+ * on the CPU) and the decoded textures are uploaded in
+ * batches on the copy queue by Update, which is called once per frame on
+ * the render thread. A texture becomes resident when the fence of its batch
+ * has been reached; until then the handle reports it as not resident and
+ * the caller should use a fallback texture.
+ *
+ * Textures are cached by file name, so requesting the same file again (from
+ * any thread) returns the same handle and the file is only decoded once.
+ * Handles are reference counted: resident textures that are no longer
+ * referenced by any handle are evicted, oldest first, when the resident
+ * textures exceed the residency budget, or explicitly with EvictUnused.
+ */
+#pragma once
+
+#include <Texture.h>
+
+#include <DirectXTex/DDSTextureLoader12.h>
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class TextureStreamer
+{
+public:
+    enum class TextureState
+    {
+        Queued,     // Waiting for a worker.
+        Decoding,   // Being decoded by a worker.
+        Decoded,    // Waiting to be uploaded.
+        Uploading,  // Recorded on the copy queue, the fence has not been reached.
+        Resident,   // The texture can be used.
+        Failed,     // The file could not be loaded.
+    };
+
+    /**
+     * The CPU side of a texture loaded from a file: the (empty) resource in
+     * the copy destination state and the subresources to copy into it. The
+     * subresources point into Data or into the mapped DDS file.
+     */
+    struct TextureFileData
+    {
+        Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+        std::vector<D3D12_SUBRESOURCE_DATA> Subresources;
+        std::unique_ptr<uint8_t[]> Data;
+        DirectX::DDSFileMapping DDSFile;
+    };
+
+    class StreamedTexture
+    {
+    public:
+        StreamedTexture(const std::wstring& fileName);
+
+        const std::wstring& GetFileName() const
+        {
+            return m_FileName;
+        }
+
+        TextureState GetState() const
+        {
+            return m_State.load(std::memory_order_acquire);
+        }
+
+        bool IsResident() const
+        {
+            return GetState() == TextureState::Resident;
+        }
+
+        /**
+         * The texture. Only valid when the texture is resident.
+         */
+        const Texture& GetTexture() const
+        {
+            return m_Texture;
+        }
+
+    private:
+        friend class TextureStreamer;
+
+        std::wstring m_FileName;
+        std::atomic<TextureState> m_State;
+        Texture m_Texture;
+        // Owned by the worker while decoding and by the render thread afterwards.
+        TextureFileData m_FileData;
+        // The size of the resource in video memory.
+        uint64_t m_SizeInBytes;
+        // The frame of the last request, for evicting the oldest textures first.
+        uint64_t m_LastRequestFrame;
+        // The mips are generated on the compute queue after the copy.
+        bool m_GenerateMips;
+    };
+
+    // A reference to a streamed texture. The texture is not evicted while a handle refers to it.
+    using Handle = std::shared_ptr<const StreamedTexture>;
+
+    struct Statistics
+    {
+        uint64_t NumRequested;
+        // Requests that were served from the cache.
+        uint64_t NumCacheHits;
+        uint64_t NumDecoded;
+        uint64_t NumFailed;
+        uint64_t NumUploaded;
+        uint64_t NumEvicted;
+        // Textures that are queued, decoding, decoded or uploading.
+        uint64_t NumPending;
+        uint64_t NumResident;
+        uint64_t ResidentBytes;
+    };
+
+    /**
+     * @param numThreads The number of decode threads. If 0, one less than the
+     * number of hardware threads is used.
+     */
+    TextureStreamer(uint32_t numThreads = 0);
+    virtual ~TextureStreamer();
+
+    /**
+     * Request a texture. Thread safe.
+     * Returns the cached handle if the file has been requested before.
+     */
+    Handle Request(const std::wstring& fileName);
+
+    /**
+     * Record the decoded textures on the copy queue (up to the upload budget
+     * per frame), mark the textures of completed batches as resident and
+     * evict unreferenced textures if the residency budget is exceeded.
+     * Call once per frame on the render thread.
+     * @returns The number of textures that became resident.
+     */
+    size_t Update();
+
+    /**
+     * Evict all resident (or failed) textures that are not referenced by a handle.
+     * Call on the render thread.
+     * @returns The number of evicted textures.
+     */
+    size_t EvictUnused();
+
+    /**
+     * Block until all requested textures are resident (or failed).
+     * Call on the render thread.
+     */
+    void Flush();
+
+    /**
+     * The number of bytes of subresource data recorded on the copy queue per
+     * Update. A texture that is larger than the budget is uploaded on its own.
+     */
+    void SetUploadBudget(uint64_t uploadBudgetInBytes)
+    {
+        m_UploadBudget = uploadBudgetInBytes;
+    }
+
+    /**
+     * The size of the resident textures above which unreferenced textures
+     * are evicted. 0 disables eviction.
+     */
+    void SetResidencyBudget(uint64_t residencyBudgetInBytes)
+    {
+        m_ResidencyBudget = residencyBudgetInBytes;
+    }
+
+    Statistics GetStatistics() const;
+
+    /**
+     * Load a texture file into memory and create its resource without
+     * uploading it. Used by the decode threads and by
+     * CommandList::LoadTextureFromFile.
+     * @param generateMips Reserve a full mip chain for images without mips.
+     * Mips of 8-bit RGBA images are generated on the CPU, other formats
+     * have fewer subresources than mip levels and need GenerateMips.
+     */
+    static void LoadTextureFile(const std::wstring& fileName, TextureFileData& fileData, bool generateMips = true);
+
+private:
+    using TexturePtr = std::shared_ptr<StreamedTexture>;
+
+    // The textures recorded on one copy command list.
+    struct UploadBatch
+    {
+        std::vector<TexturePtr> Textures;
+        uint64_t CopyFenceValue;
+        // The fence value of the compute queue if mips are generated on the GPU, 0 otherwise.
+        uint64_t ComputeFenceValue;
+    };
+
+    void ProcessRequests();
+    size_t RetireBatches(bool wait);
+    void RecordUploads();
+    void Evict(uint64_t residencyBudget);
+
+    std::vector<std::thread> m_Threads;
+
+    // Protects the cache and the decode and upload queues.
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_DecodeCondition;
+    // Signaled by the decode threads when a texture is decoded or failed, for Flush.
+    std::condition_variable m_DecodedCondition;
+    bool m_Exit;
+
+    std::unordered_map<std::wstring, TexturePtr> m_Textures;
+    std::deque<TexturePtr> m_DecodeQueue;
+    std::vector<TexturePtr> m_UploadQueue;
+
+    // Only used on the render thread.
+    std::deque<UploadBatch> m_Batches;
+
+    std::atomic<uint64_t> m_UploadBudget;
+    std::atomic<uint64_t> m_ResidencyBudget;
+
+    uint64_t m_NumRequested;
+    uint64_t m_NumCacheHits;
+    std::atomic<uint64_t> m_NumDecoded;
+    std::atomic<uint64_t> m_NumFailed;
+    uint64_t m_NumUploaded;
+    uint64_t m_NumEvicted;
+    uint64_t m_NumResident;
+    uint64_t m_ResidentBytes;
+};
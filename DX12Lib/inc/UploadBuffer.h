@@ -1,5 +1,12 @@
 /**
  * An UploadBuffer provides a convenient method to upload resources to the GPU.
+ *
+ * Each command list has its own UploadBuffer, which sub-allocates blocks from
+ * the upload ring buffer of the command queue. When the command list is
+ * executed its blocks are retired with the fence value of the submission and
+ * reclaimed by the ring as soon as that fence completes. Requests that are too
+ * large for the ring (or made while the ring is full) get a dedicated
+ * transient buffer that is released when the command list is reset.
  */
 #pragma once
 
@@ -9,7 +16,9 @@
 #include <d3d12.h>
 
 #include <memory>
-#include <deque>
+#include <vector>
+
+class UploadRingBuffer;
 
 class UploadBuffer
 {
@@ -19,23 +28,29 @@ public:
     {
         void* CPU;
         D3D12_GPU_VIRTUAL_ADDRESS GPU;
+        // The upload resource and the offset of the allocation in it, for
+        // copy commands that take a resource instead of a GPU address.
+        ID3D12Resource* Resource;
+        size_t Offset;
     };
 
     /**
-     * @param pageSize The size to use to allocate new pages in GPU memory.
+     * @param ringBuffer The ring buffer to allocate blocks from.
+     * @param blockSize The minimum size of the blocks allocated from the ring buffer.
      */
-    UploadBuffer(size_t pageSize = _2MB);
+    UploadBuffer(UploadRingBuffer& ringBuffer, size_t blockSize = _KB(256));
 
     virtual ~UploadBuffer();
 
     /**
-     * The maximum size of an allocation is the size of a single page.
+     * The minimum size of a block allocated from the ring buffer.
      */
-    size_t GetPageSize() const { return m_PageSize;  }
+    size_t GetBlockSize() const { return m_BlockSize;  }
 
     /**
      * Allocate memory in an Upload heap.
-     * An allocation must not exceed the size of a page.
+     * Allocations of any size are supported; allocations that are too large
+     * for the ring buffer are placed in a dedicated buffer.
      * Use a memcpy or similar method to copy the 
      * buffer data to CPU pointer in the Allocation structure returned from 
      * this function.
@@ -43,59 +58,51 @@ public:
     Allocation Allocate(size_t sizeInBytes, size_t alignment);
 
     /**
-     * Release all allocated pages. This should only be done when the command list
+     * Hand the blocks allocated so far back to the ring buffer. They are
+     * reused once the command queue has reached fenceValue.
+     * Called by the command queue when the command list is executed.
+     */
+    void Retire(uint64_t fenceValue);
+
+    /**
+     * Release all dedicated buffers. This should only be done when the command list
      * is finished executing on the CommandQueue.
      */
     void Reset();
 
 private:
-    // A single page for the allocator.
+    // A dedicated buffer in an upload heap.
     struct Page
     {
         Page(size_t sizeInBytes);
         ~Page();
 
-        // Check to see if the page has room to satisfy the requested
-        // allocation.
-        bool HasSpace(size_t sizeInBytes, size_t alignment ) const;
-        
-        // Allocate memory from the page.
-        // Throws std::bad_alloc if the the allocation size is larger
-        // that the page size or the size of the allocation exceeds the 
-        // remaining space in the page.
-        Allocation Allocate(size_t sizeInBytes, size_t alignment);
-
-        // Reset the page for reuse.
-        void Reset();
-
-    private:
-
         Microsoft::WRL::ComPtr<ID3D12Resource> m_d3d12Resource;
 
         // Base pointer.
         void* m_CPUPtr;
         D3D12_GPU_VIRTUAL_ADDRESS m_GPUPtr;
-
-        // Allocated page size.
-        size_t m_PageSize;
-        // Current allocation offset in bytes.
-        size_t m_Offset;
     };
 
-    // A pool of memory pages.
-    using PagePool = std::deque< std::shared_ptr<Page> >;
+    // Make a new ring block (or dedicated page) of at least sizeInBytes current.
+    void RequestBlock(size_t sizeInBytes);
 
-    // Request a page from the pool of available pages
-    // or create a new page if there are no available pages.
-    std::shared_ptr<Page> RequestPage();
+    UploadRingBuffer& m_RingBuffer;
 
-    PagePool m_PagePool;
-    PagePool m_AvailablePages;
+    // The minimum size of a block.
+    size_t m_BlockSize;
 
-    Microsoft::WRL::ComPtr<ID3D12Device2> m_d3d12Device;
-    std::shared_ptr<Page> m_CurrentPage;
+    // The block that allocations are currently made from.
+    uint8_t* m_CPUPtr;
+    D3D12_GPU_VIRTUAL_ADDRESS m_GPUPtr;
+    ID3D12Resource* m_d3d12Resource;
+    size_t m_ResourceOffset;
+    size_t m_Size;
+    size_t m_Offset;
 
-    // The size of each page of memory.
-    size_t m_PageSize;
+    // Ring buffer blocks that have not been retired yet.
+    std::vector<uint64_t> m_Blocks;
 
-};
\ No newline at end of file
+    // Dedicated buffers that are kept alive until the command list is reset.
+    std::vector< std::unique_ptr<Page> > m_Pages;
+};
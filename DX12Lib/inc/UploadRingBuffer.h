@@ -0,0 +1,100 @@
+/**
+ * A persistently mapped ring buffer in an upload heap, shared by all command
+ * lists of a command queue.
+ *
+ * Command lists allocate blocks from the head of the ring. When a command list
+ * is executed, its blocks are retired with the fence value of the submission
+ * and the tail of the ring advances past them as soon as that fence value has
+ * completed. Memory is therefore reclaimed incrementally, in submission order,
+ * instead of a whole command list at a time.
+ *
+ * Blocks are reclaimed in allocation order, so a block that is not yet retired
+ * (its command list is still recording) holds back the blocks allocated after
+ * it. If the ring is full, AllocateBlock fails and the caller falls back to a
+ * dedicated buffer.
+ */
+#pragma once
+
+#include <Defines.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+class CommandQueue;
+
+class UploadRingBuffer
+{
+public:
+    struct Block
+    {
+        void* CPU;
+        D3D12_GPU_VIRTUAL_ADDRESS GPU;
+        // The ring buffer resource and the offset of the block in it (for copy commands).
+        ID3D12Resource* Resource;
+        size_t Offset;
+        size_t Size;
+        // Identifies the block when it is retired.
+        uint64_t Id;
+    };
+
+    /**
+     * @param commandQueue The command queue whose fence is used to reclaim blocks.
+     * @param sizeInBytes The size of the ring buffer.
+     */
+    UploadRingBuffer(CommandQueue& commandQueue, size_t sizeInBytes = _32MB);
+    virtual ~UploadRingBuffer();
+
+    size_t GetSize() const
+    {
+        return m_Size;
+    }
+
+    /**
+     * Allocate a block of at least sizeInBytes (aligned to 256 bytes).
+     * Returns false if the ring does not have enough free space.
+     * Thread safe.
+     */
+    bool AllocateBlock(size_t sizeInBytes, Block& block);
+
+    /**
+     * Retire a block. It is reused once the command queue has reached
+     * fenceValue. A fence value of 0 retires the block immediately (use this
+     * for blocks that were never submitted). Thread safe.
+     */
+    void Retire(uint64_t blockId, uint64_t fenceValue);
+
+private:
+    struct InFlightBlock
+    {
+        // The (unwrapped) end of the block in the ring.
+        uint64_t End;
+        uint64_t FenceValue;
+        bool Retired;
+    };
+
+    // Advance the tail past all retired blocks whose fence has completed.
+    void Reclaim();
+
+    CommandQueue& m_CommandQueue;
+
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_d3d12Resource;
+    uint8_t* m_CPUPtr;
+    D3D12_GPU_VIRTUAL_ADDRESS m_GPUPtr;
+    size_t m_Size;
+
+    // Head and tail are offsets that only ever increase. The position in the
+    // ring is the offset modulo the size of the ring.
+    uint64_t m_Head;
+    uint64_t m_Tail;
+
+    // Blocks between the tail and the head, in allocation order.
+    std::deque<InFlightBlock> m_InFlightBlocks;
+    // The id of the block at the front of m_InFlightBlocks.
+    uint64_t m_FirstBlockId;
+
+    std::mutex m_Mutex;
+};
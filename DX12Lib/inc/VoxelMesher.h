@@ -0,0 +1,60 @@
+/**
+ * Builds the VoxelVertex mesh of a 16x16x16 chunk section of full blocks.
+ *
+ * Only the faces of a block that border a transparent cell are emitted. Every
+ * vertex gets the ambient occlusion of the three blocks around its corner in
+ * front of the face, and the sky and block light of the cell in front of the
+ * face. Light is flooded through the transparent cells of the section, so
+ * overhangs and caves get darker with the distance to the open sky.
+ * Cells outside of the section are treated as transparent and lit by the sky.
+ */
+#pragma once
+
+#include <VoxelVertex.h>
+
+#include <cstdint>
+#include <vector>
+
+class VoxelMesher
+{
+public:
+    static const int SectionSize = 16;
+    static const int NumBlocks = SectionSize * SectionSize * SectionSize;
+    // Block type 0 is air.
+    static const uint16_t Air = 0;
+
+    struct BlockType
+    {
+        // The texture array layer of each face, indexed by VoxelFace.
+        uint16_t Layers[static_cast<int>(VoxelFace::NumFaces)];
+        // The block light the block emits (0..15).
+        uint8_t Emission;
+    };
+
+    /**
+     * @param blockTypes The types of the blocks of a section, indexed by the
+     * block value. The first type is air, its layers are not used.
+     */
+    VoxelMesher(std::vector<BlockType> blockTypes);
+
+    /**
+     * Mesh a section. Blocks are indexed x + z * 16 + y * 256 like the chunk
+     * sections of a world, values must be valid block type indices.
+     * The vertices and indices are replaced, their capacity is reused.
+     */
+    void Build(const uint16_t* blocks, VoxelVertexCollection& vertices, std::vector<uint32_t>& indices) const;
+
+    /**
+     * Flood the sky and block light of a section, one value (0..15) per cell.
+     * Solid cells get the light of the block itself (its emission).
+     */
+    void ComputeLight(const uint16_t* blocks, uint8_t* skyLight, uint8_t* blockLight) const;
+
+    static int BlockIndex(int x, int y, int z)
+    {
+        return x + z * SectionSize + y * SectionSize * SectionSize;
+    }
+
+private:
+    std::vector<BlockType> m_BlockTypes;
+};
@@ -0,0 +1,132 @@
+/**
+ * A packed 8 byte vertex format used for the faces of chunk section meshes.
+ *
+ * Positions are stored relative to the section origin (0..16 on each axis),
+ * so the section's world offset must be supplied through the model matrix.
+ * The decode counterpart lives in VoxelVS (Voxel_VS.hlsl) and both
+ * sides must be kept in sync with the bit layout below.
+ *
+ *  Word 0                                 Word 1
+ *  bits  0- 4 : x         (0..16)         bits  0-15 : texture array layer
+ *  bits  5- 9 : y         (0..16)         bits 16-19 : texture repeat in u - 1
+ *  bits 10-14 : z         (0..16)         bits 20-23 : texture repeat in v - 1
+ *  bits 15-17 : face normal (VoxelFace)   bits 24-31 : reserved (0)
+ *  bits 18-19 : ambient occlusion (0..3)
+ *  bits 20-21 : uv corner (0..3)
+ *  bits 22-25 : block light (0..15)
+ *  bits 26-29 : sky light (0..15)
+ *  bits 30-31 : reserved (0)
+ */
+#pragma once
+
+#include <d3d12.h>
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// Face normals that can be encoded in a VoxelVertex.
+enum class VoxelFace : uint8_t
+{
+    PositiveX = 0,
+    NegativeX = 1,
+    PositiveY = 2,
+    NegativeY = 3,
+    PositiveZ = 4,
+    NegativeZ = 5,
+    NumFaces
+};
+
+// The unpacked attributes of a voxel vertex.
+struct VoxelVertexAttributes
+{
+    uint8_t X, Y, Z;        // Section-local position (0..16).
+    VoxelFace Face;
+    uint8_t AO;             // Ambient occlusion level (0 = fully occluded, 3 = unoccluded).
+    uint8_t Corner;         // Which corner of the texture this vertex maps to (u = bit 0, v = bit 1).
+    uint8_t BlockLight;     // 0..15
+    uint8_t SkyLight;       // 0..15
+    uint16_t TextureLayer;  // Index into the block Texture2DArray.
+    uint8_t RepeatU;        // Number of times the texture repeats across the face in u (1..16).
+    uint8_t RepeatV;        // Number of times the texture repeats across the face in v (1..16).
+
+    bool operator==(const VoxelVertexAttributes& other) const
+    {
+        return X == other.X && Y == other.Y && Z == other.Z && Face == other.Face &&
+            AO == other.AO && Corner == other.Corner &&
+            BlockLight == other.BlockLight && SkyLight == other.SkyLight &&
+            TextureLayer == other.TextureLayer &&
+            RepeatU == other.RepeatU && RepeatV == other.RepeatV;
+    }
+};
+
+struct VoxelVertex
+{
+    VoxelVertex()
+        : m_Packed{ 0, 0 }
+    {}
+
+    explicit VoxelVertex(const VoxelVertexAttributes& attributes)
+    {
+        Encode(attributes);
+    }
+
+    /**
+     * Pack the attributes into the vertex.
+     * Values outside of the representable range are asserted in debug builds
+     * and masked in release builds.
+     */
+    void Encode(const VoxelVertexAttributes& a)
+    {
+        assert(a.X <= 16 && a.Y <= 16 && a.Z <= 16);
+        assert(a.Face < VoxelFace::NumFaces);
+        assert(a.AO <= 3 && a.Corner <= 3);
+        assert(a.BlockLight <= 15 && a.SkyLight <= 15);
+        assert(a.RepeatU >= 1 && a.RepeatU <= 16);
+        assert(a.RepeatV >= 1 && a.RepeatV <= 16);
+
+        m_Packed[0] =
+            (uint32_t(a.X & 0x1F)) |
+            (uint32_t(a.Y & 0x1F) << 5) |
+            (uint32_t(a.Z & 0x1F) << 10) |
+            (uint32_t(static_cast<uint8_t>(a.Face) & 0x7) << 15) |
+            (uint32_t(a.AO & 0x3) << 18) |
+            (uint32_t(a.Corner & 0x3) << 20) |
+            (uint32_t(a.BlockLight & 0xF) << 22) |
+            (uint32_t(a.SkyLight & 0xF) << 26);
+
+        m_Packed[1] =
+            (uint32_t(a.TextureLayer)) |
+            (uint32_t((a.RepeatU - 1) & 0xF) << 16) |
+            (uint32_t((a.RepeatV - 1) & 0xF) << 20);
+    }
+
+    /**
+     * Unpack the vertex attributes (the inverse of Encode).
+     */
+    VoxelVertexAttributes Decode() const
+    {
+        VoxelVertexAttributes a;
+        a.X = uint8_t(m_Packed[0] & 0x1F);
+        a.Y = uint8_t((m_Packed[0] >> 5) & 0x1F);
+        a.Z = uint8_t((m_Packed[0] >> 10) & 0x1F);
+        a.Face = static_cast<VoxelFace>((m_Packed[0] >> 15) & 0x7);
+        a.AO = uint8_t((m_Packed[0] >> 18) & 0x3);
+        a.Corner = uint8_t((m_Packed[0] >> 20) & 0x3);
+        a.BlockLight = uint8_t((m_Packed[0] >> 22) & 0xF);
+        a.SkyLight = uint8_t((m_Packed[0] >> 26) & 0xF);
+        a.TextureLayer = uint16_t(m_Packed[1] & 0xFFFF);
+        a.RepeatU = uint8_t(((m_Packed[1] >> 16) & 0xF) + 1);
+        a.RepeatV = uint8_t(((m_Packed[1] >> 20) & 0xF) + 1);
+        return a;
+    }
+
+    uint32_t m_Packed[2];
+
+    static const int InputElementCount = 1;
+    static const D3D12_INPUT_ELEMENT_DESC InputElements[InputElementCount];
+};
+
+static_assert(sizeof(VoxelVertex) == 8, "VoxelVertex must be 8 bytes.");
+
+using VoxelVertexCollection = std::vector<VoxelVertex>;
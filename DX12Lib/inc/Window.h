@@ -143,9 +143,6 @@ private:
     HighResolutionClock m_UpdateClock;
     HighResolutionClock m_RenderClock;
 
-    UINT64 m_FenceValues[BufferCount];
-    uint64_t m_FrameValues[BufferCount];
-
     std::weak_ptr<Game> m_pGame;
 
     Microsoft::WRL::ComPtr<IDXGISwapChain4> m_dxgiSwapChain;
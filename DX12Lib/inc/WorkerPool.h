@@ -0,0 +1,72 @@
+/**
+ * The WorkerPool runs the tasks of a parallel loop on persistent worker threads.
+ *
+ * The threads are created once and sleep on a condition variable between
+ * loops, so a loop only costs a wake-up instead of creating and joining a
+ * thread per task. The calling thread takes part in the loop, and the tasks
+ * are handed out through an atomic counter, so uneven tasks are balanced
+ * across the threads.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+    using Task = std::function<void(size_t index)>;
+
+    /**
+     * @param numThreads The number of worker threads. If 0, one less than the
+     * number of hardware threads is used (the calling thread is the last one).
+     */
+    WorkerPool(uint32_t numThreads = 0);
+    virtual ~WorkerPool();
+
+    /**
+     * Call task(i) for every i in [0, numTasks) and wait for all of them to
+     * finish. The tasks run concurrently on the workers and the calling
+     * thread. If a task throws, the remaining tasks still run and the first
+     * exception is rethrown on the calling thread. Loops started from
+     * different threads run one after the other.
+     */
+    void ParallelFor(size_t numTasks, const Task& task);
+
+    uint32_t GetNumThreads() const
+    {
+        return static_cast<uint32_t>(m_Threads.size());
+    }
+
+private:
+    void ProcessTasks();
+    // Run tasks of the current loop until there are none left.
+    void RunTasks(const Task& task, size_t numTasks);
+
+    std::vector<std::thread> m_Threads;
+
+    // Only one loop runs at a time.
+    std::mutex m_LoopMutex;
+
+    // Guards the state of the current loop.
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkCondition;
+    std::condition_variable m_DoneCondition;
+    const Task* m_pTask;
+    size_t m_NumTasks;
+    size_t m_NumFinished;
+    // The number of workers that are running tasks of the current loop.
+    uint32_t m_NumActive;
+    // Incremented for every loop, so a worker joins each loop once.
+    uint64_t m_Generation;
+    std::exception_ptr m_Exception;
+    bool m_Exit;
+
+    std::atomic<size_t> m_NextTask;
+};
@@ -6,6 +6,7 @@
 #include <Game.h>
 #include <DescriptorAllocator.h>
 #include <DescriptorAllocatorPage.h>
+#include <FramePacer.h>
 #include <Window.h>
 
 constexpr wchar_t WINDOW_CLASS_NAME[] = L"DX12RenderWindowClass";
@@ -61,7 +62,7 @@ Application::Application(HINSTANCE hInst)
     }
 }
 
-void Application::Initialize()
+void Application::Initialize(bool useWarp)
 {
 #if defined(_DEBUG)
     // Always enable the debug layer before doing anything DX12 related
@@ -75,7 +76,7 @@ void Application::Initialize()
     //debugInterface->SetEnableSynchronizedCommandQueueValidation(TRUE);
 #endif
 
-    auto dxgiAdapter = GetAdapter(false);
+    auto dxgiAdapter = GetAdapter(useWarp);
     if ( !dxgiAdapter )
     {
         // If no supporting DX12 adapters exist, fall back to WARP
@@ -103,16 +104,18 @@ void Application::Initialize()
         m_DescriptorAllocators[i] = std::make_unique<DescriptorAllocator>(static_cast<D3D12_DESCRIPTOR_HEAP_TYPE>(i));
     }
 
+    m_FramePacer = std::make_unique<FramePacer>(m_DirectCommandQueue, Window::BufferCount);
+
     // Initialize frame counter 
     ms_FrameCount = 0;
 }
 
-void Application::Create(HINSTANCE hInst)
+void Application::Create(HINSTANCE hInst, bool useWarp)
 {
     if (!gs_pSingelton)
     {
         gs_pSingelton = new Application(hInst);
-        gs_pSingelton->Initialize();
+        gs_pSingelton->Initialize(useWarp);
     }
 }
 
@@ -374,6 +377,13 @@ void Application::Flush()
     m_DirectCommandQueue->Flush();
     m_ComputeCommandQueue->Flush();
     m_CopyCommandQueue->Flush();
+
+    m_FramePacer->RetireCompletedFrames();
+}
+
+FramePacer& Application::GetFramePacer() const
+{
+    return *m_FramePacer;
 }
 
 DescriptorAllocation Application::AllocateDescriptors(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t numDescriptors)
@@ -0,0 +1,1360 @@
+#include <DX12LibPCH.h>
+
+#include <BlockModelBaker.h>
+
+#include <BlockModelTable.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#include <fstream>
+#include <iterator>
+#include <set>
+
+namespace
+{
+    // Limits for broken or hostile resource packs.
+    const int MaxParentDepth = 32;
+    const int MaxJsonDepth = 64;
+    const size_t MaxMultipartStates = 4096;
+
+    // A minimal JSON document model, enough for the model and block state files.
+    struct JsonValue
+    {
+        enum class Type
+        {
+            Null,
+            Bool,
+            Number,
+            String,
+            Array,
+            Object,
+        };
+
+        Type ValueType = Type::Null;
+        bool Bool = false;
+        double Number = 0.0;
+        std::string String;
+        std::vector<JsonValue> Array;
+        // Members in file order; the variant keys of block states are ordered.
+        std::vector<std::pair<std::string, JsonValue> > Object;
+
+        bool IsObject() const
+        {
+            return ValueType == Type::Object;
+        }
+        bool IsArray() const
+        {
+            return ValueType == Type::Array;
+        }
+        bool IsString() const
+        {
+            return ValueType == Type::String;
+        }
+
+        const JsonValue* Find(const char* key) const
+        {
+            for (auto& member : Object)
+            {
+                if (member.first == key)
+                {
+                    return &member.second;
+                }
+            }
+            return nullptr;
+        }
+
+        std::string GetString(const char* key, const std::string& defaultValue = std::string()) const
+        {
+            const JsonValue* value = Find(key);
+            return value && value->ValueType == Type::String ? value->String : defaultValue;
+        }
+
+        double GetNumber(const char* key, double defaultValue) const
+        {
+            const JsonValue* value = Find(key);
+            return value && value->ValueType == Type::Number ? value->Number : defaultValue;
+        }
+
+        bool GetBool(const char* key, bool defaultValue) const
+        {
+            const JsonValue* value = Find(key);
+            return value && value->ValueType == Type::Bool ? value->Bool : defaultValue;
+        }
+
+        // Read an array of numbers, returns false if the value is missing or has another size.
+        bool GetNumbers(const char* key, float* numbers, size_t count) const
+        {
+            const JsonValue* value = Find(key);
+            if (!value || !value->IsArray() || value->Array.size() != count)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < count; ++i)
+            {
+                numbers[i] = static_cast<float>(value->Array[i].Number);
+            }
+            return true;
+        }
+    };
+
+    class JsonParser
+    {
+    public:
+        JsonParser(const std::string& text)
+            : m_Text(text)
+            , m_Position(0)
+        {}
+
+        // Throws std::runtime_error if the text is not valid JSON.
+        JsonValue Parse()
+        {
+            JsonValue value = ParseValue(0);
+            SkipWhitespace();
+            if (m_Position != m_Text.size())
+            {
+                Fail();
+            }
+            return value;
+        }
+
+    private:
+        [[noreturn]] void Fail() const
+        {
+            throw std::runtime_error("Invalid JSON.");
+        }
+
+        void SkipWhitespace()
+        {
+            while (m_Position < m_Text.size() &&
+                (m_Text[m_Position] == ' ' || m_Text[m_Position] == '\t' || m_Text[m_Position] == '\r' || m_Text[m_Position] == '\n'))
+            {
+                ++m_Position;
+            }
+        }
+
+        char Peek()
+        {
+            SkipWhitespace();
+            return m_Position < m_Text.size() ? m_Text[m_Position] : '\0';
+        }
+
+        void Expect(char c)
+        {
+            if (Peek() != c)
+            {
+                Fail();
+            }
+            ++m_Position;
+        }
+
+        bool ParseLiteral(const char* literal)
+        {
+            size_t length = strlen(literal);
+            if (m_Text.compare(m_Position, length, literal) != 0)
+            {
+                return false;
+            }
+            m_Position += length;
+            return true;
+        }
+
+        JsonValue ParseValue(int depth)
+        {
+            if (depth > MaxJsonDepth)
+            {
+                Fail();
+            }
+
+            JsonValue value;
+            char c = Peek();
+            if (c == '{')
+            {
+                ++m_Position;
+                value.ValueType = JsonValue::Type::Object;
+                if (Peek() == '}')
+                {
+                    ++m_Position;
+                    return value;
+                }
+                for (;;)
+                {
+                    if (Peek() != '"')
+                    {
+                        Fail();
+                    }
+                    std::string key = ParseString();
+                    Expect(':');
+                    value.Object.emplace_back(std::move(key), ParseValue(depth + 1));
+                    if (Peek() != ',')
+                    {
+                        break;
+                    }
+                    ++m_Position;
+                }
+                Expect('}');
+            }
+            else if (c == '[')
+            {
+                ++m_Position;
+                value.ValueType = JsonValue::Type::Array;
+                if (Peek() == ']')
+                {
+                    ++m_Position;
+                    return value;
+                }
+                for (;;)
+                {
+                    value.Array.push_back(ParseValue(depth + 1));
+                    if (Peek() != ',')
+                    {
+                        break;
+                    }
+                    ++m_Position;
+                }
+                Expect(']');
+            }
+            else if (c == '"')
+            {
+                value.ValueType = JsonValue::Type::String;
+                value.String = ParseString();
+            }
+            else if (ParseLiteral("true"))
+            {
+                value.ValueType = JsonValue::Type::Bool;
+                value.Bool = true;
+            }
+            else if (ParseLiteral("false"))
+            {
+                value.ValueType = JsonValue::Type::Bool;
+            }
+            else if (ParseLiteral("null"))
+            {
+                value.ValueType = JsonValue::Type::Null;
+            }
+            else
+            {
+                const char* start = m_Text.c_str() + m_Position;
+                char* end = nullptr;
+                value.ValueType = JsonValue::Type::Number;
+                value.Number = strtod(start, &end);
+                if (end == start)
+                {
+                    Fail();
+                }
+                m_Position += end - start;
+            }
+
+            return value;
+        }
+
+        uint32_t ParseHex4()
+        {
+            if (m_Position + 4 > m_Text.size())
+            {
+                Fail();
+            }
+            uint32_t code = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                char c = m_Text[m_Position++];
+                code <<= 4;
+                if (c >= '0' && c <= '9') code |= c - '0';
+                else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+                else Fail();
+            }
+            return code;
+        }
+
+        void AppendUTF8(std::string& s, uint32_t code)
+        {
+            if (code < 0x80)
+            {
+                s += static_cast<char>(code);
+            }
+            else if (code < 0x800)
+            {
+                s += static_cast<char>(0xC0 | (code >> 6));
+                s += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else if (code < 0x10000)
+            {
+                s += static_cast<char>(0xE0 | (code >> 12));
+                s += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                s += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else
+            {
+                s += static_cast<char>(0xF0 | (code >> 18));
+                s += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                s += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                s += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+
+        std::string ParseString()
+        {
+            // The opening quote has been peeked.
+            ++m_Position;
+            std::string s;
+            while (m_Position < m_Text.size())
+            {
+                char c = m_Text[m_Position++];
+                if (c == '"')
+                {
+                    return s;
+                }
+                if (c != '\\')
+                {
+                    s += c;
+                    continue;
+                }
+                if (m_Position >= m_Text.size())
+                {
+                    break;
+                }
+                c = m_Text[m_Position++];
+                switch (c)
+                {
+                case '"': s += '"'; break;
+                case '\\': s += '\\'; break;
+                case '/': s += '/'; break;
+                case 'b': s += '\b'; break;
+                case 'f': s += '\f'; break;
+                case 'n': s += '\n'; break;
+                case 'r': s += '\r'; break;
+                case 't': s += '\t'; break;
+                case 'u':
+                {
+                    uint32_t code = ParseHex4();
+                    // Combine surrogate pairs.
+                    if (code >= 0xD800 && code < 0xDC00 && m_Text.compare(m_Position, 2, "\\u") == 0)
+                    {
+                        m_Position += 2;
+                        uint32_t low = ParseHex4();
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    AppendUTF8(s, code);
+                    break;
+                }
+                default:
+                    Fail();
+                }
+            }
+            Fail();
+        }
+
+        const std::string& m_Text;
+        size_t m_Position;
+    };
+
+    JsonValue ParseJsonFile(const fs::path& fileName)
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open a block model file.");
+        }
+        std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        // Skip a UTF-8 byte order mark.
+        if (text.compare(0, 3, "\xEF\xBB\xBF") == 0)
+        {
+            text.erase(0, 3);
+        }
+        return JsonParser(text).Parse();
+    }
+
+    // Resource locations may have a namespace, only the minecraft namespace is supported.
+    std::string StripNamespace(const std::string& name)
+    {
+        return name.compare(0, 10, "minecraft:") == 0 ? name.substr(10) : name;
+    }
+
+    const int NumFaces = static_cast<int>(VoxelFace::NumFaces);
+
+    // The direction of each VoxelFace.
+    const int FaceNormals[NumFaces][3] =
+    {
+        {  1,  0,  0 }, // east
+        { -1,  0,  0 }, // west
+        {  0,  1,  0 }, // up
+        {  0, -1,  0 }, // down
+        {  0,  0,  1 }, // south
+        {  0,  0, -1 }, // north
+    };
+
+    const char* FaceNames[NumFaces] = { "east", "west", "up", "down", "south", "north" };
+
+    // The corners of each face of an element (0 = from, 1 = to on each axis),
+    // in the vertex order of the game, which matches the UV corners below.
+    const uint8_t FaceCorners[NumFaces][4][3] =
+    {
+        { { 1, 1, 1 }, { 1, 0, 1 }, { 1, 0, 0 }, { 1, 1, 0 } }, // east
+        { { 0, 1, 0 }, { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 } }, // west
+        { { 0, 1, 0 }, { 0, 1, 1 }, { 1, 1, 1 }, { 1, 1, 0 } }, // up
+        { { 0, 0, 1 }, { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 } }, // down
+        { { 0, 1, 1 }, { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 } }, // south
+        { { 1, 1, 0 }, { 1, 0, 0 }, { 0, 0, 0 }, { 0, 1, 0 } }, // north
+    };
+
+    // The UV corners (u0, v0), (u0, v1), (u1, v1), (u1, v0) as indices into [u0, v0, u1, v1].
+    const uint8_t UVCorners[4][2] = { { 0, 1 }, { 0, 3 }, { 2, 3 }, { 2, 1 } };
+
+    int ParseFace(const std::string& name)
+    {
+        for (int face = 0; face < NumFaces; ++face)
+        {
+            if (name == FaceNames[face])
+            {
+                return face;
+            }
+        }
+        return -1;
+    }
+
+    // The texture coordinates (in pixels) of a position when the texture is projected onto a face.
+    // For an element without explicit UVs these are the UVs of its corners.
+    void ProjectUV(int face, const float* p, float* uv)
+    {
+        switch (static_cast<VoxelFace>(face))
+        {
+        case VoxelFace::PositiveX: uv[0] = 16.0f - p[2]; uv[1] = 16.0f - p[1]; break;
+        case VoxelFace::NegativeX: uv[0] = p[2]; uv[1] = 16.0f - p[1]; break;
+        case VoxelFace::PositiveY: uv[0] = p[0]; uv[1] = p[2]; break;
+        case VoxelFace::NegativeY: uv[0] = p[0]; uv[1] = 16.0f - p[2]; break;
+        case VoxelFace::PositiveZ: uv[0] = p[0]; uv[1] = 16.0f - p[1]; break;
+        default: uv[0] = 16.0f - p[0]; uv[1] = 16.0f - p[1]; break;
+        }
+    }
+
+    // Rotate a vector by the rotation of a variant: -x degrees around the x axis,
+    // then -y degrees around the y axis, in steps of 90 degrees.
+    template<typename T>
+    void RotateVariant(T* v, int x, int y)
+    {
+        for (int i = 0; i < ((x / 90) & 3); ++i)
+        {
+            T t = v[1];
+            v[1] = v[2];
+            v[2] = -t;
+        }
+        for (int i = 0; i < ((y / 90) & 3); ++i)
+        {
+            T t = v[0];
+            v[0] = -v[2];
+            v[2] = t;
+        }
+    }
+
+    int RotateFace(int face, int x, int y)
+    {
+        int normal[3] = { FaceNormals[face][0], FaceNormals[face][1], FaceNormals[face][2] };
+        RotateVariant(normal, x, y);
+        for (int rotated = 0; rotated < NumFaces; ++rotated)
+        {
+            if (normal[0] == FaceNormals[rotated][0] && normal[1] == FaceNormals[rotated][1] && normal[2] == FaceNormals[rotated][2])
+            {
+                return rotated;
+            }
+        }
+        return face;
+    }
+
+    struct ModelFace
+    {
+        bool HasUV = false;
+        // u0, v0, u1, v1 in pixels.
+        float UV[4] = {};
+        // A texture name or a #variable.
+        std::string Texture;
+        int CullFace = -1;
+        int Rotation = 0;
+        int TintIndex = -1;
+    };
+
+    struct ModelElement
+    {
+        float From[3] = {};
+        float To[3] = {};
+
+        bool HasRotation = false;
+        float Origin[3] = {};
+        int Axis = 0;
+        float Angle = 0.0f;
+        bool Rescale = false;
+
+        bool Shade = true;
+        bool HasFace[NumFaces] = {};
+        ModelFace Faces[NumFaces];
+    };
+
+    struct Model
+    {
+        // Texture variables, including the ones inherited from the parents.
+        std::map<std::string, std::string> Textures;
+        std::vector<ModelElement> Elements;
+        bool AmbientOcclusion = true;
+    };
+
+    ModelElement ParseElement(const JsonValue& json)
+    {
+        ModelElement element;
+        if (!json.GetNumbers("from", element.From, 3) || !json.GetNumbers("to", element.To, 3))
+        {
+            throw std::runtime_error("A model element has no bounds.");
+        }
+        element.Shade = json.GetBool("shade", true);
+
+        const JsonValue* rotation = json.Find("rotation");
+        if (rotation && rotation->IsObject())
+        {
+            element.HasRotation = true;
+            rotation->GetNumbers("origin", element.Origin, 3);
+            std::string axis = rotation->GetString("axis", "y");
+            element.Axis = axis == "x" ? 0 : axis == "z" ? 2 : 1;
+            element.Angle = static_cast<float>(rotation->GetNumber("angle", 0.0));
+            element.Rescale = rotation->GetBool("rescale", false);
+        }
+
+        const JsonValue* faces = json.Find("faces");
+        if (faces && faces->IsObject())
+        {
+            for (auto& member : faces->Object)
+            {
+                int face = ParseFace(member.first);
+                if (face < 0 || !member.second.IsObject())
+                {
+                    continue;
+                }
+                ModelFace& modelFace = element.Faces[face];
+                element.HasFace[face] = true;
+                modelFace.HasUV = member.second.GetNumbers("uv", modelFace.UV, 4);
+                modelFace.Texture = member.second.GetString("texture");
+                modelFace.CullFace = ParseFace(member.second.GetString("cullface"));
+                modelFace.Rotation = static_cast<int>(member.second.GetNumber("rotation", 0.0));
+                modelFace.TintIndex = static_cast<int>(member.second.GetNumber("tintindex", -1.0));
+            }
+        }
+
+        return element;
+    }
+
+    // Loads model files and resolves their parents. Models are cached by name.
+    class ModelLoader
+    {
+    public:
+        ModelLoader(const fs::path& modelDirectory)
+            : m_ModelDirectory(modelDirectory)
+        {}
+
+        // The resolved model, or nullptr if the model or one of its parents is missing or invalid.
+        const Model* Load(const std::string& name, int depth = 0)
+        {
+            auto cached = m_Models.find(name);
+            if (cached != m_Models.end())
+            {
+                return cached->second.get();
+            }
+            if (depth > MaxParentDepth)
+            {
+                return nullptr;
+            }
+
+            std::unique_ptr<Model> model;
+            if (name.compare(0, 8, "builtin/") == 0)
+            {
+                // Built in models (items, entity rendered blocks) have no elements.
+                model = std::make_unique<Model>();
+            }
+            else
+            {
+                try
+                {
+                    model = LoadFile(name, depth);
+                }
+                catch (std::exception&)
+                {
+                    model.reset();
+                }
+            }
+
+            const Model* result = model.get();
+            m_Models[name] = std::move(model);
+            return result;
+        }
+
+    private:
+        std::unique_ptr<Model> LoadFile(const std::string& name, int depth)
+        {
+            fs::path fileName = m_ModelDirectory / fs::path(name + ".json");
+            if (!fs::exists(fileName))
+            {
+                return nullptr;
+            }
+            JsonValue json = ParseJsonFile(fileName);
+            if (!json.IsObject())
+            {
+                return nullptr;
+            }
+
+            auto model = std::make_unique<Model>();
+
+            std::string parentName = json.GetString("parent");
+            if (!parentName.empty())
+            {
+                const Model* parent = Load(StripNamespace(parentName), depth + 1);
+                if (!parent)
+                {
+                    return nullptr;
+                }
+                *model = *parent;
+            }
+
+            model->AmbientOcclusion = json.GetBool("ambientocclusion", model->AmbientOcclusion);
+
+            const JsonValue* textures = json.Find("textures");
+            if (textures && textures->IsObject())
+            {
+                for (auto& member : textures->Object)
+                {
+                    if (member.second.IsString())
+                    {
+                        model->Textures[member.first] = member.second.String;
+                    }
+                }
+            }
+
+            // The elements of a model replace the elements of its parent.
+            const JsonValue* elements = json.Find("elements");
+            if (elements && elements->IsArray())
+            {
+                model->Elements.clear();
+                for (auto& element : elements->Array)
+                {
+                    model->Elements.push_back(ParseElement(element));
+                }
+            }
+
+            return model;
+        }
+
+        fs::path m_ModelDirectory;
+        std::map<std::string, std::unique_ptr<Model> > m_Models;
+    };
+
+    // Resolve a #variable through the texture variables of a model.
+    // Returns an empty string if the variable is not defined.
+    std::string ResolveTexture(const Model& model, std::string texture)
+    {
+        for (int i = 0; i < MaxParentDepth && !texture.empty() && texture[0] == '#'; ++i)
+        {
+            auto variable = model.Textures.find(texture.substr(1));
+            texture = variable != model.Textures.end() ? variable->second : std::string();
+        }
+        if (texture.empty() || texture[0] == '#')
+        {
+            return std::string();
+        }
+
+        // Block textures are named like the layers of the baked texture array.
+        texture = StripNamespace(texture);
+        return texture.compare(0, 7, "blocks/") == 0 ? texture.substr(7) : texture;
+    }
+
+    // A model as it is used by a variant.
+    struct ModelReference
+    {
+        std::string Model;
+        int X = 0;
+        int Y = 0;
+        bool UVLock = false;
+    };
+
+    bool ParseModelReference(const JsonValue& json, ModelReference& reference)
+    {
+        // Weighted lists of models use the first model.
+        const JsonValue* value = json.IsArray() ? (json.Array.empty() ? nullptr : &json.Array[0]) : &json;
+        if (!value || !value->IsObject())
+        {
+            return false;
+        }
+
+        // The models of block states are relative to models/block.
+        std::string model = StripNamespace(value->GetString("model"));
+        if (model.empty())
+        {
+            return false;
+        }
+        reference.Model = model.find('/') == std::string::npos ? "block/" + model : model;
+        reference.X = static_cast<int>(value->GetNumber("x", 0.0));
+        reference.Y = static_cast<int>(value->GetNumber("y", 0.0));
+        reference.UVLock = value->GetBool("uvlock", false);
+        return true;
+    }
+
+    // Collects the baked states and quads and writes the baked file.
+    class BlockModelWriter
+    {
+    public:
+        BlockModelWriter(ModelLoader& loader)
+            : m_Loader(loader)
+        {}
+
+        using NamedState = std::pair<std::string, BakedBlockState>;
+
+        // Add a state made of the quads of one or more models.
+        // Returns false if a model can't be loaded.
+        bool AddState(const std::string& name, const std::vector<ModelReference>& references)
+        {
+            BakedBlockState state;
+            if (!BakeState(references, state))
+            {
+                return false;
+            }
+
+            m_States.emplace_back(name, state);
+            return true;
+        }
+
+        // Add states that were baked with BakeState.
+        void AddStates(const std::vector<NamedState>& states)
+        {
+            m_States.insert(m_States.end(), states.begin(), states.end());
+        }
+
+        // Bake the quads of one or more models without adding a state for them.
+        // Returns false if a model can't be loaded.
+        bool BakeState(const std::vector<ModelReference>& references, BakedBlockState& bakedState)
+        {
+            // States with the same models share their quads.
+            std::string key;
+            for (auto& reference : references)
+            {
+                key += reference.Model + "," + std::to_string(reference.X) + "," + std::to_string(reference.Y) +
+                    (reference.UVLock ? ",u;" : ";");
+            }
+
+            auto baked = m_BakedModels.find(key);
+            if (baked == m_BakedModels.end())
+            {
+                BakedBlockState state = {};
+                state.FirstQuad = static_cast<uint32_t>(m_Quads.size());
+                state.Flags = BlockModelTable::StateAmbientOcclusion;
+                for (auto& reference : references)
+                {
+                    const Model* model = m_Loader.Load(reference.Model);
+                    if (!model)
+                    {
+                        m_Quads.resize(state.FirstQuad);
+                        return false;
+                    }
+                    if (!model->AmbientOcclusion)
+                    {
+                        state.Flags &= ~BlockModelTable::StateAmbientOcclusion;
+                    }
+                    BakeModel(*model, reference);
+                }
+
+                size_t numQuads = m_Quads.size() - state.FirstQuad;
+                if (numQuads > UINT16_MAX)
+                {
+                    m_Quads.resize(state.FirstQuad);
+                    return false;
+                }
+                state.NumQuads = static_cast<uint16_t>(numQuads);
+                state.FullFaces = ComputeFullFaces(state);
+
+                baked = m_BakedModels.emplace(key, state).first;
+            }
+
+            bakedState = baked->second;
+            return true;
+        }
+
+        uint32_t GetNumStates() const
+        {
+            return static_cast<uint32_t>(m_States.size());
+        }
+
+        size_t GetNumQuads() const
+        {
+            return m_Quads.size();
+        }
+
+        // Drop the quads baked since GetNumQuads returned numQuads, and the
+        // models that share them. The texture names they added are kept.
+        void DiscardQuads(size_t numQuads)
+        {
+            m_Quads.resize(numQuads);
+            for (auto baked = m_BakedModels.begin(); baked != m_BakedModels.end(); )
+            {
+                if (baked->second.FirstQuad >= numQuads)
+                {
+                    baked = m_BakedModels.erase(baked);
+                }
+                else
+                {
+                    ++baked;
+                }
+            }
+        }
+
+        void Write(const std::wstring& fileName, uint32_t numSourceFiles, uint64_t sourceHash)
+        {
+            // States are sorted by name for the binary search of BlockModelTable::FindState.
+            std::stable_sort(m_States.begin(), m_States.end(), [](const NamedState& a, const NamedState& b)
+            {
+                return a.first < b.first;
+            });
+            m_States.erase(std::unique(m_States.begin(), m_States.end(), [](const NamedState& a, const NamedState& b)
+            {
+                return a.first == b.first;
+            }), m_States.end());
+
+            std::vector<char> strings;
+            auto addString = [&strings](const std::string& s)
+            {
+                uint32_t offset = static_cast<uint32_t>(strings.size());
+                strings.insert(strings.end(), s.c_str(), s.c_str() + s.size() + 1);
+                return offset;
+            };
+
+            std::vector<BakedBlockState> states;
+            for (auto& state : m_States)
+            {
+                states.push_back(state.second);
+                states.back().NameOffset = addString(state.first);
+            }
+            std::vector<uint32_t> textureNames;
+            for (auto& texture : m_Textures)
+            {
+                textureNames.push_back(addString(texture));
+            }
+            if (strings.empty())
+            {
+                strings.push_back('\0');
+            }
+            // Keep the file size a multiple of 4.
+            strings.resize((strings.size() + 3) & ~size_t(3), '\0');
+
+            BlockModelFileHeader header = {};
+            header.Magic = BlockModelTable::FileMagic;
+            header.Version = BlockModelTable::FileVersion;
+            header.NumSourceFiles = numSourceFiles;
+            header.SourceHash = sourceHash;
+            header.NumStates = static_cast<uint32_t>(states.size());
+            header.StatesOffset = sizeof(BlockModelFileHeader);
+            header.NumQuads = static_cast<uint32_t>(m_Quads.size());
+            header.QuadsOffset = header.StatesOffset + header.NumStates * sizeof(BakedBlockState);
+            header.NumTextures = static_cast<uint32_t>(textureNames.size());
+            header.TexturesOffset = header.QuadsOffset + header.NumQuads * sizeof(BakedQuad);
+            header.StringsSize = static_cast<uint32_t>(strings.size());
+            header.StringsOffset = header.TexturesOffset + header.NumTextures * sizeof(uint32_t);
+
+            std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(states.data()), states.size() * sizeof(BakedBlockState));
+            file.write(reinterpret_cast<const char*>(m_Quads.data()), m_Quads.size() * sizeof(BakedQuad));
+            file.write(reinterpret_cast<const char*>(textureNames.data()), textureNames.size() * sizeof(uint32_t));
+            file.write(strings.data(), strings.size());
+
+            if (!file)
+            {
+                throw std::runtime_error("Failed to write the baked block models.");
+            }
+        }
+
+    private:
+
+        uint16_t AddTexture(const std::string& name)
+        {
+            auto texture = m_TextureIndices.find(name);
+            if (texture != m_TextureIndices.end())
+            {
+                return texture->second;
+            }
+            if (m_Textures.size() >= UINT16_MAX)
+            {
+                throw std::runtime_error("Too many block model textures.");
+            }
+            uint16_t index = static_cast<uint16_t>(m_Textures.size());
+            m_Textures.push_back(name);
+            m_TextureIndices[name] = index;
+            return index;
+        }
+
+        void BakeModel(const Model& model, const ModelReference& reference)
+        {
+            const bool uvLock = reference.UVLock && (reference.X != 0 || reference.Y != 0);
+
+            for (auto& element : model.Elements)
+            {
+                // Rotation of the element around its origin, with the optional
+                // scale that keeps a diagonal (cross) element the size of the block.
+                const float angle = element.Angle * 3.14159265f / 180.0f;
+                const float c = std::cos(angle);
+                const float s = std::sin(angle);
+                const float scale = element.Rescale && c > 0.0f ? 1.0f / c : 1.0f;
+
+                for (int face = 0; face < NumFaces; ++face)
+                {
+                    if (!element.HasFace[face])
+                    {
+                        continue;
+                    }
+                    const ModelFace& modelFace = element.Faces[face];
+                    std::string texture = ResolveTexture(model, modelFace.Texture);
+                    if (texture.empty())
+                    {
+                        continue;
+                    }
+
+                    float uv[4];
+                    if (modelFace.HasUV)
+                    {
+                        memcpy(uv, modelFace.UV, sizeof(uv));
+                    }
+                    else
+                    {
+                        // The default UVs project the element onto the face.
+                        float from[3], to[3];
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            from[i] = FaceCorners[face][0][i] ? element.To[i] : element.From[i];
+                            to[i] = FaceCorners[face][2][i] ? element.To[i] : element.From[i];
+                        }
+                        ProjectUV(face, from, uv);
+                        ProjectUV(face, to, uv + 2);
+                    }
+
+                    BakedQuad quad = {};
+                    quad.Texture = AddTexture(texture);
+                    quad.Face = static_cast<uint8_t>(RotateFace(face, reference.X, reference.Y));
+                    quad.CullFace = modelFace.CullFace < 0 ? BlockModelTable::NoCullFace :
+                        static_cast<uint8_t>(RotateFace(modelFace.CullFace, reference.X, reference.Y));
+                    quad.TintIndex = static_cast<int8_t>(modelFace.TintIndex);
+                    quad.Flags = element.Shade ? BlockModelTable::QuadShade : 0;
+
+                    for (int vertex = 0; vertex < 4; ++vertex)
+                    {
+                        float p[3];
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            p[i] = FaceCorners[face][vertex][i] ? element.To[i] : element.From[i];
+                        }
+
+                        if (element.HasRotation && element.Angle != 0.0f)
+                        {
+                            float d[3] = { p[0] - element.Origin[0], p[1] - element.Origin[1], p[2] - element.Origin[2] };
+                            int a = (element.Axis + 1) % 3;
+                            int b = (element.Axis + 2) % 3;
+                            float da = d[a] * c - d[b] * s;
+                            float db = d[a] * s + d[b] * c;
+                            p[a] = element.Origin[a] + da * scale;
+                            p[b] = element.Origin[b] + db * scale;
+                        }
+
+                        // The variant rotates the whole model around the center of the block.
+                        float centered[3] = { p[0] - 8.0f, p[1] - 8.0f, p[2] - 8.0f };
+                        RotateVariant(centered, reference.X, reference.Y);
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            p[i] = centered[i] + 8.0f;
+                        }
+
+                        float vertexUV[2];
+                        if (uvLock)
+                        {
+                            // The texture stays aligned with the world.
+                            ProjectUV(quad.Face, p, vertexUV);
+                        }
+                        else
+                        {
+                            const uint8_t* corner = UVCorners[(vertex + modelFace.Rotation / 90) & 3];
+                            vertexUV[0] = uv[corner[0]];
+                            vertexUV[1] = uv[corner[1]];
+                        }
+
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            quad.Positions[vertex][i] = p[i] / 16.0f;
+                        }
+                        quad.UVs[vertex][0] = vertexUV[0] / 16.0f;
+                        quad.UVs[vertex][1] = vertexUV[1] / 16.0f;
+                    }
+
+                    m_Quads.push_back(quad);
+                }
+            }
+        }
+
+        // The faces of the block that are completely covered by a quad on the block boundary.
+        uint8_t ComputeFullFaces(const BakedBlockState& state) const
+        {
+            const float epsilon = 1e-4f;
+
+            uint8_t fullFaces = 0;
+            for (uint32_t q = state.FirstQuad; q < state.FirstQuad + state.NumQuads; ++q)
+            {
+                const BakedQuad& quad = m_Quads[q];
+                const int* normal = FaceNormals[quad.Face];
+                int axis = normal[0] != 0 ? 0 : normal[1] != 0 ? 1 : 2;
+                float plane = normal[axis] > 0 ? 1.0f : 0.0f;
+
+                bool full = true;
+                float minimum[3] = { 1.0f, 1.0f, 1.0f };
+                float maximum[3] = { 0.0f, 0.0f, 0.0f };
+                for (int vertex = 0; vertex < 4; ++vertex)
+                {
+                    const float* p = quad.Positions[vertex];
+                    full = full && std::abs(p[axis] - plane) < epsilon;
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        minimum[i] = std::min(minimum[i], p[i]);
+                        maximum[i] = std::max(maximum[i], p[i]);
+                    }
+                }
+                for (int i = 0; i < 3; ++i)
+                {
+                    if (i != axis)
+                    {
+                        full = full && minimum[i] < epsilon && maximum[i] > 1.0f - epsilon;
+                    }
+                }
+
+                if (full)
+                {
+                    fullFaces |= static_cast<uint8_t>(1u << quad.Face);
+                }
+            }
+
+            return fullFaces;
+        }
+
+        ModelLoader& m_Loader;
+        std::vector<NamedState> m_States;
+        std::vector<BakedQuad> m_Quads;
+        std::map<std::string, BakedBlockState> m_BakedModels;
+        std::vector<std::string> m_Textures;
+        std::map<std::string, uint16_t> m_TextureIndices;
+    };
+
+    using PropertyValues = std::map<std::string, std::string>;
+
+    std::vector<std::string> SplitValues(const std::string& values)
+    {
+        std::vector<std::string> result;
+        size_t start = 0;
+        for (size_t end = values.find('|'); ; end = values.find('|', start))
+        {
+            result.push_back(values.substr(start, end - start));
+            if (end == std::string::npos)
+            {
+                break;
+            }
+            start = end + 1;
+        }
+        return result;
+    }
+
+    std::string JsonToString(const JsonValue& value)
+    {
+        if (value.ValueType == JsonValue::Type::Bool)
+        {
+            return value.Bool ? "true" : "false";
+        }
+        if (value.ValueType == JsonValue::Type::Number)
+        {
+            return std::to_string(static_cast<int>(value.Number));
+        }
+        return value.String;
+    }
+
+    // Collect the values of every property that is tested in a multipart condition.
+    void CollectProperties(const JsonValue& when, std::map<std::string, std::set<std::string> >& properties)
+    {
+        for (auto& member : when.Object)
+        {
+            if (member.first == "OR")
+            {
+                for (auto& condition : member.second.Array)
+                {
+                    CollectProperties(condition, properties);
+                }
+            }
+            else
+            {
+                for (auto& value : SplitValues(JsonToString(member.second)))
+                {
+                    properties[member.first].insert(value);
+                }
+            }
+        }
+    }
+
+    bool MatchCondition(const JsonValue& when, const PropertyValues& values)
+    {
+        for (auto& member : when.Object)
+        {
+            if (member.first == "OR")
+            {
+                bool any = false;
+                for (auto& condition : member.second.Array)
+                {
+                    any = any || MatchCondition(condition, values);
+                }
+                if (!any)
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            auto value = values.find(member.first);
+            std::vector<std::string> accepted = SplitValues(JsonToString(member.second));
+            if (value == values.end() || std::find(accepted.begin(), accepted.end(), value->second) == accepted.end())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Expand a multipart block state into one state per combination of property values.
+    // The block is added with all of its states or, if one of them can't be baked, none.
+    bool AddMultipartStates(BlockModelWriter& writer, const std::string& block, const JsonValue& multipart)
+    {
+        std::map<std::string, std::set<std::string> > properties;
+        for (auto& part : multipart.Array)
+        {
+            const JsonValue* when = part.Find("when");
+            if (when && when->IsObject())
+            {
+                CollectProperties(*when, properties);
+            }
+        }
+
+        // Conditions only test for "true", the other value of boolean properties is implied.
+        size_t numStates = 1;
+        for (auto& property : properties)
+        {
+            if (property.second.size() == 1 && *property.second.begin() == "true")
+            {
+                property.second.insert("false");
+            }
+            numStates *= property.second.size();
+            if (numStates > MaxMultipartStates)
+            {
+                return false;
+            }
+        }
+
+        const size_t firstQuad = writer.GetNumQuads();
+        std::vector<BlockModelWriter::NamedState> states;
+        states.reserve(numStates);
+        for (size_t stateIndex = 0; stateIndex < numStates; ++stateIndex)
+        {
+            PropertyValues values;
+            std::string variant;
+            size_t remainder = stateIndex;
+            for (auto& property : properties)
+            {
+                auto value = property.second.begin();
+                std::advance(value, remainder % property.second.size());
+                remainder /= property.second.size();
+
+                values[property.first] = *value;
+                variant += (variant.empty() ? "" : ",") + property.first + "=" + *value;
+            }
+
+            std::vector<ModelReference> references;
+            for (auto& part : multipart.Array)
+            {
+                const JsonValue* when = part.Find("when");
+                const JsonValue* apply = part.Find("apply");
+                ModelReference reference;
+                if (apply && (!when || MatchCondition(*when, values)) && ParseModelReference(*apply, reference))
+                {
+                    references.push_back(reference);
+                }
+            }
+
+            BakedBlockState state;
+            if (!writer.BakeState(references, state))
+            {
+                writer.DiscardQuads(firstQuad);
+                return false;
+            }
+            states.emplace_back(block + "#" + (variant.empty() ? "normal" : variant), state);
+        }
+
+        writer.AddStates(states);
+        return true;
+    }
+
+    bool IsJSONFile(const fs::path& path)
+    {
+        std::wstring extension = path.extension().wstring();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::towlower);
+        return extension == L".json";
+    }
+
+    std::vector<fs::path> ListJSONFiles(const fs::path& directory)
+    {
+        std::vector<fs::path> files;
+        if (fs::is_directory(directory))
+        {
+            for (auto& entry : fs::directory_iterator(directory))
+            {
+                if (fs::is_regular_file(entry.status()) && IsJSONFile(entry.path()))
+                {
+                    files.push_back(entry.path());
+                }
+            }
+        }
+        // Directory order is not specified, sort so the bakes are stable.
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    // 64-bit FNV-1a, the same hash as the signature of the TextureArrayBaker.
+    const uint64_t FNVOffsetBasis = 14695981039346656037ull;
+    const uint64_t FNVPrime = 1099511628211ull;
+
+    uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * FNVPrime;
+        }
+        return hash;
+    }
+
+    uint64_t HashString(uint64_t hash, const std::wstring& string)
+    {
+        // Include the terminator so "ab" + "c" and "a" + "bc" hash differently.
+        return HashBytes(hash, string.c_str(), (string.size() + 1) * sizeof(wchar_t));
+    }
+}
+
+BlockModelBaker::BlockModelBaker(const std::wstring& assetDirectory, const std::wstring& outputDirectory)
+    : m_AssetDirectory(assetDirectory)
+    , m_OutputDirectory(outputDirectory)
+{
+    while (!m_AssetDirectory.empty() && (m_AssetDirectory.back() == L'/' || m_AssetDirectory.back() == L'\\'))
+    {
+        m_AssetDirectory.pop_back();
+    }
+
+    m_BakedFileName = (fs::path(m_OutputDirectory) / fs::path(m_AssetDirectory).filename()).wstring() + L".blockmodels";
+}
+
+BlockModelBaker::~BlockModelBaker()
+{}
+
+BlockModelBaker::SourceSignature BlockModelBaker::ScanSourceFiles() const
+{
+    SourceSignature signature;
+    signature.Hash = FNVOffsetBasis;
+
+    // Any added, removed, renamed or rewritten file changes the hash, also
+    // when it doesn't change the number of files or the newest write time.
+    // ListJSONFiles sorts the files by name. The name includes the directory,
+    // so moving a file between the two directories changes the hash too.
+    const wchar_t* directories[] =
+    {
+        L"blockstates",
+        L"models/block",
+    };
+    for (auto directory : directories)
+    {
+        for (auto& file : ListJSONFiles(fs::path(m_AssetDirectory) / directory))
+        {
+            uint64_t fileSize = static_cast<uint64_t>(fs::file_size(file));
+            uint64_t writeTime = static_cast<uint64_t>(fs::last_write_time(file).time_since_epoch().count());
+
+            signature.Hash = HashString(signature.Hash, std::wstring(directory) + L"/" + file.filename().wstring());
+            signature.Hash = HashBytes(signature.Hash, &fileSize, sizeof(fileSize));
+            signature.Hash = HashBytes(signature.Hash, &writeTime, sizeof(writeTime));
+            ++signature.NumFiles;
+        }
+    }
+
+    return signature;
+}
+
+bool BlockModelBaker::IsBakeCurrent() const
+{
+    BlockModelFileHeader header;
+    if (!BlockModelTable::ReadHeader(m_BakedFileName, header))
+    {
+        return false;
+    }
+
+    SourceSignature signature = ScanSourceFiles();
+
+    return signature.NumFiles == header.NumSourceFiles && signature.Hash == header.SourceHash;
+}
+
+uint32_t BlockModelBaker::Bake()
+{
+    SourceSignature signature = ScanSourceFiles();
+
+    ModelLoader loader(fs::path(m_AssetDirectory) / L"models");
+    BlockModelWriter writer(loader);
+
+    for (auto& fileName : ListJSONFiles(fs::path(m_AssetDirectory) / L"blockstates"))
+    {
+        const std::string block = fileName.stem().string();
+
+        JsonValue json;
+        try
+        {
+            json = ParseJsonFile(fileName);
+        }
+        catch (std::exception&)
+        {
+            continue;
+        }
+
+        const JsonValue* variants = json.Find("variants");
+        const JsonValue* multipart = json.Find("multipart");
+        if (variants && variants->IsObject())
+        {
+            for (auto& variant : variants->Object)
+            {
+                ModelReference reference;
+                if (ParseModelReference(variant.second, reference))
+                {
+                    writer.AddState(block + "#" + variant.first, { reference });
+                }
+            }
+        }
+        else if (multipart && multipart->IsArray())
+        {
+            AddMultipartStates(writer, block, *multipart);
+        }
+    }
+
+    if (!m_OutputDirectory.empty())
+    {
+        fs::create_directories(m_OutputDirectory);
+    }
+
+    writer.Write(m_BakedFileName, signature.NumFiles, signature.Hash);
+
+    return writer.GetNumStates();
+}
+
+const std::wstring& BlockModelBaker::BakeIfNeeded()
+{
+    if (!IsBakeCurrent())
+    {
+        Bake();
+    }
+
+    return m_BakedFileName;
+}
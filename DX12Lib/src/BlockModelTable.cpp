@@ -0,0 +1,175 @@
+#include <DX12LibPCH.h>
+
+#include <BlockModelTable.h>
+
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    bool IsValidHeader(const BlockModelFileHeader& header)
+    {
+        return header.Magic == BlockModelTable::FileMagic && header.Version == BlockModelTable::FileVersion;
+    }
+
+    // Check that a table of count elements lies inside the file.
+    bool IsInFile(uint32_t offset, uint64_t count, size_t elementSize, size_t fileSize)
+    {
+        return offset % 4 == 0 && offset <= fileSize && count * elementSize <= fileSize - offset;
+    }
+}
+
+BlockModelTable::BlockModelTable()
+    : m_Header(nullptr)
+    , m_States(nullptr)
+    , m_Quads(nullptr)
+    , m_TextureNames(nullptr)
+    , m_Strings(nullptr)
+{}
+
+BlockModelTable::BlockModelTable(BlockModelTable&& other)
+    : BlockModelTable()
+{
+    *this = std::move(other);
+}
+
+BlockModelTable& BlockModelTable::operator=(BlockModelTable&& other)
+{
+    if (this != &other)
+    {
+        Close();
+
+        m_File = std::move(other.m_File);
+        m_Header = other.m_Header;
+        m_States = other.m_States;
+        m_Quads = other.m_Quads;
+        m_TextureNames = other.m_TextureNames;
+        m_Strings = other.m_Strings;
+
+        other.Close();
+    }
+    return *this;
+}
+
+BlockModelTable::~BlockModelTable()
+{
+    Close();
+}
+
+void BlockModelTable::Open(const std::wstring& fileName)
+{
+    Close();
+
+    if (!m_File.Open(fileName.c_str()))
+    {
+        throw std::runtime_error("Failed to map the baked block models.");
+    }
+
+    const uint8_t* data = m_File.GetData();
+    const size_t size = m_File.GetSize();
+    const BlockModelFileHeader* header = reinterpret_cast<const BlockModelFileHeader*>(data);
+    if (size < sizeof(BlockModelFileHeader) || !IsValidHeader(*header) ||
+        !IsInFile(header->StatesOffset, header->NumStates, sizeof(BakedBlockState), size) ||
+        !IsInFile(header->QuadsOffset, header->NumQuads, sizeof(BakedQuad), size) ||
+        !IsInFile(header->TexturesOffset, header->NumTextures, sizeof(uint32_t), size) ||
+        !IsInFile(header->StringsOffset, header->StringsSize, 1, size) ||
+        header->StringsSize == 0 || data[header->StringsOffset + header->StringsSize - 1] != 0)
+    {
+        Close();
+        throw std::runtime_error("Invalid baked block models.");
+    }
+
+    m_Header = header;
+    m_States = reinterpret_cast<const BakedBlockState*>(data + header->StatesOffset);
+    m_Quads = reinterpret_cast<const BakedQuad*>(data + header->QuadsOffset);
+    m_TextureNames = reinterpret_cast<const uint32_t*>(data + header->TexturesOffset);
+    m_Strings = reinterpret_cast<const char*>(data + header->StringsOffset);
+
+    // Validate the references once, so the accessors don't need to.
+    for (uint32_t i = 0; i < header->NumStates; ++i)
+    {
+        const BakedBlockState& state = m_States[i];
+        if (state.NameOffset >= header->StringsSize ||
+            static_cast<uint64_t>(state.FirstQuad) + state.NumQuads > header->NumQuads)
+        {
+            Close();
+            throw std::runtime_error("Invalid baked block models.");
+        }
+    }
+    for (uint32_t i = 0; i < header->NumTextures; ++i)
+    {
+        if (m_TextureNames[i] >= header->StringsSize)
+        {
+            Close();
+            throw std::runtime_error("Invalid baked block models.");
+        }
+    }
+    for (uint32_t i = 0; i < header->NumQuads; ++i)
+    {
+        if (m_Quads[i].Texture >= header->NumTextures)
+        {
+            Close();
+            throw std::runtime_error("Invalid baked block models.");
+        }
+    }
+}
+
+void BlockModelTable::Close()
+{
+    m_File.Close();
+    m_Header = nullptr;
+    m_States = nullptr;
+    m_Quads = nullptr;
+    m_TextureNames = nullptr;
+    m_Strings = nullptr;
+}
+
+bool BlockModelTable::ReadHeader(const std::wstring& fileName, BlockModelFileHeader& header)
+{
+    std::ifstream file(fileName, std::ios::binary);
+    return file.read(reinterpret_cast<char*>(&header), sizeof(header)) && IsValidHeader(header);
+}
+
+uint32_t BlockModelTable::FindState(const char* name) const
+{
+    uint32_t first = 0;
+    uint32_t count = GetNumStates();
+    while (count > 0)
+    {
+        uint32_t step = count / 2;
+        uint32_t middle = first + step;
+        if (strcmp(GetStateName(middle), name) < 0)
+        {
+            first = middle + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+
+    return first < GetNumStates() && strcmp(GetStateName(first), name) == 0 ? first : InvalidState;
+}
+
+uint32_t BlockModelTable::FindState(const std::string& block, const std::string& variant) const
+{
+    return FindState((block + "#" + variant).c_str());
+}
+
+std::vector<uint32_t> BlockModelTable::ResolveTextureLayers(const TextureArrayBaker::LayerTable& layers) const
+{
+    std::vector<uint32_t> textureLayers(GetNumTextures(), InvalidLayer);
+    for (uint32_t i = 0; i < GetNumTextures(); ++i)
+    {
+        // Texture names are ASCII.
+        const char* name = GetTextureName(i);
+        auto layer = layers.find(std::wstring(name, name + strlen(name)));
+        if (layer != layers.end())
+        {
+            textureLayers[i] = layer->second;
+        }
+    }
+
+    return textureLayers;
+}
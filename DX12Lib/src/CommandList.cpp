@@ -14,10 +14,10 @@
 #include <RootSignature.h>
 #include <StructuredBuffer.h>
 #include <Texture.h>
+#include <TextureStreamer.h>
 #include <UploadBuffer.h>
 #include <VertexBuffer.h>
 
-#include <DirectXTex/DDSTextureLoader12.h>
 #include <DirectXTex/WICTextureLoader12.h>
 
 #include <d3dx12.h>
@@ -29,8 +29,10 @@
 namespace fs = std::experimental::filesystem;
 using namespace DirectX;
 
-std::map<std::wstring, ID3D12Resource* > CommandList::ms_TextureCache;
+std::map<std::wstring, ComPtr<ID3D12Resource> > CommandList::ms_TextureCache;
+std::set<std::wstring> CommandList::ms_TexturesLoading;
 std::mutex CommandList::ms_TextureCacheMutex;
+std::condition_variable CommandList::ms_TextureCacheCondition;
 
 CommandList::CommandList(D3D12_COMMAND_LIST_TYPE type)
 	: m_d3d12CommandListType(type)
@@ -42,7 +44,8 @@ CommandList::CommandList(D3D12_COMMAND_LIST_TYPE type)
 	ThrowIfFailed(device->CreateCommandList(0, m_d3d12CommandListType, m_d3d12CommandAllocator.Get(),
 		nullptr, IID_PPV_ARGS(&m_d3d12CommandList)));
 
-	m_UploadBuffer = std::make_unique<UploadBuffer>();
+	auto commandQueue = Application::Get().GetCommandQueue(m_d3d12CommandListType);
+	m_UploadBuffer = std::make_unique<UploadBuffer>(commandQueue->GetUploadRingBuffer());
 
 	m_ResourceStateTracker = std::make_unique<ResourceStateTracker>();
 
@@ -99,6 +102,7 @@ void CommandList::CopyResource(Resource& dstRes, const Resource& srcRes)
 	FlushResourceBarriers();
 
 	m_d3d12CommandList->CopyResource(dstRes.GetD3D12Resource().Get(), srcRes.GetD3D12Resource().Get());
+	m_Recorder.Record(RecordedCommandType::CopyResource);
 
 	m_TrackedObjects.push_back(dstRes.GetD3D12Resource());
 	m_TrackedObjects.push_back(srcRes.GetD3D12Resource());
@@ -147,6 +151,7 @@ void CommandList::CopyBuffer(Buffer& buffer, size_t numElements, size_t elementS
 
 			UpdateSubresources(m_d3d12CommandList.Get(), d3d12Resource.Get(),
 				uploadResource.Get(), 0, 0, 1, &subresourceData);
+			m_Recorder.Record(RecordedCommandType::CopyBuffer, 0, 0, 0, bufferSize);
 
 			// Add references to resources so they stay in scope until the command list is reset.
 			m_TrackedObjects.push_back(uploadResource);
@@ -186,71 +191,83 @@ void CommandList::SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY primitiveTopology)
 
 void CommandList::LoadTextureFromFile(Texture& texture, const std::wstring& fileName)
 {
-	auto device = Application::Get().GetDevice();
-
-	fs::path filePath(fileName);
-	if (!fs::exists(filePath))
-	{
-		throw std::invalid_argument("Invalid filename specified.");
-	}
-	auto iter = ms_TextureCache.find(fileName);
-	if (iter != ms_TextureCache.end())
-	{
-		texture.SetD3D12Resource(iter->second);
-	}
-	else
 	{
-		Microsoft::WRL::ComPtr<ID3D12Resource> textureResource;
-		std::unique_ptr<uint8_t[]> textureData;
-		std::vector<D3D12_SUBRESOURCE_DATA> subresourceData;
+		std::unique_lock<std::mutex> lock(ms_TextureCacheMutex);
+		// If another thread is loading the same file, wait for it instead of decoding the file twice.
+		ms_TextureCacheCondition.wait(lock, [&fileName] { return ms_TexturesLoading.count(fileName) == 0; });
 
-		if (filePath.extension() == ".dds")
+		auto iter = ms_TextureCache.find(fileName);
+		if (iter != ms_TextureCache.end())
 		{
-			// Use DDS texture loader.
-			ThrowIfFailed(LoadDDSTextureFromFileEx(device.Get(),
-				fileName.c_str(), 0, D3D12_RESOURCE_FLAG_NONE,
-				DDS_LOADER_MIP_RESERVE, &textureResource, textureData,
-				subresourceData
-			));
+			texture.SetD3D12Resource(iter->second);
+			texture.CreateViews();
+			return;
 		}
-		else
+		ms_TexturesLoading.insert(fileName);
+	}
+
+	// The file stops loading on every way out of this function, including the
+	// exceptions of the decode, the resource creation and the copies, so the
+	// threads waiting for it never wait forever.
+	struct LoadingGuard
+	{
+		const std::wstring& FileName;
+
+		~LoadingGuard()
 		{
-			D3D12_SUBRESOURCE_DATA resourceData;
-			// Use WIC texture loader.
-			ThrowIfFailed(LoadWICTextureFromFileEx(device.Get(),
-				fileName.c_str(), 0, D3D12_RESOURCE_FLAG_NONE,
-				WIC_LOADER_MIP_RESERVE, &textureResource, textureData,
-				resourceData
-			));
-
-			subresourceData.push_back(resourceData);
+			{
+				std::lock_guard<std::mutex> lock(ms_TextureCacheMutex);
+				ms_TexturesLoading.erase(FileName);
+			}
+			ms_TextureCacheCondition.notify_all();
 		}
+	} loadingGuard{ fileName };
 
-		// Update the global state tracker.
-		ResourceStateTracker::AddGlobalResourceState(textureResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+	TextureStreamer::TextureFileData fileData;
+	TextureStreamer::LoadTextureFile(fileName, fileData);
 
-		texture.SetD3D12Resource(textureResource);
-		texture.CreateViews();
+	auto textureResource = fileData.Resource;
 
-		CopyTextureSubresource(texture, 0, static_cast<uint32_t>(subresourceData.size()), subresourceData.data());
+	// Update the global state tracker.
+	ResourceStateTracker::AddGlobalResourceState(textureResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
 
-		if (subresourceData.size() < textureResource->GetDesc().MipLevels)
-		{
-			GenerateMips(texture);
-		}
+	texture.SetD3D12Resource(textureResource);
+	texture.CreateViews();
 
-		// Add the texture resource to the texture cache.
+	CopyTextureSubresource(texture, 0, static_cast<uint32_t>(fileData.Subresources.size()), fileData.Subresources.data());
+
+	if (fileData.Subresources.size() < textureResource->GetDesc().MipLevels)
+	{
+		GenerateMips(texture);
+	}
+
+	// Add the texture resource to the texture cache, the waiting threads find it once the guard woke them.
+	{
 		std::lock_guard<std::mutex> lock(ms_TextureCacheMutex);
-		ms_TextureCache[fileName] = textureResource.Get();
+		ms_TextureCache[fileName] = textureResource;
 	}
 }
 
+TextureArrayBaker::LayerTable CommandList::LoadTextureArray(Texture& texture, const std::wstring& sourceDirectory, const std::wstring& bakeDirectory)
+{
+	TextureArrayBaker baker(sourceDirectory, bakeDirectory);
+	auto layers = baker.BakeIfNeeded();
+
+	LoadTextureFromFile(texture, baker.GetTextureFileName());
+
+	return layers;
+}
+
 bool CommandList::CreateCubeTexture(const wchar_t* name, Texture& texture) {
-	auto iter = ms_TextureCache.find(name);
-	if (iter != ms_TextureCache.end())
 	{
-		texture.SetD3D12Resource(iter->second);
-		return true;
+		std::lock_guard<std::mutex> lock(ms_TextureCacheMutex);
+		auto iter = ms_TextureCache.find(name);
+		if (iter != ms_TextureCache.end())
+		{
+			texture.SetD3D12Resource(iter->second);
+			texture.CreateViews();
+			return true;
+		}
 	}
 
 	auto device = Application::Get().GetDevice();
@@ -325,7 +342,7 @@ bool CommandList::CreateCubeTexture(const wchar_t* name, Texture& texture) {
 
 	// Add the texture resource to the texture cache.
 	std::lock_guard<std::mutex> lock(ms_TextureCacheMutex);
-	ms_TextureCache[name] = texTemp.Get();
+	ms_TextureCache[name] = texResource;
 
 	return true;
 }
@@ -499,6 +516,7 @@ void CommandList::ClearTexture(const Texture& texture, const float clearColor[4]
 {
 	TransitionBarrier(texture, D3D12_RESOURCE_STATE_RENDER_TARGET);
 	m_d3d12CommandList->ClearRenderTargetView(texture.GetRenderTargetView(), clearColor, 0, nullptr);
+	m_Recorder.Record(RecordedCommandType::Clear);
 
 	m_TrackedObjects.push_back(texture.GetD3D12Resource().Get());
 }
@@ -507,13 +525,13 @@ void CommandList::ClearDepthStencilTexture(const Texture& texture, D3D12_CLEAR_F
 {
 	TransitionBarrier(texture, D3D12_RESOURCE_STATE_DEPTH_WRITE);
 	m_d3d12CommandList->ClearDepthStencilView(texture.GetDepthStencilView(), clearFlags, depth, stencil, 0, nullptr);
+	m_Recorder.Record(RecordedCommandType::Clear);
 
 	m_TrackedObjects.push_back(texture.GetD3D12Resource().Get());
 }
 
 void CommandList::CopyTextureSubresource(Texture& texture, uint32_t firstSubresource, uint32_t numSubresources, D3D12_SUBRESOURCE_DATA* subresourceData)
 {
-	auto device = Application::Get().GetDevice();
 	auto destinationResource = texture.GetD3D12Resource();
 	if (destinationResource)
 	{
@@ -522,20 +540,13 @@ void CommandList::CopyTextureSubresource(Texture& texture, uint32_t firstSubreso
 
 		UINT64 requiredSize = GetRequiredIntermediateSize(destinationResource.Get(), firstSubresource, numSubresources);
 
-		// Create a temporary (intermediate) resource for uploading the subresources
-		ComPtr<ID3D12Resource> intermediateResource;
-		ThrowIfFailed(device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(requiredSize),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&intermediateResource)
-		));
+		// The subresources are copied row by row straight into the upload ring buffer
+		// (large textures get a dedicated upload page that lives as long as the command list).
+		auto uploadAllocation = m_UploadBuffer->Allocate(static_cast<size_t>(requiredSize), D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
 
-		UpdateSubresources(m_d3d12CommandList.Get(), destinationResource.Get(), intermediateResource.Get(), 0, firstSubresource, numSubresources, subresourceData);
+		UpdateSubresources(m_d3d12CommandList.Get(), destinationResource.Get(), uploadAllocation.Resource, uploadAllocation.Offset, firstSubresource, numSubresources, subresourceData);
+		m_Recorder.Record(RecordedCommandType::CopyTexture, numSubresources, 0, 0, requiredSize);
 
-		m_TrackedObjects.push_back(intermediateResource);
 		m_TrackedObjects.push_back(destinationResource);
 	}
 }
@@ -546,6 +557,7 @@ void CommandList::SetGraphicsDynamicConstantBuffer(uint32_t rootParameterIndex,
 	auto heapAllococation = m_UploadBuffer->Allocate(sizeInBytes, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
 	memcpy(heapAllococation.CPU, bufferData, sizeInBytes);
 	m_d3d12CommandList->SetGraphicsRootConstantBufferView(rootParameterIndex, heapAllococation.GPU);
+	m_Recorder.Record(RecordedCommandType::DynamicBuffer, rootParameterIndex, 0, 0, sizeInBytes);
 }
 
 void CommandList::SetGraphics32BitConstants(uint32_t rootParameterIndex, uint32_t numConstants, const void* constants)
@@ -582,6 +594,7 @@ void CommandList::SetDynamicVertexBuffer(uint32_t slot, size_t numVertices, size
 	vertexBufferView.StrideInBytes = static_cast<UINT>(vertexSize);
 
 	m_d3d12CommandList->IASetVertexBuffers(slot, 1, &vertexBufferView);
+	m_Recorder.Record(RecordedCommandType::DynamicBuffer, slot, 0, 0, bufferSize);
 }
 
 void CommandList::SetIndexBuffer(const IndexBuffer& indexBuffer)
@@ -609,6 +622,7 @@ void CommandList::SetDynamicIndexBuffer(size_t numIndicies, DXGI_FORMAT indexFor
 	indexBufferView.Format = indexFormat;
 
 	m_d3d12CommandList->IASetIndexBuffer(&indexBufferView);
+	m_Recorder.Record(RecordedCommandType::DynamicBuffer, 0, 0, 0, bufferSize);
 }
 
 void CommandList::SetGraphicsDynamicStructuredBuffer(uint32_t slot, size_t numElements, size_t elementSize, const void* bufferData)
@@ -620,6 +634,7 @@ void CommandList::SetGraphicsDynamicStructuredBuffer(uint32_t slot, size_t numEl
 	memcpy(heapAllocation.CPU, bufferData, bufferSize);
 
 	m_d3d12CommandList->SetGraphicsRootShaderResourceView(slot, heapAllocation.GPU);
+	m_Recorder.Record(RecordedCommandType::DynamicBuffer, slot, 0, 0, bufferSize);
 }
 void CommandList::SetViewport(const D3D12_VIEWPORT& viewport)
 {
@@ -648,6 +663,7 @@ void CommandList::SetScissorRects(const std::vector<D3D12_RECT>& scissorRects)
 void CommandList::SetPipelineState(Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState)
 {
 	m_d3d12CommandList->SetPipelineState(pipelineState.Get());
+	m_Recorder.Record(RecordedCommandType::SetPipelineState);
 
 	m_TrackedObjects.push_back(pipelineState);
 }
@@ -665,6 +681,7 @@ void CommandList::SetGraphicsRootSignature(const RootSignature& rootSignature)
 		}
 
 		m_d3d12CommandList->SetGraphicsRootSignature(d3d12RootSignature);
+		m_Recorder.Record(RecordedCommandType::SetRootSignature);
 
 		m_TrackedObjects.push_back(m_CurrentRootSignature);
 	}
@@ -683,6 +700,7 @@ void CommandList::SetComputeRootSignature(const RootSignature& rootSignature)
 		}
 
 		m_d3d12CommandList->SetComputeRootSignature(d3d12RootSignature);
+		m_Recorder.Record(RecordedCommandType::SetRootSignature);
 
 		m_TrackedObjects.push_back(m_CurrentRootSignature);
 	}
@@ -784,6 +802,7 @@ void CommandList::Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t st
 	}
 
 	m_d3d12CommandList->DrawInstanced(vertexCount, instanceCount, startVertex, startInstance);
+	m_Recorder.Record(RecordedCommandType::Draw, vertexCount, instanceCount);
 }
 
 void CommandList::DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
@@ -801,6 +820,7 @@ void CommandList::DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint3
 	}
 
 	m_d3d12CommandList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+	m_Recorder.Record(RecordedCommandType::DrawIndexed, indexCount, instanceCount);
 }
 
 void CommandList::Dispatch(uint32_t numGroupsX, uint32_t numGroupsY, uint32_t numGroupsZ)
@@ -818,6 +838,7 @@ void CommandList::Dispatch(uint32_t numGroupsX, uint32_t numGroupsY, uint32_t nu
 	}
 
 	m_d3d12CommandList->Dispatch(numGroupsX, numGroupsY, numGroupsZ);
+	m_Recorder.Record(RecordedCommandType::Dispatch, numGroupsX, numGroupsY, numGroupsZ);
 }
 
 bool CommandList::Close(CommandList& pendingCommandList)
@@ -841,6 +862,11 @@ void CommandList::Close()
 	m_d3d12CommandList->Close();
 }
 
+uint32_t CommandList::GetGlobalStateShards() const
+{
+	return m_ResourceStateTracker->GetGlobalStateShards();
+}
+
 
 void CommandList::Reset()
 {
@@ -860,6 +886,8 @@ void CommandList::Reset()
 
 	m_CurrentRootSignature = nullptr;
 	m_GenerateMipsCommandList = nullptr;
+
+	m_Recorder.Reset();
 }
 
 void CommandList::ReleaseTrackedObjects()
@@ -867,6 +895,11 @@ void CommandList::ReleaseTrackedObjects()
 	m_TrackedObjects.clear();
 }
 
+void CommandList::RetireUploadBuffer(uint64_t fenceValue)
+{
+	m_UploadBuffer->Retire(fenceValue);
+}
+
 void CommandList::SetDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE heapType, ID3D12DescriptorHeap* heap)
 {
 	if (m_DescriptorHeaps[heapType] != heap)
@@ -898,5 +931,6 @@ void CommandList::BindDescriptorHeaps()
 	}
 
 	m_d3d12CommandList->SetDescriptorHeaps(numDescriptorHeaps, descriptorHeaps);
+	m_Recorder.Record(RecordedCommandType::SetDescriptorHeaps, numDescriptorHeaps);
 }
 
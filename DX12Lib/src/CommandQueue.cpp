@@ -4,7 +4,10 @@
 
 #include <Application.h>
 #include <CommandList.h>
+#include <CommandRecorder.h>
 #include <ResourceStateTracker.h>
+#include <UploadRingBuffer.h>
+#include <WorkerPool.h>
 
 CommandQueue::CommandQueue(D3D12_COMMAND_LIST_TYPE type)
     : m_FenceValue(0)
@@ -19,7 +22,7 @@ CommandQueue::CommandQueue(D3D12_COMMAND_LIST_TYPE type)
     desc.NodeMask = 0;
 
     ThrowIfFailed(device->CreateCommandQueue(&desc, IID_PPV_ARGS(&m_d3d12CommandQueue)));
-    ThrowIfFailed(device->CreateFence(m_FenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_d3d12Fence)));
+    ThrowIfFailed(device->CreateFence(m_FenceValue.load(), D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_d3d12Fence)));
 
     switch ( type )
     {
@@ -36,6 +39,8 @@ CommandQueue::CommandQueue(D3D12_COMMAND_LIST_TYPE type)
 
     m_FenceEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
     assert(m_FenceEvent && "Failed to create fence event handle.");
+
+    m_UploadRingBuffer = std::make_unique<UploadRingBuffer>(*this);
 }
 
 CommandQueue::~CommandQueue()
@@ -44,8 +49,15 @@ CommandQueue::~CommandQueue()
 
 uint64_t CommandQueue::Signal()
 {
-    uint64_t fenceValue = ++m_FenceValue;
+    std::lock_guard<std::mutex> submitLock(m_SubmitMutex);
+    return SignalLocked();
+}
+
+uint64_t CommandQueue::SignalLocked()
+{
+    uint64_t fenceValue = m_FenceValue.load(std::memory_order_relaxed) + 1;
     m_d3d12CommandQueue->Signal(m_d3d12Fence.Get(), fenceValue);
+    m_FenceValue.store(fenceValue, std::memory_order_release);
     return fenceValue;
 }
 
@@ -65,7 +77,11 @@ void CommandQueue::WaitForFenceValue(uint64_t fenceValue)
 
 void CommandQueue::Flush()
 {
-    auto tmpQueue = m_CommandListQueue;
+    CommandListQueue tmpQueue;
+    {
+        std::lock_guard<std::mutex> lock(m_CommandListQueueMutex);
+        tmpQueue = m_CommandListQueue;
+    }
     while (!tmpQueue.empty())
     {
         auto entry = tmpQueue.front();
@@ -78,19 +94,26 @@ void CommandQueue::Flush()
     // using the CommandQueue::Signal method then the 
     // fence value of the command queue might be higher than the fence
     // value of any of the executed command lists.
-    WaitForFenceValue( m_FenceValue );
+    WaitForFenceValue( m_FenceValue.load(std::memory_order_acquire) );
 }
 
 std::shared_ptr<CommandList> CommandQueue::GetCommandList()
 {
     std::shared_ptr<CommandList> commandList;
 
-    // If there is a command list on the queue.
-    if ( !m_CommandListQueue.empty() && IsFenceComplete(m_CommandListQueue.front().fenceValue))
     {
-        commandList = m_CommandListQueue.front().commandList;
-        m_CommandListQueue.pop();
+        std::lock_guard<std::mutex> lock(m_CommandListQueueMutex);
 
+        // If there is a command list on the queue.
+        if ( !m_CommandListQueue.empty() && IsFenceComplete(m_CommandListQueue.front().fenceValue))
+        {
+            commandList = m_CommandListQueue.front().commandList;
+            m_CommandListQueue.pop();
+        }
+    }
+
+    if ( commandList )
+    {
         commandList->Reset();
     }
     else
@@ -103,6 +126,33 @@ std::shared_ptr<CommandList> CommandQueue::GetCommandList()
     return commandList;
 }
 
+std::vector<std::shared_ptr<CommandList> > CommandQueue::RecordCommandLists(size_t numItems, const RecordFunction& recordFunc, uint32_t numWorkers)
+{
+    size_t numCommandLists = std::max<size_t>(std::min<size_t>(numWorkers, numItems), 1);
+
+    std::vector<std::shared_ptr<CommandList> > commandLists(numCommandLists);
+    for (auto& commandList : commandLists)
+    {
+        commandList = GetCommandList();
+    }
+
+    // The copy queue never records, so the threads are created on first use.
+    std::call_once(m_RecordingPoolFlag, [this]()
+    {
+        m_RecordingPool = std::make_unique<WorkerPool>();
+    });
+
+    // Exceptions thrown by recordFunc are rethrown here by the pool.
+    m_RecordingPool->ParallelFor(numCommandLists, [&](size_t index)
+    {
+        size_t first = numItems * index / numCommandLists;
+        size_t last = numItems * (index + 1) / numCommandLists;
+        recordFunc(*commandLists[index], first, last);
+    });
+
+    return commandLists;
+}
+
 // Execute a command list.
 // Returns the fence value to wait for for this command list.
 uint64_t CommandQueue::ExecuteCommandList(std::shared_ptr<CommandList> commandList)
@@ -112,7 +162,18 @@ uint64_t CommandQueue::ExecuteCommandList(std::shared_ptr<CommandList> commandLi
 
 uint64_t CommandQueue::ExecuteCommandLists(const std::vector<std::shared_ptr<CommandList> >& commandLists)
 {
-    ResourceStateTracker::Lock();
+    // Pending barriers must be resolved (and final states committed) in the
+    // same order as the command lists are executed on this queue.
+    std::unique_lock<std::mutex> submitLock(m_SubmitMutex);
+
+    // The global state of every resource used by the command lists stays
+    // locked until all of them are resolved, so the resolve on another queue
+    // never sees half of the batch committed.
+    uint32_t globalStateShards = 0;
+    for (const auto& commandList : commandLists)
+    {
+        globalStateShards |= commandList->GetGlobalStateShards();
+    }
 
     // Command lists that need to put back on the command list queue.
     std::vector<std::shared_ptr<CommandList> > toBeQueued;
@@ -126,9 +187,19 @@ uint64_t CommandQueue::ExecuteCommandLists(const std::vector<std::shared_ptr<Com
     std::vector<ID3D12CommandList*> d3d12CommandLists;
     d3d12CommandLists.reserve(commandLists.size() * 2); // 2x since each command list will have a pending command list.
 
-    for (auto commandList : commandLists)
+    // Command lists are taken from the queue before the global state is locked.
+    std::vector<std::shared_ptr<CommandList> > pendingCommandLists;
+    pendingCommandLists.reserve(commandLists.size());
+    for (size_t i = 0; i < commandLists.size(); ++i)
     {
-        auto pendingCommandList = GetCommandList();
+        pendingCommandLists.push_back(GetCommandList());
+    }
+
+    ResourceStateTracker::LockGlobalState(globalStateShards);
+    for (size_t i = 0; i < commandLists.size(); ++i)
+    {
+        const auto& commandList = commandLists[i];
+        const auto& pendingCommandList = pendingCommandLists[i];
         bool hasPendingBarriers = commandList->Close( *pendingCommandList );
         pendingCommandList->Close();
         // If there are no pending barriers on the pending command list, there is no reason to 
@@ -139,6 +210,12 @@ uint64_t CommandQueue::ExecuteCommandLists(const std::vector<std::shared_ptr<Com
         }
         d3d12CommandLists.push_back(commandList->GetGraphicsCommandList().Get());
 
+        // The pending barriers are counted with the command list they belong to.
+        auto statistics = commandList->GetRecorder().GetStatistics();
+        statistics += pendingCommandList->GetRecorder().GetStatistics();
+        statistics.NumCommandLists = hasPendingBarriers ? 2 : 1;
+        CommandRecorder::Submit(statistics);
+
         toBeQueued.push_back(pendingCommandList);
         toBeQueued.push_back(commandList);
 
@@ -148,17 +225,26 @@ uint64_t CommandQueue::ExecuteCommandLists(const std::vector<std::shared_ptr<Com
             generateMipsCommandLists.push_back( generateMipsCommandList );
         }
     }
+    ResourceStateTracker::UnlockGlobalState(globalStateShards);
 
     UINT numCommandLists = static_cast<UINT>(d3d12CommandLists.size());
     m_d3d12CommandQueue->ExecuteCommandLists(numCommandLists, d3d12CommandLists.data());
-    uint64_t fenceValue = Signal();
+    uint64_t fenceValue = SignalLocked();
     
-    ResourceStateTracker::Unlock();
+    submitLock.unlock();
 
     // Queue command lists for reuse.
     for (auto commandList : toBeQueued)
     {
-        m_CommandListQueue.emplace(CommandListEntry{ fenceValue, commandList });
+        // The upload memory of the command list is reclaimed once the fence value is reached.
+        commandList->RetireUploadBuffer(fenceValue);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_CommandListQueueMutex);
+        for (auto commandList : toBeQueued)
+        {
+            m_CommandListQueue.emplace(CommandListEntry{ fenceValue, commandList });
+        }
     }
 
     // If there are any command lists that generate mips then execute those
@@ -175,7 +261,7 @@ uint64_t CommandQueue::ExecuteCommandLists(const std::vector<std::shared_ptr<Com
 
 void CommandQueue::Wait( const CommandQueue& other )
 {
-    m_d3d12CommandQueue->Wait( other.m_d3d12Fence.Get(), other.m_FenceValue );
+    m_d3d12CommandQueue->Wait( other.m_d3d12Fence.Get(), other.m_FenceValue.load(std::memory_order_acquire) );
 }
 
 Microsoft::WRL::ComPtr<ID3D12CommandQueue> CommandQueue::GetD3D12CommandQueue() const
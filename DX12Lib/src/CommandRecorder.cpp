@@ -0,0 +1,123 @@
+#include <DX12LibPCH.h>
+
+#include <CommandRecorder.h>
+
+std::atomic<bool> CommandRecorder::ms_CaptureEnabled(false);
+std::mutex CommandRecorder::ms_FrameMutex;
+FrameStatistics CommandRecorder::ms_CurrentFrame;
+FrameStatistics CommandRecorder::ms_LastFrame;
+CommandRecorder::Clock::time_point CommandRecorder::ms_FrameStart = CommandRecorder::Clock::now();
+
+FrameStatistics& FrameStatistics::operator+=(const FrameStatistics& other)
+{
+    NumCommandLists += other.NumCommandLists;
+    NumDraws += other.NumDraws;
+    NumDispatches += other.NumDispatches;
+    NumBarriers += other.NumBarriers;
+    NumCopies += other.NumCopies;
+    NumPipelineStateChanges += other.NumPipelineStateChanges;
+    NumRootSignatureChanges += other.NumRootSignatureChanges;
+    NumDescriptorTables += other.NumDescriptorTables;
+    NumDescriptorsCopied += other.NumDescriptorsCopied;
+    NumDescriptorsReused += other.NumDescriptorsReused;
+    UploadBytes += other.UploadBytes;
+    RecordMilliseconds += other.RecordMilliseconds;
+    FrameMilliseconds += other.FrameMilliseconds;
+
+    return *this;
+}
+
+CommandRecorder::CommandRecorder()
+{
+    Reset();
+}
+
+void CommandRecorder::Record(RecordedCommandType type, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint64_t bytes)
+{
+    switch (type)
+    {
+    case RecordedCommandType::ResourceBarrier:
+        m_Statistics.NumBarriers += arg0;
+        break;
+    case RecordedCommandType::Draw:
+    case RecordedCommandType::DrawIndexed:
+        m_Statistics.NumDraws++;
+        break;
+    case RecordedCommandType::Dispatch:
+        m_Statistics.NumDispatches++;
+        break;
+    case RecordedCommandType::CopyResource:
+    case RecordedCommandType::CopyBuffer:
+    case RecordedCommandType::CopyTexture:
+        m_Statistics.NumCopies++;
+        break;
+    case RecordedCommandType::SetPipelineState:
+        m_Statistics.NumPipelineStateChanges++;
+        break;
+    case RecordedCommandType::SetRootSignature:
+        m_Statistics.NumRootSignatureChanges++;
+        break;
+    case RecordedCommandType::SetDescriptorTables:
+        m_Statistics.NumDescriptorTables += arg0;
+        m_Statistics.NumDescriptorsCopied += arg1;
+        m_Statistics.NumDescriptorsReused += arg2;
+        break;
+    default:
+        break;
+    }
+    m_Statistics.UploadBytes += bytes;
+
+    if (ms_CaptureEnabled.load(std::memory_order_relaxed))
+    {
+        m_Commands.push_back({ type, { arg0, arg1, arg2 }, bytes });
+    }
+}
+
+void CommandRecorder::Reset()
+{
+    m_Commands.clear();
+    m_Statistics = FrameStatistics();
+    m_Statistics.NumCommandLists = 1;
+    m_ResetTime = Clock::now();
+}
+
+FrameStatistics CommandRecorder::GetStatistics() const
+{
+    FrameStatistics statistics = m_Statistics;
+    statistics.RecordMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - m_ResetTime).count();
+    return statistics;
+}
+
+void CommandRecorder::SetCaptureEnabled(bool enabled)
+{
+    ms_CaptureEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool CommandRecorder::IsCaptureEnabled()
+{
+    return ms_CaptureEnabled.load(std::memory_order_relaxed);
+}
+
+void CommandRecorder::Submit(const FrameStatistics& statistics)
+{
+    std::lock_guard<std::mutex> lock(ms_FrameMutex);
+    ms_CurrentFrame += statistics;
+}
+
+void CommandRecorder::EndFrame()
+{
+    std::lock_guard<std::mutex> lock(ms_FrameMutex);
+
+    auto now = Clock::now();
+    ms_CurrentFrame.FrameMilliseconds = std::chrono::duration<double, std::milli>(now - ms_FrameStart).count();
+    ms_FrameStart = now;
+
+    ms_LastFrame = ms_CurrentFrame;
+    ms_CurrentFrame = FrameStatistics();
+}
+
+FrameStatistics CommandRecorder::GetLastFrameStatistics()
+{
+    std::lock_guard<std::mutex> lock(ms_FrameMutex);
+    return ms_LastFrame;
+}
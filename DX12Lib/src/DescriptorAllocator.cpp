@@ -5,9 +5,13 @@
 
 #include <Application.h>
 
+std::atomic<uint64_t> DescriptorAllocator::ms_NextId( 0 );
+
 DescriptorAllocator::DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t numDescriptorsPerHeap)
     : m_HeapType(type)
     , m_NumDescriptorsPerHeap(numDescriptorsPerHeap)
+    , m_Id(++ms_NextId)
+    , m_FreePages(std::make_shared<FreePagePool>())
 {
 }
 
@@ -19,60 +23,196 @@ std::shared_ptr<DescriptorAllocatorPage> DescriptorAllocator::CreateAllocatorPag
     auto newPage = std::make_shared<DescriptorAllocatorPage>( m_HeapType, m_NumDescriptorsPerHeap );
 
     m_HeapPool.emplace_back( newPage );
-    m_AvailableHeaps.insert( m_HeapPool.size() - 1 );
 
     return newPage;
 }
 
-DescriptorAllocation DescriptorAllocator::Allocate(uint32_t numDescriptors)
+std::shared_ptr<DescriptorAllocator::ThreadCache> DescriptorAllocator::GetThreadCache()
 {
-    std::lock_guard<std::mutex> lock( m_AllocationMutex );
+    struct ThreadCacheEntry
+    {
+        uint64_t AllocatorId;
+        std::weak_ptr<ThreadCache> Cache;
+    };
+    // The caches of the calling thread, one for every allocator it has used.
+    // Entries of destroyed allocators expire and are removed lazily.
+    struct ThreadCacheList
+    {
+        std::vector<ThreadCacheEntry> Entries;
 
-    DescriptorAllocation allocation;
+        // The thread exits: return its pages to the free pool of every
+        // allocator that is still alive.
+        ~ThreadCacheList()
+        {
+            for ( auto& entry : Entries )
+            {
+                auto cache = entry.Cache.lock();
+                if ( !cache )
+                {
+                    continue;
+                }
+
+                std::lock_guard<std::mutex> lock( cache->Mutex );
+                if ( auto freePages = cache->FreePages.lock() )
+                {
+                    std::lock_guard<std::mutex> poolLock( freePages->Mutex );
+                    freePages->Pages.insert( freePages->Pages.end(), cache->Pages.begin(), cache->Pages.end() );
+                }
+                cache->Pages.clear();
+                cache->Exited = true;
+            }
+        }
+    };
+    thread_local ThreadCacheList t_ThreadCaches;
 
-    for ( auto iter = m_AvailableHeaps.begin(); iter != m_AvailableHeaps.end(); ++iter )
+    auto& entries = t_ThreadCaches.Entries;
+    for ( auto iter = entries.begin(); iter != entries.end(); )
     {
-        auto allocatorPage = m_HeapPool[*iter];
+        auto cache = iter->Cache.lock();
+        if ( !cache )
+        {
+            iter = entries.erase( iter );
+            continue;
+        }
+        if ( iter->AllocatorId == m_Id )
+        {
+            return cache;
+        }
+        ++iter;
+    }
 
-        allocation = allocatorPage->Allocate( numDescriptors );
+    auto cache = std::make_shared<ThreadCache>();
+    cache->FreePages = m_FreePages;
+    {
+        std::lock_guard<std::mutex> lock( m_AllocationMutex );
+        m_ThreadCaches.push_back( cache );
+    }
+    entries.push_back( { m_Id, cache } );
 
-        if ( allocatorPage->NumFreeHandles() == 0 )
+    return cache;
+}
+
+DescriptorAllocation DescriptorAllocator::Allocate(uint32_t numDescriptors)
+{
+    auto cache = GetThreadCache();
+
+    std::lock_guard<std::mutex> lock( cache->Mutex );
+
+    // Try the most recently acquired pages first, they are the least fragmented.
+    for ( auto iter = cache->Pages.rbegin(); iter != cache->Pages.rend(); ++iter )
+    {
+        auto& allocatorPage = *iter;
+        if ( allocatorPage->NumFreeHandles() < numDescriptors )
         {
-            m_AvailableHeaps.erase( iter );
+            continue;
         }
 
+        DescriptorAllocation allocation = allocatorPage->Allocate( numDescriptors );
+
         // A valid allocation has been found.
         if ( !allocation.IsNull() )
         {
-            break;
+            return allocation;
+        }
+    }
+
+    // No page of this thread could satisfy the requested number of descriptors.
+    // Take over a page of an exited thread, or a whole new page.
+    std::shared_ptr<DescriptorAllocatorPage> freePage = TakeFreePage( numDescriptors );
+    if ( freePage )
+    {
+        cache->Pages.push_back( freePage );
+
+        DescriptorAllocation allocation = freePage->Allocate( numDescriptors );
+        if ( !allocation.IsNull() )
+        {
+            return allocation;
         }
     }
 
-    // No available heap could satisfy the requested number of descriptors.
-    if ( allocation.IsNull() )
+    std::shared_ptr<DescriptorAllocatorPage> newPage;
     {
+        std::lock_guard<std::mutex> poolLock( m_AllocationMutex );
+
         m_NumDescriptorsPerHeap = std::max( m_NumDescriptorsPerHeap, numDescriptors );
-        auto newPage = CreateAllocatorPage();
+        newPage = CreateAllocatorPage();
+    }
+    cache->Pages.push_back( newPage );
+
+    return newPage->Allocate( numDescriptors );
+}
 
-        allocation = newPage->Allocate( numDescriptors );
+std::shared_ptr<DescriptorAllocatorPage> DescriptorAllocator::TakeFreePage( uint32_t numDescriptors )
+{
+    std::lock_guard<std::mutex> lock( m_FreePages->Mutex );
+
+    auto& pages = m_FreePages->Pages;
+    for ( auto iter = pages.begin(); iter != pages.end(); ++iter )
+    {
+        // The free handles may be fragmented, the allocation can still fail.
+        if ( (*iter)->HasSpace( numDescriptors ) )
+        {
+            auto page = *iter;
+            pages.erase( iter );
+            return page;
+        }
     }
 
-    return allocation;
+    return nullptr;
 }
 
 void DescriptorAllocator::ReleaseStaleDescriptors( uint64_t frameNumber )
 {
-    std::lock_guard<std::mutex> lock( m_AllocationMutex );
+    std::vector< std::shared_ptr<ThreadCache> > threadCaches;
+    {
+        std::lock_guard<std::mutex> lock( m_AllocationMutex );
+        threadCaches = m_ThreadCaches;
+    }
 
-    for ( size_t i = 0; i < m_HeapPool.size(); ++i )
+    // Stale descriptors are returned to their page in one batch per page.
+    bool threadExited = false;
+    for ( auto& cache : threadCaches )
     {
-        auto page = m_HeapPool[i];
+        std::lock_guard<std::mutex> lock( cache->Mutex );
+
+        for ( auto& page : cache->Pages )
+        {
+            page->ReleaseStaleDescriptors( frameNumber );
+        }
+        threadExited |= cache->Exited;
+    }
 
-        page->ReleaseStaleDescriptors( frameNumber );
+    // Descriptors that were allocated by exited threads may still be in flight.
+    {
+        std::lock_guard<std::mutex> lock( m_FreePages->Mutex );
 
-        if ( page->NumFreeHandles() > 0 )
+        for ( auto& page : m_FreePages->Pages )
         {
-            m_AvailableHeaps.insert( i );
+            page->ReleaseStaleDescriptors( frameNumber );
         }
     }
+
+    // Forget the caches of exited threads, their pages are in the free pool.
+    if ( threadExited )
+    {
+        std::lock_guard<std::mutex> lock( m_AllocationMutex );
+
+        m_ThreadCaches.erase( std::remove_if( m_ThreadCaches.begin(), m_ThreadCaches.end(),
+            []( const std::shared_ptr<ThreadCache>& cache )
+            {
+                return cache->Exited.load();
+            } ), m_ThreadCaches.end() );
+    }
+}
+
+size_t DescriptorAllocator::GetNumPages()
+{
+    std::lock_guard<std::mutex> lock( m_AllocationMutex );
+    return m_HeapPool.size();
+}
+
+size_t DescriptorAllocator::GetNumFreePages()
+{
+    std::lock_guard<std::mutex> lock( m_FreePages->Mutex );
+    return m_FreePages->Pages.size();
 }
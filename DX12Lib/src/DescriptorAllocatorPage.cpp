@@ -6,7 +6,10 @@
 #include <Helpers.h>
 
 DescriptorAllocatorPage::DescriptorAllocatorPage( D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t numDescriptors )
-    : m_HeapType( type )
+    // Every block holds at least one descriptor, so this is enough to never allocate.
+    : m_Allocator( numDescriptors, numDescriptors )
+    , m_AllocationNodes( numDescriptors, TLSFAllocator<OffsetType>::InvalidNode )
+    , m_HeapType( type )
     , m_NumDescriptorsInHeap( numDescriptors )
 {
     auto device = Application::Get().GetDevice();
@@ -19,10 +22,6 @@ DescriptorAllocatorPage::DescriptorAllocatorPage( D3D12_DESCRIPTOR_HEAP_TYPE typ
 
     m_BaseDescriptor = m_d3d12DescriptorHeap->GetCPUDescriptorHandleForHeapStart();
     m_DescriptorHandleIncrementSize = Application::Get().GetDescriptorHandleIncrementSize( m_HeapType );
-    m_NumFreeHandles = m_NumDescriptorsInHeap;
-
-    // Initialize the free lists
-    AddNewBlock( 0, m_NumFreeHandles );
 }
 
 D3D12_DESCRIPTOR_HEAP_TYPE DescriptorAllocatorPage::GetHeapType() const
@@ -32,66 +31,28 @@ D3D12_DESCRIPTOR_HEAP_TYPE DescriptorAllocatorPage::GetHeapType() const
 
 bool DescriptorAllocatorPage::HasSpace( uint32_t numDescriptors ) const
 {
-    return numDescriptors < m_NumFreeHandles;
+    return numDescriptors < NumFreeHandles();
 }
 
 uint32_t DescriptorAllocatorPage::NumFreeHandles() const
 {
-    return m_NumFreeHandles;
-}
-
-void DescriptorAllocatorPage::AddNewBlock( uint32_t offset, uint32_t numDescriptors )
-{
-    auto offsetIt = m_FreeListByOffset.emplace( offset, numDescriptors );
-    auto sizeIt = m_FreeListBySize.emplace( numDescriptors, offsetIt.first );
-    offsetIt.first->second.FreeListBySizeIt = sizeIt;
+    return m_Allocator.GetFreeSize();
 }
 
 DescriptorAllocation DescriptorAllocatorPage::Allocate( uint32_t numDescriptors )
 {
     std::lock_guard<std::mutex> lock( m_AllocationMutex );
 
-    // There are less than the requested number of descriptors left in the heap.
-    // Return a NULL descriptor and try another heap.
-    if ( numDescriptors > m_NumFreeHandles )
-    {
-        return DescriptorAllocation();
-    }
-
-    // Get the first block that is large enough to satisfy the request.
-    auto smallestBlockIt = m_FreeListBySize.lower_bound( numDescriptors );
-    if ( smallestBlockIt == m_FreeListBySize.end() )
+    // Get a block that is large enough to satisfy the request.
+    // If there is none, return a NULL descriptor and try another heap.
+    auto allocation = m_Allocator.Allocate( numDescriptors );
+    if ( !allocation.IsValid() )
     {
-        // There was no free block that could satisfy the request.
         return DescriptorAllocation();
     }
 
-    // The size of the smallest block that satisfies the request.
-    auto blockSize = smallestBlockIt->first;
-
-    // The pointer to the same entry in the FreeListByIndex map.
-    auto offsetIt = smallestBlockIt->second;
-
-    // The offset in the descriptor heap.
-    auto offset = offsetIt->first;
-
-    // Compute the new free block that results from splitting this block.
-    auto newOffset = offset + numDescriptors;
-    auto newSize = blockSize - numDescriptors;
-
-    // Remove the existing free block from the free list.
-    m_FreeListBySize.erase( smallestBlockIt );
-    m_FreeListByOffset.erase( offsetIt );
-
-    if ( newSize > 0 )
-    {
-        // If the allocation didn't exactly match the requested size,
-        // return the left-over to the free list.
-        AddNewBlock( newOffset, newSize );
-    }
-
-    // Decrement free handles.
-    m_NumFreeHandles -= numDescriptors;
+    auto offset = allocation.Offset;
+    m_AllocationNodes[offset] = allocation.Node;
 
     return DescriptorAllocation(
         CD3DX12_CPU_DESCRIPTOR_HANDLE( m_BaseDescriptor, offset, m_DescriptorHandleIncrementSize ),
@@ -116,66 +77,14 @@ void DescriptorAllocatorPage::Free( DescriptorAllocation&& descriptor, uint64_t
 
 void DescriptorAllocatorPage::FreeBlock( uint32_t offset, uint32_t numDescriptors )
 {
-    // Find the first element whose offset is greater than the specified offset.
-    // This is the block that should appear after the block that is being freed.
-    auto nextBlockIt = m_FreeListByOffset.upper_bound( offset );
-
-    // Find the block that appears before the block being freed.
-    auto prevBlockIt = nextBlockIt;
-    // If it's not the first block in the list.
-    if ( prevBlockIt != m_FreeListByOffset.begin() )
-    {
-        // Go to the previous block in the list.
-        --prevBlockIt;
-    }
-    else
-    {
-        // Otherwise, just set it to the end of the list to indicate that no
-        // block comes before the one being freed.
-        prevBlockIt = m_FreeListByOffset.end();
-    }
-
-    if ( prevBlockIt != m_FreeListByOffset.end() &&
-         offset == prevBlockIt->first + prevBlockIt->second.Size )
-    {
-        // The previous block is exactly behind the block that is to be freed.
-        //
-        // PrevBlock.Offset           Offset
-        // |                          |
-        // |<-----PrevBlock.Size----->|<------Size-------->|
-        //
-
-        // Increase the block size by the size of merging with the previous block.
-        offset = prevBlockIt->first;
-        numDescriptors += prevBlockIt->second.Size;
-
-        // Remove the previous block from the free list.
-        m_FreeListBySize.erase( prevBlockIt->second.FreeListBySizeIt );
-        m_FreeListByOffset.erase( prevBlockIt );
-    }
-
-    if ( nextBlockIt != m_FreeListByOffset.end() &&
-         offset + numDescriptors == nextBlockIt->first )
-    {
-        // The next block is exactly in front of the block that is to be freed.
-        //
-        // Offset               NextBlock.Offset 
-        // |                    |
-        // |<------Size-------->|<-----NextBlock.Size----->|
-
-        // Increase the block size by the size of merging with the next block.
-        numDescriptors += nextBlockIt->second.Size;
-
-        // Remove the next block from the free list.
-        m_FreeListBySize.erase( nextBlockIt->second.FreeListBySizeIt );
-        m_FreeListByOffset.erase( nextBlockIt );
-    }
-
-    // Add the freed block to the free list.
-    AddNewBlock( offset, numDescriptors );
-
-    // Add the number of free handles back to the heap.
-    m_NumFreeHandles += numDescriptors;
+    auto node = m_AllocationNodes[offset];
+    assert( node != TLSFAllocator<OffsetType>::InvalidNode && "Freeing a block that was not allocated." );
+    assert( m_Allocator.GetAllocationSize( node ) == numDescriptors && "Freeing a block with the wrong size." );
+    (void)numDescriptors;
+
+    // Return the block to the allocator, which merges it with its free neighbours.
+    m_Allocator.Free( node );
+    m_AllocationNodes[offset] = TLSFAllocator<OffsetType>::InvalidNode;
 }
 
 void DescriptorAllocatorPage::ReleaseStaleDescriptors( uint64_t frameNumber )
@@ -0,0 +1,358 @@
+//--------------------------------------------------------------------------------------
+// File: MipChainGenerator.cpp
+//
+// Functions for generating the mip chain of R8G8B8A8 images on the CPU, so mips can
+// be produced when textures are baked or loaded without a compute pass on the GPU.
+//--------------------------------------------------------------------------------------
+
+#include <DX12LibPCH.h>
+#include <DirectXTex/MipChainGenerator.h>
+
+#include <WorkerPool.h>
+
+#include <DirectXPackedVector.h>
+
+#include <atomic>
+#include <cmath>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+    //-------------------------------------------------------------------------------------
+    // Separable downsampling filters. Destination pixel x is the weighted sum of the
+    // source pixels 2x + firstTap ... 2x + firstTap + numTaps - 1.
+    //-------------------------------------------------------------------------------------
+    struct DownsampleFilter
+    {
+        int firstTap;
+        int numTaps;
+        float weights[8];
+    };
+
+    const DownsampleFilter g_BoxFilter = { 0, 2, { 0.5f, 0.5f } };
+
+    // Zeroth order modified Bessel function of the first kind, used by the Kaiser window.
+    double BesselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            double t = x / (2.0 * k);
+            term *= t * t;
+            sum += term;
+            if (term < sum * 1e-12)
+                break;
+        }
+        return sum;
+    }
+
+    DownsampleFilter CreateKaiserFilter()
+    {
+        // Sinc for a 2:1 reduction over 3 source pixels on either side of the center,
+        // windowed with a Kaiser window (alpha = 4).
+        const double radius = 3.0;
+        const double alpha = 4.0;
+        const double pi = 3.14159265358979323846;
+
+        DownsampleFilter filter = { -2, 6, {} };
+
+        double sum = 0.0;
+        for (int i = 0; i < filter.numTaps; ++i)
+        {
+            // Distance of the tap from the center of the destination pixel (2x + 0.5).
+            double d = (filter.firstTap + i) - 0.5;
+            double t = d / 2.0;
+            double sinc = t == 0.0 ? 1.0 : std::sin(pi * t) / (pi * t);
+            double r = d / radius;
+            double window = std::abs(r) >= 1.0 ? 0.0 : BesselI0(alpha * std::sqrt(1.0 - r * r)) / BesselI0(alpha);
+
+            filter.weights[i] = static_cast<float>(sinc * window);
+            sum += filter.weights[i];
+        }
+        for (int i = 0; i < filter.numTaps; ++i)
+        {
+            filter.weights[i] = static_cast<float>(filter.weights[i] / sum);
+        }
+
+        return filter;
+    }
+
+    const DownsampleFilter g_KaiserFilter = CreateKaiserFilter();
+
+    //-------------------------------------------------------------------------------------
+    // Aligned scratch buffers of vectors (XMVECTOR needs 16 byte alignment, also on x86).
+    //-------------------------------------------------------------------------------------
+    struct AlignedDeleter
+    {
+        void operator()(void* p) const
+        {
+            _aligned_free(p);
+        }
+    };
+
+    using ScopedAlignedArrayXMVECTOR = std::unique_ptr<XMVECTOR[], AlignedDeleter>;
+
+    ScopedAlignedArrayXMVECTOR AllocateVectors(size_t count)
+    {
+        return ScopedAlignedArrayXMVECTOR(static_cast<XMVECTOR*>(_aligned_malloc(sizeof(XMVECTOR) * count, 16)));
+    }
+
+    inline uint32_t Address(int i, uint32_t size, bool wrap)
+    {
+        int s = static_cast<int>(size);
+        if (wrap)
+        {
+            i %= s;
+            return static_cast<uint32_t>(i < 0 ? i + s : i);
+        }
+        return static_cast<uint32_t>(std::min(std::max(i, 0), s - 1));
+    }
+
+    void LoadPixels(const uint8_t* src, size_t count, bool srgb, XMVECTOR* dst)
+    {
+        auto packed = reinterpret_cast<const XMUBYTEN4*>(src);
+        for (size_t i = 0; i < count; ++i)
+        {
+            XMVECTOR v = XMLoadUByteN4(&packed[i]);
+            dst[i] = srgb ? XMColorSRGBToRGB(v) : v;
+        }
+    }
+
+    void StorePixels(const XMVECTOR* src, size_t count, bool srgb, float alphaScale, uint8_t* dst)
+    {
+        auto packed = reinterpret_cast<XMUBYTEN4*>(dst);
+        XMVECTOR scale = XMVectorSet(1.0f, 1.0f, 1.0f, alphaScale);
+        for (size_t i = 0; i < count; ++i)
+        {
+            XMVECTOR v = XMVectorSaturate(XMVectorMultiply(src[i], scale));
+            XMStoreUByteN4(&packed[i], srgb ? XMColorRGBToSRGB(v) : v);
+        }
+    }
+
+    // Downsample horizontally (width -> dstWidth) and then vertically (height -> dstHeight).
+    void Downsample(const XMVECTOR* src, uint32_t width, uint32_t height,
+        XMVECTOR* temp, XMVECTOR* dst, uint32_t dstWidth, uint32_t dstHeight,
+        const DownsampleFilter& filter, bool wrap)
+    {
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            const XMVECTOR* row = src + static_cast<size_t>(y) * width;
+            XMVECTOR* out = temp + static_cast<size_t>(y) * dstWidth;
+            for (uint32_t x = 0; x < dstWidth; ++x)
+            {
+                XMVECTOR sum = XMVectorZero();
+                for (int t = 0; t < filter.numTaps; ++t)
+                {
+                    uint32_t sx = Address(static_cast<int>(2 * x) + filter.firstTap + t, width, wrap);
+                    sum = XMVectorMultiplyAdd(row[sx], XMVectorReplicate(filter.weights[t]), sum);
+                }
+                out[x] = sum;
+            }
+        }
+
+        for (uint32_t y = 0; y < dstHeight; ++y)
+        {
+            XMVECTOR* out = dst + static_cast<size_t>(y) * dstWidth;
+            for (uint32_t x = 0; x < dstWidth; ++x)
+            {
+                out[x] = XMVectorZero();
+            }
+            for (int t = 0; t < filter.numTaps; ++t)
+            {
+                uint32_t sy = Address(static_cast<int>(2 * y) + filter.firstTap + t, height, wrap);
+                const XMVECTOR* row = temp + static_cast<size_t>(sy) * dstWidth;
+                XMVECTOR weight = XMVectorReplicate(filter.weights[t]);
+                for (uint32_t x = 0; x < dstWidth; ++x)
+                {
+                    out[x] = XMVectorMultiplyAdd(row[x], weight, out[x]);
+                }
+            }
+            // Negative lobes of the Kaiser filter may overshoot.
+            for (uint32_t x = 0; x < dstWidth; ++x)
+            {
+                out[x] = XMVectorSaturate(out[x]);
+            }
+        }
+    }
+
+    // The fraction of pixels whose (scaled) alpha passes the alpha test.
+    float ComputeAlphaCoverage(const XMVECTOR* pixels, size_t count, float alphaReference, float alphaScale)
+    {
+        size_t covered = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (XMVectorGetW(pixels[i]) * alphaScale > alphaReference)
+                ++covered;
+        }
+        return static_cast<float>(covered) / static_cast<float>(count);
+    }
+
+    // Find the alpha scale for which the coverage of a mip is closest to the coverage of the top level.
+    float FindAlphaScale(const XMVECTOR* pixels, size_t count, float alphaReference, float targetCoverage)
+    {
+        float minScale = 0.0f;
+        float maxScale = 4.0f;
+        float scale = 1.0f;
+
+        float bestScale = 1.0f;
+        float bestError = 2.0f;
+
+        for (int i = 0; i < 10; ++i)
+        {
+            float coverage = ComputeAlphaCoverage(pixels, count, alphaReference, scale);
+
+            // Coverage is a step function of the scale, on a tie prefer the scale that covers more.
+            float error = std::abs(coverage - targetCoverage);
+            if (error < bestError || (error == bestError && scale > bestScale))
+            {
+                bestScale = scale;
+                bestError = error;
+            }
+
+            if (coverage < targetCoverage)
+                minScale = scale;
+            else if (coverage > targetCoverage)
+                maxScale = scale;
+            else
+                break;
+
+            scale = (minScale + maxScale) * 0.5f;
+        }
+
+        return bestScale;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+uint32_t DirectX::CountMipLevels(uint32_t width, uint32_t height)
+{
+    uint32_t mipLevels = 1;
+    while (width > 1 || height > 1)
+    {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+        ++mipLevels;
+    }
+    return mipLevels;
+}
+
+_Use_decl_annotations_
+size_t DirectX::ComputeMipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    size_t size = 0;
+    for (uint32_t mip = 0; mip < mipLevels; ++mip)
+    {
+        size += static_cast<size_t>(width) * height * 4;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+    return size;
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::GenerateMipChain(
+    const MipChainImage& image,
+    unsigned int filterFlags,
+    float alphaReference)
+{
+    if (!image.pixels || !image.width || !image.height || !image.mipLevels)
+        return E_INVALIDARG;
+
+    if (image.mipLevels > CountMipLevels(image.width, image.height))
+        return E_INVALIDARG;
+
+    if (image.mipLevels == 1)
+        return S_OK;
+
+    const bool srgb = (filterFlags & MIP_FILTER_SRGB) != 0;
+    const bool wrap = (filterFlags & MIP_FILTER_WRAP) != 0;
+    const DownsampleFilter& filter = (filterFlags & MIP_FILTER_KAISER) ? g_KaiserFilter : g_BoxFilter;
+
+    size_t topCount = static_cast<size_t>(image.width) * image.height;
+
+    // The source and destination level, and the horizontally filtered intermediate.
+    ScopedAlignedArrayXMVECTOR src = AllocateVectors(topCount);
+    size_t firstWidth = std::max(image.width / 2, 1u);
+    ScopedAlignedArrayXMVECTOR dst = AllocateVectors(firstWidth * std::max(image.height / 2, 1u));
+    ScopedAlignedArrayXMVECTOR temp = AllocateVectors(firstWidth * image.height);
+    if (!src || !dst || !temp)
+        return E_OUTOFMEMORY;
+
+    LoadPixels(image.pixels, topCount, srgb, src.get());
+
+    // Coverage is only preserved for images that actually use alpha testing.
+    float targetCoverage = 1.0f;
+    if (filterFlags & MIP_FILTER_ALPHA_COVERAGE)
+    {
+        targetCoverage = ComputeAlphaCoverage(src.get(), topCount, alphaReference, 1.0f);
+    }
+    const bool preserveCoverage = targetCoverage > 0.0f && targetCoverage < 1.0f;
+
+    uint8_t* level = image.pixels;
+    uint32_t width = image.width;
+    uint32_t height = image.height;
+
+    for (uint32_t mip = 1; mip < image.mipLevels; ++mip)
+    {
+        uint32_t dstWidth = std::max(width / 2, 1u);
+        uint32_t dstHeight = std::max(height / 2, 1u);
+        size_t dstCount = static_cast<size_t>(dstWidth) * dstHeight;
+
+        Downsample(src.get(), width, height, temp.get(), dst.get(), dstWidth, dstHeight, filter, wrap);
+
+        float alphaScale = preserveCoverage ? FindAlphaScale(dst.get(), dstCount, alphaReference, targetCoverage) : 1.0f;
+
+        level += static_cast<size_t>(width) * height * 4;
+        StorePixels(dst.get(), dstCount, srgb, alphaScale, level);
+
+        // The next level is filtered from the unscaled alpha, so the scales do not compound.
+        std::swap(src, dst);
+        width = dstWidth;
+        height = dstHeight;
+    }
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::GenerateMipChains(
+    const MipChainImage* images,
+    size_t numImages,
+    unsigned int filterFlags,
+    float alphaReference,
+    WorkerPool* pool)
+{
+    if (!images && numImages)
+        return E_INVALIDARG;
+
+    // Every image is a task, the first failure is reported.
+    std::atomic<HRESULT> result(S_OK);
+    auto generate = [&](size_t i)
+    {
+        HRESULT hr = GenerateMipChain(images[i], filterFlags, alphaReference);
+        if (FAILED(hr))
+        {
+            HRESULT expected = S_OK;
+            result.compare_exchange_strong(expected, hr);
+        }
+    };
+
+    if (pool)
+    {
+        pool->ParallelFor(numImages, generate);
+    }
+    else
+    {
+        for (size_t i = 0; i < numImages; ++i)
+        {
+            generate(i);
+        }
+    }
+
+    return result;
+}
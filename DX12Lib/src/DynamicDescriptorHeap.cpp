@@ -8,6 +8,21 @@
 
 #include <new> // For std::bad_alloc
 
+namespace
+{
+    // FNV-1a over the handle values.
+    uint64_t HashDescriptorRange(const D3D12_CPU_DESCRIPTOR_HANDLE* descriptors, uint32_t numDescriptors)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (uint32_t i = 0; i < numDescriptors; ++i)
+        {
+            hash ^= static_cast<uint64_t>(descriptors[i].ptr);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+}
+
 DynamicDescriptorHeap::DynamicDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptorsPerHeap)
     : m_DescriptorHeapType(heapType)
     , m_NumDescriptorsPerHeap(numDescriptorsPerHeap)
@@ -82,10 +97,13 @@ void DynamicDescriptorHeap::CommitStagedDescriptors(CommandList& commandList, st
             m_CurrentCPUDescriptorHandle = m_CurrentDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
             m_CurrentGPUDescriptorHandle = m_CurrentDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
             m_NumFreeHandles = m_NumDescriptorsPerHeap;
+            ClearDescriptorTableCache();
 
             commandList.SetDescriptorHeap(m_DescriptorHeapType, m_CurrentDescriptorHeap.Get());
         }
 
+        uint32_t numDescriptorTables = 0;
+        uint32_t numDescriptorsCopied = 0;
         DWORD rootIndex;
         // Scan from LSB to MSB for a bit set in staleDescriptorsBitMask
         while (_BitScanForward(&rootIndex, m_StaleDescriptorTableBitMask))
@@ -93,30 +111,44 @@ void DynamicDescriptorHeap::CommitStagedDescriptors(CommandList& commandList, st
             UINT numSrcDescriptors = m_DescriptorTableCache[rootIndex].NumDescriptors;
             D3D12_CPU_DESCRIPTOR_HANDLE* pSrcDescriptorHandles = m_DescriptorTableCache[rootIndex].BaseDescriptor;
 
-            D3D12_CPU_DESCRIPTOR_HANDLE pDestDescriptorRangeStarts[] =
-            {
-                m_CurrentCPUDescriptorHandle
-            };
-            UINT pDestDescriptorRangeSizes[] =
+            uint64_t hash = HashDescriptorRange(pSrcDescriptorHandles, numSrcDescriptors);
+            D3D12_GPU_DESCRIPTOR_HANDLE gpuDescriptor;
+            if (!FindCachedDescriptorTable(hash, pSrcDescriptorHandles, numSrcDescriptors, gpuDescriptor))
             {
-                numSrcDescriptors
-            };
-
-            // Copy the staged CPU visible descriptors to the GPU visible descriptor heap.
-            device->CopyDescriptors(1, pDestDescriptorRangeStarts, pDestDescriptorRangeSizes,
-                numSrcDescriptors, pSrcDescriptorHandles, nullptr, m_DescriptorHeapType);
+                D3D12_CPU_DESCRIPTOR_HANDLE pDestDescriptorRangeStarts[] =
+                {
+                    m_CurrentCPUDescriptorHandle
+                };
+                UINT pDestDescriptorRangeSizes[] =
+                {
+                    numSrcDescriptors
+                };
+
+                // Copy the staged CPU visible descriptors to the GPU visible descriptor heap.
+                device->CopyDescriptors(1, pDestDescriptorRangeStarts, pDestDescriptorRangeSizes,
+                    numSrcDescriptors, pSrcDescriptorHandles, nullptr, m_DescriptorHeapType);
+
+                gpuDescriptor = m_CurrentGPUDescriptorHandle;
+                AddCachedDescriptorTable(hash, pSrcDescriptorHandles, numSrcDescriptors, gpuDescriptor);
+
+                // Offset current CPU and GPU descriptor handles.
+                m_CurrentCPUDescriptorHandle.Offset(numSrcDescriptors, m_DescriptorHandleIncrementSize);
+                m_CurrentGPUDescriptorHandle.Offset(numSrcDescriptors, m_DescriptorHandleIncrementSize);
+                m_NumFreeHandles -= numSrcDescriptors;
+
+                numDescriptorsCopied += numSrcDescriptors;
+            }
 
             // Set the descriptors on the command list using the passed-in set function.
-            setFunc(d3d12GraphicsCommandList, rootIndex, m_CurrentGPUDescriptorHandle);
-
-            // Offset current CPU and GPU descriptor handles.
-            m_CurrentCPUDescriptorHandle.Offset(numSrcDescriptors, m_DescriptorHandleIncrementSize);
-            m_CurrentGPUDescriptorHandle.Offset(numSrcDescriptors, m_DescriptorHandleIncrementSize);
-            m_NumFreeHandles -= numSrcDescriptors;
+            setFunc(d3d12GraphicsCommandList, rootIndex, gpuDescriptor);
 
             // Flip the stale bit so the descriptor table is not recopied again unless it is updated with a new descriptor.
             m_StaleDescriptorTableBitMask ^= (1 << rootIndex);
+            ++numDescriptorTables;
         }
+
+        commandList.GetRecorder().Record(RecordedCommandType::SetDescriptorTables, numDescriptorTables,
+            numDescriptorsCopied, numDescriptorsToCommit - numDescriptorsCopied);
     }
 }
 
@@ -138,6 +170,7 @@ D3D12_GPU_DESCRIPTOR_HANDLE DynamicDescriptorHeap::CopyDescriptor(CommandList& c
         m_CurrentCPUDescriptorHandle = m_CurrentDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
         m_CurrentGPUDescriptorHandle = m_CurrentDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
         m_NumFreeHandles = m_NumDescriptorsPerHeap;
+        ClearDescriptorTableCache();
 
         comandList.SetDescriptorHeap(m_DescriptorHeapType, m_CurrentDescriptorHeap.Get());
     }
@@ -154,6 +187,44 @@ D3D12_GPU_DESCRIPTOR_HANDLE DynamicDescriptorHeap::CopyDescriptor(CommandList& c
     return hGPU;
 }
 
+bool DynamicDescriptorHeap::FindCachedDescriptorTable(uint64_t hash, const D3D12_CPU_DESCRIPTOR_HANDLE* descriptors, uint32_t numDescriptors, D3D12_GPU_DESCRIPTOR_HANDLE& gpuDescriptor) const
+{
+    auto iter = m_CachedDescriptorTables.find(hash);
+    if (iter == m_CachedDescriptorTables.end() || iter->second.NumDescriptors != numDescriptors)
+    {
+        return false;
+    }
+
+    // Guard against hash collisions.
+    const D3D12_CPU_DESCRIPTOR_HANDLE* cachedDescriptors = m_CachedDescriptorHandles.data() + iter->second.FirstHandle;
+    for (uint32_t i = 0; i < numDescriptors; ++i)
+    {
+        if (cachedDescriptors[i].ptr != descriptors[i].ptr)
+        {
+            return false;
+        }
+    }
+
+    gpuDescriptor = iter->second.GPUDescriptor;
+    return true;
+}
+
+void DynamicDescriptorHeap::AddCachedDescriptorTable(uint64_t hash, const D3D12_CPU_DESCRIPTOR_HANDLE* descriptors, uint32_t numDescriptors, D3D12_GPU_DESCRIPTOR_HANDLE gpuDescriptor)
+{
+    CachedDescriptorTable& table = m_CachedDescriptorTables[hash];
+    table.FirstHandle = static_cast<uint32_t>(m_CachedDescriptorHandles.size());
+    table.NumDescriptors = numDescriptors;
+    table.GPUDescriptor = gpuDescriptor;
+
+    m_CachedDescriptorHandles.insert(m_CachedDescriptorHandles.end(), descriptors, descriptors + numDescriptors);
+}
+
+void DynamicDescriptorHeap::ClearDescriptorTableCache()
+{
+    m_CachedDescriptorTables.clear();
+    m_CachedDescriptorHandles.clear();
+}
+
 void DynamicDescriptorHeap::ParseRootSignature(const RootSignature& rootSignature)
 {
     // If the root signature changes, all descriptors must be (re)bound to the
@@ -226,6 +297,7 @@ void DynamicDescriptorHeap::Reset()
     m_CurrentGPUDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(D3D12_DEFAULT);
     m_NumFreeHandles = 0;
     m_StaleDescriptorTableBitMask = 0;
+    ClearDescriptorTableCache();
 
     // Reset the table cache
     for (int i = 0; i < MaxDescriptorTables; ++i)
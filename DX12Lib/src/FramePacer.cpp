@@ -0,0 +1,60 @@
+#include <DX12LibPCH.h>
+
+#include <FramePacer.h>
+
+#include <CommandQueue.h>
+
+FramePacer::FramePacer(std::shared_ptr<CommandQueue> commandQueue, uint32_t numFramesInFlight)
+    : m_CommandQueue(commandQueue)
+    , m_NumFramesInFlight(0)
+    , m_CurrentFrame{ 0, 0 }
+    , m_LastCompletedFrame(0)
+{
+    SetNumFramesInFlight(numFramesInFlight);
+}
+
+FramePacer::~FramePacer()
+{}
+
+void FramePacer::SetNumFramesInFlight(uint32_t numFramesInFlight)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_NumFramesInFlight = std::min(std::max(numFramesInFlight, 1u), MaxFramesInFlight);
+}
+
+uint64_t FramePacer::EndFrame(uint64_t frameNumber)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_CurrentFrame.FenceValue = m_CommandQueue->Signal();
+    m_CurrentFrame.FrameNumber = frameNumber;
+    m_FramesInFlight.push_back(m_CurrentFrame);
+    m_CurrentFrame = Frame{ 0, 0 };
+
+    // Only wait if the CPU is too far ahead of the GPU.
+    while (m_FramesInFlight.size() > m_NumFramesInFlight)
+    {
+        m_CommandQueue->WaitForFenceValue(m_FramesInFlight.front().FenceValue);
+        m_LastCompletedFrame = m_FramesInFlight.front().FrameNumber;
+        m_FramesInFlight.pop_front();
+    }
+
+    RetireFrames();
+
+    return m_LastCompletedFrame;
+}
+
+void FramePacer::RetireCompletedFrames()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    RetireFrames();
+}
+
+void FramePacer::RetireFrames()
+{
+    while (!m_FramesInFlight.empty() && m_CommandQueue->IsFenceComplete(m_FramesInFlight.front().FenceValue))
+    {
+        m_LastCompletedFrame = m_FramesInFlight.front().FrameNumber;
+        m_FramesInFlight.pop_front();
+    }
+}
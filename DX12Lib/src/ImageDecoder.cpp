@@ -0,0 +1,183 @@
+#include <ImageDecoder.h>
+
+#include <PngDecoder.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <codecvt>
+#include <locale>
+#endif
+
+namespace
+{
+    // Read a file that was opened at its end.
+    bool ReadStream(std::ifstream& file, std::vector<uint8_t>& data)
+    {
+        if (!file)
+        {
+            return false;
+        }
+
+        std::streamoff size = file.tellg();
+        if (size < 0)
+        {
+            return false;
+        }
+        data.resize(static_cast<size_t>(size));
+        file.seekg(0);
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(data.data()), size));
+    }
+}
+
+ImageBatchDecoder::ImageBatchDecoder(uint32_t numWorkers)
+    : m_NumWorkers(numWorkers)
+{
+    m_Decoders.push_back(std::make_unique<PngDecoder>());
+}
+
+ImageBatchDecoder::~ImageBatchDecoder()
+{}
+
+void ImageBatchDecoder::AddDecoder(std::unique_ptr<ImageDecoder> decoder)
+{
+    m_Decoders.push_back(std::move(decoder));
+}
+
+const ImageDecoder* ImageBatchDecoder::FindDecoder(const uint8_t* data, size_t size) const
+{
+    for (auto& decoder : m_Decoders)
+    {
+        if (decoder->CanDecode(data, size))
+        {
+            return decoder.get();
+        }
+    }
+    return nullptr;
+}
+
+bool ImageBatchDecoder::Decode(const uint8_t* data, size_t size, DecodedImage& image) const
+{
+    const ImageDecoder* decoder = FindDecoder(data, size);
+    if (!decoder)
+    {
+        image = DecodedImage();
+        return false;
+    }
+    return decoder->Decode(data, size, image);
+}
+
+bool ImageBatchDecoder::DecodeFile(const std::string& fileName, DecodedImage& image) const
+{
+    std::vector<uint8_t> data;
+    if (!ReadFile(fileName, data))
+    {
+        image = DecodedImage();
+        return false;
+    }
+    return Decode(data.data(), data.size(), image);
+}
+
+bool ImageBatchDecoder::DecodeFile(const std::wstring& fileName, DecodedImage& image) const
+{
+    std::vector<uint8_t> data;
+    if (!ReadFile(fileName, data))
+    {
+        image = DecodedImage();
+        return false;
+    }
+    return Decode(data.data(), data.size(), image);
+}
+
+ImageBatchDecoder::Statistics ImageBatchDecoder::DecodeFiles(const std::vector<std::string>& fileNames, std::vector<DecodedImage>& images) const
+{
+    return DecodeFileList(fileNames, images);
+}
+
+ImageBatchDecoder::Statistics ImageBatchDecoder::DecodeFiles(const std::vector<std::wstring>& fileNames, std::vector<DecodedImage>& images) const
+{
+    return DecodeFileList(fileNames, images);
+}
+
+template<typename FileName>
+ImageBatchDecoder::Statistics ImageBatchDecoder::DecodeFileList(const std::vector<FileName>& fileNames, std::vector<DecodedImage>& images) const
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    images.clear();
+    images.resize(fileNames.size());
+
+    uint32_t numWorkers = m_NumWorkers;
+    if (numWorkers == 0)
+    {
+        numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    numWorkers = static_cast<uint32_t>(std::min<size_t>(numWorkers, fileNames.size()));
+
+    // Workers take the next file that has not been decoded yet. Small files
+    // are cheap to decode, so the reading of the files is spread across the
+    // workers as well.
+    std::atomic<size_t> nextImage(0);
+    std::atomic<size_t> numDecoded(0);
+    std::atomic<uint64_t> numBytesRead(0);
+    auto decodeImages = [&]()
+    {
+        std::vector<uint8_t> data;
+        for (size_t i = nextImage++; i < fileNames.size(); i = nextImage++)
+        {
+            if (ReadFile(fileNames[i], data))
+            {
+                numBytesRead += data.size();
+                if (Decode(data.data(), data.size(), images[i]))
+                {
+                    ++numDecoded;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 1; i < numWorkers; ++i)
+    {
+        workers.emplace_back(decodeImages);
+    }
+    // The calling thread is one of the workers.
+    decodeImages();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - startTime;
+
+    Statistics statistics;
+    statistics.NumImages = fileNames.size();
+    statistics.NumDecoded = numDecoded;
+    statistics.NumBytesRead = numBytesRead;
+    statistics.Seconds = duration.count();
+    statistics.ImagesPerSecond = statistics.Seconds > 0.0 ? statistics.NumDecoded / statistics.Seconds : 0.0;
+
+    return statistics;
+}
+
+bool ImageBatchDecoder::ReadFile(const std::string& fileName, std::vector<uint8_t>& data)
+{
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    return ReadStream(file, data);
+}
+
+bool ImageBatchDecoder::ReadFile(const std::wstring& fileName, std::vector<uint8_t>& data)
+{
+#ifdef _WIN32
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    return ReadStream(file, data);
+#else
+    // File names are UTF-8 on other platforms.
+    std::wstring_convert<std::codecvt_utf8<wchar_t> > converter;
+    return ReadFile(converter.to_bytes(fileName), data);
+#endif
+}
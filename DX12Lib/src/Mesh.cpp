@@ -31,11 +31,16 @@ Mesh::~Mesh()
 }
 
 void Mesh::Draw(CommandList& commandList)
+{
+	Bind(commandList);
+	commandList.DrawIndexed(m_IndexCount);
+}
+
+void Mesh::Bind(CommandList& commandList)
 {
 	commandList.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	commandList.SetVertexBuffer(0, m_VertexBuffer);
 	commandList.SetIndexBuffer(m_IndexBuffer);
-	commandList.DrawIndexed(m_IndexCount);
 }
 
 std::unique_ptr<Mesh> Mesh::CreateSphere(CommandList& commandList, float diameter, size_t tessellation, bool rhcoords)
@@ -398,6 +403,40 @@ static void ReverseWinding(IndexCollection& indices, std::vector<T>& vertices)
 	}
 }
 
+std::unique_ptr<Mesh> Mesh::CreateVoxelMesh(CommandList& commandList, const VoxelVertexCollection& vertices, const std::vector<uint32_t>& indices)
+{
+	assert(!vertices.empty() && !indices.empty());
+
+	std::unique_ptr<Mesh> mesh(new Mesh());
+
+	commandList.CopyVertexBuffer(mesh->m_VertexBuffer, vertices);
+	mesh->m_VertexBuffer.SetName(L"Voxel Vertices");
+	commandList.CopyIndexBuffer(mesh->m_IndexBuffer, indices);
+	mesh->m_IndexBuffer.SetName(L"Voxel Indices");
+
+	mesh->m_IndexCount = static_cast<UINT>(indices.size());
+	mesh->World = XMMatrixIdentity();
+
+	return mesh;
+}
+
+std::unique_ptr<Mesh> Mesh::CreateBlockModelMesh(CommandList& commandList, const CubeVertexCollection& vertices, const std::vector<uint32_t>& indices)
+{
+	assert(!vertices.empty() && !indices.empty());
+
+	std::unique_ptr<Mesh> mesh(new Mesh());
+
+	commandList.CopyVertexBuffer(mesh->m_VertexBuffer, vertices);
+	mesh->m_VertexBuffer.SetName(L"Block Model Vertices");
+	commandList.CopyIndexBuffer(mesh->m_IndexBuffer, indices);
+	mesh->m_IndexBuffer.SetName(L"Block Model Indices");
+
+	mesh->m_IndexCount = static_cast<UINT>(indices.size());
+	mesh->World = XMMatrixIdentity();
+
+	return mesh;
+}
+
 template<typename T>
 void Mesh::Initialize(CommandList& commandList, std::vector<T>& vertices, IndexCollection& indices, bool rhcoords)
 {
@@ -0,0 +1,320 @@
+#include <DX12LibPCH.h>
+
+#include <MeshingScheduler.h>
+
+#include <Camera.h>
+
+using namespace DirectX;
+
+MeshingScheduler::MeshingScheduler(Mesher mesher, uint32_t numThreads)
+    : m_Mesher(std::move(mesher))
+    , m_NumInFlight(0)
+    , m_NextGeneration(0)
+    , m_RequestsSorted(true)
+    , m_Exit(false)
+    , m_ViewPosition(0.0f, 0.0f, 0.0f)
+    , m_ViewDirection(0.0f, 0.0f, 1.0f)
+    , m_Completions(nullptr)
+    , m_ReadyHead(nullptr)
+    , m_ReadyTail(nullptr)
+    , m_FreeCompletions(nullptr)
+    , m_NumResultNodes(0)
+    , m_NumRequested(0)
+    , m_NumMeshed(0)
+    , m_MeshNanoseconds(0)
+    , m_NumIntegrated(0)
+    , m_NumSuperseded(0)
+    , m_TotalLatencyMilliseconds(0.0)
+{
+    if (numThreads == 0)
+    {
+        uint32_t numHardwareThreads = std::thread::hardware_concurrency();
+        numThreads = numHardwareThreads > 1 ? numHardwareThreads - 1 : 1;
+    }
+
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        m_Threads.emplace_back(&MeshingScheduler::ProcessRequests, this);
+    }
+}
+
+MeshingScheduler::~MeshingScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_RequestMutex);
+        m_Exit = true;
+    }
+    m_RequestCondition.notify_all();
+
+    for (auto& thread : m_Threads)
+    {
+        thread.join();
+    }
+
+    for (Completion* list : { m_Completions.exchange(nullptr), m_ReadyHead, m_FreeCompletions })
+    {
+        while (list)
+        {
+            Completion* next = list->Next;
+            delete list;
+            list = next;
+        }
+    }
+}
+
+void MeshingScheduler::Request(const SectionKey& key)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_RequestMutex);
+
+        auto& state = m_Sections[key];
+        if (state.Generation != 0 && state.Queued)
+        {
+            // Already waiting for a worker.
+            return;
+        }
+
+        state.Generation = ++m_NextGeneration;
+        state.Queued = true;
+
+        m_Requests.push_back({ key, state.Generation, Clock::now(), ComputePriority(key) });
+        m_RequestsSorted = false;
+    }
+
+    ++m_NumRequested;
+    m_RequestCondition.notify_one();
+}
+
+void XM_CALLCONV MeshingScheduler::SetView(FXMVECTOR position, FXMVECTOR direction)
+{
+    std::lock_guard<std::mutex> lock(m_RequestMutex);
+
+    XMStoreFloat3(&m_ViewPosition, position);
+    XMStoreFloat3(&m_ViewDirection, XMVector3Normalize(direction));
+
+    for (auto& request : m_Requests)
+    {
+        request.Priority = ComputePriority(request.Key);
+    }
+    m_RequestsSorted = false;
+}
+
+void MeshingScheduler::SetView(const Camera& camera)
+{
+    // The camera looks down the +Z axis in view space (left-handed).
+    XMVECTOR direction = XMVector3Rotate(XMVectorSet(0, 0, 1, 0), camera.get_Rotation());
+    SetView(camera.get_Translation(), direction);
+}
+
+float MeshingScheduler::ComputePriority(const SectionKey& key) const
+{
+    float dx = key.X * 16.0f + 8.0f - m_ViewPosition.x;
+    float dy = key.Y * 16.0f + 8.0f - m_ViewPosition.y;
+    float dz = key.Z * 16.0f + 8.0f - m_ViewPosition.z;
+
+    float distanceSq = dx * dx + dy * dy + dz * dz;
+    float facing = dx * m_ViewDirection.x + dy * m_ViewDirection.y + dz * m_ViewDirection.z;
+
+    // Sections behind the camera are scheduled as if they were twice as far away.
+    return facing < 0.0f ? distanceSq * 4.0f : distanceSq;
+}
+
+void MeshingScheduler::ProcessRequests()
+{
+    ScratchBuffer scratch;
+
+    while (true)
+    {
+        MeshRequest request;
+        {
+            std::unique_lock<std::mutex> lock(m_RequestMutex);
+            m_RequestCondition.wait(lock, [this] { return m_Exit || !m_Requests.empty(); });
+
+            if (m_Exit)
+            {
+                return;
+            }
+
+            if (!m_RequestsSorted)
+            {
+                // Highest priority (lowest value) at the back so it can be popped cheaply.
+                std::sort(m_Requests.begin(), m_Requests.end(), [](const MeshRequest& a, const MeshRequest& b)
+                {
+                    return a.Priority > b.Priority;
+                });
+                m_RequestsSorted = true;
+            }
+
+            request = m_Requests.back();
+            m_Requests.pop_back();
+
+            m_Sections[request.Key].Queued = false;
+            ++m_NumInFlight;
+        }
+
+        scratch.Vertices.clear();
+        scratch.Indices.clear();
+
+        auto start = Clock::now();
+        m_Mesher(request.Key, scratch);
+        auto end = Clock::now();
+
+        m_MeshNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        ++m_NumMeshed;
+
+        // Swap the mesh into a recycled node. The scratch buffer gets the
+        // buffers of the node, which are cleared before the next job.
+        Completion* completion = AcquireCompletion();
+        completion->Result.Key = request.Key;
+        completion->Result.Vertices.swap(scratch.Vertices);
+        completion->Result.Indices.swap(scratch.Indices);
+        completion->Generation = request.Generation;
+        completion->RequestTime = request.RequestTime;
+        PushCompletion(completion);
+
+        {
+            std::lock_guard<std::mutex> lock(m_RequestMutex);
+            --m_NumInFlight;
+            if (m_NumInFlight == 0 && m_Requests.empty())
+            {
+                m_IdleCondition.notify_all();
+            }
+        }
+    }
+}
+
+void MeshingScheduler::PushCompletion(Completion* completion)
+{
+    completion->Next = m_Completions.load(std::memory_order_relaxed);
+    while (!m_Completions.compare_exchange_weak(completion->Next, completion,
+        std::memory_order_release, std::memory_order_relaxed))
+    {}
+}
+
+MeshingScheduler::Completion* MeshingScheduler::AcquireCompletion()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_FreeMutex);
+        if (m_FreeCompletions)
+        {
+            Completion* completion = m_FreeCompletions;
+            m_FreeCompletions = completion->Next;
+            return completion;
+        }
+    }
+
+    ++m_NumResultNodes;
+    return new Completion{};
+}
+
+void MeshingScheduler::ReleaseCompletion(Completion* completion)
+{
+    std::lock_guard<std::mutex> lock(m_FreeMutex);
+    completion->Next = m_FreeCompletions;
+    m_FreeCompletions = completion;
+}
+
+size_t MeshingScheduler::Integrate(const std::function<void(MeshResult&)>& integrate, double budgetMilliseconds)
+{
+    // Take everything that was completed since the last call. The queue is a
+    // LIFO stack, so reverse it to integrate in completion order.
+    Completion* completion = m_Completions.exchange(nullptr, std::memory_order_acquire);
+    Completion* reversed = nullptr;
+    while (completion)
+    {
+        Completion* next = completion->Next;
+        completion->Next = reversed;
+        reversed = completion;
+        completion = next;
+    }
+    if (reversed)
+    {
+        if (m_ReadyTail)
+        {
+            m_ReadyTail->Next = reversed;
+        }
+        else
+        {
+            m_ReadyHead = reversed;
+        }
+        for (m_ReadyTail = reversed; m_ReadyTail->Next; m_ReadyTail = m_ReadyTail->Next)
+        {}
+    }
+
+    auto start = Clock::now();
+    size_t numIntegrated = 0;
+
+    while (m_ReadyHead)
+    {
+        // Always make some progress, even with a zero budget.
+        if (numIntegrated > 0)
+        {
+            std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+            if (elapsed.count() >= budgetMilliseconds)
+            {
+                break;
+            }
+        }
+
+        completion = m_ReadyHead;
+        m_ReadyHead = completion->Next;
+        if (!m_ReadyHead)
+        {
+            m_ReadyTail = nullptr;
+        }
+
+        bool current = false;
+        {
+            std::lock_guard<std::mutex> lock(m_RequestMutex);
+            auto iter = m_Sections.find(completion->Result.Key);
+            if (iter != m_Sections.end() && iter->second.Generation == completion->Generation)
+            {
+                m_Sections.erase(iter);
+                current = true;
+            }
+        }
+
+        if (current)
+        {
+            integrate(completion->Result);
+
+            std::chrono::duration<double, std::milli> latency = Clock::now() - completion->RequestTime;
+            m_TotalLatencyMilliseconds += latency.count();
+            ++m_NumIntegrated;
+            ++numIntegrated;
+        }
+        else
+        {
+            ++m_NumSuperseded;
+        }
+
+        ReleaseCompletion(completion);
+    }
+
+    return numIntegrated;
+}
+
+void MeshingScheduler::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_RequestMutex);
+    m_IdleCondition.wait(lock, [this] { return m_NumInFlight == 0 && m_Requests.empty(); });
+}
+
+MeshingScheduler::Statistics MeshingScheduler::GetStatistics() const
+{
+    Statistics statistics;
+    {
+        std::lock_guard<std::mutex> lock(m_RequestMutex);
+        statistics.NumPending = m_Requests.size();
+    }
+
+    statistics.NumRequested = m_NumRequested;
+    statistics.NumMeshed = m_NumMeshed;
+    statistics.NumIntegrated = m_NumIntegrated;
+    statistics.NumSuperseded = m_NumSuperseded;
+    statistics.NumResultNodes = m_NumResultNodes;
+    statistics.TotalMeshMilliseconds = m_MeshNanoseconds * 1e-6;
+    statistics.AverageLatencyMilliseconds = m_NumIntegrated > 0 ? m_TotalLatencyMilliseconds / m_NumIntegrated : 0.0;
+
+    return statistics;
+}
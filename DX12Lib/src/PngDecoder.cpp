@@ -0,0 +1,571 @@
+#include <PngDecoder.h>
+
+#include <zlib.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "zlibwapi.lib")
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const uint8_t PngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    // Larger images are rejected, which keeps the size computations far from overflowing.
+    const uint32_t MaxDimension = 16384;
+
+    enum PngColorType
+    {
+        PNG_COLOR_GRAY = 0,
+        PNG_COLOR_RGB = 2,
+        PNG_COLOR_PALETTE = 3,
+        PNG_COLOR_GRAY_ALPHA = 4,
+        PNG_COLOR_RGBA = 6,
+    };
+
+    enum PngFilterType
+    {
+        PNG_FILTER_NONE = 0,
+        PNG_FILTER_SUB = 1,
+        PNG_FILTER_UP = 2,
+        PNG_FILTER_AVERAGE = 3,
+        PNG_FILTER_PAETH = 4,
+    };
+
+    // The origin and spacing of the pixels of the seven Adam7 passes.
+    const uint32_t Adam7X[7] = { 0, 4, 0, 2, 0, 1, 0 };
+    const uint32_t Adam7Y[7] = { 0, 0, 4, 0, 2, 0, 1 };
+    const uint32_t Adam7DX[7] = { 8, 8, 4, 4, 2, 2, 1 };
+    const uint32_t Adam7DY[7] = { 8, 8, 8, 4, 4, 2, 2 };
+
+    struct PngHeader
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t bitDepth;
+        uint32_t colorType;
+        bool interlaced;
+    };
+
+    // The palette and the transparency of an image, ready for conversion.
+    struct PngColorTable
+    {
+        uint8_t palette[256][4];
+        // The transparent color of gray and RGB images, at the source bit depth.
+        uint16_t colorKey[3];
+        bool hasColorKey;
+    };
+
+    // A pass of the image: the whole image, or one of the Adam7 passes.
+    struct PngPass
+    {
+        uint32_t x, y, dx, dy;
+        uint32_t width, height;
+    };
+
+    inline uint32_t ReadUInt32(const uint8_t* p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    inline uint16_t ReadUInt16(const uint8_t* p)
+    {
+        return static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    inline uint32_t ChunkType(const char name[5])
+    {
+        return ReadUInt32(reinterpret_cast<const uint8_t*>(name));
+    }
+
+    uint32_t NumChannels(uint32_t colorType)
+    {
+        switch (colorType)
+        {
+        case PNG_COLOR_GRAY:
+        case PNG_COLOR_PALETTE:
+            return 1;
+        case PNG_COLOR_GRAY_ALPHA:
+            return 2;
+        case PNG_COLOR_RGB:
+            return 3;
+        case PNG_COLOR_RGBA:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    bool IsValidBitDepth(uint32_t colorType, uint32_t bitDepth)
+    {
+        switch (colorType)
+        {
+        case PNG_COLOR_GRAY:
+            return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8 || bitDepth == 16;
+        case PNG_COLOR_PALETTE:
+            return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8;
+        case PNG_COLOR_RGB:
+        case PNG_COLOR_GRAY_ALPHA:
+        case PNG_COLOR_RGBA:
+            return bitDepth == 8 || bitDepth == 16;
+        default:
+            return false;
+        }
+    }
+
+    // The size of a row of filtered data, without the filter type byte.
+    inline size_t RowBytes(uint32_t width, uint32_t bitsPerPixel)
+    {
+        return (static_cast<size_t>(width) * bitsPerPixel + 7) / 8;
+    }
+
+    std::vector<PngPass> GetPasses(const PngHeader& header)
+    {
+        std::vector<PngPass> passes;
+        if (!header.interlaced)
+        {
+            passes.push_back({ 0, 0, 1, 1, header.width, header.height });
+            return passes;
+        }
+
+        for (int i = 0; i < 7; ++i)
+        {
+            PngPass pass = { Adam7X[i], Adam7Y[i], Adam7DX[i], Adam7DY[i], 0, 0 };
+            pass.width = header.width > pass.x ? (header.width - pass.x + pass.dx - 1) / pass.dx : 0;
+            pass.height = header.height > pass.y ? (header.height - pass.y + pass.dy - 1) / pass.dy : 0;
+            // Empty passes have no data in the stream.
+            if (pass.width > 0 && pass.height > 0)
+            {
+                passes.push_back(pass);
+            }
+        }
+        return passes;
+    }
+
+    inline uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c)
+    {
+        int p = int(a) + int(b) - int(c);
+        int pa = std::abs(p - int(a));
+        int pb = std::abs(p - int(b));
+        int pc = std::abs(p - int(c));
+        if (pa <= pb && pa <= pc)
+        {
+            return a;
+        }
+        return pb <= pc ? b : c;
+    }
+
+    // Reverse the filter of a row in place. prior is the previous (unfiltered) row or nullptr.
+    bool UnfilterRow(uint8_t filterType, uint8_t* row, const uint8_t* prior, size_t rowBytes, size_t bytesPerPixel)
+    {
+        switch (filterType)
+        {
+        case PNG_FILTER_NONE:
+            break;
+        case PNG_FILTER_SUB:
+            for (size_t i = bytesPerPixel; i < rowBytes; ++i)
+            {
+                row[i] = static_cast<uint8_t>(row[i] + row[i - bytesPerPixel]);
+            }
+            break;
+        case PNG_FILTER_UP:
+            if (prior)
+            {
+                for (size_t i = 0; i < rowBytes; ++i)
+                {
+                    row[i] = static_cast<uint8_t>(row[i] + prior[i]);
+                }
+            }
+            break;
+        case PNG_FILTER_AVERAGE:
+            for (size_t i = 0; i < rowBytes; ++i)
+            {
+                int left = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+                int up = prior ? prior[i] : 0;
+                row[i] = static_cast<uint8_t>(row[i] + ((left + up) >> 1));
+            }
+            break;
+        case PNG_FILTER_PAETH:
+            for (size_t i = 0; i < rowBytes; ++i)
+            {
+                uint8_t left = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+                uint8_t up = prior ? prior[i] : 0;
+                uint8_t upLeft = (prior && i >= bytesPerPixel) ? prior[i - bytesPerPixel] : 0;
+                row[i] = static_cast<uint8_t>(row[i] + Paeth(left, up, upLeft));
+            }
+            break;
+        default:
+            return false;
+        }
+        return true;
+    }
+
+    // Read sample i of a row of samples with less than 8 bits.
+    inline uint32_t ReadPackedSample(const uint8_t* row, uint32_t i, uint32_t bitDepth)
+    {
+        size_t bit = static_cast<size_t>(i) * bitDepth;
+        uint32_t shift = 8 - bitDepth - static_cast<uint32_t>(bit % 8);
+        return (row[bit / 8] >> shift) & ((1u << bitDepth) - 1);
+    }
+
+    // Convert an unfiltered row to R8G8B8A8. Consecutive pixels are written dstStride bytes apart.
+    void ConvertRow(const PngHeader& header, const PngColorTable& colors, const uint8_t* row, uint32_t width,
+        uint8_t* dst, size_t dstStride)
+    {
+        const uint32_t bitDepth = header.bitDepth;
+
+        for (uint32_t x = 0; x < width; ++x, dst += dstStride)
+        {
+            switch (header.colorType)
+            {
+            case PNG_COLOR_GRAY:
+            {
+                uint32_t sample;
+                uint8_t gray;
+                if (bitDepth == 16)
+                {
+                    sample = ReadUInt16(row + x * 2);
+                    gray = static_cast<uint8_t>(sample >> 8);
+                }
+                else if (bitDepth == 8)
+                {
+                    sample = row[x];
+                    gray = static_cast<uint8_t>(sample);
+                }
+                else
+                {
+                    // Scale 1, 2 and 4 bit samples to the full range (e.g. 0xF becomes 0xFF).
+                    sample = ReadPackedSample(row, x, bitDepth);
+                    gray = static_cast<uint8_t>(sample * (255 / ((1u << bitDepth) - 1)));
+                }
+                dst[0] = dst[1] = dst[2] = gray;
+                dst[3] = (colors.hasColorKey && sample == colors.colorKey[0]) ? 0 : 255;
+                break;
+            }
+            case PNG_COLOR_RGB:
+                if (bitDepth == 16)
+                {
+                    const uint8_t* p = row + x * 6;
+                    dst[0] = p[0];
+                    dst[1] = p[2];
+                    dst[2] = p[4];
+                    dst[3] = (colors.hasColorKey && ReadUInt16(p) == colors.colorKey[0] &&
+                        ReadUInt16(p + 2) == colors.colorKey[1] && ReadUInt16(p + 4) == colors.colorKey[2]) ? 0 : 255;
+                }
+                else
+                {
+                    const uint8_t* p = row + x * 3;
+                    dst[0] = p[0];
+                    dst[1] = p[1];
+                    dst[2] = p[2];
+                    dst[3] = (colors.hasColorKey && p[0] == colors.colorKey[0] &&
+                        p[1] == colors.colorKey[1] && p[2] == colors.colorKey[2]) ? 0 : 255;
+                }
+                break;
+            case PNG_COLOR_PALETTE:
+            {
+                uint32_t index = bitDepth == 8 ? row[x] : ReadPackedSample(row, x, bitDepth);
+                std::memcpy(dst, colors.palette[index], 4);
+                break;
+            }
+            case PNG_COLOR_GRAY_ALPHA:
+                if (bitDepth == 16)
+                {
+                    const uint8_t* p = row + x * 4;
+                    dst[0] = dst[1] = dst[2] = p[0];
+                    dst[3] = p[2];
+                }
+                else
+                {
+                    const uint8_t* p = row + x * 2;
+                    dst[0] = dst[1] = dst[2] = p[0];
+                    dst[3] = p[1];
+                }
+                break;
+            case PNG_COLOR_RGBA:
+                if (bitDepth == 16)
+                {
+                    const uint8_t* p = row + x * 8;
+                    dst[0] = p[0];
+                    dst[1] = p[2];
+                    dst[2] = p[4];
+                    dst[3] = p[6];
+                }
+                else
+                {
+                    std::memcpy(dst, row + x * 4, 4);
+                }
+                break;
+            }
+        }
+    }
+
+    // Inflates the concatenated IDAT chunks into a buffer of the expected size.
+    class PngInflater
+    {
+    public:
+        PngInflater(uint8_t* output, size_t outputSize)
+            : m_Initialized(false)
+            , m_Failed(false)
+        {
+            std::memset(&m_Stream, 0, sizeof(m_Stream));
+            m_Stream.next_out = output;
+            m_Stream.avail_out = static_cast<uInt>(outputSize);
+            m_Initialized = inflateInit(&m_Stream) == Z_OK;
+            m_Failed = !m_Initialized;
+        }
+
+        ~PngInflater()
+        {
+            if (m_Initialized)
+            {
+                inflateEnd(&m_Stream);
+            }
+        }
+
+        void Inflate(const uint8_t* data, size_t size)
+        {
+            if (m_Failed || IsComplete())
+            {
+                return;
+            }
+
+            m_Stream.next_in = const_cast<Bytef*>(data);
+            m_Stream.avail_in = static_cast<uInt>(size);
+            while (m_Stream.avail_in > 0 && m_Stream.avail_out > 0)
+            {
+                int result = inflate(&m_Stream, Z_NO_FLUSH);
+                if (result == Z_STREAM_END)
+                {
+                    break;
+                }
+                if (result != Z_OK)
+                {
+                    m_Failed = true;
+                    break;
+                }
+            }
+        }
+
+        bool IsComplete() const
+        {
+            return !m_Failed && m_Stream.avail_out == 0;
+        }
+
+    private:
+        z_stream m_Stream;
+        bool m_Initialized;
+        bool m_Failed;
+    };
+}
+
+bool PngDecoder::CanDecode(const uint8_t* data, size_t size) const
+{
+    return size >= sizeof(PngSignature) && std::memcmp(data, PngSignature, sizeof(PngSignature)) == 0;
+}
+
+bool PngDecoder::Decode(const uint8_t* data, size_t size, DecodedImage& image) const
+{
+    image = DecodedImage();
+
+    if (!CanDecode(data, size))
+    {
+        return false;
+    }
+
+    const uint8_t* chunk = data + sizeof(PngSignature);
+    const uint8_t* end = data + size;
+
+    PngHeader header = {};
+    PngColorTable colors;
+    for (auto& entry : colors.palette)
+    {
+        // Out of range palette indices decode as opaque black.
+        entry[0] = entry[1] = entry[2] = 0;
+        entry[3] = 255;
+    }
+    colors.hasColorKey = false;
+    uint32_t numPaletteEntries = 0;
+
+    std::vector<PngPass> passes;
+    std::vector<uint8_t> filtered;
+    std::unique_ptr<PngInflater> inflater;
+    bool hasHeader = false;
+    bool hasEnd = false;
+    bool hasTransparency = false;
+
+    while (!hasEnd)
+    {
+        // Length, type and CRC.
+        if (end - chunk < 12)
+        {
+            return false;
+        }
+        uint32_t length = ReadUInt32(chunk);
+        uint32_t type = ReadUInt32(chunk + 4);
+        const uint8_t* chunkData = chunk + 8;
+        if (length > 0x7FFFFFFFu || static_cast<size_t>(end - chunkData) < size_t(length) + 4)
+        {
+            return false;
+        }
+        uint32_t crc = ReadUInt32(chunkData + length);
+        if (crc != static_cast<uint32_t>(crc32(crc32(0L, Z_NULL, 0), chunk + 4, length + 4)))
+        {
+            return false;
+        }
+        chunk = chunkData + length + 4;
+
+        // The header comes first.
+        if (!hasHeader && type != ChunkType("IHDR"))
+        {
+            return false;
+        }
+
+        if (type == ChunkType("IHDR"))
+        {
+            if (hasHeader || length != 13)
+            {
+                return false;
+            }
+            header.width = ReadUInt32(chunkData);
+            header.height = ReadUInt32(chunkData + 4);
+            header.bitDepth = chunkData[8];
+            header.colorType = chunkData[9];
+            header.interlaced = chunkData[12] == 1;
+
+            // Compression method 0, filter method 0, interlace method 0 or 1.
+            if (header.width == 0 || header.height == 0 || header.width > MaxDimension || header.height > MaxDimension ||
+                !IsValidBitDepth(header.colorType, header.bitDepth) ||
+                chunkData[10] != 0 || chunkData[11] != 0 || chunkData[12] > 1)
+            {
+                return false;
+            }
+            hasHeader = true;
+        }
+        else if (type == ChunkType("PLTE"))
+        {
+            if (length % 3 != 0 || length / 3 > 256 || inflater)
+            {
+                return false;
+            }
+            numPaletteEntries = length / 3;
+            for (uint32_t i = 0; i < numPaletteEntries; ++i)
+            {
+                std::memcpy(colors.palette[i], chunkData + i * 3, 3);
+            }
+        }
+        else if (type == ChunkType("tRNS"))
+        {
+            if (inflater)
+            {
+                return false;
+            }
+            if (header.colorType == PNG_COLOR_PALETTE)
+            {
+                if (length > numPaletteEntries)
+                {
+                    return false;
+                }
+                for (uint32_t i = 0; i < length; ++i)
+                {
+                    colors.palette[i][3] = chunkData[i];
+                }
+            }
+            else if (header.colorType == PNG_COLOR_GRAY && length == 2)
+            {
+                colors.colorKey[0] = ReadUInt16(chunkData);
+                colors.hasColorKey = true;
+            }
+            else if (header.colorType == PNG_COLOR_RGB && length == 6)
+            {
+                colors.colorKey[0] = ReadUInt16(chunkData);
+                colors.colorKey[1] = ReadUInt16(chunkData + 2);
+                colors.colorKey[2] = ReadUInt16(chunkData + 4);
+                colors.hasColorKey = true;
+            }
+            else
+            {
+                return false;
+            }
+            hasTransparency = true;
+        }
+        else if (type == ChunkType("sRGB"))
+        {
+            image.IsSRGB = true;
+        }
+        else if (type == ChunkType("IDAT"))
+        {
+            if (!inflater)
+            {
+                if (header.colorType == PNG_COLOR_PALETTE && numPaletteEntries == 0)
+                {
+                    return false;
+                }
+
+                // The filtered data of all passes, each row starts with its filter type.
+                uint32_t bitsPerPixel = NumChannels(header.colorType) * header.bitDepth;
+                passes = GetPasses(header);
+                size_t filteredSize = 0;
+                for (auto& pass : passes)
+                {
+                    filteredSize += pass.height * (RowBytes(pass.width, bitsPerPixel) + 1);
+                }
+                filtered.resize(filteredSize);
+                inflater = std::make_unique<PngInflater>(filtered.data(), filtered.size());
+            }
+            inflater->Inflate(chunkData, length);
+        }
+        else if (type == ChunkType("IEND"))
+        {
+            hasEnd = true;
+        }
+        else if ((type & 0x20000000u) == 0)
+        {
+            // Unknown critical chunk (the first letter of the type is upper case).
+            return false;
+        }
+    }
+
+    if (!inflater || !inflater->IsComplete())
+    {
+        return false;
+    }
+
+    image.Width = header.width;
+    image.Height = header.height;
+    image.RowPitch = static_cast<size_t>(header.width) * 4;
+    image.SlicePitch = image.RowPitch * header.height;
+    image.HasAlpha = hasTransparency || header.colorType == PNG_COLOR_GRAY_ALPHA || header.colorType == PNG_COLOR_RGBA;
+    image.SourceBitDepth = header.bitDepth;
+
+    std::unique_ptr<uint8_t[]> pixels(new uint8_t[image.SlicePitch]);
+
+    const uint32_t bitsPerPixel = NumChannels(header.colorType) * header.bitDepth;
+    const size_t bytesPerPixel = std::max<size_t>(1, bitsPerPixel / 8);
+
+    uint8_t* row = filtered.data();
+    for (auto& pass : passes)
+    {
+        size_t rowBytes = RowBytes(pass.width, bitsPerPixel);
+        const uint8_t* prior = nullptr;
+
+        for (uint32_t y = 0; y < pass.height; ++y)
+        {
+            if (!UnfilterRow(row[0], row + 1, prior, rowBytes, bytesPerPixel))
+            {
+                return false;
+            }
+
+            uint8_t* dst = pixels.get() + (pass.y + y * pass.dy) * image.RowPitch + pass.x * 4;
+            ConvertRow(header, colors, row + 1, pass.width, dst, pass.dx * 4);
+
+            prior = row + 1;
+            row += rowBytes + 1;
+        }
+    }
+
+    image.Pixels = std::move(pixels);
+    return true;
+}
@@ -0,0 +1,156 @@
+#include <DX12LibPCH.h>
+
+#include <RenderQueue.h>
+
+#include <CommandList.h>
+#include <Mesh.h>
+#include <RootSignature.h>
+#include <Texture.h>
+
+namespace
+{
+    const size_t MaxObjectIds = 1 << 16;
+}
+
+RenderQueue::RenderQueue(const RootParameters& rootParameters)
+    : m_RootParameters(rootParameters)
+{}
+
+RenderQueue::~RenderQueue()
+{}
+
+uint64_t RenderQueue::GetObjectId(const void* object, uint32_t bits)
+{
+    auto iter = m_ObjectIds.find(object);
+    if (iter == m_ObjectIds.end())
+    {
+        iter = m_ObjectIds.emplace(object, m_ObjectIds.size()).first;
+    }
+    return iter->second & ((1ull << bits) - 1);
+}
+
+uint32_t RenderQueue::GetMaterialIndex(const Material& material)
+{
+    // There are usually only a handful of materials in a frame.
+    for (size_t i = m_Materials.size(); i-- > 0; )
+    {
+        if (memcmp(&m_Materials[i], &material, sizeof(Material)) == 0)
+        {
+            return static_cast<uint32_t>(i);
+        }
+    }
+
+    m_Materials.push_back(material);
+    return static_cast<uint32_t>(m_Materials.size() - 1);
+}
+
+void RenderQueue::Submit(ID3D12PipelineState* pipelineState, const RootSignature& rootSignature,
+    Mesh& mesh, const Texture& texture, const Material& material, float depth,
+    size_t constantsSize, const void* constants)
+{
+    DrawPacket packet;
+    packet.pPipelineState = pipelineState;
+    packet.pRootSignature = &rootSignature;
+    packet.pMesh = &mesh;
+    packet.pTexture = &texture;
+    packet.MaterialIndex = GetMaterialIndex(material);
+    packet.ConstantsOffset = static_cast<uint32_t>(m_ConstantData.size());
+    packet.ConstantsSize = static_cast<uint32_t>(constantsSize);
+
+    if (constantsSize > 0)
+    {
+        auto bytes = static_cast<const uint8_t*>(constants);
+        m_ConstantData.insert(m_ConstantData.end(), bytes, bytes + constantsSize);
+    }
+
+    uint64_t key = DrawSortKey::Pack(GetObjectId(pipelineState, DrawSortKey::PipelineStateBits),
+        GetObjectId(&rootSignature, DrawSortKey::RootSignatureBits),
+        GetObjectId(&texture, DrawSortKey::TextureBits),
+        packet.MaterialIndex,
+        GetObjectId(&mesh, DrawSortKey::MeshBits),
+        depth);
+
+    m_SortEntries.push_back({ key, static_cast<uint32_t>(m_Packets.size()) });
+    m_Packets.push_back(packet);
+}
+
+void RenderQueue::Flush(CommandList& commandList)
+{
+    size_t numPackets = Sort();
+    Record(commandList, 0, numPackets);
+    Clear();
+}
+
+size_t RenderQueue::Sort()
+{
+    m_Statistics = Statistics();
+    m_Statistics.NumPackets = static_cast<uint32_t>(m_Packets.size());
+
+    RadixSortDrawKeys(m_SortEntries, m_SortScratch);
+
+    return m_Packets.size();
+}
+
+void RenderQueue::Record(CommandList& commandList, size_t first, size_t last)
+{
+    DrawStateFilter filter;
+
+    for (size_t i = first; i < last; ++i)
+    {
+        const DrawPacket& packet = m_Packets[m_SortEntries[i].PacketIndex];
+
+        uint32_t changes = filter.Draw(packet.pPipelineState, packet.pRootSignature, packet.pTexture,
+            packet.MaterialIndex, packet.pMesh);
+
+        if (changes & DrawStateFilter::PipelineStateChange)
+        {
+            commandList.SetPipelineState(packet.pPipelineState);
+        }
+
+        if (changes & DrawStateFilter::RootSignatureChange)
+        {
+            commandList.SetGraphicsRootSignature(*packet.pRootSignature);
+        }
+
+        if (changes & DrawStateFilter::TextureChange)
+        {
+            commandList.SetShaderResourceView(m_RootParameters.Textures, 0, *packet.pTexture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        }
+
+        if (changes & DrawStateFilter::MaterialChange)
+        {
+            commandList.SetGraphicsDynamicConstantBuffer(m_RootParameters.Material, m_Materials[packet.MaterialIndex]);
+        }
+
+        if (changes & DrawStateFilter::MeshChange)
+        {
+            packet.pMesh->Bind(commandList);
+        }
+
+        if (packet.ConstantsSize > 0)
+        {
+            commandList.SetGraphicsDynamicConstantBuffer(m_RootParameters.DrawConstants, packet.ConstantsSize,
+                m_ConstantData.data() + packet.ConstantsOffset);
+        }
+
+        commandList.DrawIndexed(packet.pMesh->GetIndexCount());
+    }
+
+    std::lock_guard<std::mutex> lock(m_StatisticsMutex);
+    m_Statistics += filter.GetStatistics();
+}
+
+void RenderQueue::Clear()
+{
+    m_Packets.clear();
+    m_SortEntries.clear();
+    m_Materials.clear();
+    m_ConstantData.clear();
+
+    // Forget the ids of objects that are no longer submitted once in a while,
+    // so the map does not grow with every object that was ever drawn.
+    if (m_ObjectIds.size() > MaxObjectIds)
+    {
+        m_ObjectIds.clear();
+    }
+}
@@ -0,0 +1,140 @@
+#include <DX12LibPCH.h>
+
+#include <RenderQueueSort.h>
+
+static_assert(DrawSortKey::PipelineStateShift + DrawSortKey::PipelineStateBits == 64, "The sort key must use exactly 64 bits.");
+
+uint64_t DrawSortKey::Pack(uint64_t pipelineState, uint64_t rootSignature, uint64_t texture,
+    uint64_t material, uint64_t mesh, float depth)
+{
+    return (pipelineState & ((1ull << PipelineStateBits) - 1)) << PipelineStateShift
+        | (rootSignature & ((1ull << RootSignatureBits) - 1)) << RootSignatureShift
+        | (texture & ((1ull << TextureBits) - 1)) << TextureShift
+        | (material & ((1ull << MaterialBits) - 1)) << MaterialShift
+        | (mesh & ((1ull << MeshBits) - 1)) << MeshShift
+        | QuantizeDepth(depth) << DepthShift;
+}
+
+uint64_t DrawSortKey::QuantizeDepth(float depth)
+{
+    // The bit pattern of a non-negative float increases with its value,
+    // so the upper bits of the pattern are a monotonic depth key.
+    depth = std::max(depth, 0.0f);
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits >> (32 - DepthBits);
+}
+
+uint32_t RadixSortDrawKeys(std::vector<DrawSortEntry>& entries, std::vector<DrawSortEntry>& scratch)
+{
+    if (entries.empty())
+    {
+        return 0;
+    }
+
+    // LSD radix sort on 8 bit digits. Passes in which all keys share the same
+    // digit are skipped, which is common for the upper (object id) digits.
+    scratch.resize(entries.size());
+
+    uint32_t numPasses = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 8)
+    {
+        uint32_t counts[256] = {};
+        for (const auto& entry : entries)
+        {
+            counts[(entry.Key >> shift) & 0xFF]++;
+        }
+
+        if (counts[(entries.front().Key >> shift) & 0xFF] == entries.size())
+        {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t& count : counts)
+        {
+            uint32_t c = count;
+            count = offset;
+            offset += c;
+        }
+
+        for (const auto& entry : entries)
+        {
+            scratch[counts[(entry.Key >> shift) & 0xFF]++] = entry;
+        }
+
+        entries.swap(scratch);
+        numPasses++;
+    }
+
+    return numPasses;
+}
+
+DrawStatistics& DrawStatistics::operator+=(const DrawStatistics& other)
+{
+    NumPackets += other.NumPackets;
+    NumDraws += other.NumDraws;
+    NumPipelineStateChanges += other.NumPipelineStateChanges;
+    NumRootSignatureChanges += other.NumRootSignatureChanges;
+    NumTextureChanges += other.NumTextureChanges;
+    NumMaterialChanges += other.NumMaterialChanges;
+    NumMeshChanges += other.NumMeshChanges;
+    return *this;
+}
+
+DrawStateFilter::DrawStateFilter()
+    : m_PipelineState(nullptr)
+    , m_RootSignature(nullptr)
+    , m_Texture(nullptr)
+    , m_Material(UINT32_MAX)
+    , m_Mesh(nullptr)
+{}
+
+uint32_t DrawStateFilter::Draw(const void* pipelineState, const void* rootSignature, const void* texture,
+    uint32_t material, const void* mesh)
+{
+    uint32_t changes = 0;
+
+    if (pipelineState != m_PipelineState)
+    {
+        m_PipelineState = pipelineState;
+        changes |= PipelineStateChange;
+        m_Statistics.NumPipelineStateChanges++;
+    }
+
+    if (rootSignature != m_RootSignature)
+    {
+        m_RootSignature = rootSignature;
+        changes |= RootSignatureChange;
+        m_Statistics.NumRootSignatureChanges++;
+
+        // Changing the root signature invalidates all root arguments.
+        m_Texture = nullptr;
+        m_Material = UINT32_MAX;
+    }
+
+    if (texture != m_Texture)
+    {
+        m_Texture = texture;
+        changes |= TextureChange;
+        m_Statistics.NumTextureChanges++;
+    }
+
+    if (material != m_Material)
+    {
+        m_Material = material;
+        changes |= MaterialChange;
+        m_Statistics.NumMaterialChanges++;
+    }
+
+    if (mesh != m_Mesh)
+    {
+        m_Mesh = mesh;
+        changes |= MeshChange;
+        m_Statistics.NumMeshChanges++;
+    }
+
+    m_Statistics.NumDraws++;
+
+    return changes;
+}
@@ -6,9 +6,7 @@
 #include <Resource.h>
 
 // Static definitions.
-std::mutex ResourceStateTracker::ms_GlobalMutex;
-bool ResourceStateTracker::ms_IsLocked = false;
-ResourceStateTracker::ResourceStateMap ResourceStateTracker::ms_GlobalResourceState;
+ResourceStateTracker::GlobalResourceStateShard ResourceStateTracker::ms_GlobalResourceState[NumGlobalResourceStateShards];
 
 ResourceStateTracker::ResourceStateTracker()
 {}
@@ -31,18 +29,18 @@ void ResourceStateTracker::ResourceBarrier(const D3D12_RESOURCE_BARRIER& barrier
             auto& resourceState = iter->second;
             // If the known final state of the resource is different...
             if ( transitionBarrier.Subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES &&
-                 !resourceState.SubresourceState.empty() )
+                 resourceState.HasSubresourceStates() )
             {
-                for ( auto subresourceState : resourceState.SubresourceState )
+                resourceState.ForEachSubresourceState( [&]( UINT subresource, D3D12_RESOURCE_STATES state )
                 {
-                    if ( transitionBarrier.StateAfter != subresourceState.second )
+                    if ( transitionBarrier.StateAfter != state )
                     {
                         D3D12_RESOURCE_BARRIER newBarrier = barrier;
-                        newBarrier.Transition.Subresource = subresourceState.first;
-                        newBarrier.Transition.StateBefore = subresourceState.second;
+                        newBarrier.Transition.Subresource = subresource;
+                        newBarrier.Transition.StateBefore = state;
                         m_ResourceBarriers.push_back( newBarrier );
                     }
-                }
+                } );
             }
             else
             {
@@ -108,14 +106,13 @@ void ResourceStateTracker::FlushResourceBarriers(CommandList& commandList)
     {
         auto d3d12CommandList = commandList.GetGraphicsCommandList();
         d3d12CommandList->ResourceBarrier(numBarriers, m_ResourceBarriers.data());
+        commandList.GetRecorder().Record(RecordedCommandType::ResourceBarrier, numBarriers);
         m_ResourceBarriers.clear();
     }
 }
 
-uint32_t ResourceStateTracker::FlushPendingResourceBarriers(CommandList& commandList)
+std::vector<D3D12_RESOURCE_BARRIER> ResourceStateTracker::ResolvePendingResourceBarriers()
 {
-    assert(ms_IsLocked);
-
     // Resolve the pending resource barriers by checking the global state of the 
     // (sub)resources. Add barriers if the pending state and the global state do
     //  not match.
@@ -128,9 +125,10 @@ uint32_t ResourceStateTracker::FlushPendingResourceBarriers(CommandList& command
         if (pendingBarrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)  // Only transition barriers should be pending...
         {
             auto pendingTransition = pendingBarrier.Transition;
-            
-            const auto& iter = ms_GlobalResourceState.find(pendingTransition.pResource);
-            if (iter != ms_GlobalResourceState.end())
+
+            auto& shard = GetGlobalResourceStateShard(pendingTransition.pResource);
+            const auto& iter = shard.ResourceStates.find(pendingTransition.pResource);
+            if (iter != shard.ResourceStates.end())
             {
                 auto globalState = (iter->second).GetSubresourceState(pendingTransition.Subresource);
                 if (pendingTransition.StateAfter != globalState)
@@ -143,31 +141,77 @@ uint32_t ResourceStateTracker::FlushPendingResourceBarriers(CommandList& command
         }
     }
 
+    m_PendingResourceBarriers.clear();
+
+    return resourceBarriers;
+}
+
+uint32_t ResourceStateTracker::FlushPendingResourceBarriers(CommandList& commandList)
+{
+    ResourceBarriers resourceBarriers = ResolvePendingResourceBarriers();
+
     UINT numBarriers = static_cast<UINT>(resourceBarriers.size());
     if (numBarriers > 0 )
     {
         auto d3d12CommandList = commandList.GetGraphicsCommandList();
         d3d12CommandList->ResourceBarrier(numBarriers, resourceBarriers.data());
+        commandList.GetRecorder().Record(RecordedCommandType::ResourceBarrier, numBarriers);
     }
 
-    m_PendingResourceBarriers.clear();
-
     return numBarriers;
 }
 
 void ResourceStateTracker::CommitFinalResourceStates()
 {
-    assert(ms_IsLocked);
-
     // Commit final resource states to the global resource state array (map).
     for (const auto& resourceState : m_FinalResourceState)
     {
-        ms_GlobalResourceState[resourceState.first] = resourceState.second;
+        auto& shard = GetGlobalResourceStateShard(resourceState.first);
+        shard.ResourceStates[resourceState.first] = resourceState.second;
     }
 
     m_FinalResourceState.clear();
 }
 
+uint32_t ResourceStateTracker::GetGlobalStateShards() const
+{
+    uint32_t shards = 0;
+    for (const auto& pendingBarrier : m_PendingResourceBarriers)
+    {
+        if (pendingBarrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+        {
+            shards |= 1u << GetGlobalResourceStateShardIndex(pendingBarrier.Transition.pResource);
+        }
+    }
+    for (const auto& resourceState : m_FinalResourceState)
+    {
+        shards |= 1u << GetGlobalResourceStateShardIndex(resourceState.first);
+    }
+    return shards;
+}
+
+void ResourceStateTracker::LockGlobalState(uint32_t shards)
+{
+    for (size_t i = 0; i < NumGlobalResourceStateShards; ++i)
+    {
+        if (shards & (1u << i))
+        {
+            ms_GlobalResourceState[i].Mutex.lock();
+        }
+    }
+}
+
+void ResourceStateTracker::UnlockGlobalState(uint32_t shards)
+{
+    for (size_t i = 0; i < NumGlobalResourceStateShards; ++i)
+    {
+        if (shards & (1u << i))
+        {
+            ms_GlobalResourceState[i].Mutex.unlock();
+        }
+    }
+}
+
 void ResourceStateTracker::Reset()
 {
     // Reset the pending, current, and final resource states.
@@ -176,28 +220,26 @@ void ResourceStateTracker::Reset()
     m_FinalResourceState.clear();
 }
 
-void ResourceStateTracker::Lock()
+size_t ResourceStateTracker::GetGlobalResourceStateShardIndex(ID3D12Resource* resource)
 {
-    assert(!ms_IsLocked);
-
-    ms_GlobalMutex.lock();
-    ms_IsLocked = true;
+    // Resources are heap allocated, so the low bits of the address carry no information.
+    size_t hash = reinterpret_cast<size_t>(resource) >> 6;
+    hash ^= hash >> 7;
+    return hash % NumGlobalResourceStateShards;
 }
 
-void ResourceStateTracker::Unlock()
+ResourceStateTracker::GlobalResourceStateShard& ResourceStateTracker::GetGlobalResourceStateShard(ID3D12Resource* resource)
 {
-    assert(ms_IsLocked);
-
-    ms_IsLocked = false;
-    ms_GlobalMutex.unlock();
+    return ms_GlobalResourceState[GetGlobalResourceStateShardIndex(resource)];
 }
 
 void ResourceStateTracker::AddGlobalResourceState(ID3D12Resource* resource, D3D12_RESOURCE_STATES state)
 {
     if ( resource != nullptr )
     {
-        std::lock_guard<std::mutex> lock(ms_GlobalMutex);
-        ms_GlobalResourceState[resource].SetSubresourceState(D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, state);
+        auto& shard = GetGlobalResourceStateShard(resource);
+        std::lock_guard<std::mutex> lock(shard.Mutex);
+        shard.ResourceStates[resource].SetSubresourceState(D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, state);
     }
 }
 
@@ -205,7 +247,8 @@ void ResourceStateTracker::RemoveGlobalResourceState(ID3D12Resource* resource)
 {
     if ( resource != nullptr )
     {
-        std::lock_guard<std::mutex> lock(ms_GlobalMutex);
-        ms_GlobalResourceState.erase(resource);
+        auto& shard = GetGlobalResourceStateShard(resource);
+        std::lock_guard<std::mutex> lock(shard.Mutex);
+        shard.ResourceStates.erase(resource);
     }
 }
@@ -0,0 +1,330 @@
+#include <DX12LibPCH.h>
+
+#include <TextureArrayBaker.h>
+
+#include <DirectXTex/MipChainGenerator.h>
+#include <WorkerPool.h>
+
+#include <cstring>
+#include <cwctype>
+#include <fstream>
+
+namespace
+{
+    const uint32_t IndexFileVersion = 3;
+
+    // Block textures tile and are sRGB encoded, leaves and plants are alpha tested.
+    const unsigned int MipFilterFlags = DirectX::MIP_FILTER_BOX | DirectX::MIP_FILTER_SRGB |
+        DirectX::MIP_FILTER_WRAP | DirectX::MIP_FILTER_ALPHA_COVERAGE;
+
+    // The parts of the DDS file format that are needed to write a Texture2DArray.
+    const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+    const uint32_t DDS_FOURCC = 0x00000004;
+    const uint32_t DDS_HEADER_FLAGS_TEXTURE = 0x00001007; // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT
+    const uint32_t DDS_HEADER_FLAGS_MIPMAP = 0x00020000;  // DDSD_MIPMAPCOUNT
+    const uint32_t DDS_HEADER_FLAGS_PITCH = 0x00000008;   // DDSD_PITCH
+    const uint32_t DDS_SURFACE_FLAGS_TEXTURE = 0x00001000; // DDSCAPS_TEXTURE
+    const uint32_t DDS_SURFACE_FLAGS_MIPMAP = 0x00400008;  // DDSCAPS_COMPLEX | DDSCAPS_MIPMAP
+
+#pragma pack(push,1)
+    struct DDS_PIXELFORMAT
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t RGBBitCount;
+        uint32_t RBitMask;
+        uint32_t GBitMask;
+        uint32_t BBitMask;
+        uint32_t ABitMask;
+    };
+
+    struct DDS_HEADER
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DDS_PIXELFORMAT ddspf;
+        uint32_t caps;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+
+    struct DDS_HEADER_DXT10
+    {
+        DXGI_FORMAT dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+#pragma pack(pop)
+
+    bool IsPNGFile(const fs::path& path)
+    {
+        std::wstring extension = path.extension().wstring();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::towlower);
+        return extension == L".png";
+    }
+
+    // 64-bit FNV-1a.
+    const uint64_t FNVOffsetBasis = 14695981039346656037ull;
+    const uint64_t FNVPrime = 1099511628211ull;
+
+    uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * FNVPrime;
+        }
+        return hash;
+    }
+
+    uint64_t HashString(uint64_t hash, const std::wstring& string)
+    {
+        // Include the terminator so "ab" + "c" and "a" + "bc" hash differently.
+        return HashBytes(hash, string.c_str(), (string.size() + 1) * sizeof(wchar_t));
+    }
+}
+
+TextureArrayBaker::TextureArrayBaker(const std::wstring& sourceDirectory, const std::wstring& outputDirectory, uint32_t layerSize)
+    : m_SourceDirectory(sourceDirectory)
+    , m_OutputDirectory(outputDirectory)
+    , m_LayerSize(layerSize)
+    , m_MipLevels(DirectX::CountMipLevels(layerSize, layerSize))
+    , m_LayerBytes(DirectX::ComputeMipChainSize(layerSize, layerSize, m_MipLevels))
+    , m_DecodeStatistics()
+{
+    if (m_LayerSize == 0 || (m_LayerSize & (m_LayerSize - 1)) != 0)
+    {
+        throw std::invalid_argument("The layer size of a texture array must be a power of two.");
+    }
+
+    while (!m_SourceDirectory.empty() && (m_SourceDirectory.back() == L'/' || m_SourceDirectory.back() == L'\\'))
+    {
+        m_SourceDirectory.pop_back();
+    }
+
+    fs::path bakedPath = fs::path(m_OutputDirectory) / fs::path(m_SourceDirectory).filename();
+    m_TextureFileName = bakedPath.wstring() + L".dds";
+    m_IndexFileName = bakedPath.wstring() + L".index";
+}
+
+TextureArrayBaker::~TextureArrayBaker()
+{}
+
+std::vector<TextureArrayBaker::SourceImage> TextureArrayBaker::ScanSourceDirectory(SourceSignature& signature) const
+{
+    std::vector<SourceImage> images;
+    signature = SourceSignature();
+
+    for (auto& entry : fs::directory_iterator(m_SourceDirectory))
+    {
+        if (!fs::is_regular_file(entry.status()) || !IsPNGFile(entry.path()))
+        {
+            continue;
+        }
+
+        uint64_t fileSize = static_cast<uint64_t>(fs::file_size(entry.path()));
+        uint64_t writeTime = static_cast<uint64_t>(fs::last_write_time(entry.path()).time_since_epoch().count());
+
+        images.push_back({ entry.path().stem().wstring(), entry.path().wstring(), fileSize, writeTime });
+    }
+
+    // Directory order is not specified, sort so the layers and the signature are stable between bakes.
+    std::sort(images.begin(), images.end(), [](const SourceImage& a, const SourceImage& b)
+    {
+        return a.Name < b.Name;
+    });
+
+    // Any added, removed, renamed or rewritten image changes the hash, also
+    // when it doesn't change the number of images or the newest write time.
+    signature.NumImages = static_cast<uint32_t>(images.size());
+    signature.Hash = FNVOffsetBasis;
+    for (auto& image : images)
+    {
+        signature.Hash = HashString(signature.Hash, image.Name);
+        signature.Hash = HashBytes(signature.Hash, &image.FileSize, sizeof(image.FileSize));
+        signature.Hash = HashBytes(signature.Hash, &image.WriteTime, sizeof(image.WriteTime));
+    }
+
+    return images;
+}
+
+bool TextureArrayBaker::IsBakeCurrent() const
+{
+    if (!fs::exists(m_TextureFileName) || !fs::exists(m_IndexFileName))
+    {
+        return false;
+    }
+
+    std::wifstream index(m_IndexFileName);
+    uint32_t version = 0, layerSize = 0, numImages = 0;
+    uint64_t hash = 0;
+    if (!(index >> version >> layerSize >> numImages >> hash) ||
+        version != IndexFileVersion || layerSize != m_LayerSize)
+    {
+        return false;
+    }
+
+    SourceSignature signature;
+    ScanSourceDirectory(signature);
+
+    return signature.NumImages == numImages && signature.Hash == hash;
+}
+
+uint32_t TextureArrayBaker::Bake(uint32_t numWorkers)
+{
+    SourceSignature signature;
+    auto images = ScanSourceDirectory(signature);
+
+    std::vector<std::wstring> fileNames;
+    fileNames.reserve(images.size());
+    for (auto& image : images)
+    {
+        fileNames.push_back(image.FileName);
+    }
+
+    ImageBatchDecoder decoder(numWorkers);
+    std::vector<DecodedImage> decodedImages;
+    m_DecodeStatistics = decoder.DecodeFiles(fileNames, decodedImages);
+
+    // Pack the images that can be used in name order.
+    std::vector<uint8_t> layers(images.size() * m_LayerBytes);
+    std::vector<std::wstring> names;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        auto& decoded = decodedImages[i];
+
+        // Animated textures are a vertical strip of frames, only the first frame is used.
+        if (!decoded.Pixels || decoded.Width != m_LayerSize || decoded.Height < m_LayerSize || decoded.Height % m_LayerSize != 0)
+        {
+            continue;
+        }
+
+        std::memcpy(layers.data() + names.size() * m_LayerBytes, decoded.Pixels.get(), decoded.RowPitch * m_LayerSize);
+        decoded.Pixels.reset();
+
+        names.push_back(images[i].Name);
+    }
+
+    if (names.empty())
+    {
+        throw std::runtime_error("No textures were found to bake into a texture array.");
+    }
+
+    uint32_t numLayers = static_cast<uint32_t>(names.size());
+
+    std::vector<DirectX::MipChainImage> mipChains;
+    for (uint32_t layer = 0; layer < numLayers; ++layer)
+    {
+        mipChains.push_back({ layers.data() + layer * m_LayerBytes, m_LayerSize, m_LayerSize, m_MipLevels });
+    }
+    // The calling thread is one of the workers, a single worker needs no pool.
+    std::unique_ptr<WorkerPool> pool;
+    if (numWorkers != 1)
+    {
+        pool = std::make_unique<WorkerPool>(numWorkers > 1 ? numWorkers - 1 : 0);
+    }
+    ThrowIfFailed(DirectX::GenerateMipChains(mipChains.data(), mipChains.size(), MipFilterFlags, 0.5f, pool.get()));
+
+    if (!m_OutputDirectory.empty())
+    {
+        fs::create_directories(m_OutputDirectory);
+    }
+
+    // Remove the index first so an interrupted bake is never mistaken for a current one.
+    std::error_code ec;
+    fs::remove(m_IndexFileName, ec);
+
+    WriteTextureFile(layers, numLayers);
+    WriteIndexFile(names, signature);
+
+    return numLayers;
+}
+
+void TextureArrayBaker::WriteTextureFile(const std::vector<uint8_t>& layers, uint32_t numLayers) const
+{
+    DDS_HEADER header = {};
+    header.size = sizeof(DDS_HEADER);
+    header.flags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_MIPMAP | DDS_HEADER_FLAGS_PITCH;
+    header.height = m_LayerSize;
+    header.width = m_LayerSize;
+    header.pitchOrLinearSize = m_LayerSize * 4;
+    header.mipMapCount = m_MipLevels;
+    header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+    header.ddspf.flags = DDS_FOURCC;
+    header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+    header.caps = DDS_SURFACE_FLAGS_TEXTURE | DDS_SURFACE_FLAGS_MIPMAP;
+
+    DDS_HEADER_DXT10 headerDXT10 = {};
+    headerDXT10.dxgiFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+    headerDXT10.resourceDimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    headerDXT10.arraySize = numLayers;
+
+    std::ofstream file(m_TextureFileName, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&DDS_MAGIC), sizeof(DDS_MAGIC));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(&headerDXT10), sizeof(headerDXT10));
+    // Layers are stored with all of their mip levels, in the order DDS expects.
+    file.write(reinterpret_cast<const char*>(layers.data()), static_cast<std::streamsize>(numLayers * m_LayerBytes));
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write the baked texture array.");
+    }
+}
+
+void TextureArrayBaker::WriteIndexFile(const std::vector<std::wstring>& names, const SourceSignature& signature) const
+{
+    std::wofstream file(m_IndexFileName, std::ios::trunc);
+    file << IndexFileVersion << L" " << m_LayerSize << L" " << signature.NumImages << L" " << signature.Hash << L"\n";
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        file << names[i] << L" " << i << L"\n";
+    }
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write the texture array index.");
+    }
+}
+
+TextureArrayBaker::LayerTable TextureArrayBaker::BakeIfNeeded()
+{
+    if (!IsBakeCurrent())
+    {
+        Bake();
+    }
+
+    return LoadLayerTable(m_IndexFileName);
+}
+
+TextureArrayBaker::LayerTable TextureArrayBaker::LoadLayerTable(const std::wstring& indexFileName)
+{
+    std::wifstream file(indexFileName);
+    uint32_t version = 0, layerSize = 0, numImages = 0;
+    uint64_t hash = 0;
+    if (!(file >> version >> layerSize >> numImages >> hash) || version != IndexFileVersion)
+    {
+        throw std::runtime_error("Invalid texture array index.");
+    }
+
+    LayerTable layers;
+    std::wstring name;
+    uint32_t layer;
+    while (file >> name >> layer)
+    {
+        layers[name] = layer;
+    }
+
+    return layers;
+}
@@ -0,0 +1,524 @@
+#include <DX12LibPCH.h>
+
+#include <TextureStreamer.h>
+
+#include <Application.h>
+#include <CommandList.h>
+#include <CommandQueue.h>
+#include <ImageDecoder.h>
+#include <PngDecoder.h>
+#include <ResourceStateTracker.h>
+
+#include <DirectXTex/MipChainGenerator.h>
+#include <DirectXTex/WICTextureLoader12.h>
+
+using namespace DirectX;
+
+namespace
+{
+    // Enough for a few hundred block textures with their mips per frame.
+    const uint64_t DefaultUploadBudget = 16 * 1024 * 1024;
+}
+
+TextureStreamer::StreamedTexture::StreamedTexture(const std::wstring& fileName)
+    : m_FileName(fileName)
+    , m_State(TextureState::Queued)
+    , m_Texture(fileName)
+    , m_SizeInBytes(0)
+    , m_LastRequestFrame(0)
+    , m_GenerateMips(false)
+{}
+
+TextureStreamer::TextureStreamer(uint32_t numThreads)
+    : m_Exit(false)
+    , m_UploadBudget(DefaultUploadBudget)
+    , m_ResidencyBudget(0)
+    , m_NumRequested(0)
+    , m_NumCacheHits(0)
+    , m_NumDecoded(0)
+    , m_NumFailed(0)
+    , m_NumUploaded(0)
+    , m_NumEvicted(0)
+    , m_NumResident(0)
+    , m_ResidentBytes(0)
+{
+    if (numThreads == 0)
+    {
+        uint32_t numHardwareThreads = std::thread::hardware_concurrency();
+        numThreads = numHardwareThreads > 1 ? numHardwareThreads - 1 : 1;
+    }
+
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        m_Threads.emplace_back(&TextureStreamer::ProcessRequests, this);
+    }
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Exit = true;
+    }
+    m_DecodeCondition.notify_all();
+
+    for (auto& thread : m_Threads)
+    {
+        thread.join();
+    }
+
+    // The command lists of the batches keep the resources alive until they
+    // have executed, so the batches don't need to be waited for.
+}
+
+TextureStreamer::Handle TextureStreamer::Request(const std::wstring& fileName)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    ++m_NumRequested;
+
+    auto& texture = m_Textures[fileName];
+    if (texture)
+    {
+        texture->m_LastRequestFrame = Application::GetFrameCount();
+        ++m_NumCacheHits;
+        return texture;
+    }
+
+    texture = std::make_shared<StreamedTexture>(fileName);
+    texture->m_LastRequestFrame = Application::GetFrameCount();
+    m_DecodeQueue.push_back(texture);
+
+    lock.unlock();
+    m_DecodeCondition.notify_one();
+
+    return texture;
+}
+
+void TextureStreamer::ProcessRequests()
+{
+    // WIC needs COM on every thread that decodes (PNG files don't use WIC).
+    HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+    while (true)
+    {
+        TexturePtr texture;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_DecodeCondition.wait(lock, [this] { return m_Exit || !m_DecodeQueue.empty(); });
+
+            if (m_Exit)
+            {
+                break;
+            }
+
+            texture = std::move(m_DecodeQueue.front());
+            m_DecodeQueue.pop_front();
+        }
+
+        texture->m_State.store(TextureState::Decoding, std::memory_order_release);
+
+        bool decoded = false;
+        try
+        {
+            LoadTextureFile(texture->m_FileName, texture->m_FileData);
+
+            auto device = Application::Get().GetDevice();
+            auto desc = texture->m_FileData.Resource->GetDesc();
+            texture->m_SizeInBytes = device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+
+            decoded = true;
+        }
+        catch (const std::exception&)
+        {
+            texture->m_FileData = TextureFileData();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (decoded)
+            {
+                ++m_NumDecoded;
+                texture->m_State.store(TextureState::Decoded, std::memory_order_release);
+                m_UploadQueue.push_back(std::move(texture));
+            }
+            else
+            {
+                ++m_NumFailed;
+                texture->m_State.store(TextureState::Failed, std::memory_order_release);
+            }
+        }
+        m_DecodedCondition.notify_all();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        CoUninitialize();
+    }
+}
+
+size_t TextureStreamer::Update()
+{
+    size_t numResident = RetireBatches(false);
+
+    RecordUploads();
+
+    uint64_t residencyBudget = m_ResidencyBudget;
+    if (residencyBudget > 0)
+    {
+        Evict(residencyBudget);
+    }
+
+    return numResident;
+}
+
+size_t TextureStreamer::RetireBatches(bool wait)
+{
+    auto copyQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY);
+    auto computeQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE);
+
+    size_t numResident = 0;
+    while (!m_Batches.empty())
+    {
+        auto& batch = m_Batches.front();
+        if (wait)
+        {
+            copyQueue->WaitForFenceValue(batch.CopyFenceValue);
+            if (batch.ComputeFenceValue != 0)
+            {
+                computeQueue->WaitForFenceValue(batch.ComputeFenceValue);
+            }
+        }
+        else if (!copyQueue->IsFenceComplete(batch.CopyFenceValue) ||
+            (batch.ComputeFenceValue != 0 && !computeQueue->IsFenceComplete(batch.ComputeFenceValue)))
+        {
+            // Batches complete in order.
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (auto& texture : batch.Textures)
+        {
+            if (!texture->m_GenerateMips)
+            {
+                // Textures that were only accessed on the copy queue decay to the common state
+                // when the copy has finished.
+                ResourceStateTracker::AddGlobalResourceState(texture->m_Texture.GetD3D12Resource().Get(), D3D12_RESOURCE_STATE_COMMON);
+            }
+
+            texture->m_State.store(TextureState::Resident, std::memory_order_release);
+
+            ++m_NumResident;
+            m_ResidentBytes += texture->m_SizeInBytes;
+            ++numResident;
+        }
+
+        m_Batches.pop_front();
+    }
+
+    return numResident;
+}
+
+void TextureStreamer::RecordUploads()
+{
+    std::vector<TexturePtr> textures;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_UploadQueue.empty())
+        {
+            return;
+        }
+
+        // Take the oldest decoded textures that fit into the budget (and at least one).
+        uint64_t uploadBudget = m_UploadBudget;
+        uint64_t uploadSize = 0;
+        size_t numTextures = 0;
+        for (auto& texture : m_UploadQueue)
+        {
+            auto d3d12Resource = texture->m_FileData.Resource.Get();
+            UINT64 requiredSize = GetRequiredIntermediateSize(d3d12Resource, 0,
+                static_cast<UINT>(texture->m_FileData.Subresources.size()));
+
+            if (numTextures > 0 && uploadSize + requiredSize > uploadBudget)
+            {
+                break;
+            }
+            uploadSize += requiredSize;
+            ++numTextures;
+        }
+
+        textures.assign(std::make_move_iterator(m_UploadQueue.begin()), std::make_move_iterator(m_UploadQueue.begin() + numTextures));
+        m_UploadQueue.erase(m_UploadQueue.begin(), m_UploadQueue.begin() + numTextures);
+    }
+
+    auto copyQueue = Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY);
+    auto commandList = copyQueue->GetCommandList();
+
+    bool generateMips = false;
+    for (auto& texture : textures)
+    {
+        auto& fileData = texture->m_FileData;
+
+        ResourceStateTracker::AddGlobalResourceState(fileData.Resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+
+        texture->m_Texture.SetD3D12Resource(fileData.Resource);
+        texture->m_Texture.CreateViews();
+
+        // The subresources are copied into the upload buffer while the copy is recorded,
+        // so the decoded data is released right away.
+        commandList->CopyTextureSubresource(texture->m_Texture, 0, static_cast<uint32_t>(fileData.Subresources.size()), fileData.Subresources.data());
+
+        if (fileData.Subresources.size() < fileData.Resource->GetDesc().MipLevels)
+        {
+            // Recorded on the compute queue, which waits for the copy queue.
+            commandList->GenerateMips(texture->m_Texture);
+            texture->m_GenerateMips = true;
+            generateMips = true;
+        }
+
+        fileData = TextureFileData();
+
+        texture->m_State.store(TextureState::Uploading, std::memory_order_release);
+    }
+
+    UploadBatch batch;
+    batch.CopyFenceValue = copyQueue->ExecuteCommandList(commandList);
+    batch.ComputeFenceValue = generateMips ? Application::Get().GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE)->Signal() : 0;
+    batch.Textures = std::move(textures);
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_NumUploaded += batch.Textures.size();
+    }
+
+    m_Batches.push_back(std::move(batch));
+}
+
+size_t TextureStreamer::EvictUnused()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    size_t numEvicted = 0;
+    for (auto iter = m_Textures.begin(); iter != m_Textures.end(); )
+    {
+        auto& texture = iter->second;
+        auto state = texture->GetState();
+
+        // Handles are only created from the cache while the mutex is held, so a
+        // texture that is only referenced by the cache can't gain a reference here.
+        if ((state == TextureState::Resident || state == TextureState::Failed) && texture.use_count() == 1)
+        {
+            if (state == TextureState::Resident)
+            {
+                ResourceStateTracker::RemoveGlobalResourceState(texture->m_Texture.GetD3D12Resource().Get());
+                --m_NumResident;
+                m_ResidentBytes -= texture->m_SizeInBytes;
+            }
+            iter = m_Textures.erase(iter);
+            ++m_NumEvicted;
+            ++numEvicted;
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+
+    return numEvicted;
+}
+
+void TextureStreamer::Evict(uint64_t residencyBudget)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (m_ResidentBytes <= residencyBudget)
+    {
+        return;
+    }
+
+    std::vector<TexturePtr> candidates;
+    for (auto& entry : m_Textures)
+    {
+        auto& texture = entry.second;
+        if (texture->GetState() == TextureState::Resident && texture.use_count() == 1)
+        {
+            candidates.push_back(texture);
+        }
+    }
+
+    // Least recently requested first.
+    std::sort(candidates.begin(), candidates.end(), [](const TexturePtr& a, const TexturePtr& b)
+    {
+        return a->m_LastRequestFrame < b->m_LastRequestFrame;
+    });
+
+    for (auto& texture : candidates)
+    {
+        if (m_ResidentBytes <= residencyBudget)
+        {
+            break;
+        }
+
+        ResourceStateTracker::RemoveGlobalResourceState(texture->m_Texture.GetD3D12Resource().Get());
+        --m_NumResident;
+        m_ResidentBytes -= texture->m_SizeInBytes;
+        ++m_NumEvicted;
+
+        m_Textures.erase(texture->m_FileName);
+    }
+}
+
+void TextureStreamer::Flush()
+{
+    while (true)
+    {
+        RecordUploads();
+        RetireBatches(true);
+
+        // Textures that are still queued or decoding, the others have been
+        // uploaded and retired, or are waiting in the upload queue.
+        auto isDecoding = [this]()
+        {
+            for (auto& entry : m_Textures)
+            {
+                auto state = entry.second->GetState();
+                if (state == TextureState::Queued || state == TextureState::Decoding)
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        if (m_UploadQueue.empty() && !isDecoding())
+        {
+            return;
+        }
+
+        // Sleep until the decode threads have a texture to upload.
+        m_DecodedCondition.wait(lock, [this, &isDecoding]
+        {
+            return !m_UploadQueue.empty() || !isDecoding();
+        });
+    }
+}
+
+TextureStreamer::Statistics TextureStreamer::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    Statistics statistics;
+    statistics.NumRequested = m_NumRequested;
+    statistics.NumCacheHits = m_NumCacheHits;
+    statistics.NumDecoded = m_NumDecoded;
+    statistics.NumFailed = m_NumFailed;
+    statistics.NumUploaded = m_NumUploaded;
+    statistics.NumEvicted = m_NumEvicted;
+    statistics.NumResident = m_NumResident;
+    statistics.ResidentBytes = m_ResidentBytes;
+    statistics.NumPending = 0;
+    for (auto& entry : m_Textures)
+    {
+        auto state = entry.second->GetState();
+        if (state != TextureState::Resident && state != TextureState::Failed)
+        {
+            ++statistics.NumPending;
+        }
+    }
+
+    return statistics;
+}
+
+void TextureStreamer::LoadTextureFile(const std::wstring& fileName, TextureFileData& fileData, bool generateMips)
+{
+    auto device = Application::Get().GetDevice();
+
+    fs::path filePath(fileName);
+    if (!fs::exists(filePath))
+    {
+        throw std::invalid_argument("Invalid filename specified.");
+    }
+
+    if (filePath.extension() == ".dds")
+    {
+        // Use DDS texture loader. The file is mapped and its subresources are
+        // copied from the mapping to the upload heap without an extra copy.
+        ThrowIfFailed(LoadDDSTextureFromFileEx(device.Get(),
+            fileName.c_str(), 0, D3D12_RESOURCE_FLAG_NONE,
+            generateMips ? DDS_LOADER_MIP_RESERVE : DDS_LOADER_DEFAULT, &fileData.Resource, fileData.DDSFile,
+            fileData.Subresources
+        ));
+        return;
+    }
+
+    D3D12_SUBRESOURCE_DATA resourceData;
+    if (filePath.extension() == ".png")
+    {
+        // Use the portable PNG decoder, which can run on any number of threads without COM.
+        std::vector<uint8_t> fileContents;
+        DecodedImage image;
+        if (!ImageBatchDecoder::ReadFile(fileName, fileContents) ||
+            !PngDecoder().Decode(fileContents.data(), fileContents.size(), image))
+        {
+            throw std::runtime_error("Failed to decode PNG file.");
+        }
+
+        DXGI_FORMAT format = image.IsSRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+        UINT16 mipLevels = generateMips ? static_cast<UINT16>(CountMipLevels(image.Width, image.Height)) : 1;
+
+        ThrowIfFailed(device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Tex2D(format, image.Width, image.Height, 1, mipLevels),
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr,
+            IID_PPV_ARGS(&fileData.Resource)));
+
+        resourceData.pData = image.Pixels.get();
+        resourceData.RowPitch = static_cast<LONG_PTR>(image.RowPitch);
+        resourceData.SlicePitch = static_cast<LONG_PTR>(image.SlicePitch);
+        fileData.Data = std::move(image.Pixels);
+    }
+    else
+    {
+        // Use WIC texture loader.
+        ThrowIfFailed(LoadWICTextureFromFileEx(device.Get(),
+            fileName.c_str(), 0, D3D12_RESOURCE_FLAG_NONE,
+            generateMips ? WIC_LOADER_MIP_RESERVE : WIC_LOADER_DEFAULT, &fileData.Resource, fileData.Data,
+            resourceData
+        ));
+    }
+
+    fileData.Subresources.assign(1, resourceData);
+
+    // 8-bit RGBA images get their mips on the CPU, without a compute pass on the GPU.
+    auto desc = fileData.Resource->GetDesc();
+    bool srgb = desc.Format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    if (desc.MipLevels > 1 && (desc.Format == DXGI_FORMAT_R8G8B8A8_UNORM || srgb) &&
+        resourceData.RowPitch == static_cast<LONG_PTR>(desc.Width * 4))
+    {
+        uint32_t width = static_cast<uint32_t>(desc.Width);
+        uint32_t height = desc.Height;
+
+        std::unique_ptr<uint8_t[]> mipData(new uint8_t[ComputeMipChainSize(width, height, desc.MipLevels)]);
+        memcpy(mipData.get(), resourceData.pData, resourceData.SlicePitch);
+        ThrowIfFailed(GenerateMipChain({ mipData.get(), width, height, desc.MipLevels }, srgb ? MIP_FILTER_SRGB : MIP_FILTER_BOX));
+
+        fileData.Subresources.clear();
+        const uint8_t* level = mipData.get();
+        for (uint16_t mip = 0; mip < desc.MipLevels; ++mip)
+        {
+            D3D12_SUBRESOURCE_DATA mipResource;
+            mipResource.pData = level;
+            mipResource.RowPitch = width * 4;
+            mipResource.SlicePitch = mipResource.RowPitch * height;
+            fileData.Subresources.push_back(mipResource);
+
+            level += mipResource.SlicePitch;
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+        fileData.Data = std::move(mipData);
+    }
+}
@@ -4,70 +4,113 @@
 
 #include <Application.h>
 #include <Helpers.h>
+#include <UploadRingBuffer.h>
 
 #include <d3dx12.h>
 
-#include <new> // for std::bad_alloc
-
-UploadBuffer::UploadBuffer(size_t pageSize)
-    : m_PageSize(pageSize)
+UploadBuffer::UploadBuffer(UploadRingBuffer& ringBuffer, size_t blockSize)
+    : m_RingBuffer(ringBuffer)
+    , m_BlockSize(blockSize)
+    , m_CPUPtr(nullptr)
+    , m_GPUPtr(D3D12_GPU_VIRTUAL_ADDRESS(0))
+    , m_d3d12Resource(nullptr)
+    , m_ResourceOffset(0)
+    , m_Size(0)
+    , m_Offset(0)
 {}
 
 UploadBuffer::~UploadBuffer()
-{}
+{
+    // Blocks of a command list that was never executed are not used by the GPU.
+    Retire(0);
+}
 
 UploadBuffer::Allocation UploadBuffer::Allocate(size_t sizeInBytes, size_t alignment)
 {
-    if (sizeInBytes > m_PageSize)
-    {
-        throw std::bad_alloc();
-    }
+    size_t alignedSize = Math::AlignUp(sizeInBytes, alignment);
+    // Blocks of the ring buffer are only 256 byte aligned, so the address
+    // is aligned instead of the offset in the block (textures need 512).
+    size_t alignedOffset = m_CPUPtr ? static_cast<size_t>(Math::AlignUp(m_GPUPtr + m_Offset, alignment) - m_GPUPtr) : 0;
 
-    // If there is no current page, or the requested allocation exceeds the
-    // remaining space in the current page, request a new page.
-    if (!m_CurrentPage || !m_CurrentPage->HasSpace(sizeInBytes, alignment))
+    // If the requested allocation exceeds the remaining space in the
+    // current block, request a new block.
+    if (!m_CPUPtr || alignedOffset + alignedSize > m_Size)
     {
-        m_CurrentPage = RequestPage();
+        size_t padding = alignment > D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT ? alignment : 0;
+        RequestBlock(alignedSize + padding);
+        alignedOffset = static_cast<size_t>(Math::AlignUp(m_GPUPtr, alignment) - m_GPUPtr);
     }
 
-    return m_CurrentPage->Allocate(sizeInBytes, alignment);
-}
+    Allocation allocation;
+    allocation.CPU = m_CPUPtr + alignedOffset;
+    allocation.GPU = m_GPUPtr + alignedOffset;
+    allocation.Resource = m_d3d12Resource;
+    allocation.Offset = m_ResourceOffset + alignedOffset;
 
-void UploadBuffer::Reset()
-{
-    m_CurrentPage = nullptr;
-    // Reset all available pages.
-    m_AvailablePages = m_PagePool;
+    m_Offset = alignedOffset + alignedSize;
 
-    for (auto page : m_AvailablePages)
-    {
-        // Reset the page for new allocations.
-        page->Reset();
-    }
+    return allocation;
 }
 
-std::shared_ptr<UploadBuffer::Page> UploadBuffer::RequestPage()
+void UploadBuffer::RequestBlock(size_t sizeInBytes)
 {
-    std::shared_ptr<Page> page;
+    size_t blockSize = std::max(sizeInBytes, m_BlockSize);
 
-    if (!m_AvailablePages.empty())
+    // Large requests would starve the other command lists sharing the ring.
+    UploadRingBuffer::Block block;
+    if (blockSize <= m_RingBuffer.GetSize() / 4 && m_RingBuffer.AllocateBlock(blockSize, block))
     {
-        page = m_AvailablePages.front();
-        m_AvailablePages.pop_front();
+        m_Blocks.push_back(block.Id);
+
+        m_CPUPtr = static_cast<uint8_t*>(block.CPU);
+        m_GPUPtr = block.GPU;
+        m_d3d12Resource = block.Resource;
+        m_ResourceOffset = block.Offset;
+        m_Size = block.Size;
     }
     else
     {
-        page = std::make_shared<Page>(m_PageSize);
-        m_PagePool.push_back(page);
+        auto page = std::make_unique<Page>(blockSize);
+
+        m_CPUPtr = static_cast<uint8_t*>(page->m_CPUPtr);
+        m_GPUPtr = page->m_GPUPtr;
+        m_d3d12Resource = page->m_d3d12Resource.Get();
+        m_ResourceOffset = 0;
+        m_Size = blockSize;
+
+        m_Pages.push_back(std::move(page));
     }
 
-    return page;
+    m_Offset = 0;
+}
+
+void UploadBuffer::Retire(uint64_t fenceValue)
+{
+    for (auto blockId : m_Blocks)
+    {
+        m_RingBuffer.Retire(blockId, fenceValue);
+    }
+    m_Blocks.clear();
+
+    // Nothing can be allocated from the retired blocks anymore.
+    m_CPUPtr = nullptr;
+    m_GPUPtr = D3D12_GPU_VIRTUAL_ADDRESS(0);
+    m_d3d12Resource = nullptr;
+    m_ResourceOffset = 0;
+    m_Size = 0;
+    m_Offset = 0;
+}
+
+void UploadBuffer::Reset()
+{
+    // Any block that was not retired was never submitted.
+    Retire(0);
+
+    m_Pages.clear();
 }
 
 UploadBuffer::Page::Page(size_t sizeInBytes)
-    : m_PageSize(sizeInBytes)
-    , m_Offset(0)
-    , m_CPUPtr(nullptr)
+    : m_CPUPtr(nullptr)
     , m_GPUPtr(D3D12_GPU_VIRTUAL_ADDRESS(0))
 {
     auto device = Application::Get().GetDevice();
@@ -75,7 +118,7 @@ UploadBuffer::Page::Page(size_t sizeInBytes)
     ThrowIfFailed(device->CreateCommittedResource(
         &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
         D3D12_HEAP_FLAG_NONE,
-        &CD3DX12_RESOURCE_DESC::Buffer(m_PageSize),
+        &CD3DX12_RESOURCE_DESC::Buffer(sizeInBytes),
         D3D12_RESOURCE_STATE_GENERIC_READ,
         nullptr,
         IID_PPV_ARGS(&m_d3d12Resource)
@@ -91,36 +134,3 @@ UploadBuffer::Page::~Page()
     m_CPUPtr = nullptr;
     m_GPUPtr = D3D12_GPU_VIRTUAL_ADDRESS(0);
 }
-
-bool UploadBuffer::Page::HasSpace(size_t sizeInBytes, size_t alignment ) const
-{
-    size_t alignedSize = Math::AlignUp(sizeInBytes, alignment);
-    size_t alignedOffset = Math::AlignUp(m_Offset, alignment);
-
-    return alignedOffset + alignedSize <= m_PageSize;
-}
-
-UploadBuffer::Allocation UploadBuffer::Page::Allocate(size_t sizeInBytes, size_t alignment)
-{
-    if (!HasSpace(sizeInBytes, alignment))
-    {
-        // Can't allocate space from page.
-        throw std::bad_alloc();
-    }
-
-    size_t alignedSize = Math::AlignUp(sizeInBytes, alignment);
-    m_Offset = Math::AlignUp(m_Offset, alignment);
-
-    Allocation allocation;
-    allocation.CPU = static_cast<uint8_t*>(m_CPUPtr) + m_Offset;
-    allocation.GPU = m_GPUPtr + m_Offset;
-
-    m_Offset += alignedSize;
-
-    return allocation;
-}
-
-void UploadBuffer::Page::Reset()
-{
-    m_Offset = 0;
-}
\ No newline at end of file
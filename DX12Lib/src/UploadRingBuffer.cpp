@@ -0,0 +1,106 @@
+#include <DX12LibPCH.h>
+
+#include <UploadRingBuffer.h>
+
+#include <Application.h>
+#include <CommandQueue.h>
+#include <Helpers.h>
+
+#include <d3dx12.h>
+
+UploadRingBuffer::UploadRingBuffer(CommandQueue& commandQueue, size_t sizeInBytes)
+    : m_CommandQueue(commandQueue)
+    , m_CPUPtr(nullptr)
+    , m_GPUPtr(D3D12_GPU_VIRTUAL_ADDRESS(0))
+    , m_Size(sizeInBytes)
+    , m_Head(0)
+    , m_Tail(0)
+    , m_FirstBlockId(0)
+{
+    auto device = Application::Get().GetDevice();
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(m_Size),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_d3d12Resource)
+    ));
+
+    m_d3d12Resource->SetName(L"Upload Ring Buffer");
+
+    m_GPUPtr = m_d3d12Resource->GetGPUVirtualAddress();
+    ThrowIfFailed(m_d3d12Resource->Map(0, nullptr, reinterpret_cast<void**>(&m_CPUPtr)));
+}
+
+UploadRingBuffer::~UploadRingBuffer()
+{
+    m_d3d12Resource->Unmap(0, nullptr);
+    m_CPUPtr = nullptr;
+    m_GPUPtr = D3D12_GPU_VIRTUAL_ADDRESS(0);
+}
+
+bool UploadRingBuffer::AllocateBlock(size_t sizeInBytes, Block& block)
+{
+    size_t alignedSize = Math::AlignUp(sizeInBytes, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+    if (alignedSize == 0 || alignedSize > m_Size)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    Reclaim();
+
+    // A block never wraps around the end of the ring. If it does not fit
+    // before the end, the remaining space is skipped.
+    uint64_t offset = m_Head % m_Size;
+    uint64_t padding = offset + alignedSize > m_Size ? m_Size - offset : 0;
+
+    if (m_Head + padding + alignedSize - m_Tail > m_Size)
+    {
+        return false;
+    }
+
+    offset = (m_Head + padding) % m_Size;
+    m_Head += padding + alignedSize;
+
+    m_InFlightBlocks.push_back({ m_Head, 0, false });
+
+    block.CPU = m_CPUPtr + offset;
+    block.GPU = m_GPUPtr + offset;
+    block.Resource = m_d3d12Resource.Get();
+    block.Offset = static_cast<size_t>(offset);
+    block.Size = alignedSize;
+    block.Id = m_FirstBlockId + m_InFlightBlocks.size() - 1;
+
+    return true;
+}
+
+void UploadRingBuffer::Retire(uint64_t blockId, uint64_t fenceValue)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    assert(blockId >= m_FirstBlockId && blockId - m_FirstBlockId < m_InFlightBlocks.size());
+
+    auto& block = m_InFlightBlocks[static_cast<size_t>(blockId - m_FirstBlockId)];
+    block.FenceValue = fenceValue;
+    block.Retired = true;
+}
+
+void UploadRingBuffer::Reclaim()
+{
+    while (!m_InFlightBlocks.empty())
+    {
+        const auto& block = m_InFlightBlocks.front();
+        if (!block.Retired || !m_CommandQueue.IsFenceComplete(block.FenceValue))
+        {
+            break;
+        }
+
+        m_Tail = block.End;
+        m_InFlightBlocks.pop_front();
+        ++m_FirstBlockId;
+    }
+}
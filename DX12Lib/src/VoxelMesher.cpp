@@ -0,0 +1,215 @@
+#include <DX12LibPCH.h>
+
+#include <VoxelMesher.h>
+
+namespace
+{
+    const int NumFaces = static_cast<int>(VoxelFace::NumFaces);
+    const uint8_t MaxLight = 15;
+
+    struct Int3
+    {
+        int X, Y, Z;
+    };
+
+    // The face normals, and the directions of u and -v on the face as seen
+    // from the outside. The corners of a quad are in the order (u, v) =
+    // (0, 0), (1, 0), (0, 1), (1, 1), which is the corner of the VoxelVertex,
+    // and the triangles (0, 1, 2) and (2, 1, 3) are clockwise from the outside.
+    const Int3 Normals[NumFaces] = {
+        { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+    };
+    const Int3 Rights[NumFaces] = {
+        { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { -1, 0, 0 }, { -1, 0, 0 }, { 1, 0, 0 },
+    };
+    const Int3 Ups[NumFaces] = {
+        { 0, 1, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 1, 0 },
+    };
+
+    bool IsInSection(int x, int y, int z)
+    {
+        return x >= 0 && y >= 0 && z >= 0 &&
+            x < VoxelMesher::SectionSize && y < VoxelMesher::SectionSize && z < VoxelMesher::SectionSize;
+    }
+
+    // Spread the light of the queued cells through the transparent cells of the section.
+    void Flood(const uint16_t* blocks, uint8_t* light, std::vector<int>& queue)
+    {
+        for (size_t next = 0; next < queue.size(); ++next)
+        {
+            int index = queue[next];
+            uint8_t spread = light[index] - 1;
+            if (spread == 0)
+            {
+                continue;
+            }
+
+            int x = index % VoxelMesher::SectionSize;
+            int z = (index / VoxelMesher::SectionSize) % VoxelMesher::SectionSize;
+            int y = index / (VoxelMesher::SectionSize * VoxelMesher::SectionSize);
+            for (const Int3& normal : Normals)
+            {
+                int nx = x + normal.X, ny = y + normal.Y, nz = z + normal.Z;
+                if (!IsInSection(nx, ny, nz))
+                {
+                    continue;
+                }
+
+                int neighbour = VoxelMesher::BlockIndex(nx, ny, nz);
+                if (blocks[neighbour] == VoxelMesher::Air && light[neighbour] < spread)
+                {
+                    light[neighbour] = spread;
+                    queue.push_back(neighbour);
+                }
+            }
+        }
+    }
+}
+
+const int VoxelMesher::SectionSize;
+const int VoxelMesher::NumBlocks;
+const uint16_t VoxelMesher::Air;
+
+VoxelMesher::VoxelMesher(std::vector<BlockType> blockTypes)
+    : m_BlockTypes(std::move(blockTypes))
+{
+    if (m_BlockTypes.empty())
+    {
+        m_BlockTypes.push_back(BlockType{});
+    }
+}
+
+void VoxelMesher::ComputeLight(const uint16_t* blocks, uint8_t* skyLight, uint8_t* blockLight) const
+{
+    std::vector<int> queue;
+    queue.reserve(NumBlocks);
+
+    // The sky lights every column down to its first solid block.
+    std::fill(skyLight, skyLight + NumBlocks, uint8_t(0));
+    for (int z = 0; z < SectionSize; ++z)
+    {
+        for (int x = 0; x < SectionSize; ++x)
+        {
+            for (int y = SectionSize - 1; y >= 0 && blocks[BlockIndex(x, y, z)] == Air; --y)
+            {
+                skyLight[BlockIndex(x, y, z)] = MaxLight;
+                queue.push_back(BlockIndex(x, y, z));
+            }
+        }
+    }
+    Flood(blocks, skyLight, queue);
+
+    queue.clear();
+    for (int i = 0; i < NumBlocks; ++i)
+    {
+        blockLight[i] = m_BlockTypes[blocks[i]].Emission;
+        if (blockLight[i] > 0)
+        {
+            queue.push_back(i);
+        }
+    }
+    Flood(blocks, blockLight, queue);
+}
+
+void VoxelMesher::Build(const uint16_t* blocks, VoxelVertexCollection& vertices, std::vector<uint32_t>& indices) const
+{
+    vertices.clear();
+    indices.clear();
+
+    uint8_t skyLight[NumBlocks];
+    uint8_t blockLight[NumBlocks];
+    ComputeLight(blocks, skyLight, blockLight);
+
+    auto isSolid = [blocks](int x, int y, int z)
+    {
+        return IsInSection(x, y, z) && blocks[BlockIndex(x, y, z)] != Air;
+    };
+
+    for (int y = 0; y < SectionSize; ++y)
+    {
+        for (int z = 0; z < SectionSize; ++z)
+        {
+            for (int x = 0; x < SectionSize; ++x)
+            {
+                uint16_t block = blocks[BlockIndex(x, y, z)];
+                if (block == Air)
+                {
+                    continue;
+                }
+
+                const BlockType& type = m_BlockTypes[block];
+                for (int face = 0; face < NumFaces; ++face)
+                {
+                    const Int3& n = Normals[face];
+                    const Int3& r = Rights[face];
+                    const Int3& u = Ups[face];
+
+                    // The cell in front of the face.
+                    int fx = x + n.X, fy = y + n.Y, fz = z + n.Z;
+                    if (isSolid(fx, fy, fz))
+                    {
+                        continue;
+                    }
+
+                    VoxelVertexAttributes attributes = {};
+                    attributes.Face = static_cast<VoxelFace>(face);
+                    attributes.TextureLayer = type.Layers[face];
+                    attributes.RepeatU = 1;
+                    attributes.RepeatV = 1;
+                    if (IsInSection(fx, fy, fz))
+                    {
+                        attributes.SkyLight = skyLight[BlockIndex(fx, fy, fz)];
+                        attributes.BlockLight = blockLight[BlockIndex(fx, fy, fz)];
+                    }
+                    else
+                    {
+                        attributes.SkyLight = MaxLight;
+                    }
+
+                    uint32_t first = static_cast<uint32_t>(vertices.size());
+                    uint8_t ao[4];
+                    for (uint8_t corner = 0; corner < 4; ++corner)
+                    {
+                        // The directions from the center of the face to the corner.
+                        int su = (corner & 1) ? 1 : -1;
+                        int sv = (corner & 2) ? -1 : 1;
+                        int dx = su * r.X + sv * u.X;
+                        int dy = su * r.Y + sv * u.Y;
+                        int dz = su * r.Z + sv * u.Z;
+
+                        bool side1 = isSolid(fx + su * r.X, fy + su * r.Y, fz + su * r.Z);
+                        bool side2 = isSolid(fx + sv * u.X, fy + sv * u.Y, fz + sv * u.Z);
+                        bool diagonal = isSolid(fx + dx, fy + dy, fz + dz);
+                        ao[corner] = (side1 && side2) ? 0 : uint8_t(3 - side1 - side2 - diagonal);
+
+                        attributes.X = uint8_t(x + (1 + n.X + dx) / 2);
+                        attributes.Y = uint8_t(y + (1 + n.Y + dy) / 2);
+                        attributes.Z = uint8_t(z + (1 + n.Z + dz) / 2);
+                        attributes.AO = ao[corner];
+                        attributes.Corner = corner;
+                        vertices.emplace_back(attributes);
+                    }
+
+                    // Split the quad along the brighter diagonal, so the
+                    // occlusion is interpolated the same way on every face.
+                    if (ao[0] + ao[3] > ao[1] + ao[2])
+                    {
+                        uint32_t quad[6] = { 0, 1, 3, 0, 3, 2 };
+                        for (uint32_t i : quad)
+                        {
+                            indices.push_back(first + i);
+                        }
+                    }
+                    else
+                    {
+                        uint32_t quad[6] = { 0, 1, 2, 2, 1, 3 };
+                        for (uint32_t i : quad)
+                        {
+                            indices.push_back(first + i);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,8 @@
+#include <DX12LibPCH.h>
+
+#include <VoxelVertex.h>
+
+const D3D12_INPUT_ELEMENT_DESC VoxelVertex::InputElements[] =
+{
+    { "PACKED", 0, DXGI_FORMAT_R32G32_UINT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+};
@@ -5,6 +5,8 @@
 #include <Application.h>
 #include <CommandQueue.h>
 #include <CommandList.h>
+#include <CommandRecorder.h>
+#include <FramePacer.h>
 #include <Game.h>
 #include <ResourceStateTracker.h>
 
@@ -15,8 +17,6 @@ Window::Window(HWND hWnd, const std::wstring& windowName, int clientWidth, int c
     , m_ClientHeight(clientHeight)
     , m_VSync(vSync)
     , m_Fullscreen(false)
-    , m_FenceValues{0}
-    , m_FrameValues{0}
 {
     Application& app = Application::Get();
 
@@ -375,15 +375,15 @@ UINT Window::Present()
     UINT presentFlags = m_IsTearingSupported && !m_VSync ? DXGI_PRESENT_ALLOW_TEARING : 0;
     ThrowIfFailed(m_dxgiSwapChain->Present(syncInterval, presentFlags));
 
-    m_FenceValues[m_CurrentBackBufferIndex] = commandQueue->Signal();
-    m_FrameValues[m_CurrentBackBufferIndex] = Application::GetFrameCount();
+    CommandRecorder::EndFrame();
 
-    m_CurrentBackBufferIndex = m_dxgiSwapChain->GetCurrentBackBufferIndex();
+    // Writes to the next back buffer are ordered on the direct queue after the
+    // present, so the CPU only has to wait if it is too many frames ahead.
+    uint64_t completedFrame = Application::Get().GetFramePacer().EndFrame( Application::GetFrameCount() );
 
-    commandQueue->WaitForFenceValue( m_FenceValues[m_CurrentBackBufferIndex] );
+    m_CurrentBackBufferIndex = m_dxgiSwapChain->GetCurrentBackBufferIndex();
 
-    // TODO: Release stale descriptors
-    Application::Get().ReleaseStaleDescriptors( m_FrameValues[m_CurrentBackBufferIndex] );
+    Application::Get().ReleaseStaleDescriptors( completedFrame );
 
     return m_CurrentBackBufferIndex;
 }
@@ -0,0 +1,142 @@
+#include <DX12LibPCH.h>
+
+#include <WorkerPool.h>
+
+WorkerPool::WorkerPool(uint32_t numThreads)
+    : m_pTask(nullptr)
+    , m_NumTasks(0)
+    , m_NumFinished(0)
+    , m_NumActive(0)
+    , m_Generation(0)
+    , m_Exit(false)
+    , m_NextTask(0)
+{
+    if (numThreads == 0)
+    {
+        uint32_t numHardwareThreads = std::thread::hardware_concurrency();
+        numThreads = numHardwareThreads > 1 ? numHardwareThreads - 1 : 1;
+    }
+
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        m_Threads.emplace_back(&WorkerPool::ProcessTasks, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Exit = true;
+    }
+    m_WorkCondition.notify_all();
+
+    for (auto& thread : m_Threads)
+    {
+        thread.join();
+    }
+}
+
+void WorkerPool::ParallelFor(size_t numTasks, const Task& task)
+{
+    if (numTasks == 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> loopLock(m_LoopMutex);
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_pTask = &task;
+        m_NumTasks = numTasks;
+        m_NumFinished = 0;
+        m_Exception = nullptr;
+        m_NextTask = 0;
+        ++m_Generation;
+    }
+    // A single task is run on the calling thread without waking anyone.
+    if (numTasks > 1)
+    {
+        m_WorkCondition.notify_all();
+    }
+
+    RunTasks(task, numTasks);
+
+    // Wait until every task has finished and no worker still refers to the task.
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_DoneCondition.wait(lock, [this]()
+    {
+        return m_NumFinished == m_NumTasks && m_NumActive == 0;
+    });
+    m_pTask = nullptr;
+
+    std::exception_ptr exception = m_Exception;
+    m_Exception = nullptr;
+    lock.unlock();
+
+    if (exception)
+    {
+        std::rethrow_exception(exception);
+    }
+}
+
+void WorkerPool::RunTasks(const Task& task, size_t numTasks)
+{
+    size_t numFinished = 0;
+    for (size_t index = m_NextTask++; index < numTasks; index = m_NextTask++)
+    {
+        try
+        {
+            task(index);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (!m_Exception)
+            {
+                m_Exception = std::current_exception();
+            }
+        }
+        ++numFinished;
+    }
+
+    if (numFinished > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_NumFinished += numFinished;
+    }
+}
+
+void WorkerPool::ProcessTasks()
+{
+    uint64_t generation = 0;
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true)
+    {
+        m_WorkCondition.wait(lock, [this, generation]()
+        {
+            return m_Exit || (m_pTask && m_Generation != generation);
+        });
+        if (m_Exit)
+        {
+            return;
+        }
+
+        generation = m_Generation;
+        const Task& task = *m_pTask;
+        size_t numTasks = m_NumTasks;
+        ++m_NumActive;
+        lock.unlock();
+
+        RunTasks(task, numTasks);
+
+        lock.lock();
+        --m_NumActive;
+        if (m_NumActive == 0 && m_NumFinished == m_NumTasks)
+        {
+            m_DoneCondition.notify_one();
+        }
+    }
+}
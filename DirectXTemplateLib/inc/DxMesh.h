@@ -41,6 +41,9 @@ public:
     
     void Draw( ID3D11DeviceContext* pDeviceContext );
 
+    // Draw instanceCount copies of the mesh, the per-instance data is read from vertex buffer slot 1.
+    void DrawInstanced( ID3D11DeviceContext* pDeviceContext, ID3D11Buffer* pInstanceBuffer, UINT instanceStride, UINT instanceCount );
+
     static std::unique_ptr<DxMesh> CreateCube( ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true);
     static std::unique_ptr<DxMesh> CreateSphere( ID3D11DeviceContext* deviceContext, float diameter = 1, size_t tessellation = 16, bool rhcoords = true);
     static std::unique_ptr<DxMesh> CreateCone( ID3D11DeviceContext* deviceContext, float diameter = 1, float height = 1, size_t tessellation = 32, bool rhcoords = true);
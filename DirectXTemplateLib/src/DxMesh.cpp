@@ -33,6 +33,20 @@ void DxMesh::Draw( ID3D11DeviceContext* pDeviceContext )
     pDeviceContext->DrawIndexed( m_IndexCount, 0, 0 );
 }
 
+void DxMesh::DrawInstanced( ID3D11DeviceContext* pDeviceContext, ID3D11Buffer* pInstanceBuffer, UINT instanceStride, UINT instanceCount )
+{
+    assert( pDeviceContext && pInstanceBuffer );
+
+    ID3D11Buffer* const buffers[] = { m_VertexBuffer.Get(), pInstanceBuffer };
+    const UINT strides[] = { sizeof(VertexPositionNormalTexture), instanceStride };
+    const UINT offsets[] = { 0, 0 };
+
+    pDeviceContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+    pDeviceContext->IASetVertexBuffers( 0, 2, buffers, strides, offsets );
+    pDeviceContext->IASetIndexBuffer( m_IndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0 );
+    pDeviceContext->DrawIndexedInstanced( m_IndexCount, instanceCount, 0, 0, 0 );
+}
+
 std::unique_ptr<DxMesh> DxMesh::CreateSphere( ID3D11DeviceContext* pDeviceContext, float diameter, size_t tessellation, bool rhcoords )
 {
     VertexCollection vertices;
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Application.h"
+#include "FramePacer.h"
 #include "TexturedCube.h"
 
 
@@ -12,11 +13,22 @@ void ReportLiveObjects()
     dxgiDebug->Release();
 }
 
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int nCmdShow)
 {
     int retCode = 0;
 
-    Application::Create(hInstance);
+    // Use -warp to render on the software adapter, e.g. on a machine without a D3D12 GPU.
+    bool useWarp = lpCmdLine && strstr(lpCmdLine, "-warp") != nullptr;
+
+    Application::Create(hInstance, useWarp);
+
+    // Use -frames N to change the number of frames the CPU may record ahead of the GPU.
+    const char* framesArg = lpCmdLine ? strstr(lpCmdLine, "-frames ") : nullptr;
+    if (framesArg)
+    {
+        Application::Get().GetFramePacer().SetNumFramesInFlight(static_cast<uint32_t>(atoi(framesArg + 8)));
+    }
+
     {
         std::shared_ptr<TexturedCube> demo = std::make_shared<TexturedCube>(L"Learning DirectX 12 - Lesson 3", 800, 600);
         retCode = Application::Get().Run(demo);
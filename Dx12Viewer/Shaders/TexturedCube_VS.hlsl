@@ -82,4 +82,4 @@ CubeVertexShaderOutput CubeVS(CubeVertexPositionNormalTexture IN)
 	OUT.TexCoord = IN.TexCoord;
 
 	return OUT;
-}
\ No newline at end of file
+}
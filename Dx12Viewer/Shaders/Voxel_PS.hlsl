@@ -0,0 +1,25 @@
+// The lights, the material and the texture array are shared with the cube pixel shader.
+#include "TexturedCube_PS.hlsl"
+
+struct VoxelShaderInput
+{
+    float4 PositionVS : POSITION;
+    float3 NormalVS   : NORMAL;
+    float3 TexCoord   : TEXCOORD;
+    float  Shade      : SHADE;
+};
+
+float4 VoxelPS( VoxelShaderInput IN ) : SV_Target
+{
+    LightResult lit = DoLighting( IN.PositionVS.xyz, normalize( IN.NormalVS ) );
+
+    float4 emissive = MaterialCB.Emissive;
+    float4 ambient = MaterialCB.Ambient;
+    float4 diffuse = MaterialCB.Diffuse * lit.Diffuse;
+    float4 specular = MaterialCB.Specular * lit.Specular;
+    float4 texColor = CubeTexture.Sample( CubeSampler, IN.TexCoord );
+
+    // The point and spot lights are added on top of the baked sky and block light.
+    float4 color = ( emissive + ambient * IN.Shade + diffuse + specular ) * texColor;
+    return float4( color.rgb, texColor.a );
+}
@@ -0,0 +1,65 @@
+struct Mat
+{
+	matrix ModelMatrix;
+	matrix ModelViewMatrix;
+	matrix InverseTransposeModelViewMatrix;
+	matrix ModelViewProjectionMatrix;
+};
+
+ConstantBuffer<Mat> MatCB : register(b0);
+
+// Packed chunk section vertex (see VoxelVertex.h for the bit layout).
+struct VoxelVertexPacked
+{
+	uint2 Packed : PACKED;
+};
+
+struct VoxelVertexShaderOutput
+{
+	float4 PositionVS : POSITION;
+	float3 NormalVS   : NORMAL;
+	float3 TexCoord   : TEXCOORD;
+	// Ambient occlusion times the light level of the vertex.
+	float  Shade      : SHADE;
+	float4 Position   : SV_Position;
+};
+
+static const float3 VoxelNormals[6] =
+{
+	float3( 1, 0, 0),
+	float3(-1, 0, 0),
+	float3( 0, 1, 0),
+	float3( 0,-1, 0),
+	float3( 0, 0, 1),
+	float3( 0, 0,-1),
+};
+
+// The brightness of the 4 ambient occlusion levels (0 = fully occluded).
+static const float AmbientOcclusion[4] = { 0.45f, 0.65f, 0.82f, 1.0f };
+
+VoxelVertexShaderOutput VoxelVS(VoxelVertexPacked IN)
+{
+	VoxelVertexShaderOutput OUT;
+
+	uint word0 = IN.Packed.x;
+	uint word1 = IN.Packed.y;
+
+	float3 position = float3(word0 & 0x1F, (word0 >> 5) & 0x1F, (word0 >> 10) & 0x1F);
+	float3 normal = VoxelNormals[min((word0 >> 15) & 0x7, 5)];
+	uint ao = (word0 >> 18) & 0x3;
+	uint corner = (word0 >> 20) & 0x3;
+	uint blockLight = (word0 >> 22) & 0xF;
+	uint skyLight = (word0 >> 26) & 0xF;
+	float2 repeat = float2(((word1 >> 16) & 0xF) + 1, ((word1 >> 20) & 0xF) + 1);
+
+	// Every light level is 80% of the next one, like the light table of the game.
+	float light = pow(0.8f, 15.0f - max(blockLight, skyLight));
+
+	OUT.Position = mul(MatCB.ModelViewProjectionMatrix, float4(position, 1.0f));
+	OUT.PositionVS = mul(MatCB.ModelViewMatrix, float4(position, 1.0f));
+	OUT.NormalVS = mul((float3x3)MatCB.InverseTransposeModelViewMatrix, normal);
+	OUT.TexCoord = float3(float2(corner & 1, corner >> 1) * repeat, word1 & 0xFFFF);
+	OUT.Shade = AmbientOcclusion[ao] * light;
+
+	return OUT;
+}
@@ -1,8 +1,10 @@
 #include "pch.h"
 #include "TexturedCube.h"
 #include "Application.h"
+#include "BlockModelBaker.h"
 #include "CommandQueue.h"
 #include "CommandList.h"
+#include "CommandRecorder.h"
 #include "Helpers.h"
 #include "Light.h"
 #include "Material.h"
@@ -64,6 +66,152 @@ namespace {
 
 		return M;
 	};
+
+	// The blocks of the generated terrain, indices into the VoxelMesher block types.
+	enum TerrainBlock : uint16_t
+	{
+		Air = VoxelMesher::Air,
+		Stone,
+		Dirt,
+		Grass,
+		Glowstone,
+		NumTerrainBlocks
+	};
+
+	// The block textures of the faces of the terrain blocks, in VoxelFace order (+X, -X, +Y, -Y, +Z, -Z).
+	const wchar_t* const TerrainBlockTextures[NumTerrainBlocks][static_cast<int>(VoxelFace::NumFaces)] =
+	{
+		{},
+		{ L"stone", L"stone", L"stone", L"stone", L"stone", L"stone" },
+		{ L"dirt", L"dirt", L"dirt", L"dirt", L"dirt", L"dirt" },
+		{ L"grass_side", L"grass_side", L"grass_top", L"dirt", L"grass_side", L"grass_side" },
+		{ L"glowstone", L"glowstone", L"glowstone", L"glowstone", L"glowstone", L"glowstone" },
+	};
+
+	// The block states drawn in a row next to the cube. States that are not in the baked table are skipped.
+	const char* const ShowcaseBlockStates[] =
+	{
+		"crafting_table#normal",
+		"furnace#facing=south",
+		"bookshelf#normal",
+		"oak_stairs#facing=east,half=bottom,shape=straight",
+		"oak_fence#east=true,north=false,south=false,west=true",
+		"cobblestone_wall#east=true,north=false,south=false,up=true,west=true",
+	};
+	const float ShowcaseSpacing = 2.0f;
+
+	// The normal of each VoxelFace.
+	const XMFLOAT3 FaceNormals[static_cast<int>(VoxelFace::NumFaces)] =
+	{
+		{ 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f },
+		{ 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f },
+	};
+
+	// The block resources are read from the game, the baked files are written to the working directory.
+	const std::wstring BlockTextureDirectory = L"E:/Games/MineCraft/assets/minecraft/textures/blocks";
+	const std::wstring BlockModelDirectory = L"E:/Games/MineCraft/assets/minecraft";
+	const std::wstring BakeDirectory = L"Baked";
+
+	// The terrain sections around the origin, and the time per frame spent uploading their meshes.
+	const int TerrainRadius = 4;
+	const double TerrainIntegrateMilliseconds = 2.0;
+
+	// Draws are recorded on another command list (and thread) per this many draws.
+	const size_t MinDrawsPerCommandList = 64;
+
+	// The terrain is lit by its baked sky and block light, the lights of the scene only add to it.
+	const Material TerrainMaterial(
+		{ 0.0f, 0.0f, 0.0f, 1.0f },
+		{ 1.0f, 1.0f, 1.0f, 1.0f },
+		{ 0.5f, 0.5f, 0.5f, 1.0f },
+		{ 0.0f, 0.0f, 0.0f, 1.0f },
+		1.0f);
+
+	// The terrain block types with the layers of their textures in the block texture array.
+	// Faces whose texture is not in the array use the first layer.
+	std::vector<VoxelMesher::BlockType> CreateTerrainBlockTypes(const TextureArrayBaker::LayerTable& layers)
+	{
+		std::vector<VoxelMesher::BlockType> blockTypes(NumTerrainBlocks, VoxelMesher::BlockType{});
+		for (int block = Stone; block < NumTerrainBlocks; ++block)
+		{
+			for (int face = 0; face < static_cast<int>(VoxelFace::NumFaces); ++face)
+			{
+				auto layer = layers.find(TerrainBlockTextures[block][face]);
+				if (layer != layers.end())
+				{
+					blockTypes[block].Layers[face] = static_cast<uint16_t>(layer->second);
+				}
+			}
+		}
+		blockTypes[Glowstone].Emission = 15;
+		return blockTypes;
+	}
+
+	// Append the quads of a block state at an offset in blocks. The layers are the
+	// resolved texture layers of the table, quads without a layer are skipped.
+	void AppendBlockModel(const BlockModelTable& models, const std::vector<uint32_t>& layers, uint32_t state,
+		const XMFLOAT3& offset, CubeVertexCollection& vertices, std::vector<uint32_t>& indices)
+	{
+		const BakedQuad* quads = models.GetQuads(state);
+		for (uint16_t q = 0; q < models.GetState(state).NumQuads; ++q)
+		{
+			const BakedQuad& quad = quads[q];
+			uint32_t layer = layers[quad.Texture];
+			if (layer == BlockModelTable::InvalidLayer || quad.Face >= static_cast<uint8_t>(VoxelFace::NumFaces))
+			{
+				continue;
+			}
+
+			uint32_t first = static_cast<uint32_t>(vertices.size());
+			for (int corner = 0; corner < 4; ++corner)
+			{
+				const float* p = quad.Positions[corner];
+				vertices.emplace_back(XMFLOAT3(offset.x + p[0], offset.y + p[1], offset.z + p[2]), FaceNormals[quad.Face],
+					XMFLOAT2(quad.UVs[corner][0], quad.UVs[corner][1]), static_cast<int>(layer));
+			}
+
+			// The corners are clockwise seen from the front of the quad.
+			for (uint32_t i : { 0u, 1u, 2u, 0u, 2u, 3u })
+			{
+				indices.push_back(first + i);
+			}
+		}
+	}
+
+	// Fill a section with rolling hills around y = -8. The section origin is in blocks.
+	void GenerateTerrain(int originX, int originY, int originZ, uint16_t* blocks)
+	{
+		for (int z = 0; z < VoxelMesher::SectionSize; ++z)
+		{
+			for (int x = 0; x < VoxelMesher::SectionSize; ++x)
+			{
+				float wx = static_cast<float>(originX + x);
+				float wz = static_cast<float>(originZ + z);
+				float surface = -8.0f + 3.0f * std::sin(wx * 0.3f) + 2.0f * std::cos(wz * 0.25f);
+				int height = static_cast<int>(std::floor(surface)) - originY;
+
+				for (int y = 0; y < VoxelMesher::SectionSize; ++y)
+				{
+					uint16_t block = Air;
+					if (y < height - 3)
+					{
+						// Light up a few of the caves below the hills.
+						block = (x * 7 + z * 13 + y * 5) % 61 == 0 ? Glowstone : Stone;
+					}
+					else if (y < height - 1)
+					{
+						block = Dirt;
+					}
+					else if (y < height)
+					{
+						block = Grass;
+					}
+					blocks[VoxelMesher::BlockIndex(x, y, z)] = block;
+				}
+			}
+		}
+	}
 };
 
 TexturedCube::TexturedCube(const std::wstring& name, int width, int height, bool vSync)
@@ -74,6 +222,7 @@ TexturedCube::TexturedCube(const std::wstring& name, int width, int height, bool
 		width, height, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL),
 		&CD3DX12_CLEAR_VALUE(DXGI_FORMAT_D32_FLOAT, 1.0f, 0),
 		D3D12_RESOURCE_STATE_COMMON, L"Depth Buffer")
+	, m_RenderQueue({ RootParameters::MatricesCB, RootParameters::MaterialCB, RootParameters::Textures })
 	, m_Forward(0)
 	, m_Backward(0)
 	, m_Left(0)
@@ -114,6 +263,17 @@ bool TexturedCube::LoadContent()
 	m_SphereMesh = Mesh::CreateSphere(*commandList);
 	m_ConeMesh = Mesh::CreateCone(*commandList);
 
+	// The sections are generated and meshed on the worker threads, nearest to the camera first.
+	// They are requested once the block textures are baked and the mesher knows their layers.
+	m_MeshingScheduler = std::make_unique<MeshingScheduler>(
+		[this](const MeshingScheduler::SectionKey& key, MeshingScheduler::ScratchBuffer& scratch)
+	{
+		uint16_t blocks[VoxelMesher::NumBlocks];
+		GenerateTerrain(key.X * VoxelMesher::SectionSize, key.Y * VoxelMesher::SectionSize, key.Z * VoxelMesher::SectionSize, blocks);
+		m_VoxelMesher->Build(blocks, scratch.Vertices, scratch.Indices);
+	});
+	m_MeshingScheduler->SetView(m_Camera);
+
 	// Load some textures
 	commandList->LoadTextureFromFile(m_DefaultTexture, L"Textures/DefaultWhite.bmp");
 	m_DefaultTexture.SetName(L"Default Texture");
@@ -121,6 +281,35 @@ bool TexturedCube::LoadContent()
 
 	commandList->CreateCubeTexture(L"CubeTextures", m_MonaLisaTexture);
 
+	m_TextureStreamer = std::make_unique<TextureStreamer>();
+
+	// The block textures are baked into one texture array and the block models
+	// are compiled from the model JSON files on the first run, later startups
+	// only check that the baked files are current. Neither holds up the first frame.
+	m_BlockAssetBake = std::async(std::launch::async, []()
+	{
+		BakedBlockAssets assets;
+		try
+		{
+			if (GetFileAttributesW(BlockTextureDirectory.c_str()) != INVALID_FILE_ATTRIBUTES)
+			{
+				TextureArrayBaker baker(BlockTextureDirectory, BakeDirectory);
+				assets.Layers = baker.BakeIfNeeded();
+				assets.TextureFileName = baker.GetTextureFileName();
+			}
+			if (GetFileAttributesW((BlockModelDirectory + L"/blockstates").c_str()) != INVALID_FILE_ATTRIBUTES)
+			{
+				BlockModelBaker baker(BlockModelDirectory, BakeDirectory);
+				assets.ModelFileName = baker.BakeIfNeeded();
+			}
+		}
+		catch (const std::exception& ex) {
+			OutputDebugStringA(ex.what());
+			OutputDebugStringA("\n");
+		}
+		return assets;
+	});
+
 	// Load the vertex shader.
 	ComPtr<ID3DBlob> vertexShaderBlob;
 	ThrowIfFailed(D3DReadFileToBlob(L"Shaders/TexturedCube_VS.cso", &vertexShaderBlob));
@@ -129,6 +318,12 @@ bool TexturedCube::LoadContent()
 	ComPtr<ID3DBlob> pixelShaderBlob;
 	ThrowIfFailed(D3DReadFileToBlob(L"Shaders/TexturedCube_PS.cso", &pixelShaderBlob));
 
+	// Load the shaders of the voxel meshes.
+	ComPtr<ID3DBlob> voxelVertexShaderBlob;
+	ThrowIfFailed(D3DReadFileToBlob(L"Shaders/Voxel_VS.cso", &voxelVertexShaderBlob));
+	ComPtr<ID3DBlob> voxelPixelShaderBlob;
+	ThrowIfFailed(D3DReadFileToBlob(L"Shaders/Voxel_PS.cso", &voxelPixelShaderBlob));
+
 	// Create a root signature.
 	D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
 	featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
@@ -194,6 +389,13 @@ bool TexturedCube::LoadContent()
 		//HRESULT hr = device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_PipelineState));
 		HRESULT hr = device->CreatePipelineState(&pipelineStateStreamDesc, IID_ID3D12PipelineState, &m_PipelineState);
 		ThrowIfFailed(hr);
+
+		// The voxel meshes only differ in the vertex format and the shaders.
+		pipelineStateStream.InputLayout = { VoxelVertex::InputElements, VoxelVertex::InputElementCount };
+		pipelineStateStream.VS = CD3DX12_SHADER_BYTECODE(voxelVertexShaderBlob.Get());
+		pipelineStateStream.PS = CD3DX12_SHADER_BYTECODE(voxelPixelShaderBlob.Get());
+		hr = device->CreatePipelineState(&pipelineStateStreamDesc, IID_ID3D12PipelineState, &m_VoxelPipelineState);
+		ThrowIfFailed(hr);
 	}
 	catch (const std::exception& ex) {
 		OutputDebugStringA(ex.what());
@@ -211,9 +413,8 @@ bool TexturedCube::LoadContent()
 
 void TexturedCube::ResizeDepthBuffer(int width, int height)
 {
-	// Flush any GPU commands that might be referencing the depth buffer.
-	Application::Get().Flush();
-
+	// The previous depth buffer is kept alive by the command lists that still
+	// reference it, so there is no need to flush the command queues here.
 	width = std::max(1, width);
 	height = std::max(1, height);
 
@@ -239,8 +440,66 @@ void TexturedCube::OnResize(ResizeEventArgs& e)
 	}
 }
 
+void TexturedCube::OnBlockAssetsBaked(BakedBlockAssets& assets)
+{
+	// The baked array is streamed in, the terrain is drawn once it is resident.
+	if (!assets.TextureFileName.empty())
+	{
+		m_BlockLayers = std::move(assets.Layers);
+		m_BlockTextures = m_TextureStreamer->Request(assets.TextureFileName);
+	}
+
+	if (!assets.ModelFileName.empty())
+	{
+		try
+		{
+			m_BlockModels.Open(assets.ModelFileName);
+			m_BlockModelLayers = m_BlockModels.ResolveTextureLayers(m_BlockLayers);
+
+			XMFLOAT3 offset(-6.0f, 0.0f, -4.0f);
+			for (const char* name : ShowcaseBlockStates)
+			{
+				uint32_t state = m_BlockModels.FindState(name);
+				if (state != BlockModelTable::InvalidState)
+				{
+					AppendBlockModel(m_BlockModels, m_BlockModelLayers, state, offset, m_BlockModelVertices, m_BlockModelIndices);
+					offset.x += ShowcaseSpacing;
+				}
+			}
+		}
+		catch (const std::exception& ex) {
+			OutputDebugStringA(ex.what());
+			OutputDebugStringA("\n");
+		}
+	}
+
+	// Without block textures the terrain uses the first layer of the cube texture array.
+	m_VoxelMesher = std::make_unique<VoxelMesher>(CreateTerrainBlockTypes(m_BlockLayers));
+	for (int z = -TerrainRadius; z < TerrainRadius; ++z)
+	{
+		for (int x = -TerrainRadius; x < TerrainRadius; ++x)
+		{
+			m_MeshingScheduler->Request({ x, -1, z });
+		}
+	}
+}
+
 void TexturedCube::UnloadContent()
 {
+	// The bake writes to the baked files, let it finish.
+	if (m_BlockAssetBake.valid())
+	{
+		m_BlockAssetBake.wait();
+	}
+
+	// Stop the workers before the mesher they use.
+	m_MeshingScheduler.reset();
+	m_TerrainMeshes.clear();
+	m_VoxelMesher.reset();
+	m_BlockModelMesh.reset();
+	m_BlockTextures.reset();
+	m_TextureStreamer.reset();
+	m_BlockModels.Close();
 }
 
 void TexturedCube::OnUpdate(UpdateEventArgs& e)
@@ -250,15 +509,34 @@ void TexturedCube::OnUpdate(UpdateEventArgs& e)
 
 	super::OnUpdate(e);
 
+	if (m_BlockAssetBake.valid() && m_BlockAssetBake.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		BakedBlockAssets assets = m_BlockAssetBake.get();
+		OnBlockAssetsBaked(assets);
+	}
+
+	if (m_TextureStreamer)
+	{
+		m_TextureStreamer->Update();
+	}
+
 	totalTime += e.ElapsedTime;
 	frameCount++;
 
 	if (totalTime > 1.0)
 	{
 		double fps = frameCount / totalTime;
+		FrameStatistics stats = CommandRecorder::GetLastFrameStatistics();
 
 		wchar_t buffer[512];
-		swprintf_s(buffer, L"%s - FPS: %f\n", this->m_pWindow->GetWindowName().c_str(), fps);
+		const RenderQueue::Statistics& queueStats = m_RenderQueue.GetStatistics();
+		uint32_t numStateChanges = queueStats.NumPipelineStateChanges + queueStats.NumRootSignatureChanges +
+			queueStats.NumTextureChanges + queueStats.NumMaterialChanges + queueStats.NumMeshChanges;
+		MeshingScheduler::Statistics meshingStats = m_MeshingScheduler->GetStatistics();
+		swprintf_s(buffer, L"%s - FPS: %f - Draws: %u State changes: %u Barriers: %u Upload: %.1f KB Record: %.3f ms Sections: %llu/%llu\n",
+			this->m_pWindow->GetWindowName().c_str(), fps,
+			stats.NumDraws, numStateChanges, stats.NumBarriers, stats.UploadBytes / 1024.0, stats.RecordMilliseconds,
+			meshingStats.NumIntegrated, meshingStats.NumRequested);
 		this->m_pWindow->SetWindowTitle(buffer);
 
 		frameCount = 0;
@@ -277,6 +555,9 @@ void TexturedCube::OnUpdate(UpdateEventArgs& e)
 	XMVECTOR cameraRotation = XMQuaternionRotationRollPitchYaw(XMConvertToRadians(m_Pitch), XMConvertToRadians(m_Yaw), 0.0f);
 	m_Camera.set_Rotation(cameraRotation);
 
+	// Mesh the terrain sections in front of the camera first.
+	m_MeshingScheduler->SetView(m_Camera);
+
 	XMMATRIX viewMatrix = m_Camera.get_ViewMatrix();
 
 	const int numPointLights = 4;
@@ -391,6 +672,13 @@ void XM_CALLCONV ComputeMatrices(FXMMATRIX model, CXMMATRIX view, CXMMATRIX view
 	mat.ModelViewProjectionMatrix = model * viewProjection;
 }
 
+// The view space depth of the origin of an object, used to sort the draws.
+float XM_CALLCONV ViewDepth(FXMMATRIX model, CXMMATRIX view)
+{
+	XMVECTOR positionVS = XMVector3TransformCoord(model.r[3], view);
+	return XMVectorGetZ(positionVS);
+}
+
 void TexturedCube::OnRender(RenderEventArgs& e)
 {
 	super::OnRender(e);
@@ -409,22 +697,26 @@ void TexturedCube::OnRender(RenderEventArgs& e)
 		commandList->ClearDepthStencilTexture(m_DepthBuffer, D3D12_CLEAR_FLAG_DEPTH);
 	}
 
-	commandList->SetPipelineState(m_PipelineState);
-	commandList->SetGraphicsRootSignature(m_RootSignature);
-
-	// Upload lights
 	LightProperties lightProps;
 	lightProps.NumPointLights = static_cast<uint32_t>(m_PointLights.size());
 	lightProps.NumSpotLights = static_cast<uint32_t>(m_SpotLights.size());
 
-	commandList->SetGraphics32BitConstants(RootParameters::LightPropertiesCB, lightProps);
-	commandList->SetGraphicsDynamicStructuredBuffer(RootParameters::PointLights, m_PointLights);
-	commandList->SetGraphicsDynamicStructuredBuffer(RootParameters::SpotLights, m_SpotLights);
+	// The state every command list that records draws starts with.
+	// The pipeline state is set by the render queue.
+	auto setFrameState = [&](CommandList& drawCommandList)
+	{
+		drawCommandList.SetGraphicsRootSignature(m_RootSignature);
+
+		// Upload lights
+		drawCommandList.SetGraphics32BitConstants(RootParameters::LightPropertiesCB, lightProps);
+		drawCommandList.SetGraphicsDynamicStructuredBuffer(RootParameters::PointLights, m_PointLights);
+		drawCommandList.SetGraphicsDynamicStructuredBuffer(RootParameters::SpotLights, m_SpotLights);
 
-	commandList->SetViewport(m_Viewport);
-	commandList->SetScissorRect(m_ScissorRect);
+		drawCommandList.SetViewport(m_Viewport);
+		drawCommandList.SetScissorRect(m_ScissorRect);
 
-	commandList->SetRenderTarget(&renderTarget, &m_DepthBuffer);
+		drawCommandList.SetRenderTarget(&renderTarget, &m_DepthBuffer);
+	};
 
 	// Draw the earth sphere
 	//XMMATRIX translationMatrix = XMMatrixTranslation(-4.0f, 2.0f, -4.0f);
@@ -450,11 +742,62 @@ void TexturedCube::OnRender(RenderEventArgs& e)
 	Mat matrices;
 	ComputeMatrices(m_CubeMesh->World, viewMatrix, viewProjectionMatrix, matrices);
 
-	commandList->SetGraphicsDynamicConstantBuffer(RootParameters::MatricesCB, matrices);
-	commandList->SetGraphicsDynamicConstantBuffer(RootParameters::MaterialCB, Material::White);
-	commandList->SetShaderResourceView(RootParameters::Textures, 0, m_MonaLisaTexture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	m_RenderQueue.Submit(m_PipelineState.Get(), m_RootSignature, *m_CubeMesh, m_MonaLisaTexture, Material::White,
+		ViewDepth(m_CubeMesh->World, viewMatrix), matrices);
 
-	m_CubeMesh->Draw(*commandList);
+	// Draw the block models with the block texture array, once both are loaded.
+	if (!m_BlockModelVertices.empty())
+	{
+		m_BlockModelMesh = Mesh::CreateBlockModelMesh(*commandList, m_BlockModelVertices, m_BlockModelIndices);
+		m_BlockModelVertices.clear();
+		m_BlockModelIndices.clear();
+	}
+	if (m_BlockModelMesh && m_BlockTextures && m_BlockTextures->IsResident())
+	{
+		ComputeMatrices(m_BlockModelMesh->World, viewMatrix, viewProjectionMatrix, matrices);
+
+		m_RenderQueue.Submit(m_PipelineState.Get(), m_RootSignature, *m_BlockModelMesh, m_BlockTextures->GetTexture(), Material::White,
+			ViewDepth(m_BlockModelMesh->World, viewMatrix), matrices);
+	}
+
+	// Upload the terrain sections that were meshed since the last frame, within the frame budget.
+	m_MeshingScheduler->Integrate([this, &commandList](MeshingScheduler::MeshResult& result)
+	{
+		if (!result.Indices.empty())
+		{
+			std::unique_ptr<Mesh> mesh = Mesh::CreateVoxelMesh(*commandList, result.Vertices, result.Indices);
+			mesh->World = XMMatrixTranslation(result.Key.X * 16.0f, result.Key.Y * 16.0f, result.Key.Z * 16.0f);
+			m_TerrainMeshes.push_back(std::move(mesh));
+		}
+	}, TerrainIntegrateMilliseconds);
+
+	// Draw the terrain. Its faces index the block texture array, so it is drawn
+	// once the array is resident. Without block textures (or if the array
+	// failed to load) the cube texture array is used.
+	const Texture* terrainTexture = &m_MonaLisaTexture;
+	bool drawTerrain = m_VoxelPipelineState != nullptr;
+	if (m_BlockTextures)
+	{
+		if (m_BlockTextures->IsResident())
+		{
+			terrainTexture = &m_BlockTextures->GetTexture();
+		}
+		else if (m_BlockTextures->GetState() != TextureStreamer::TextureState::Failed)
+		{
+			drawTerrain = false;
+		}
+	}
+
+	if (drawTerrain)
+	{
+		for (const auto& terrainMesh : m_TerrainMeshes)
+		{
+			ComputeMatrices(terrainMesh->World, viewMatrix, viewProjectionMatrix, matrices);
+
+			m_RenderQueue.Submit(m_VoxelPipelineState.Get(), m_RootSignature, *terrainMesh, *terrainTexture, TerrainMaterial,
+				ViewDepth(terrainMesh->World, viewMatrix), matrices);
+		}
+	}
 
 	//// Draw a torus
 	//translationMatrix = XMMatrixTranslation(4.0f, 0.6f, -4.0f);
@@ -529,7 +872,6 @@ void TexturedCube::OnRender(RenderEventArgs& e)
 
 	//commandList->SetGraphicsDynamicConstantBuffer(RootParameters::MatricesCB, matrices);
 	//commandList->SetGraphicsDynamicConstantBuffer(RootParameters::MaterialCB, Material::Red);
-	commandList->SetShaderResourceView(RootParameters::Textures, 0, m_DefaultTexture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 
 	//m_PlaneMesh->Draw(*commandList);
 
@@ -555,10 +897,8 @@ void TexturedCube::OnRender(RenderEventArgs& e)
 		XMMATRIX worldMatrix = XMMatrixTranslationFromVector(lightPos);
 		ComputeMatrices(worldMatrix, viewMatrix, viewProjectionMatrix, matrices);
 
-		commandList->SetGraphicsDynamicConstantBuffer(RootParameters::MatricesCB, matrices);
-		commandList->SetGraphicsDynamicConstantBuffer(RootParameters::MaterialCB, lightMaterial);
-
-		m_SphereMesh->Draw(*commandList);
+		m_RenderQueue.Submit(m_PipelineState.Get(), m_RootSignature, *m_SphereMesh, m_DefaultTexture, lightMaterial,
+			ViewDepth(worldMatrix, viewMatrix), matrices);
 	}
 
 	for (const auto& l : m_SpotLights)
@@ -574,13 +914,25 @@ void TexturedCube::OnRender(RenderEventArgs& e)
 
 		ComputeMatrices(worldMatrix, viewMatrix, viewProjectionMatrix, matrices);
 
-		commandList->SetGraphicsDynamicConstantBuffer(RootParameters::MatricesCB, matrices);
-		commandList->SetGraphicsDynamicConstantBuffer(RootParameters::MaterialCB, lightMaterial);
-
-		m_ConeMesh->Draw(*commandList);
+		m_RenderQueue.Submit(m_PipelineState.Get(), m_RootSignature, *m_ConeMesh, m_DefaultTexture, lightMaterial,
+			ViewDepth(worldMatrix, viewMatrix), matrices);
 	}
 
-	commandQueue->ExecuteCommandList(commandList);
+	// Record the sorted draws on the recording threads of the queue, on one
+	// command list per range of draws.
+	size_t numDraws = m_RenderQueue.Sort();
+	uint32_t numRecordingThreads = static_cast<uint32_t>(std::min<size_t>(
+		std::thread::hardware_concurrency(), numDraws / MinDrawsPerCommandList + 1));
+	auto commandLists = commandQueue->RecordCommandLists(numDraws, [&](CommandList& drawCommandList, size_t first, size_t last)
+	{
+		setFrameState(drawCommandList);
+		m_RenderQueue.Record(drawCommandList, first, last);
+	}, numRecordingThreads);
+	m_RenderQueue.Clear();
+
+	// The clears and the mesh uploads go first.
+	commandLists.insert(commandLists.begin(), commandList);
+	commandQueue->ExecuteCommandLists(commandLists);
 
 	// Present
 	m_pWindow->Present();
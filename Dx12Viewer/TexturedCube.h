@@ -1,5 +1,13 @@
 #pragma once
+#include "BlockModelTable.h"
 #include "Game.h"
+#include "MeshingScheduler.h"
+#include "RenderQueue.h"
+#include "TextureArrayBaker.h"
+#include "TextureStreamer.h"
+#include "VoxelMesher.h"
+
+#include <future>
 
 class TexturedCube : public Game
 {
@@ -14,6 +22,38 @@ protected:
 	Texture m_DefaultTexture;
 	Texture m_MonaLisaTexture;
 
+	// Loads textures in the background.
+	std::unique_ptr<TextureStreamer> m_TextureStreamer;
+
+	// The block textures and block models are baked on a background thread,
+	// which takes a while on the first run and whenever the resource pack changes.
+	struct BakedBlockAssets
+	{
+		std::wstring TextureFileName;
+		TextureArrayBaker::LayerTable Layers;
+		std::wstring ModelFileName;
+	};
+	std::future<BakedBlockAssets> m_BlockAssetBake;
+
+	// All block textures in one texture array, and the layer of each block texture.
+	TextureStreamer::Handle m_BlockTextures;
+	TextureArrayBaker::LayerTable m_BlockLayers;
+
+	// The quads of every block state, and the layer of each of their textures in the block texture array.
+	BlockModelTable m_BlockModels;
+	std::vector<uint32_t> m_BlockModelLayers;
+
+	// A row of block models drawn with the block texture array. The vertices
+	// are built once the models are baked and uploaded on the next frame.
+	CubeVertexCollection m_BlockModelVertices;
+	std::vector<uint32_t> m_BlockModelIndices;
+	std::unique_ptr<Mesh> m_BlockModelMesh;
+
+	// Sections of generated terrain, meshed in the background and drawn once they are integrated.
+	std::unique_ptr<VoxelMesher> m_VoxelMesher;
+	std::unique_ptr<MeshingScheduler> m_MeshingScheduler;
+	std::vector<std::unique_ptr<Mesh>> m_TerrainMeshes;
+
 	// Depth buffer.
 	Texture m_DepthBuffer;
 
@@ -22,6 +62,11 @@ protected:
 
 	// Pipeline state object.
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> m_PipelineState;
+	// Pipeline state object for the VoxelVertex meshes.
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> m_VoxelPipelineState;
+
+	// Sorts the draws of a frame by state.
+	RenderQueue m_RenderQueue;
 
 	D3D12_VIEWPORT m_Viewport;
 	D3D12_RECT m_ScissorRect;
@@ -121,5 +166,8 @@ protected:
 
 	// Resize the depth buffer to match the size of the client area.
 	void ResizeDepthBuffer(int width, int height);
+
+	// Stream in the baked block assets and start meshing the terrain with their layers.
+	void OnBlockAssetsBaked(BakedBlockAssets& assets);
 };
 
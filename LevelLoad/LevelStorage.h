@@ -1,5 +1,6 @@
 #pragma once
 #include "mc.h"
+#include "WorldManifest.h"
 
 namespace MC {
 	using FileArray = std::vector<FS::path>;
@@ -49,8 +50,9 @@ namespace MC {
 
 			FS::path regionFile = this->getRegionPath();
 
-			sprintf_s(DataConversionBuffer, "r.%d.%d.mca", regionX, regionZ);
-			regionFile.append(DataConversionBuffer);
+			wchar_t fileName[_MAX_FNAME];
+			swprintf_s(fileName, L"r.%d.%d.mca", regionX, regionZ);
+			regionFile.append(fileName);
 
 			return regionFile;
 		}
@@ -69,5 +71,20 @@ namespace MC {
 
 			return files;
 		}
+
+		FS::path getManifestFile() const {
+			FS::path manifestFile(m_LevelDir);
+			manifestFile.append(L"region.manifest");
+			return manifestFile;
+		}
+
+		// Load the world manifest and bring it up to date with the region
+		// files, only the headers of changed region files are read.
+		std::unique_ptr<WorldManifest> loadManifest() const {
+			auto manifest = std::make_unique<WorldManifest>(this->getManifestFile());
+			manifest->update(this->getRegionPath());
+			manifest->save();
+			return manifest;
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,283 @@
+#pragma once
+#include <algorithm>
+#include <unordered_map>
+#include "mc.h"
+
+// A persistent index of the region files of a level, so the chunks of a
+// world can be enumerated without opening every .mca file.
+
+namespace MC {
+	struct ChunkPos {
+		int x;
+		int z;
+	};
+
+	using ChunkPosArray = std::vector<ChunkPos>;
+
+	class WorldManifest
+	{
+	public:
+		static const unsigned __int32 FILE_MAGIC = 0x4D57434D; // 'MCWM'
+		static const unsigned __int32 FILE_VERSION = 3;
+		static const int REGION_CHUNKS = 1024;
+
+		// Everything needed from a region file, its header in host byte order.
+		struct RegionEntry {
+			__int32 regionX;
+			__int32 regionZ;
+			unsigned __int64 fileSize;
+			__int64 lastWriteTime;
+			// Indexed by relX + relZ * 32, like the region header.
+			__int32 locations[REGION_CHUNKS];
+			__int32 timestamps[REGION_CHUNKS];
+
+			bool hasChunk(int relX, int relZ) const {
+				return locations[relX + relZ * 32] != 0;
+			}
+		};
+
+	private:
+		struct FileHeader {
+			unsigned __int32 magic;
+			unsigned __int32 version;
+			unsigned __int32 numRegions;
+			unsigned __int32 reserved;
+		};
+
+		FS::path m_FileName;
+		std::vector<RegionEntry> m_Regions;
+		// Index into m_Regions by the packed region coordinates.
+		std::unordered_map<unsigned __int64, size_t> m_Index;
+		bool m_Dirty = false;
+
+		static unsigned __int64 regionKey(int regionX, int regionZ) {
+			return ((unsigned __int64)(unsigned __int32)regionX << 32) | (unsigned __int32)regionZ;
+		}
+
+		static bool parseRegionName(const FS::path& file, int& regionX, int& regionZ) {
+			if (file.extension() != L".mca") {
+				return false;
+			}
+			return swscanf_s(file.filename().c_str(), L"r.%d.%d.mca", &regionX, &regionZ) == 2;
+		}
+
+		// Read the location and timestamp tables, the first two sectors of a region file.
+		static bool readRegionHeader(const FS::path& file, RegionEntry& entry) {
+			int handle = _wopen(file.c_str(), _O_RDONLY | _O_BINARY | _O_SEQUENTIAL, _S_IREAD);
+			if (handle == -1) {
+				return false;
+			}
+
+			// Both tables must be complete, a shorter file is not a region file.
+			bool valid = _read(handle, entry.locations, sizeof(entry.locations)) == sizeof(entry.locations) &&
+				_read(handle, entry.timestamps, sizeof(entry.timestamps)) == sizeof(entry.timestamps);
+			_close(handle);
+			if (!valid) {
+				return false;
+			}
+
+			for (int i = 0; i < REGION_CHUNKS; i++) {
+				entry.locations[i] = BigEndian32(entry.locations + i);
+				entry.timestamps[i] = BigEndian32(entry.timestamps + i);
+			}
+			return true;
+		}
+
+		void rebuildIndex() {
+			m_Index.clear();
+			m_Index.reserve(m_Regions.size());
+			for (size_t i = 0; i < m_Regions.size(); i++) {
+				m_Index[regionKey(m_Regions[i].regionX, m_Regions[i].regionZ)] = i;
+			}
+		}
+
+		void addChunks(const RegionEntry& region, int minX, int maxX, int minZ, int maxZ,
+			int x, int z, __int64 radiusSq, ChunkPosArray& chunks) const {
+			int baseX = region.regionX * 32;
+			int baseZ = region.regionZ * 32;
+			int fromX = (std::max)(minX, baseX), toX = (std::min)(maxX, baseX + 31);
+			int fromZ = (std::max)(minZ, baseZ), toZ = (std::min)(maxZ, baseZ + 31);
+			for (int cz = fromZ; cz <= toZ; cz++) {
+				for (int cx = fromX; cx <= toX; cx++) {
+					__int64 dx = cx - x, dz = cz - z;
+					if (dx * dx + dz * dz <= radiusSq && region.hasChunk(cx - baseX, cz - baseZ)) {
+						chunks.push_back({ cx, cz });
+					}
+				}
+			}
+		}
+
+	public:
+		WorldManifest(const FS::path& fileName) : m_FileName(fileName) {
+			load();
+		}
+
+		const FS::path& getFileName() const { return m_FileName; }
+		const std::vector<RegionEntry>& getRegions() const { return m_Regions; }
+		bool isDirty() const { return m_Dirty; }
+
+		// Read the manifest file. A missing or invalid file leaves the manifest
+		// empty, the next update then reads every region header.
+		bool load() {
+			m_Regions.clear();
+			m_Index.clear();
+			m_Dirty = true;
+
+			FS::ifstream ifs(m_FileName, std::ios_base::binary);
+			FileHeader header;
+			if (!ifs.read((char*)&header, sizeof(header)) ||
+				header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+				return false;
+			}
+
+			m_Regions.resize(header.numRegions);
+			if (!ifs.read((char*)m_Regions.data(), sizeof(RegionEntry) * header.numRegions)) {
+				m_Regions.clear();
+				return false;
+			}
+
+			rebuildIndex();
+			m_Dirty = false;
+			return true;
+		}
+
+		// Bring the manifest up to date with the region directory. Only the
+		// headers of new region files and of files whose size or write time
+		// changed are read, removed files are dropped.
+		// Returns the number of region headers that were read.
+		int update(const FS::path& regionPath) {
+			std::vector<RegionEntry> regions;
+			regions.reserve(m_Regions.size());
+			int numRead = 0;
+
+			boost::system::error_code ec;
+			FS::directory_iterator di(regionPath, ec);
+			FS::directory_iterator dend;
+			for (; !ec && di != dend; di.increment(ec)) {
+				const FS::path& file = di->path();
+				int regionX, regionZ;
+				if (!parseRegionName(file, regionX, regionZ)) {
+					continue;
+				}
+
+				boost::system::error_code sizeError, timeError;
+				unsigned __int64 fileSize = FS::file_size(file, sizeError);
+				__int64 lastWriteTime = FS::last_write_time(file, timeError);
+				if (sizeError || timeError) {
+					continue;
+				}
+
+				auto known = m_Index.find(regionKey(regionX, regionZ));
+				if (known != m_Index.end()) {
+					const RegionEntry& entry = m_Regions[known->second];
+					if (entry.fileSize == fileSize && entry.lastWriteTime == lastWriteTime) {
+						regions.push_back(entry);
+						continue;
+					}
+				}
+
+				regions.emplace_back();
+				RegionEntry& entry = regions.back();
+				entry.regionX = regionX;
+				entry.regionZ = regionZ;
+				entry.fileSize = fileSize;
+				entry.lastWriteTime = lastWriteTime;
+				if (!readRegionHeader(file, entry)) {
+					DebugMessage(L"Manifest can't read region file \"%s\".\n", file.c_str());
+					regions.pop_back();
+					continue;
+				}
+				numRead++;
+			}
+
+			if (numRead > 0 || regions.size() != m_Regions.size()) {
+				m_Dirty = true;
+			}
+			m_Regions.swap(regions);
+			rebuildIndex();
+			return numRead;
+		}
+
+		// Write the manifest file if it changed since it was loaded or saved.
+		bool save() {
+			if (!m_Dirty) {
+				return true;
+			}
+
+			FS::path tempName(m_FileName);
+			tempName += L".tmp";
+			{
+				FS::ofstream ofs(tempName, std::ios_base::binary | std::ios_base::trunc);
+				FileHeader header{ FILE_MAGIC, FILE_VERSION, (unsigned __int32)m_Regions.size(), 0 };
+				ofs.write((const char*)&header, sizeof(header));
+				ofs.write((const char*)m_Regions.data(), sizeof(RegionEntry) * m_Regions.size());
+				if (!ofs) {
+					return false;
+				}
+			}
+
+			boost::system::error_code ec;
+			FS::rename(tempName, m_FileName, ec);
+			if (ec) {
+				FS::remove(tempName, ec);
+				return false;
+			}
+			m_Dirty = false;
+			return true;
+		}
+
+		const RegionEntry* getRegion(int regionX, int regionZ) const {
+			auto it = m_Index.find(regionKey(regionX, regionZ));
+			return it != m_Index.end() ? &m_Regions[it->second] : nullptr;
+		}
+
+		bool hasChunk(int chunkX, int chunkZ) const {
+			const RegionEntry* region = getRegion(chunkX >> 5, chunkZ >> 5);
+			return region && region->hasChunk(chunkX & 31, chunkZ & 31);
+		}
+
+		// The location of a chunk in its region file as stored in the region header, 0 if it doesn't exist.
+		__int32 getChunkLocation(int chunkX, int chunkZ) const {
+			const RegionEntry* region = getRegion(chunkX >> 5, chunkZ >> 5);
+			return region ? region->locations[(chunkX & 31) + (chunkZ & 31) * 32] : 0;
+		}
+
+		__int32 getChunkTimestamp(int chunkX, int chunkZ) const {
+			const RegionEntry* region = getRegion(chunkX >> 5, chunkZ >> 5);
+			return region ? region->timestamps[(chunkX & 31) + (chunkZ & 31) * 32] : 0;
+		}
+
+		// All existing chunks within a radius (in chunks) around a chunk, ordered by region.
+		ChunkPosArray getChunksInRadius(int chunkX, int chunkZ, int radius) const {
+			ChunkPosArray chunks;
+			int minX = chunkX - radius, maxX = chunkX + radius;
+			int minZ = chunkZ - radius, maxZ = chunkZ + radius;
+			__int64 radiusSq = (__int64)radius * radius;
+
+			int minRegionX = minX >> 5, maxRegionX = maxX >> 5;
+			int minRegionZ = minZ >> 5, maxRegionZ = maxZ >> 5;
+			__int64 numRegionsInBox = (__int64)(maxRegionX - minRegionX + 1) * (maxRegionZ - minRegionZ + 1);
+
+			if (numRegionsInBox <= (__int64)m_Regions.size()) {
+				for (int rz = minRegionZ; rz <= maxRegionZ; rz++) {
+					for (int rx = minRegionX; rx <= maxRegionX; rx++) {
+						if (const RegionEntry* region = getRegion(rx, rz)) {
+							addChunks(*region, minX, maxX, minZ, maxZ, chunkX, chunkZ, radiusSq, chunks);
+						}
+					}
+				}
+			}
+			else {
+				// The radius covers more regions than the world has.
+				for (const RegionEntry& region : m_Regions) {
+					if (region.regionX >= minRegionX && region.regionX <= maxRegionX &&
+						region.regionZ >= minRegionZ && region.regionZ <= maxRegionZ) {
+						addChunks(region, minX, maxX, minZ, maxZ, chunkX, chunkZ, radiusSq, chunks);
+					}
+				}
+			}
+
+			return chunks;
+		}
+	};
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace MC {
+
+	// The per-instance data of an instanced block (a unit cube).
+	struct BlockInstance
+	{
+		// Block position relative to the origin of the builder,
+		// x in bits 0-9, y in bits 10-19 and z in bits 20-29.
+		uint32_t PackedPosition;
+		// Texture of the block (layer in the block texture array).
+		uint32_t TextureIndex;
+	};
+	static_assert(sizeof(BlockInstance) == 8, "BlockInstance must match the instance input layout.");
+
+	// Builds the instance buffer of the instanced block path on the CPU.
+	// Blocks are added in any order and grouped by block type by Build, so
+	// every block type is drawn with a single DrawIndexedInstanced call.
+	// Has no dependency on Direct3D so it can be used without a device.
+	class BlockInstanceBuilder
+	{
+	public:
+		static const int PositionBits = 10;
+		static const int PositionRange = 1 << PositionBits;
+
+		// A range of instances that share a block type.
+		struct Batch
+		{
+			uint32_t BlockType;
+			uint32_t FirstInstance;
+			uint32_t InstanceCount;
+		};
+
+		BlockInstanceBuilder(int originX = 0, int originY = 0, int originZ = 0)
+			: m_OriginX(originX), m_OriginY(originY), m_OriginZ(originZ)
+		{
+		}
+
+		// Set the origin of the packed positions. Clears all blocks.
+		void SetOrigin(int originX, int originY, int originZ) {
+			Clear();
+			m_OriginX = originX;
+			m_OriginY = originY;
+			m_OriginZ = originZ;
+		}
+		int GetOriginX() const { return m_OriginX; }
+		int GetOriginY() const { return m_OriginY; }
+		int GetOriginZ() const { return m_OriginZ; }
+
+		// Add a block at world position (x, y, z). Returns false if the block
+		// is more than PositionRange blocks away from the origin.
+		bool Add(uint32_t blockType, int x, int y, int z, uint32_t textureIndex) {
+			x -= m_OriginX;
+			y -= m_OriginY;
+			z -= m_OriginZ;
+			if (x < 0 || x >= PositionRange || y < 0 || y >= PositionRange || z < 0 || z >= PositionRange) {
+				return false;
+			}
+
+			m_Pending.push_back({ blockType, { PackPosition(x, y, z), textureIndex } });
+			return true;
+		}
+
+		// Group the added blocks by block type (in ascending order of block type,
+		// keeping the order in which blocks of a type were added).
+		void Build() {
+			m_Instances.clear();
+			m_Batches.clear();
+
+			uint32_t maxBlockType = 0;
+			for (const auto& pending : m_Pending) {
+				maxBlockType = pending.BlockType > maxBlockType ? pending.BlockType : maxBlockType;
+			}
+
+			std::vector<uint32_t> offsets(m_Pending.empty() ? 0 : maxBlockType + 2, 0);
+			for (const auto& pending : m_Pending) {
+				offsets[pending.BlockType + 1]++;
+			}
+			for (size_t type = 0; type + 1 < offsets.size(); type++) {
+				if (offsets[type + 1] > 0) {
+					m_Batches.push_back({ static_cast<uint32_t>(type), offsets[type], offsets[type + 1] });
+				}
+				offsets[type + 1] += offsets[type];
+			}
+
+			m_Instances.resize(m_Pending.size());
+			for (const auto& pending : m_Pending) {
+				m_Instances[offsets[pending.BlockType]++] = pending.Instance;
+			}
+		}
+
+		// Remove all blocks.
+		void Clear() {
+			m_Pending.clear();
+			m_Instances.clear();
+			m_Batches.clear();
+		}
+
+		size_t GetBlockCount() const { return m_Pending.size(); }
+
+		// The instances grouped by block type (valid after Build).
+		const std::vector<BlockInstance>& GetInstances() const { return m_Instances; }
+		// One batch per block type (valid after Build).
+		const std::vector<Batch>& GetBatches() const { return m_Batches; }
+
+		static uint32_t PackPosition(int x, int y, int z) {
+			assert(x >= 0 && x < PositionRange && y >= 0 && y < PositionRange && z >= 0 && z < PositionRange);
+			return static_cast<uint32_t>(x) | static_cast<uint32_t>(y) << PositionBits | static_cast<uint32_t>(z) << (2 * PositionBits);
+		}
+
+		static void UnpackPosition(uint32_t packedPosition, int& x, int& y, int& z) {
+			const uint32_t mask = PositionRange - 1;
+			x = static_cast<int>(packedPosition & mask);
+			y = static_cast<int>((packedPosition >> PositionBits) & mask);
+			z = static_cast<int>((packedPosition >> (2 * PositionBits)) & mask);
+		}
+
+	private:
+		struct PendingInstance
+		{
+			uint32_t BlockType;
+			BlockInstance Instance;
+		};
+
+		int m_OriginX;
+		int m_OriginY;
+		int m_OriginZ;
+
+		std::vector<PendingInstance> m_Pending;
+		std::vector<BlockInstance> m_Instances;
+		std::vector<Batch> m_Batches;
+	};
+
+}
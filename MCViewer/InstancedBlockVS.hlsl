@@ -0,0 +1,45 @@
+cbuffer Parameters : register(b0)
+{
+	float4x4 ViewProj               : packoffset(c0);
+	// World position of the origin of the packed instance positions.
+	float4 Origin                   : packoffset(c4);
+};
+
+struct VSInputInstanced
+{
+	float4 Position         : SV_Position;
+	float3 Normal           : NORMAL;
+	float2 TexCoord         : TEXCOORD0;
+	// Per instance: x in bits 0-9, y in bits 10-19, z in bits 20-29.
+	uint InstancePosition   : INSTANCEPOSITION;
+	// Per instance: layer of the block texture array (unused until blocks share a texture array).
+	uint TextureIndex       : TEXTUREINDEX;
+};
+
+struct VSOutputTx
+{
+	float4 Diffuse    : COLOR0;
+	float4 Specular   : COLOR1;
+	float2 TexCoord   : TEXCOORD0;
+	float4 PositionPS : SV_Position;
+};
+
+VSOutputTx main(VSInputInstanced vin)
+{
+	VSOutputTx vout;
+
+	float3 blockPosition = float3(
+		vin.InstancePosition & 0x3FF,
+		(vin.InstancePosition >> 10) & 0x3FF,
+		(vin.InstancePosition >> 20) & 0x3FF);
+
+	float4 position = float4(vin.Position.xyz + blockPosition + Origin.xyz, 1.0f);
+
+	vout.PositionPS = mul(position, ViewProj);
+	vout.Diffuse = float4(1.0f, 1.0f, 1.0f, 1.0f);
+	// No fog.
+	vout.Specular = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	vout.TexCoord = vin.TexCoord;
+
+	return vout;
+}
@@ -0,0 +1,193 @@
+#pragma once
+#include "Block.h"
+#include "BlockInstanceBuilder.h"
+
+namespace MC {
+
+	// Draws many unit cube blocks with one DrawIndexedInstanced call per block type.
+	// The per-instance data (packed position and texture index) comes from a
+	// BlockInstanceBuilder, so the input layout and shaders are bound once per
+	// frame instead of once per block.
+	class InstancedBlockRenderer
+	{
+		struct cbParameters {
+			XMMATRIX ViewProj;
+			XMFLOAT4 Origin;
+		};
+
+	public:
+		InstancedBlockRenderer() { };
+
+		InstancedBlockRenderer(InstancedBlockRenderer const&) = delete;
+		InstancedBlockRenderer& operator=(InstancedBlockRenderer const&) = delete;
+
+		HRESULT Initialize(ID3D11Device* device) {
+			VertexCollection vertices;
+			IndexCollection indices;
+			ComputeBox(vertices, indices, XMFLOAT3(1.0f, 1.0f, 1.0f), false, false);
+
+			// Move the box so a block at (x, y, z) covers [x, x + 1] etc.
+			for (auto& vertex : vertices) {
+				vertex.position.x += 0.5f;
+				vertex.position.y += 0.5f;
+				vertex.position.z += 0.5f;
+			}
+			m_IndexCount = static_cast<UINT>(indices.size());
+
+			CreateBuffer(device, vertices, D3D11_BIND_VERTEX_BUFFER, m_VertexBuffer.ReleaseAndGetAddressOf());
+			CreateBuffer(device, indices, D3D11_BIND_INDEX_BUFFER, m_IndexBuffer.ReleaseAndGetAddressOf());
+
+			Microsoft::WRL::ComPtr<ID3DBlob> blob;
+			HRESULT hr = CompileShader(L"InstancedBlockVS.hlsl", "main", "vs_5_0", blob.ReleaseAndGetAddressOf());
+			if (FAILED(hr)) {
+				throw "Failed to compile instanced block vertex shader.";
+			};
+
+			hr = device->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, m_VertexShader.ReleaseAndGetAddressOf());
+			if (FAILED(hr)) {
+				throw "Failed to create instanced block vertex shader.";
+			};
+			DirectX::SetDebugObjectName(m_VertexShader.Get(), "m_InstancedBlockVertexShader");
+
+			const D3D11_INPUT_ELEMENT_DESC inputElements[] = {
+				{ "SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				{ "INSTANCEPOSITION", 0, DXGI_FORMAT_R32_UINT, 1, offsetof(BlockInstance, PackedPosition), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+				{ "TEXTUREINDEX", 0, DXGI_FORMAT_R32_UINT, 1, offsetof(BlockInstance, TextureIndex), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			};
+			hr = device->CreateInputLayout(inputElements, _countof(inputElements),
+				blob->GetBufferPointer(), blob->GetBufferSize(),
+				m_InputLayout.ReleaseAndGetAddressOf());
+			if (FAILED(hr)) {
+				throw "Failed to create instanced block input layout.";
+			};
+			DirectX::SetDebugObjectName(m_InputLayout.Get(), "m_InstancedBlockInputLayout");
+
+			hr = CompileShader(L"PixelShader.hlsl", "main", "ps_5_0", blob.ReleaseAndGetAddressOf());
+			if (FAILED(hr)) {
+				throw "Failed to compile pixel shader.";
+			};
+
+			hr = device->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), nullptr, m_PixelShader.ReleaseAndGetAddressOf());
+			if (FAILED(hr)) {
+				throw "Failed to create pixel shader.";
+			};
+			DirectX::SetDebugObjectName(m_PixelShader.Get(), "m_InstancedBlockPixelShader");
+
+			D3D11_BUFFER_DESC cbds{ 0 };
+			cbds.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+			cbds.ByteWidth = sizeof(cbParameters);
+			cbds.Usage = D3D11_USAGE_DEFAULT;
+			hr = device->CreateBuffer(&cbds, nullptr, m_CbParametersBuffer.ReleaseAndGetAddressOf());
+			if (FAILED(hr)) {
+				throw "Failed to create instanced block constant buffer.";
+			};
+
+			return S_OK;
+		}
+
+		void Reset() {
+			m_VertexShader.Reset();
+			m_PixelShader.Reset();
+			m_InputLayout.Reset();
+			m_VertexBuffer.Reset();
+			m_IndexBuffer.Reset();
+			m_InstanceBuffer.Reset();
+			m_CbParametersBuffer.Reset();
+			m_InstanceCapacity = 0;
+			m_Batches.clear();
+		}
+
+		// Upload the instances of a built BlockInstanceBuilder. The instance buffer
+		// grows (to the next power of two) when it is too small.
+		void Update(ID3D11DeviceContext* deviceContext, const BlockInstanceBuilder& builder) {
+			const auto& instances = builder.GetInstances();
+			m_Batches = builder.GetBatches();
+			m_Origin = XMFLOAT4(static_cast<float>(builder.GetOriginX()), static_cast<float>(builder.GetOriginY()),
+				static_cast<float>(builder.GetOriginZ()), 0.0f);
+
+			if (instances.empty()) {
+				return;
+			}
+
+			if (instances.size() > m_InstanceCapacity) {
+				UINT capacity = 1024;
+				while (capacity < instances.size()) {
+					capacity *= 2;
+				}
+
+				Microsoft::WRL::ComPtr<ID3D11Device> device;
+				deviceContext->GetDevice(device.GetAddressOf());
+
+				D3D11_BUFFER_DESC bufferDesc = {};
+				bufferDesc.ByteWidth = capacity * sizeof(BlockInstance);
+				bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+				bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+				bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+				ThrowIfFailed(device->CreateBuffer(&bufferDesc, nullptr, m_InstanceBuffer.ReleaseAndGetAddressOf()));
+				DirectX::SetDebugObjectName(m_InstanceBuffer.Get(), "m_InstanceBuffer");
+
+				m_InstanceCapacity = capacity;
+			}
+
+			D3D11_MAPPED_SUBRESOURCE mapped;
+			ThrowIfFailed(deviceContext->Map(m_InstanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+			memcpy(mapped.pData, instances.data(), instances.size() * sizeof(BlockInstance));
+			deviceContext->Unmap(m_InstanceBuffer.Get(), 0);
+		}
+
+		// Draw all instances. textures[blockType] is bound for the batch of a
+		// block type if it is in range and not null.
+		void XM_CALLCONV Draw(ID3D11DeviceContext* deviceContext,
+			DirectX::FXMMATRIX view,
+			DirectX::CXMMATRIX projection,
+			ID3D11ShaderResourceView* const* textures, size_t numTextures)
+		{
+			if (m_Batches.empty()) {
+				return;
+			}
+
+			cbParameters parameters;
+			parameters.ViewProj = XMMatrixTranspose(XMMatrixMultiply(view, projection));
+			parameters.Origin = m_Origin;
+			deviceContext->UpdateSubresource(m_CbParametersBuffer.Get(), 0, nullptr, &parameters, 0, 0);
+
+			deviceContext->IASetInputLayout(m_InputLayout.Get());
+			deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			deviceContext->IASetIndexBuffer(m_IndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+			UINT strides[2] = { sizeof(FaceVertexType), sizeof(BlockInstance) };
+			UINT offsets[2] = { 0, 0 };
+			ID3D11Buffer* buffers[2] = { m_VertexBuffer.Get(), m_InstanceBuffer.Get() };
+			deviceContext->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+
+			deviceContext->VSSetShader(m_VertexShader.Get(), nullptr, 0);
+			deviceContext->VSSetConstantBuffers(0, 1, m_CbParametersBuffer.GetAddressOf());
+			deviceContext->PSSetShader(m_PixelShader.Get(), nullptr, 0);
+
+			for (const auto& batch : m_Batches) {
+				if (textures && batch.BlockType < numTextures && textures[batch.BlockType]) {
+					deviceContext->PSSetShaderResources(0, 1, &textures[batch.BlockType]);
+				}
+				deviceContext->DrawIndexedInstanced(m_IndexCount, batch.InstanceCount, 0, 0, batch.FirstInstance);
+			}
+		}
+
+		// The number of draw calls issued by Draw.
+		size_t GetDrawCount() const { return m_Batches.size(); }
+
+	private:
+		Microsoft::WRL::ComPtr<ID3D11VertexShader> m_VertexShader{ nullptr };
+		Microsoft::WRL::ComPtr<ID3D11PixelShader> m_PixelShader{ nullptr };
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> m_InputLayout{ nullptr };
+		Microsoft::WRL::ComPtr<ID3D11Buffer> m_VertexBuffer{ nullptr };
+		Microsoft::WRL::ComPtr<ID3D11Buffer> m_IndexBuffer{ nullptr };
+		Microsoft::WRL::ComPtr<ID3D11Buffer> m_InstanceBuffer{ nullptr };
+		Microsoft::WRL::ComPtr<ID3D11Buffer> m_CbParametersBuffer{ nullptr };
+		UINT m_IndexCount{ 0 };
+		UINT m_InstanceCapacity{ 0 };
+		XMFLOAT4 m_Origin{ 0.0f, 0.0f, 0.0f, 0.0f };
+		std::vector<BlockInstanceBuilder::Batch> m_Batches;
+	};
+
+}
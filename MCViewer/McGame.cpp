@@ -105,6 +105,8 @@ namespace MC {
 			CreateWICTextureFromFile(device, L"E:/Games/MineCraft/assets/minecraft/textures/blocks/grass_top.png", nullptr,
 				m_texture.ReleaseAndGetAddressOf()));
 
+		m_BlockRenderer.Initialize(device);
+
 #pragma region Region
 		{
 			int chunkX = PositionToChunk((int)posX);
@@ -120,6 +122,10 @@ namespace MC {
 			RegionFile regionFile(regionFileName);
 			std::vector<std::shared_ptr<CompoundTag>> regions = regionFile.ReadChunks(chunkX, chunkZ);
 
+			// Center the packed instance positions on the chunk of the player.
+			const int halfRange = BlockInstanceBuilder::PositionRange / 2;
+			m_BlockInstances.SetOrigin(offsetX - halfRange, 0, offsetZ - halfRange);
+
 			for (auto r = regions.begin(); r != regions.end(); r++) {
 				auto regionLevel = (*r)->getCompound(L"Level");
 				int size;
@@ -132,9 +138,14 @@ namespace MC {
 						int y = heightMap.get()[x * 16 + z];
 						//auto block = new Block(device, context, offsetX + x, y, offsetZ + z);
 						//m_Blocks.emplace_back(block);
+						// The height map holds the first air block above the column.
+						m_BlockInstances.Add(0, offsetX + x, y - 1, offsetZ + z, 0);
 					}
 				}
 			}
+
+			m_BlockInstances.Build();
+			m_BlockRenderer.Update(context, m_BlockInstances);
 		}
 		//int chunks[][2] = {
 		//{ chunkX - 2, chunkZ - 2 },
@@ -270,6 +281,7 @@ namespace MC {
 	{
 		//m_model.reset();
 		m_texture.Reset();
+		m_BlockRenderer.Reset();
 	}
 
 	void McGame::OnRender(ID3D11DeviceContext1 * context)
@@ -281,6 +293,9 @@ namespace MC {
 			auto block = *b;
 			block->Draw(context, m_view, m_proj);
 		}
+
+		ID3D11ShaderResourceView* blockTextures[] = { m_texture.Get() };
+		m_BlockRenderer.Draw(context, m_view, m_proj, blockTextures, _countof(blockTextures));
 	}
 
 	void McGame::OnUpdate(DX::StepTimer const& timer)
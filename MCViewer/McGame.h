@@ -3,6 +3,7 @@
 #include "mc.h"
 #include "nbttag.h"
 #include "Block.h"
+#include "InstancedBlocks.h"
 #include <wrl.h>
 
 namespace MC
@@ -37,6 +38,9 @@ namespace MC
 	private:
 		std::unique_ptr<CompoundTag> m_Root;
 		std::vector<std::shared_ptr<MC::Block>> m_Blocks;
+		// The blocks are drawn instanced, one draw call per block type.
+		BlockInstanceBuilder m_BlockInstances;
+		InstancedBlockRenderer m_BlockRenderer;
 		//std::unique_ptr<DirectX::BasicEffect> m_effect;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_texture;
 	};
@@ -8,6 +8,11 @@
 #include <memory>
 
 namespace MineCraft {
+	// A region file holds 32x32 chunks behind a header of two 4 KiB tables
+	// (chunk locations, then chunk timestamps).
+	const int REGION_CHUNKS = 1024;
+	const UInt REGION_HEADER_SIZE = 8192;
+
 	struct ChunkInformation {
 		int relX;
 		int relZ;
@@ -22,8 +27,21 @@ namespace MineCraft {
 
 		CompoundTag* LoadFromUncompressedData(ByteBuffer* buffer, const wchar_t* name);
 
-		CompoundTag* LoadRegionFile(const wchar_t* filePathName);
+		CompoundTag* LoadRegionFile(const wchar_t* filePathName, CompoundTag** slots = nullptr);
+
+		// Parses all chunks of a region into an unnamed compound tag per chunk, in slot order
+		// (relZ * 32 + relX). If slots is given it must hold REGION_CHUNKS entries and receives
+		// the chunk tag of every slot, nullptr for the chunks that are not stored in the region.
+		// The chunk tags are owned by the returned tag.
+		CompoundTag* LoadRegionData(const Byte8* data, UInt length, CompoundTag** slots = nullptr);
+
+		// Reads the location and timestamp of all chunks from the header of a region file.
+		// chunks must hold REGION_CHUNKS entries; absent chunks have an offset of 0.
+		void ReadRegionHeader(const Byte8* data, UInt length, ChunkInformation* chunks);
 
-		CompoundTag* LoadRegionData(const Byte8* data, UInt length);
+		// Inflates and parses one chunk of a region file, without touching the other chunks.
+		// Returns nullptr if the chunk is not stored in the region. The chunk tag
+		// is unnamed unless a name is given.
+		CompoundTag* LoadRegionChunk(const Byte8* data, UInt length, const ChunkInformation& chunk, const wchar_t* name = nullptr);
 	}
 }
\ No newline at end of file
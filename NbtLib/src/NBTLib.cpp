@@ -119,7 +119,7 @@ namespace MineCraft {
 		return root;
 	}
 
-	CompoundTagPtr NbtReader::LoadRegionFile(const wchar_t* filePathName) {
+	CompoundTagPtr NbtReader::LoadRegionFile(const wchar_t* filePathName, CompoundTag** slots) {
 		std::ifstream ifs(filePathName, std::ios::binary | std::ios::ate);
 		if (!ifs) {
 			return nullptr;
@@ -133,72 +133,88 @@ namespace MineCraft {
 		ifs.read(bytes.get(), length);
 		ifs.close();
 
-		CompoundTagPtr compound = LoadRegionData(bytes.get(), length);
+		CompoundTagPtr compound = LoadRegionData(bytes.get(), length, slots);
 
 		return compound;
 	}
 
-	CompoundTagPtr NbtReader::LoadRegionData(const Byte8* data, UInt length) {
-		MemoryByteReader reader(data, length);
+	CompoundTagPtr NbtReader::LoadRegionData(const Byte8* data, UInt length, CompoundTag** slots) {
+		ChunkInformation chunks[REGION_CHUNKS];
+		ReadRegionHeader(data, length, chunks);
+
+		CompoundTagPtr root = new CompoundTag(L"root");
+
+		// The chunks are found by slot, not by a formatted "x,z" name.
+		for (int i = 0; i < REGION_CHUNKS; i++) {
+			CompoundTagPtr tagChunk = LoadRegionChunk(data, length, chunks[i]);
+			if (nullptr != slots) {
+				slots[i] = tagChunk;
+			}
+			if (nullptr != tagChunk) {
+				root->Add(&tagChunk);
+			}
+		}
+
+		return root;
+	}
+
+	void NbtReader::ReadRegionHeader(const Byte8* data, UInt length, ChunkInformation* chunks) {
+		if (length < REGION_HEADER_SIZE) {
+			throw "File overflow";
+		}
+
+		MemoryByteReader reader(data, REGION_HEADER_SIZE);
 		ByteBuffer buffer(&reader);
 
-		ChunkInformation chunks[1024];
-		for (int i = 0; i < 1024; i++) {
+		for (int i = 0; i < REGION_CHUNKS; i++) {
 			chunks[i].offset = buffer.ReadThreeBytesInt();
 			chunks[i].roundedSize = buffer.ReadByte();
 			chunks[i].relX = i % 32;
-			chunks[i].relZ = (int)((float)i / 32.0f);
+			chunks[i].relZ = i / 32;
 		}
 
-		for (int i = 0; i < 1024; i++) {
+		for (int i = 0; i < REGION_CHUNKS; i++) {
 			chunks[i].lastChange = buffer.ReadInt();
 		}
+	}
+
+	CompoundTagPtr NbtReader::LoadRegionChunk(const Byte8* data, UInt length, const ChunkInformation& chunk, const wchar_t* name) {
+		if (0 == chunk.offset) {
+			return nullptr;
+		}
 
-		CompoundTagPtr root = new CompoundTag(L"root");
+		UInt offset = (chunk.offset - 2) * 4096 + REGION_HEADER_SIZE;
+		if (offset + 3 >= length) {
+			throw "File overflow";
+		}
 
-		wchar_t chunkName[64];
-		for (int i = 0; i < 1024; i++) {
-			ChunkInformation* chunk = chunks + i;
-			if (0 == chunk->offset) {
-				continue;
-			}
+		UInt size = (((data[offset] & 0x0f) << 24) | ((data[offset + 1] & 0xff) << 16) | ((data[offset + 2] & 0xff) << 8) | (data[offset + 3] & 0xff)) - 1;
+		if (offset + 5 + size >= length) {
+			throw "File overflow";
+		}
 
-			UInt offset = (chunk->offset - 2) * 4096 + 8192;
-			if (offset + 3 >= length) {
-				throw "File overflow";
-			}
+		Byte8 commpressionType = data[offset + 4];
+		if (NbtCommpressType::ZlibCompressed != commpressionType) {
+			throw "Chunk must be gzip compressed";
+		}
 
-			UInt size = (((data[offset] & 0x0f) << 24) | ((data[offset + 1] & 0xff) << 16) | ((data[offset + 2] & 0xff) << 8) | (data[offset + 3] & 0xff)) - 1;
-			if (offset + 5 + size >= length) {
-				throw "File overflow";
-			}
+		GzipByteReader chunkReader(data + offset + 5, size, false);
+		ByteBuffer chunkBuffer(&chunkReader);
+		//std::ofstream bin("chunk.nbt", std::ios::binary);
+		//bin.write(chunkReader.Get(), chunkReader.Size());
+		//bin.close();
 
-			Byte8 commpressionType = data[offset + 4];
-			if (NbtCommpressType::ZlibCompressed != commpressionType) {
-				throw "Chunk must be gzip compressed";
-			}
+		CompoundTagPtr tagChunk = LoadFromUncompressedData(&chunkBuffer, name);
 
-			GzipByteReader chunkReader(data + offset + 5, size, false);
-			ByteBuffer chunkBuffer(&chunkReader);
-			//std::ofstream bin("chunk.nbt", std::ios::binary);
-			//bin.write(chunkReader.Get(), chunkReader.Size());
-			//bin.close();
-
-			wsprintfW(chunkName, L"%d,%d", chunk->relX, chunk->relZ);
-			CompoundTagPtr tagChunk = LoadFromUncompressedData(&chunkBuffer, chunkName);
-
-			if (nullptr == tagChunk->GetByName<IntTag>(L"LastChange")) {
-				IntTag* tag = NbtTag::FromType<IntTag>(NbtTagType::Int, L"LastChange");
-				if (nullptr != tag) {
-					tag->SetValue((void*)&chunk->lastChange);
-					tagChunk->Add(&tag);
-				}
+		if (nullptr == tagChunk->GetByName<IntTag>(L"LastChange")) {
+			IntTag* tag = NbtTag::FromType<IntTag>(NbtTagType::Int, L"LastChange");
+			if (nullptr != tag) {
+				tag->SetValue((void*)&chunk.lastChange);
+				tagChunk->Add(&tag);
 			}
-
-			root->Add(&tagChunk);
 		}
 
-		return root;
+		return tagChunk;
 	}
 
 	StringW UTF8ToWString(const Byte8* srcString, unsigned int srcLength) {
@@ -0,0 +1,409 @@
+#include "stdafx.h"
+#include "ChunkCache.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <fstream>
+
+namespace MineCraft {
+	namespace {
+		// The location entry of a chunk as it is stored in the region header.
+		inline uint32_t ChunkLocation(const ChunkInformation& chunk) {
+			return ((uint32_t)chunk.offset << 8) | (uint8_t)chunk.roundedSize;
+		}
+
+		std::wstring CacheFileName(const std::wstring& regionFileName) {
+			// r.X.Z.mca -> r.X.Z.mcc
+			return regionFileName.substr(0, regionFileName.size() - 1) + L"c";
+		}
+
+		std::unique_ptr<Byte8[]> ReadWholeFile(const std::wstring& fileName, UInt& length) {
+			std::ifstream ifs(fileName, std::ios::binary | std::ios::ate);
+			if (!ifs) {
+				return nullptr;
+			}
+			length = (UInt)ifs.tellg();
+			ifs.seekg(0, std::ios::beg);
+			std::unique_ptr<Byte8[]> bytes = std::make_unique<Byte8[]>(length);
+			if (!ifs.read(bytes.get(), length)) {
+				return nullptr;
+			}
+			return bytes;
+		}
+
+		bool WriteAt(HANDLE file, uint64_t offset, const void* data, DWORD size) {
+			OVERLAPPED overlapped = {};
+			overlapped.Offset = (DWORD)offset;
+			overlapped.OffsetHigh = (DWORD)(offset >> 32);
+			DWORD numWritten = 0;
+			return WriteFile(file, data, size, &numWritten, &overlapped) && size == numWritten;
+		}
+	}
+
+	ChunkCache::ChunkCache(const wchar_t* savePath)
+		: m_SavePath(savePath)
+		, m_NumCacheHits(0)
+		, m_NumDecoded(0)
+		, m_NumRegionsWritten(0)
+	{}
+
+	ChunkCache::~ChunkCache() {
+		WriteBack();
+		for (auto& thread : m_WriteThreads) {
+			thread.join();
+		}
+	}
+
+	ChunkCache::Region* ChunkCache::GetRegion(int regionX, int regionZ) {
+		std::unique_ptr<Region>* found = m_Regions.Find(regionX, regionZ);
+		if (nullptr != found) {
+			return found->get();
+		}
+
+		// The file name is only formatted when a region is seen for the first time.
+		wchar_t fileName[MAX_PATH];
+		wsprintfW(fileName, L"%s/region/r.%i.%i.mca", m_SavePath.c_str(), regionX, regionZ);
+
+		// Only the header of the region file is read until a chunk has to be decoded.
+		std::unique_ptr<Region> region;
+		std::ifstream ifs(fileName, std::ios::binary);
+		auto header = std::make_unique<Byte8[]>(REGION_HEADER_SIZE);
+		if (ifs.read(header.get(), REGION_HEADER_SIZE)) {
+			region = std::make_unique<Region>();
+			region->RegionX = regionX;
+			region->RegionZ = regionZ;
+			region->FileName = fileName;
+			region->Length = 0;
+			region->Appended = false;
+			region->Cache = nullptr;
+			region->CachedSections = nullptr;
+			NbtReader::ReadRegionHeader(header.get(), REGION_HEADER_SIZE, region->Chunks);
+			OpenCache(*region);
+		}
+
+		std::unique_ptr<Region>& slot = m_Regions.Insert(regionX, regionZ);
+		slot = std::move(region);
+		return slot.get();
+	}
+
+	bool ChunkCache::IsValidHeader(const ChunkCacheHeader& header, int32_t regionX, int32_t regionZ, uint64_t size) {
+		bool valid = FileMagic == header.Magic && FileVersion == header.Version &&
+			regionX == header.RegionX && regionZ == header.RegionZ &&
+			sizeof(ChunkCacheHeader) + (uint64_t)header.NumSections * sizeof(CachedSection) <= size;
+		for (int i = 0; valid && i < REGION_CHUNKS; i++) {
+			const CachedChunk& chunk = header.Chunks[i];
+			valid = (uint64_t)chunk.FirstSection + chunk.NumSections <= header.NumSections;
+		}
+		return valid;
+	}
+
+	void ChunkCache::OpenCache(Region& region) {
+		// Shared for writing, so a write back can append to the file while it is mapped.
+		MappedFile cacheFile;
+		if (!cacheFile.Open(CacheFileName(region.FileName).c_str(), FILE_SHARE_READ | FILE_SHARE_WRITE) ||
+			cacheFile.GetSize() < sizeof(ChunkCacheHeader)) {
+			return;
+		}
+
+		// Validate the tables once, so the cached chunks can be used without checks.
+		const ChunkCacheHeader* header = (const ChunkCacheHeader*)cacheFile.GetData();
+		if (!IsValidHeader(*header, region.RegionX, region.RegionZ, cacheFile.GetSize())) {
+			return;
+		}
+
+		region.Cache = header;
+		region.CachedSections = (const CachedSection*)(cacheFile.GetData() + sizeof(ChunkCacheHeader));
+		region.CacheFile = std::move(cacheFile);
+	}
+
+	// The header entries of a mapped cache file are read while a write back
+	// appends to the same file. AppendToCacheFile only writes the entries of
+	// the chunks it appends, and those chunks stay in Decoded until the region
+	// is remapped, so IsCached must never be asked for a decoded chunk of an
+	// appended region. Every other entry of the mapping is left as it is.
+	bool ChunkCache::IsCached(const Region& region, int index) const {
+		assert(!region.Appended || nullptr == region.Decoded[index]);
+		if (nullptr == region.Cache) {
+			return false;
+		}
+		const CachedChunk& cached = region.Cache->Chunks[index];
+		const ChunkInformation& chunk = region.Chunks[index];
+		return 0 != cached.Location && ChunkLocation(chunk) == cached.Location && chunk.lastChange == cached.Timestamp;
+	}
+
+	bool ChunkCache::GetChunk(int xChunk, int zChunk, const CachedChunk*& chunk, const CachedSection*& sections) {
+		Region* region = GetRegion(xChunk >> 5, zChunk >> 5);
+		if (nullptr == region) {
+			return false;
+		}
+
+		int index = ((zChunk & 31) << 5) | (xChunk & 31);
+		if (0 == region->Chunks[index].offset) {
+			return false;
+		}
+
+		const DecodedChunk* decoded = region->Decoded[index].get();
+		if (nullptr != decoded) {
+			chunk = &decoded->Chunk;
+			sections = decoded->Sections.data();
+			return true;
+		}
+
+		if (IsCached(*region, index)) {
+			m_NumCacheHits++;
+			chunk = &region->Cache->Chunks[index];
+			sections = region->CachedSections + chunk->FirstSection;
+			return true;
+		}
+
+		std::unique_ptr<DecodedChunk> decodedChunk = std::make_unique<DecodedChunk>();
+		DecodeChunk(*region, index, *decodedChunk);
+		m_NumDecoded++;
+
+		chunk = &decodedChunk->Chunk;
+		sections = decodedChunk->Sections.data();
+		region->Decoded[index] = std::move(decodedChunk);
+		region->Dirty.push_back((uint16_t)index);
+		return true;
+	}
+
+	void ChunkCache::DecodeChunk(Region& region, int index, DecodedChunk& decoded) {
+		if (!region.Data) {
+			region.Data = ReadWholeFile(region.FileName, region.Length);
+			if (!region.Data) {
+				throw "Open file fail.";
+			}
+		}
+
+		const ChunkInformation& information = region.Chunks[index];
+		std::unique_ptr<CompoundTag> chunk(NbtReader::LoadRegionChunk(region.Data.get(), region.Length, information));
+		CompoundTagPtr _Level = chunk->GetByName<CompoundTag>(L"Level");
+		IntTag* _DataVersion = chunk->GetByName<IntTag>(L"DataVersion");
+		if (nullptr == _DataVersion || nullptr == _Level) {
+			throw "Error chunk format";
+		}
+
+		Int32 datVersion;
+		_DataVersion->GetValue(&datVersion);
+		if (datVersion != 1343) {
+			throw "Unsupported chunk version";
+		}
+
+		IntTag* _XPos = _Level->GetByName<IntTag>(L"xPos");
+		IntTag* _ZPos = _Level->GetByName<IntTag>(L"zPos");
+		if (nullptr == _XPos || nullptr == _ZPos) {
+			throw "Error chunk format";
+		}
+
+		decoded.Chunk = {};
+		decoded.Chunk.Location = ChunkLocation(information);
+		decoded.Chunk.Timestamp = information.lastChange;
+		_XPos->GetValue(&decoded.Chunk.XPos);
+		_ZPos->GetValue(&decoded.Chunk.ZPos);
+
+		short blockIds[SECTION_BLOCKS];
+		ListTagPtr _Sections = _Level->GetByName<ListTag>(L"Sections");
+		for (int s = 0; nullptr != _Sections && s < _Sections->Size(); s++) {
+			CompoundTagPtr section = _Sections->GetByIndex<CompoundTag>(s);
+			if (nullptr == section) {
+				continue;
+			}
+			auto _Y = section->GetByName<ByteTag>(L"Y");
+			auto _Blocks = section->GetByName<ByteArrayTag>(L"Blocks");
+			auto _Data = section->GetByName<ByteArrayTag>(L"Data");
+			if (nullptr == _Y || nullptr == _Blocks || nullptr == _Data || _Blocks->Size() != SECTION_BLOCKS || _Data->Size() != SECTION_BLOCKS / 2) {
+				throw "Error chunk format";
+			}
+
+			decoded.Sections.push_back(CachedSection());
+			CachedSection& cached = decoded.Sections.back();
+			Byte8 y;
+			_Y->GetValue(&y);
+			cached.Y = y;
+			cached.Reserved = 0;
+
+			const uint8_t* blocks = (const uint8_t*)_Blocks->Value();
+			const uint8_t* datas = (const uint8_t*)_Data->Value();
+			auto _Add = section->GetByName<ByteArrayTag>(L"Add");
+			const uint8_t* adds = nullptr != _Add && _Add->Size() == SECTION_BLOCKS / 2 ? (const uint8_t*)_Add->Value() : nullptr;
+			for (int b = 0; b < SECTION_BLOCKS; b++) {
+				int shift = (b & 1) << 2;
+				short id = blocks[b];
+				if (nullptr != adds) {
+					id |= ((adds[b >> 1] >> shift) & 0x0F) << 8;
+				}
+				blockIds[b] = id;
+				cached.States[b] = (uint16_t)((id << 4) | ((datas[b >> 1] >> shift) & 0x0F));
+			}
+
+			auto _BlockLight = section->GetByName<ByteArrayTag>(L"BlockLight");
+			auto _SkyLight = section->GetByName<ByteArrayTag>(L"SkyLight");
+			if (nullptr != _BlockLight && _BlockLight->Size() == SECTION_BLOCKS / 2) {
+				memcpy(cached.BlockLight, _BlockLight->Value(), sizeof(cached.BlockLight));
+			}
+			else {
+				memset(cached.BlockLight, 0, sizeof(cached.BlockLight));
+			}
+			if (nullptr != _SkyLight && _SkyLight->Size() == SECTION_BLOCKS / 2) {
+				memcpy(cached.SkyLight, _SkyLight->Value(), sizeof(cached.SkyLight));
+			}
+			else {
+				memset(cached.SkyLight, 0, sizeof(cached.SkyLight));
+			}
+
+			cached.Summary.Compute(blockIds);
+		}
+
+		decoded.Chunk.NumSections = (uint32_t)decoded.Sections.size();
+	}
+
+	void ChunkCache::RemapRegion(Region& region) {
+		// The write back that appended to the region has finished, so the new
+		// mapping sees the appended chunks.
+		region.Appended = false;
+		region.CacheFile.Close();
+		region.Cache = nullptr;
+		region.CachedSections = nullptr;
+		OpenCache(region);
+
+		for (int i = 0; i < REGION_CHUNKS; i++) {
+			if (nullptr == region.Decoded[i]) {
+				continue;
+			}
+			if (IsCached(region, i)) {
+				region.Decoded[i].reset();
+			}
+			else if (std::find(region.Dirty.begin(), region.Dirty.end(), (uint16_t)i) == region.Dirty.end()) {
+				// The append failed, try again with the next write back.
+				region.Dirty.push_back((uint16_t)i);
+			}
+		}
+
+		// Read again when the next chunk has to be decoded.
+		region.Data.reset();
+		region.Length = 0;
+	}
+
+	bool ChunkCache::AppendToCacheFile(const CacheWrite& write) {
+		// The reader maps the cache file shared for writing, so it can be appended to while it is mapped.
+		HANDLE file = CreateFileW(write.FileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+			nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (INVALID_HANDLE_VALUE == file) {
+			return false;
+		}
+
+		std::unique_ptr<ChunkCacheHeader> header = std::make_unique<ChunkCacheHeader>();
+		LARGE_INTEGER fileSize = {};
+		DWORD numRead = 0;
+		bool valid = GetFileSizeEx(file, &fileSize) &&
+			ReadFile(file, header.get(), sizeof(ChunkCacheHeader), &numRead, nullptr) && sizeof(ChunkCacheHeader) == numRead &&
+			IsValidHeader(*header, write.RegionX, write.RegionZ, (uint64_t)fileSize.QuadPart);
+		if (!valid) {
+			// A new or invalid cache file is not mapped, so it starts over.
+			memset(header.get(), 0, sizeof(ChunkCacheHeader));
+			header->Magic = FileMagic;
+			header->Version = FileVersion;
+			header->RegionX = write.RegionX;
+			header->RegionZ = write.RegionZ;
+		}
+
+		// The sections go after the ones in use, over anything an interrupted append left.
+		uint64_t offset = sizeof(ChunkCacheHeader) + (uint64_t)header->NumSections * sizeof(CachedSection);
+		bool written = true;
+		for (auto& chunk : write.Chunks) {
+			const DecodedChunk* decoded = chunk.second;
+			CachedChunk& cached = header->Chunks[chunk.first];
+			cached = decoded->Chunk;
+			cached.FirstSection = header->NumSections;
+			header->NumSections += decoded->Chunk.NumSections;
+
+			DWORD size = (DWORD)(decoded->Chunk.NumSections * sizeof(CachedSection));
+			written = written && (0 == size || WriteAt(file, offset, decoded->Sections.data(), size));
+			offset += size;
+		}
+
+		// The header is written last, so an interrupted append leaves the cached chunks intact.
+		written = written && FlushFileBuffers(file);
+		if (!valid) {
+			// Not mapped, see OpenCache.
+			written = written && WriteAt(file, 0, header.get(), sizeof(ChunkCacheHeader));
+		}
+		else {
+			// The file may be mapped by the reader, which keeps reading the entries of
+			// the other chunks (see IsCached). Only the fixed fields and the entries of
+			// the appended chunks are written, in runs of consecutive indices.
+			written = written && WriteAt(file, 0, header.get(), offsetof(ChunkCacheHeader, Chunks));
+
+			std::vector<uint16_t> indices;
+			for (auto& chunk : write.Chunks) {
+				indices.push_back(chunk.first);
+			}
+			std::sort(indices.begin(), indices.end());
+			indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+			for (size_t first = 0; written && first < indices.size(); ) {
+				size_t last = first + 1;
+				while (last < indices.size() && indices[last] == indices[last - 1] + 1) {
+					last++;
+				}
+				written = WriteAt(file, offsetof(ChunkCacheHeader, Chunks) + indices[first] * sizeof(CachedChunk),
+					&header->Chunks[indices[first]], (DWORD)((last - first) * sizeof(CachedChunk)));
+				first = last;
+			}
+		}
+		CloseHandle(file);
+		return written;
+	}
+
+	void ChunkCache::WriteBack() {
+		// The previous write back must have finished before its regions are remapped.
+		for (auto& thread : m_WriteThreads) {
+			thread.join();
+		}
+		m_WriteThreads.clear();
+
+		std::vector<CacheWrite> writes;
+		m_Regions.ForEach([this, &writes](std::unique_ptr<Region>& region) {
+			if (nullptr == region) {
+				return;
+			}
+			if (region->Appended) {
+				RemapRegion(*region);
+			}
+			if (region->Dirty.empty()) {
+				return;
+			}
+
+			// The decoded chunks stay alive until the region is remapped by the next write back.
+			CacheWrite write;
+			write.FileName = CacheFileName(region->FileName);
+			write.RegionX = region->RegionX;
+			write.RegionZ = region->RegionZ;
+			for (uint16_t index : region->Dirty) {
+				write.Chunks.emplace_back(index, region->Decoded[index].get());
+			}
+			region->Dirty.clear();
+			region->Appended = true;
+			writes.push_back(std::move(write));
+		});
+
+		if (writes.empty()) {
+			return;
+		}
+
+		m_WriteThreads.emplace_back([this, writes = std::move(writes)]() {
+			for (auto& write : writes) {
+				if (AppendToCacheFile(write)) {
+					m_NumRegionsWritten++;
+				}
+			}
+		});
+	}
+
+	ChunkCache::Statistics ChunkCache::GetStatistics() const {
+		Statistics statistics;
+		statistics.NumCacheHits = m_NumCacheHits;
+		statistics.NumDecoded = m_NumDecoded;
+		statistics.NumRegionsWritten = m_NumRegionsWritten;
+		return statistics;
+	}
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <MappedFile.h>
+#include "RegionTable.h"
+#include "SectionSummary.h"
+#include "NbtReader.h"
+
+namespace MineCraft {
+	// A section as the viewer uses it, decoded from the chunk NBT once.
+	struct CachedSection {
+		int32_t Y;
+		uint32_t Reserved;
+		SectionSummary Summary;
+		// (id << 4) | data of every block, indexed by SectionBlockIndex.
+		uint16_t States[SECTION_BLOCKS];
+		// Two blocks per byte like the NBT arrays, the low nibble is the block with the even index.
+		uint8_t BlockLight[SECTION_BLOCKS / 2];
+		uint8_t SkyLight[SECTION_BLOCKS / 2];
+
+		inline short BlockId(int index) const { return (short)(States[index] >> 4); }
+		inline Byte8 BlockData(int index) const { return (Byte8)(States[index] & 0x0F); }
+	};
+
+	struct CachedChunk {
+		// The location and timestamp of the chunk in the region header when it was decoded.
+		// A location of 0 means the chunk is not cached.
+		uint32_t Location;
+		int32_t Timestamp;
+		int32_t XPos;
+		int32_t ZPos;
+		// The sections of the chunk, in the section table of the cache file.
+		uint32_t FirstSection;
+		uint32_t NumSections;
+	};
+
+	struct ChunkCacheHeader {
+		uint32_t Magic;
+		uint32_t Version;
+		int32_t RegionX;
+		int32_t RegionZ;
+		uint32_t NumSections;
+		uint32_t Reserved;
+		// Indexed by relZ * 32 + relX, like the region header.
+		CachedChunk Chunks[REGION_CHUNKS];
+	};
+
+	static_assert(sizeof(CachedSection) == 12816, "The layout of the chunk cache file has changed.");
+	static_assert(sizeof(ChunkCacheHeader) % 8 == 0, "The sections of the chunk cache file must be aligned.");
+
+	// A persistent cache of decoded chunks, one sidecar file (r.X.Z.mcc) per
+	// region file. The cache files are mapped and the sections are used in
+	// place, so a warm startup neither inflates nor parses NBT.
+	//
+	// A cached chunk is only used if its location and timestamp still match
+	// the region header; everything else is decoded from the region file.
+	// WriteBack appends the newly decoded chunks to the cache files on a
+	// background thread and rewrites only their header entries, the chunks
+	// that are already cached are never copied or rewritten. Sections of
+	// replaced chunks are left unused in the file.
+	class ChunkCache {
+	public:
+		static const uint32_t FileMagic = 0x4343434D; // 'MCCC'
+		static const uint32_t FileVersion = 1;
+
+		struct Statistics {
+			uint64_t NumCacheHits = 0;
+			uint64_t NumDecoded = 0;
+			uint64_t NumRegionsWritten = 0;
+		};
+
+		ChunkCache(const wchar_t* savePath);
+		~ChunkCache();
+
+		ChunkCache(const ChunkCache&) = delete;
+		ChunkCache& operator=(const ChunkCache&) = delete;
+
+		// Get the decoded sections of a chunk. Returns false if the region or
+		// the chunk does not exist. The pointers stay valid until the next WriteBack.
+		bool GetChunk(int xChunk, int zChunk, const CachedChunk*& chunk, const CachedSection*& sections);
+
+		// Append the chunks decoded since the last write back to the cache
+		// files in the background. The regions and their mappings are kept;
+		// a region that was appended to is remapped by the next WriteBack,
+		// which then drops its decoded chunks and region file.
+		void WriteBack();
+
+		Statistics GetStatistics() const;
+
+	private:
+		// A chunk decoded from the region file in this session.
+		struct DecodedChunk {
+			CachedChunk Chunk;
+			std::vector<CachedSection> Sections;
+		};
+
+		struct Region {
+			int32_t RegionX;
+			int32_t RegionZ;
+			std::wstring FileName;
+			ChunkInformation Chunks[REGION_CHUNKS];
+			// The region file, read on the first chunk that is not cached.
+			std::unique_ptr<Byte8[]> Data;
+			UInt Length;
+
+			// The mapped cache file, nullptr if there is none or it is invalid.
+			const ChunkCacheHeader* Cache;
+			const CachedSection* CachedSections;
+			MappedFile CacheFile;
+
+			// The chunks decoded in this session and not yet in the mapping, indexed like Chunks.
+			std::unique_ptr<DecodedChunk> Decoded[REGION_CHUNKS];
+			// The decoded chunks that are not in the cache file yet.
+			std::vector<uint16_t> Dirty;
+			// Set when the dirty chunks were handed to a write, cleared when the region is remapped.
+			// Until then the cache file is written while it is mapped, see IsCached.
+			bool Appended;
+		};
+
+		// The chunks of one region that a write back appends to its cache file.
+		struct CacheWrite {
+			std::wstring FileName;
+			int32_t RegionX;
+			int32_t RegionZ;
+			std::vector<std::pair<uint16_t, const DecodedChunk*>> Chunks;
+		};
+
+		Region* GetRegion(int regionX, int regionZ);
+		void OpenCache(Region& region);
+		// Check the mapped header entry of a chunk. Never called for a decoded chunk of an appended region.
+		bool IsCached(const Region& region, int index) const;
+		// Check the tables of a cache file against its region and size.
+		static bool IsValidHeader(const ChunkCacheHeader& header, int32_t regionX, int32_t regionZ, uint64_t size);
+		void DecodeChunk(Region& region, int index, DecodedChunk& decoded);
+
+		// Remap a region that was appended to, and drop the decoded chunks that are now cached.
+		void RemapRegion(Region& region);
+
+		// Append the chunks to the cache file, then update its header.
+		static bool AppendToCacheFile(const CacheWrite& write);
+
+		std::wstring m_SavePath;
+		// Regions without a region file are kept with a nullptr, so their file is only probed once.
+		RegionTable<Region> m_Regions;
+
+		std::vector<std::thread> m_WriteThreads;
+
+		uint64_t m_NumCacheHits;
+		uint64_t m_NumDecoded;
+		std::atomic<uint64_t> m_NumRegionsWritten;
+	};
+}
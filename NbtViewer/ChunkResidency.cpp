@@ -0,0 +1,255 @@
+#include "stdafx.h"
+#include "ChunkResidency.h"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+
+namespace MineCraft {
+	namespace {
+		// Chunks outside of the view are loaded as if they were this much farther away.
+		const float OutOfViewPenalty = 3.0f;
+		// cos(60 degrees), the half angle of the horizontal cone counted as in view.
+		const float InViewCosine = 0.5f;
+
+		void ReportError(const char* what, const char* error) {
+			OutputDebugStringA(what);
+			OutputDebugStringA(error);
+			OutputDebugStringA("\n");
+		}
+	}
+
+	ChunkResidency::ChunkResidency(const wchar_t* savePath, const Settings& settings)
+		: m_Settings(settings)
+		, m_ChunkCache(savePath)
+		, m_XChunk(0)
+		, m_ZChunk(0)
+		, m_HasCenter(false)
+		, m_EvictionPending(false)
+		, m_NumLoaded(0)
+		, m_NumEvicted(0)
+		, m_NumLoading(0)
+		, m_Stop(false)
+	{
+		m_Settings.UnloadRadius = std::max(m_Settings.UnloadRadius, m_Settings.LoadRadius);
+		m_Thread = std::thread(&ChunkResidency::Worker, this);
+	}
+
+	ChunkResidency::~ChunkResidency() {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stop = true;
+		}
+		m_WakeWorker.notify_one();
+		m_Thread.join();
+	}
+
+	bool ChunkResidency::IsInRing(int xChunk, int zChunk, int radius) const {
+		int64_t dx = xChunk - m_XChunk;
+		int64_t dz = zChunk - m_ZChunk;
+		return dx * dx + dz * dz <= (int64_t)radius * radius;
+	}
+
+	void ChunkResidency::Update(int xChunk, int zChunk, float viewX, float viewZ) {
+		bool moved = !m_HasCenter || xChunk != m_XChunk || zChunk != m_ZChunk;
+		m_XChunk = xChunk;
+		m_ZChunk = zChunk;
+		m_HasCenter = true;
+
+		float viewLength = std::sqrt(viewX * viewX + viewZ * viewZ);
+		if (viewLength > 0.0f) {
+			viewX /= viewLength;
+			viewZ /= viewLength;
+		}
+
+		auto priority = [&](int x, int z) {
+			float dx = (float)(x - xChunk);
+			float dz = (float)(z - zChunk);
+			float distance = std::sqrt(dx * dx + dz * dz);
+			// The camera's own chunk and its neighbours are needed whatever the view is.
+			bool inView = distance <= 1.5f || viewX * dx + viewZ * dz >= InViewCosine * distance;
+			return inView ? distance : distance * OutOfViewPenalty;
+		};
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (moved) {
+			// Requests that left the unload ring are cancelled.
+			auto cancelled = std::remove_if(m_Requests.begin(), m_Requests.end(), [this](const Request& request) {
+				if (IsInRing(request.XChunk, request.ZChunk, m_Settings.UnloadRadius)) {
+					return false;
+				}
+				m_Chunks.erase(ChunkKey(request.XChunk, request.ZChunk));
+				return true;
+			});
+			m_Requests.erase(cancelled, m_Requests.end());
+
+			int radius = m_Settings.LoadRadius;
+			for (int z = zChunk - radius; z <= zChunk + radius; z++) {
+				for (int x = xChunk - radius; x <= xChunk + radius; x++) {
+					if (IsInRing(x, z, radius) && m_Chunks.emplace(ChunkKey(x, z), ChunkState::Pending).second) {
+						m_Requests.push_back({ x, z, 0.0f });
+					}
+				}
+			}
+			m_EvictionPending = true;
+		}
+
+		for (Request& request : m_Requests) {
+			request.Priority = priority(request.XChunk, request.ZChunk);
+		}
+		std::sort(m_Requests.begin(), m_Requests.end(), [](const Request& a, const Request& b) {
+			return a.Priority > b.Priority;
+		});
+
+		if (!m_Requests.empty()) {
+			m_WakeWorker.notify_one();
+		}
+	}
+
+	size_t ChunkResidency::TakeLoaded(std::vector<std::unique_ptr<LoadedChunk>>& chunks) {
+		chunks.clear();
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto& missing : m_Missing) {
+			auto state = m_Chunks.find(ChunkKey(missing.first, missing.second));
+			if (m_Chunks.end() != state) {
+				state->second = ChunkState::Missing;
+			}
+		}
+		m_Missing.clear();
+
+		while (!m_Loaded.empty() && chunks.size() < m_Settings.IntegrateBudget) {
+			std::unique_ptr<LoadedChunk> chunk = std::move(m_Loaded.front());
+			m_Loaded.pop_front();
+
+			uint64_t key = ChunkKey(chunk->XChunk, chunk->ZChunk);
+			if (!IsInRing(chunk->XChunk, chunk->ZChunk, m_Settings.UnloadRadius)) {
+				// The camera moved away while it was loading.
+				m_Chunks.erase(key);
+				continue;
+			}
+			m_Chunks[key] = ChunkState::Resident;
+			m_NumLoaded++;
+			chunks.push_back(std::move(chunk));
+		}
+
+		return chunks.size();
+	}
+
+	size_t ChunkResidency::TakeEvicted(std::vector<std::pair<int, int>>& chunks) {
+		chunks.clear();
+		if (!m_EvictionPending) {
+			return 0;
+		}
+
+		// Pending chunks are cancelled in Update or dropped in TakeLoaded.
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto it = m_Chunks.begin(); m_Chunks.end() != it;) {
+			int x = (int)(it->first >> 32);
+			int z = (int)(uint32_t)it->first;
+			if (ChunkState::Pending == it->second || IsInRing(x, z, m_Settings.UnloadRadius)) {
+				++it;
+				continue;
+			}
+			if (ChunkState::Resident == it->second) {
+				if (chunks.size() >= m_Settings.EvictBudget) {
+					// Continue in the next frame.
+					return chunks.size();
+				}
+				chunks.emplace_back(x, z);
+				m_NumEvicted++;
+			}
+			it = m_Chunks.erase(it);
+		}
+
+		m_EvictionPending = false;
+		return chunks.size();
+	}
+
+	bool ChunkResidency::IsIdle() const {
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Requests.empty() && m_Loaded.empty() && 0 == m_NumLoading;
+	}
+
+	ChunkResidency::Statistics ChunkResidency::GetStatistics() const {
+		Statistics statistics;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto& chunk : m_Chunks) {
+			statistics.NumResident += ChunkState::Resident == chunk.second ? 1 : 0;
+			statistics.NumPending += ChunkState::Pending == chunk.second ? 1 : 0;
+		}
+		statistics.NumLoaded = m_NumLoaded;
+		statistics.NumEvicted = m_NumEvicted;
+		statistics.Cache = m_CacheStatistics;
+		return statistics;
+	}
+
+	void ChunkResidency::Worker() {
+		const std::chrono::seconds writeBackInterval(m_Settings.WriteBackSeconds);
+		auto nextWriteBack = std::chrono::steady_clock::now() + writeBackInterval;
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		while (true) {
+			m_WakeWorker.wait_until(lock, nextWriteBack, [this]() { return m_Stop || !m_Requests.empty(); });
+			if (m_Stop) {
+				// The cache writes back when it is destroyed.
+				break;
+			}
+
+			auto now = std::chrono::steady_clock::now();
+			if (now >= nextWriteBack) {
+				nextWriteBack = now + writeBackInterval;
+				lock.unlock();
+				try {
+					m_ChunkCache.WriteBack();
+				}
+				catch (const std::exception& e) {
+					// The chunks that were not appended are queued again by the next write back.
+					ReportError("Chunk cache write back failed: ", e.what());
+				}
+				lock.lock();
+			}
+			if (m_Requests.empty()) {
+				continue;
+			}
+
+			Request request = m_Requests.back();
+			m_Requests.pop_back();
+			m_NumLoading++;
+			lock.unlock();
+
+			std::unique_ptr<LoadedChunk> loaded;
+			try {
+				const CachedChunk* chunk = nullptr;
+				const CachedSection* sections = nullptr;
+				if (m_ChunkCache.GetChunk(request.XChunk, request.ZChunk, chunk, sections)) {
+					loaded = std::make_unique<LoadedChunk>();
+					loaded->XChunk = request.XChunk;
+					loaded->ZChunk = request.ZChunk;
+					loaded->Chunk = *chunk;
+					loaded->Sections.assign(sections, sections + chunk->NumSections);
+				}
+			}
+			catch (const char* error) {
+				// A broken chunk, or one that can't be decoded or copied, is shown
+				// as missing instead of stopping the stream.
+				ReportError("Chunk load failed: ", error);
+				loaded.reset();
+			}
+			catch (const std::exception& e) {
+				ReportError("Chunk load failed: ", e.what());
+				loaded.reset();
+			}
+			ChunkCache::Statistics cacheStatistics = m_ChunkCache.GetStatistics();
+
+			lock.lock();
+			m_NumLoading--;
+			if (loaded) {
+				m_Loaded.push_back(std::move(loaded));
+			}
+			else {
+				m_Missing.emplace_back(request.XChunk, request.ZChunk);
+			}
+			m_CacheStatistics = cacheStatistics;
+		}
+	}
+}
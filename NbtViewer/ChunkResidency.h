@@ -0,0 +1,124 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ChunkCache.h"
+
+namespace MineCraft {
+	// Keeps the chunks around a moving camera resident.
+	//
+	// Chunks within LoadRadius of the camera's chunk are requested, nearest
+	// and in-view first, and decoded from the ChunkCache on a worker thread.
+	// Resident chunks are evicted once they are farther than UnloadRadius, so
+	// moving back and forth over a chunk border doesn't reload anything.
+	// The caller takes at most IntegrateBudget loaded and EvictBudget evicted
+	// chunks per frame, which keeps the frame time flat while moving.
+	// The worker writes the newly decoded chunks back to the cache every
+	// WriteBackSeconds, and the cache writes the rest back when it is destroyed.
+	class ChunkResidency {
+	public:
+		struct Settings {
+			// In chunks, UnloadRadius > LoadRadius gives the hysteresis.
+			int LoadRadius = 8;
+			int UnloadRadius = 10;
+			uint32_t IntegrateBudget = 4;
+			uint32_t EvictBudget = 8;
+			uint32_t WriteBackSeconds = 30;
+		};
+
+		// A chunk decoded by the worker. The sections are copied out of the
+		// cache, because it remaps regions and drops decoded chunks when it
+		// writes back.
+		struct LoadedChunk {
+			int XChunk;
+			int ZChunk;
+			CachedChunk Chunk;
+			std::vector<CachedSection> Sections;
+		};
+
+		struct Statistics {
+			uint32_t NumResident = 0;
+			uint32_t NumPending = 0;
+			uint64_t NumLoaded = 0;
+			uint64_t NumEvicted = 0;
+			ChunkCache::Statistics Cache;
+		};
+
+		ChunkResidency(const wchar_t* savePath, const Settings& settings);
+		~ChunkResidency();
+
+		ChunkResidency(const ChunkResidency&) = delete;
+		ChunkResidency& operator=(const ChunkResidency&) = delete;
+
+		// Move the rings to the camera's chunk and reorder the pending requests.
+		// viewX and viewZ are the horizontal view direction, it doesn't need to be normalized.
+		void Update(int xChunk, int zChunk, float viewX, float viewZ);
+
+		// Move at most IntegrateBudget loaded chunks to chunks, they become resident.
+		// Chunks that left the unload ring while they were loading are dropped.
+		size_t TakeLoaded(std::vector<std::unique_ptr<LoadedChunk>>& chunks);
+
+		// Fill chunks with at most EvictBudget resident chunks (x, z) outside of the unload ring.
+		size_t TakeEvicted(std::vector<std::pair<int, int>>& chunks);
+
+		// True if nothing is requested, loading or waiting to be taken.
+		bool IsIdle() const;
+
+		Statistics GetStatistics() const;
+
+	private:
+		enum class ChunkState : uint8_t {
+			// Requested or being decoded by the worker.
+			Pending,
+			Resident,
+			// Not stored in its region, or it could not be decoded.
+			Missing,
+		};
+
+		struct Request {
+			int XChunk;
+			int ZChunk;
+			float Priority;
+		};
+
+		static inline uint64_t ChunkKey(int xChunk, int zChunk) {
+			return ((uint64_t)(uint32_t)xChunk << 32) | (uint32_t)zChunk;
+		}
+
+		bool IsInRing(int xChunk, int zChunk, int radius) const;
+		void Worker();
+
+		Settings m_Settings;
+		// Only used by the worker thread.
+		ChunkCache m_ChunkCache;
+
+		// The state of every chunk that was requested, owned by the calling thread.
+		std::unordered_map<uint64_t, ChunkState> m_Chunks;
+		int m_XChunk;
+		int m_ZChunk;
+		bool m_HasCenter;
+		// Set when the camera moved, until TakeEvicted found every chunk outside of the unload ring.
+		bool m_EvictionPending;
+		uint64_t m_NumLoaded;
+		uint64_t m_NumEvicted;
+
+		// Shared with the worker. The requests are sorted by descending
+		// priority value, so the worker takes the most important from the back.
+		mutable std::mutex m_Mutex;
+		std::condition_variable m_WakeWorker;
+		std::vector<Request> m_Requests;
+		std::deque<std::unique_ptr<LoadedChunk>> m_Loaded;
+		// Chunks that turned out to be missing, reported back to the calling thread.
+		std::vector<std::pair<int, int>> m_Missing;
+		uint32_t m_NumLoading;
+		ChunkCache::Statistics m_CacheStatistics;
+		bool m_Stop;
+
+		std::thread m_Thread;
+	};
+}
@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include "MCViewer.h"
 #include "NbtReader.h"
+#include "DxApplication.h"
 #include "DxWindow.h"
 #include "DxHelper.h"
 
@@ -23,9 +24,33 @@ namespace MineCraft {
 		DirectX::XMMATRIX WorldViewProjectionMatrix;
 	};
 
+	// A block is hidden if all of its neighbours are opaque blocks of the same section.
+	// Blocks on the border of the section are always drawn.
+	static bool IsBlockHidden(const SectionSummary& summary, int x, int y, int z) {
+		if (x == 0 || y == 0 || z == 0 || x == SECTION_SIZE - 1 || y == SECTION_SIZE - 1 || z == SECTION_SIZE - 1) {
+			return false;
+		}
+		return summary.IsSolid(x - 1, y, z) && summary.IsSolid(x + 1, y, z) &&
+			summary.IsSolid(x, y - 1, z) && summary.IsSolid(x, y + 1, z) &&
+			summary.IsSolid(x, y, z - 1) && summary.IsSolid(x, y, z + 1);
+	}
+
 	MCViewer::MCViewer(DxWindow& window)
 		: super(window)
 		, m_BasePath(L"E:/Games/MineCraft/.minecraft/versions/1.12.2/saves/µ")
+		, m_ReportResidency(false)
+		, m_Forward(0)
+		, m_Backward(0)
+		, m_Left(0)
+		, m_Right(0)
+		, m_Up(0)
+		, m_Down(0)
+		, m_Shift(false)
+		, m_Pitch(0)
+		, m_Yaw(0)
+		, m_InitialPitch(0)
+		, m_InitialYaw(0)
+		, m_InstanceCapacity(0)
 	{
 		pData = (AlignedData*)_aligned_malloc(sizeof(AlignedData), 16);
 
@@ -46,122 +71,99 @@ namespace MineCraft {
 		_aligned_free(pData);
 	}
 
-	bool MCViewer::LoadChunks(Byte8 ySection, int zChunk, int xChunk) {
-		int regionX = xChunk >> 5;
-		int regionZ = zChunk >> 5;
-		wchar_t pathName[MAX_PATH];
-		wsprintfW(pathName, L"%s/region/r.%i.%i.mca", m_BasePath, regionX, regionZ);
-
-		CompoundTagPtr regions = nullptr;
-		auto mca = m_Regions.find(pathName);
-		if (m_Regions.end() != mca)
-			regions = mca->second;
-		else {
-			regions = NbtReader::LoadRegionFile(pathName);
-			if (nullptr != regions) {
-				m_Regions.try_emplace(pathName, regions);
-				//std::wofstream ofs("regions.dat", std::ios::binary);
-				//ofs << pathName << std::endl;
-				//ofs << *regions;
-				//ofs.close();
+	void MCViewer::IntegrateChunk(const ChunkResidency::LoadedChunk& chunk) {
+		int xPos = chunk.XChunk;
+		int zPos = chunk.ZChunk;
+		m_OcclusionCuller.AddChunk(xPos, zPos);
+		Blocks& blocks = m_ChunkBlocks[PackSectionKey(xPos, 0, zPos)];
+
+		for (const CachedSection& section : chunk.Sections) {
+			int y = section.Y;
+
+			// The summary was computed when the section was decoded.
+			SectionSummary& summary = m_SectionSummaries[PackSectionKey(xPos, y, zPos)];
+			summary = section.Summary;
+			m_SectionStatistics.Add(summary);
+			if (summary.IsEmpty()) {
+				// Nothing but air, no need to keep the blocks. Both cullers treat a
+				// section that was never added as air, so it is never reported visible.
+				continue;
+			}
+			m_OcclusionCuller.SetSection(xPos, y, zPos, ComputeSectionConnectivity(summary));
+			m_SectionCuller.AddSection(xPos, y, zPos);
+
+			std::vector<XMFLOAT3>& instances = m_SectionInstances[PackSectionKey(xPos, y, zPos)];
+			instances.clear();
+
+			float startX = xPos * 16.0f;
+			float startY = y * 16.0f;
+			float startZ = zPos * 16.0f;
+			for (int b = 0; b < SECTION_BLOCKS; b++) {
+				int shift = (b & 1) << 2;
+				Block block;
+				block.Id = section.BlockId(b);
+				block.Data = section.BlockData(b);
+				block.BlockLight = (section.BlockLight[b >> 1] >> shift) & 0x0F;
+				block.SkyLight = (section.SkyLight[b >> 1] >> shift) & 0x0F;
+				// b = (y * 16 + z) * 16 + x
+				block.pos = { (b & 15) + startX, (b >> 8) + startY, ((b >> 4) & 15) + startZ };
+				blocks.Add(block);
+
+				if (0 != block.Id && !IsBlockHidden(summary, b & 15, b >> 8, (b >> 4) & 15)) {
+					instances.emplace_back(block.pos.x + 0.5f, block.pos.y + 0.5f, block.pos.z + 0.5f);
+				}
 			}
+		}	// sections
+	}
+
+	void MCViewer::EvictChunk(int xChunk, int zChunk) {
+		m_OcclusionCuller.RemoveChunk(xChunk, zChunk);
+		m_SectionCuller.RemoveChunk(xChunk, zChunk);
+		for (int y = 0; y < SECTION_SIZE; y++) {
+			m_SectionSummaries.erase(PackSectionKey(xChunk, y, zChunk));
+			m_SectionInstances.erase(PackSectionKey(xChunk, y, zChunk));
 		}
+		m_ChunkBlocks.erase(PackSectionKey(xChunk, 0, zChunk));
+	}
 
-		if (nullptr == regions) {
-			return false;
+	void MCViewer::UpdateResidency() {
+		if (!m_Residency) {
+			return;
 		}
 
-		wsprintfW(pathName, L"%d,%d", xChunk & 31, zChunk & 31);
-		CompoundTagPtr chunk = regions->GetByName<CompoundTag>(pathName);
-		if (nullptr != chunk) {
-			CompoundTagPtr _Level = chunk->GetByName<CompoundTag>(L"Level");
-			IntTag* _DataVersion = chunk->GetByName<IntTag>(L"DataVersion");
-			IntTag* _LastChange = chunk->GetByName<IntTag>(L"LastChange");
+		XMFLOAT3 cameraPosition;
+		XMStoreFloat3(&cameraPosition, m_Camera.get_Translation());
+		XMFLOAT3 viewDirection;
+		XMStoreFloat3(&viewDirection, XMVector3Rotate(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), m_Camera.get_Rotation()));
 
-			if (nullptr == _DataVersion || nullptr == _Level) {
-				throw "Error chunk format";
-			}
+		int xChunk = (int)std::floor(cameraPosition.x / 16.0f);
+		int zChunk = (int)std::floor(cameraPosition.z / 16.0f);
+		m_Residency->Update(xChunk, zChunk, viewDirection.x, viewDirection.z);
 
-			Int32 datVersion;
-			_DataVersion->GetValue(&datVersion);
-			assert(datVersion == 1343);
-
-			auto _xPos = _Level->GetByName<IntTag>(L"xPos");
-			Int32 xPos;
-			_xPos->GetValue(&xPos);
-			auto _zPos = _Level->GetByName<IntTag>(L"zPos");
-			Int32 zPos;
-			_zPos->GetValue(&zPos);
-
-			auto sectionBlocks = std::make_unique<Block[]>(4096);
-			ListTagPtr _Sections = _Level->GetByName<ListTag>(L"Sections");
-			for (int s = 0; s < _Sections->Size(); s++) {
-				CompoundTagPtr section = _Sections->GetByIndex<CompoundTag>(s);
-				if (nullptr == section) {
-					continue;
-				}
-				auto _Y = section->GetByName<ByteTag>(L"Y");
-				Byte8 y;
-				_Y->GetValue(&y);
-				if (y < ySection - m_Range && y > ySection + m_Range) {
-					continue;
-				}
-				auto _Data = section->GetByName<ByteArrayTag>(L"Data");
-				Byte8* datas = (Byte8*)_Data->Value();
-				auto _BLockLight = section->GetByName<ByteArrayTag>(L"BLockLight");
-				Byte8* blockLights = (Byte8*)_BLockLight->Value();
-				auto _SkyLight = section->GetByName<ByteArrayTag>(L"SkyLight");
-				Byte8* skyLights = (Byte8*)_SkyLight->Value();
-				auto _Blocks = section->GetByName<ByteArrayTag>(L"Blocks");
-				Byte8* blocks = (Byte8*)_Blocks->Value();
-				assert(_Blocks->Size() == 4096);
-				for (int b = 0; b < 4096; b++) {
-					sectionBlocks[b].Id = blocks[b];
-					int i = b / 2;
-					if (0 == b % 2)
-					{
-						sectionBlocks[b].Data = datas[i] & 0x0F;
-						sectionBlocks[b].BlockLight = blockLights[i] & 0x0F;
-						sectionBlocks[b].SkyLight = skyLights[i] & 0x0F;
-					}
-					else {
-						sectionBlocks[b].Data = (datas[i] & 0xF0) >> 4;
-						sectionBlocks[b].BlockLight = (blockLights[i] & 0xF0) >> 4;
-						sectionBlocks[b].SkyLight = (skyLights[i] & 0xF0) >> 4;
-					}
-				}
-				auto _Add = section->GetByName<ByteArrayTag>(L"Add");
-				if (nullptr != _Add) {
-					Byte8* adds = (Byte8*)_Add->Value();
-					for (int i = 0; i < 2048; i++) {
-						int b = i << 1;
-						sectionBlocks[b].Id += (adds[i] & 0x0F) << 8;
-						sectionBlocks[b + 1].Id += ((adds[i] & 0xF0) >> 4) << 8;
-					}
-				}
-				int posX = 0;
-				int posZ = 0;
-				int posY = 0;
-				float startX = xPos * 16.0f;
-				float startZ = zPos * 16.0f;
-				for (int b = 0; b < 4096; b++, posX++) {
-					if (posX > 15) {
-						posZ++;
-						posX = 0;
-					}
-					if (posZ > 15) {
-						posY++;
-						posZ = 0;
-						posX = 0;
-					}
-					assert(posY < 16);
-					sectionBlocks[b].pos = { posX + startX, posY * 16.0f, posZ + startZ };
-					m_Blocks.Add(sectionBlocks[b]);
-				}
-			}	// sections
-		}	// chunk
+		// The section culler is rebuilt on its next Cull after sections were added or removed.
+		m_Residency->TakeLoaded(m_LoadedChunks);
+		for (auto& chunk : m_LoadedChunks) {
+			IntegrateChunk(*chunk);
+			m_ReportResidency = true;
+		}
+		m_LoadedChunks.clear();
 
-		return true;
+		m_Residency->TakeEvicted(m_EvictedChunks);
+		for (auto& chunk : m_EvictedChunks) {
+			EvictChunk(chunk.first, chunk.second);
+		}
+
+		// The statistics are shown in the title once the streaming settled, not every frame.
+		if (m_ReportResidency && m_Residency->IsIdle()) {
+			m_ReportResidency = false;
+
+			ChunkResidency::Statistics statistics = m_Residency->GetStatistics();
+			wchar_t title[512];
+			swprintf_s(title, L"%s - Sections: %llu (%.1f%% skipped), Chunks: %u resident, %llu cached, %llu decoded",
+				m_Window.get_WindowName().c_str(), m_SectionStatistics.NumSections, m_SectionStatistics.SkippedFraction() * 100.0,
+				statistics.NumResident, statistics.Cache.NumCacheHits, statistics.Cache.NumDecoded);
+			SetWindowTextW(m_Window.get_WindowHandle(), title);
+		}
 	}
 
 	bool MCViewer::LoadContent()
@@ -184,15 +186,17 @@ namespace MineCraft {
 			float yaw = _Rotation->GetInternalValue<Float32>(0);
 			float pitch = _Rotation->GetInternalValue<Float32>(1);
 
-			int xChunk = (int)(pos.x / 16.0f);
-			int zChunk = (int)(pos.z / 16.0f);
-			Byte8 ySection = (Byte8)(pos.y / 16.0f);
+			// Start at the saved player, the chunks around the camera are streamed in from the first frame.
+			// Minecraft's yaw turns from +z towards -x, the opposite way of a rotation about y.
+			m_Pitch = m_InitialPitch = pitch;
+			m_Yaw = m_InitialYaw = -yaw;
+			m_Camera.set_Translation(XMVectorSet(pos.x, pos.y, pos.z, 1.0f));
+			m_Camera.set_Rotation(XMQuaternionRotationRollPitchYaw(XMConvertToRadians(m_Pitch), XMConvertToRadians(m_Yaw), 0.0f));
+			pData->m_InitialCameraPos = m_Camera.get_Translation();
+			pData->m_InitialCameraRot = m_Camera.get_Rotation();
 
-			for (int x = xChunk - m_Range; x < xChunk + m_Range; x++) {
-				for (int z = zChunk - m_Range; z < zChunk + m_Range; z++) {
-					LoadChunks(ySection, z, x);
-				}
-			}
+			ChunkResidency::Settings residencySettings;
+			m_Residency = std::make_unique<ChunkResidency>(m_BasePath, residencySettings);
 
 			//if (nullptr != regions) {
 			//	//std::wofstream ofs("regions.dat", std::ios::binary);
@@ -348,6 +352,38 @@ namespace MineCraft {
 			return false;
 		}
 
+		// Load the vertex shader of the instanced blocks.
+		hr = CompileShader(L"Shaders/InstancedVertexShader.hlsl", "InstancedVertexShader", "vs_5_0", shaderCode.ReleaseAndGetAddressOf());
+		if (FAILED(hr))
+		{
+			MessageBoxW(m_Window.get_WindowHandle(), L"Failed to compile the instanced vertex shader.", L"Error", MB_OK | MB_ICONERROR);
+			return false;
+		}
+
+		hr = m_d3dDevice->CreateVertexShader(shaderCode->GetBufferPointer(), shaderCode->GetBufferSize(),
+			nullptr, m_d3dInstancedVertexShader.ReleaseAndGetAddressOf());
+		if (FAILED(hr))
+		{
+			MessageBoxW(m_Window.get_WindowHandle(), L"Failed to create the instanced vertex shader.", L"Error", MB_OK | MB_ICONERROR);
+			return false;
+		}
+
+		// The cube's vertices in slot 0, the block centers in slot 1.
+		const D3D11_INPUT_ELEMENT_DESC instancedInputElements[] = {
+			VertexPositionNormalTexture::InputElements[0],
+			VertexPositionNormalTexture::InputElements[1],
+			VertexPositionNormalTexture::InputElements[2],
+			{ "INSTANCEPOSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		};
+		hr = m_d3dDevice->CreateInputLayout(instancedInputElements, _countof(instancedInputElements),
+			shaderCode->GetBufferPointer(), shaderCode->GetBufferSize(),
+			m_d3dInstancedInputLayout.ReleaseAndGetAddressOf());
+		if (FAILED(hr))
+		{
+			MessageBoxW(m_Window.get_WindowHandle(), L"Failed to create the input layout for the instanced vertex shader.", L"Error", MB_OK | MB_ICONERROR);
+			return false;
+		}
+
 		// Force a resize event so the camera's projection matrix gets initialized.
 		ResizeEventArgs resizeEventArgs(m_Window.get_ClientWidth(), m_Window.get_ClientHeight());
 		OnResize(resizeEventArgs);
@@ -357,11 +393,117 @@ namespace MineCraft {
 
 	void MCViewer::UnloadContent()
 	{
+		// Stops the streaming and waits for the cache files that are still being written.
+		m_Residency.reset();
+	}
+
+	void MCViewer::UpdateCamera(float elapsedTime) {
+		// In blocks per second.
+		float speed = (m_Shift ? 64.0f : 16.0f) * elapsedTime;
+
+		XMVECTOR cameraTranslate = XMVectorSet(m_Right - m_Left, 0.0f, m_Forward - m_Backward, 1.0f) * speed;
+		XMVECTOR cameraPan = XMVectorSet(0.0f, m_Up - m_Down, 0.0f, 1.0f) * speed;
+		m_Camera.Translate(cameraTranslate, DxCamera::LocalSpace);
+		m_Camera.Translate(cameraPan, DxCamera::LocalSpace);
+
+		m_Camera.set_Rotation(XMQuaternionRotationRollPitchYaw(XMConvertToRadians(m_Pitch), XMConvertToRadians(m_Yaw), 0.0f));
+	}
+
+	void MCViewer::OnKeyPressed(DxKeyEventArgs & e)
+	{
+		super::OnKeyPressed(e);
+
+		switch (e.Key)
+		{
+		case DxKeyCode::Escape:
+			DxApplication::Get().Quit(0);
+			break;
+		case DxKeyCode::R:
+			// Back to the saved player.
+			m_Camera.set_Translation(pData->m_InitialCameraPos);
+			m_Camera.set_Rotation(pData->m_InitialCameraRot);
+			m_Pitch = m_InitialPitch;
+			m_Yaw = m_InitialYaw;
+			break;
+		case DxKeyCode::Up:
+		case DxKeyCode::W:
+			m_Forward = 1.0f;
+			break;
+		case DxKeyCode::Left:
+		case DxKeyCode::A:
+			m_Left = 1.0f;
+			break;
+		case DxKeyCode::Down:
+		case DxKeyCode::S:
+			m_Backward = 1.0f;
+			break;
+		case DxKeyCode::Right:
+		case DxKeyCode::D:
+			m_Right = 1.0f;
+			break;
+		case DxKeyCode::Q:
+			m_Down = 1.0f;
+			break;
+		case DxKeyCode::E:
+			m_Up = 1.0f;
+			break;
+		case DxKeyCode::ShiftKey:
+			m_Shift = true;
+			break;
+		}
+	}
+
+	void MCViewer::OnKeyReleased(DxKeyEventArgs & e)
+	{
+		super::OnKeyReleased(e);
+
+		switch (e.Key)
+		{
+		case DxKeyCode::Up:
+		case DxKeyCode::W:
+			m_Forward = 0.0f;
+			break;
+		case DxKeyCode::Left:
+		case DxKeyCode::A:
+			m_Left = 0.0f;
+			break;
+		case DxKeyCode::Down:
+		case DxKeyCode::S:
+			m_Backward = 0.0f;
+			break;
+		case DxKeyCode::Right:
+		case DxKeyCode::D:
+			m_Right = 0.0f;
+			break;
+		case DxKeyCode::Q:
+			m_Down = 0.0f;
+			break;
+		case DxKeyCode::E:
+			m_Up = 0.0f;
+			break;
+		case DxKeyCode::ShiftKey:
+			m_Shift = false;
+			break;
+		}
+	}
+
+	void MCViewer::OnMouseMoved(MouseMotionEventArgs & e)
+	{
+		super::OnMouseMoved(e);
+
+		const float mouseSpeed = 0.1f;
+		if (e.LeftButton)
+		{
+			m_Pitch = std::min(std::max(m_Pitch - e.RelY * mouseSpeed, -90.0f), 90.0f);
+			m_Yaw -= e.RelX * mouseSpeed;
+		}
 	}
 
 	void MCViewer::OnUpdate(UpdateEventArgs & e)
 	{
 		// Camera
+		UpdateCamera(e.ElapsedTime);
+		UpdateResidency();
 
 		// Update the light properties
 		XMStoreFloat4(&m_LightProperties.EyePosition, m_Camera.get_Translation());
@@ -405,6 +547,33 @@ namespace MineCraft {
 
 	}
 
+	void MCViewer::UpdateInstanceBuffer() {
+		if (m_FrameInstances.size() > m_InstanceCapacity) {
+			UINT capacity = 4096;
+			while (capacity < m_FrameInstances.size()) {
+				capacity *= 2;
+			}
+
+			D3D11_BUFFER_DESC instanceBufferDesc;
+			ZeroMemory(&instanceBufferDesc, sizeof(D3D11_BUFFER_DESC));
+			instanceBufferDesc.ByteWidth = capacity * sizeof(XMFLOAT3);
+			instanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+			instanceBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+			instanceBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+			if (FAILED(m_d3dDevice->CreateBuffer(&instanceBufferDesc, nullptr, m_d3dInstanceBuffer.ReleaseAndGetAddressOf()))) {
+				throw "Failed to create the block instance buffer.";
+			}
+			m_InstanceCapacity = capacity;
+		}
+
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(m_d3dDeviceContext->Map(m_d3dInstanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+			throw "Failed to map the block instance buffer.";
+		}
+		memcpy(mapped.pData, m_FrameInstances.data(), m_FrameInstances.size() * sizeof(XMFLOAT3));
+		m_d3dDeviceContext->Unmap(m_d3dInstanceBuffer.Get(), 0);
+	}
+
 	// Builds a look-at (world) matrix from a point, up and direction vectors.
 	DirectX::XMMATRIX XM_CALLCONV LookAtMatrix(DirectX::FXMVECTOR Position, DirectX::FXMVECTOR Direction, DirectX::FXMVECTOR Up)
 	{
@@ -433,6 +602,15 @@ namespace MineCraft {
 		DirectX::XMMATRIX projectionMatrix = m_Camera.get_ProjectionMatrix();
 		DirectX::XMMATRIX viewProjectionMatrix = viewMatrix * projectionMatrix;
 
+		// Cull hidden caves from the camera's section, or only against the frustum when
+		// the camera is outside of the loaded chunks.
+		Frustum frustum = Frustum::FromMatrices(viewMatrix, projectionMatrix);
+		XMFLOAT3 cameraPosition;
+		XMStoreFloat3(&cameraPosition, m_Camera.get_Translation());
+		if (!m_OcclusionCuller.Cull(cameraPosition, &frustum, m_VisibleSections)) {
+			m_SectionCuller.Cull(frustum, m_VisibleSections);
+		}
+
 		PerFrameConstantBufferData constantBufferData;
 		constantBufferData.ViewProjectionMatrix = viewProjectionMatrix;
 
@@ -458,6 +636,22 @@ namespace MineCraft {
 		m_d3dDeviceContext->OMSetRenderTargets(1, m_d3dRenderTargetView.GetAddressOf(), m_d3dDepthStencilView.Get());
 		m_d3dDeviceContext->OMSetDepthStencilState(m_d3dDepthStencilState.Get(), 0);
 
+		// Draw the blocks of the sections that passed culling.
+		m_FrameInstances.clear();
+		for (uint64_t key : m_VisibleSections) {
+			auto instances = m_SectionInstances.find(key);
+			if (m_SectionInstances.end() != instances) {
+				m_FrameInstances.insert(m_FrameInstances.end(), instances->second.begin(), instances->second.end());
+			}
+		}
+		if (!m_FrameInstances.empty()) {
+			UpdateInstanceBuffer();
+			m_d3dDeviceContext->UpdateSubresource(m_d3dMaterialPropertiesConstantBuffer.Get(), 0, nullptr, &m_MaterialProperties[1], 0, 0);
+			m_d3dDeviceContext->VSSetShader(m_d3dInstancedVertexShader.Get(), nullptr, 0);
+			m_d3dDeviceContext->IASetInputLayout(m_d3dInstancedInputLayout.Get());
+			m_Cube->DrawInstanced(m_d3dDeviceContext.Get(), m_d3dInstanceBuffer.Get(), sizeof(XMFLOAT3), (UINT)m_FrameInstances.size());
+		}
+
 		// Draw a cube
 		DirectX::XMMATRIX translationMatrix = DirectX::XMMatrixTranslation(0.0f, 8.0f, 0.0f);
 		DirectX::XMMATRIX rotationMatrix = DirectX::XMMatrixRotationY(DirectX::XMConvertToRadians(45.0f));
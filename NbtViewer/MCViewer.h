@@ -4,6 +4,10 @@
 #include "DxCamera.h"
 #include "DxMesh.h"
 #include "Blocks.h"
+#include "ChunkResidency.h"
+#include "SectionSummary.h"
+#include "SectionCulling.h"
+#include "SectionVisibility.h"
 #include "nbt.h"
 
 namespace MineCraft {
@@ -97,18 +101,38 @@ namespace MineCraft {
 	class MCViewer : public DxGame
 	{
 		using super = DxGame;
-		using RegionMap = std::map<std::wstring, CompoundTagPtr>;
 
-		Blocks m_Blocks;
+		// The blocks of the resident chunks, keyed by PackSectionKey(x, 0, z) of their chunk.
+		std::unordered_map<uint64_t, Blocks> m_ChunkBlocks;
 		const wchar_t* m_BasePath;
-		RegionMap m_Regions;
-		const byte m_Range = 3;
+		// Streams the chunks around the camera in and out, decoded by the ChunkCache.
+		std::unique_ptr<ChunkResidency> m_Residency;
+		std::vector<std::unique_ptr<ChunkResidency::LoadedChunk>> m_LoadedChunks;
+		std::vector<std::pair<int, int>> m_EvictedChunks;
+		// Set when chunks were integrated, until the statistics are shown in the window title once the streaming is idle.
+		bool m_ReportResidency;
+
+		// Occupancy summaries of the loaded sections, keyed by PackSectionKey.
+		std::map<uint64_t, SectionSummary> m_SectionSummaries;
+		SectionSummaryStatistics m_SectionStatistics;
+		// Bounds of the non-empty sections, and the ones that passed culling this frame.
+		SectionCuller m_SectionCuller;
+		SectionOcclusionCuller m_OcclusionCuller;
+		std::vector<uint64_t> m_VisibleSections;
+		// The centers of the blocks of the non-empty sections that aren't enclosed by
+		// opaque blocks, keyed by PackSectionKey. The visible sections' blocks are
+		// gathered into m_FrameInstances and drawn as instanced cubes.
+		std::unordered_map<uint64_t, std::vector<DirectX::XMFLOAT3>> m_SectionInstances;
+		std::vector<DirectX::XMFLOAT3> m_FrameInstances;
 
 	public:
 		MCViewer(DxWindow& window);
 		~MCViewer();
 
-		bool LoadChunks(Byte8 ySection, int zChunk, int xChunk);
+		void IntegrateChunk(const ChunkResidency::LoadedChunk& chunk);
+		void EvictChunk(int xChunk, int zChunk);
+		void UpdateResidency();
+		void UpdateInstanceBuffer();
 
 		// ͨ DxGame ̳
 		virtual bool LoadContent() override;
@@ -121,9 +145,32 @@ namespace MineCraft {
 		virtual void OnRender(RenderEventArgs& e);
 		virtual void OnResize(ResizeEventArgs& e);
 
+		// WASD or the arrow keys move, Q and E go down and up, Shift is faster,
+		// dragging with the left mouse button looks around and R resets the camera.
+		virtual void OnKeyPressed(DxKeyEventArgs& e);
+		virtual void OnKeyReleased(DxKeyEventArgs& e);
+		virtual void OnMouseMoved(MouseMotionEventArgs& e);
+
 	private:
+		// Move the camera by the pressed keys, before the residency follows it.
+		void UpdateCamera(float elapsedTime);
+
 		DxCamera m_Camera;
 
+		float m_Forward;
+		float m_Backward;
+		float m_Left;
+		float m_Right;
+		float m_Up;
+		float m_Down;
+		bool m_Shift;
+
+		// In degrees, the camera starts at the saved player's.
+		float m_Pitch;
+		float m_Yaw;
+		float m_InitialPitch;
+		float m_InitialYaw;
+
 		__declspec(align(16)) struct AlignedData
 		{
 			DirectX::XMVECTOR m_InitialCameraPos;
@@ -151,6 +198,12 @@ namespace MineCraft {
 
 		Microsoft::WRL::ComPtr<ID3D11InputLayout> m_d3dVertexPositionNormalTextureInputLayout;
 
+		// Vertex shader, input layout and dynamic per-instance buffer for the blocks.
+		Microsoft::WRL::ComPtr<ID3D11VertexShader> m_d3dInstancedVertexShader;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> m_d3dInstancedInputLayout;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> m_d3dInstanceBuffer;
+		UINT m_InstanceCapacity;
+
 		std::unique_ptr<DxMesh> m_Cube;
 		std::unique_ptr<DxMesh> m_LightSphere;
 		std::unique_ptr<DxMesh> m_LightCone;
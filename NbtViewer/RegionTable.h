@@ -0,0 +1,117 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace MineCraft {
+	// An open addressing hash table of objects by their region coordinates,
+	// with linear probing. The key is the packed (regionX, regionZ) pair, the
+	// slot comes from the high bits of a Fibonacci hash, and the table grows
+	// to stay at most half full, so the probe sequences stay short.
+	//
+	// The objects are owned through unique_ptrs, so they keep their address
+	// when the table grows. A key can be stored with a nullptr, e.g. for a
+	// region without a file, so it is only looked up once.
+	template<typename T>
+	class RegionTable {
+	public:
+		static const size_t InitialSlots = 64;
+
+		RegionTable()
+			: m_Slots(InitialSlots)
+			, m_Size(0)
+		{}
+
+		static inline uint64_t Key(int regionX, int regionZ) {
+			return ((uint64_t)(uint32_t)regionX << 32) | (uint32_t)regionZ;
+		}
+
+		static inline size_t Hash(uint64_t key) {
+			return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32);
+		}
+
+		// The value of a region, or nullptr if the region has not been inserted.
+		std::unique_ptr<T>* Find(int regionX, int regionZ) {
+			Slot& slot = FindSlot(Key(regionX, regionZ));
+			return slot.Used ? &slot.Value : nullptr;
+		}
+
+		// Insert a region that is not in the table yet, and return its value.
+		std::unique_ptr<T>& Insert(int regionX, int regionZ) {
+			uint64_t key = Key(regionX, regionZ);
+			if ((m_Size + 1) * 2 > m_Slots.size()) {
+				Grow();
+			}
+			Slot& slot = FindSlot(key);
+			if (!slot.Used) {
+				slot.Key = key;
+				slot.Used = true;
+				m_Size++;
+			}
+			return slot.Value;
+		}
+
+		template<typename Function>
+		void ForEach(Function function) {
+			for (auto& slot : m_Slots) {
+				if (slot.Used) {
+					function(slot.Value);
+				}
+			}
+		}
+
+		void Clear() {
+			m_Slots.clear();
+			m_Slots.resize(InitialSlots);
+			m_Size = 0;
+		}
+
+		size_t Size() const { return m_Size; }
+		size_t NumSlots() const { return m_Slots.size(); }
+
+		// The number of slots probed to find a region, 1 if it is in its home slot.
+		size_t ProbeLength(int regionX, int regionZ) const {
+			uint64_t key = Key(regionX, regionZ);
+			size_t mask = m_Slots.size() - 1;
+			size_t index = Hash(key) & mask;
+			size_t length = 1;
+			while (m_Slots[index].Used && m_Slots[index].Key != key) {
+				index = (index + 1) & mask;
+				length++;
+			}
+			return length;
+		}
+
+	private:
+		struct Slot {
+			uint64_t Key = 0;
+			bool Used = false;
+			std::unique_ptr<T> Value;
+		};
+
+		// Find the slot of a key, or the empty slot where it belongs.
+		Slot& FindSlot(uint64_t key) {
+			size_t mask = m_Slots.size() - 1;
+			size_t index = Hash(key) & mask;
+			while (m_Slots[index].Used && m_Slots[index].Key != key) {
+				index = (index + 1) & mask;
+			}
+			return m_Slots[index];
+		}
+
+		void Grow() {
+			std::vector<Slot> slots(m_Slots.size() * 2);
+			slots.swap(m_Slots);
+			for (auto& slot : slots) {
+				if (slot.Used) {
+					FindSlot(slot.Key) = std::move(slot);
+				}
+			}
+		}
+
+		// The size is a power of two.
+		std::vector<Slot> m_Slots;
+		size_t m_Size;
+	};
+}
@@ -0,0 +1,279 @@
+#include "stdafx.h"
+#include "SectionCulling.h"
+#include "SectionSummary.h"
+#include "DxCamera.h"
+#include <immintrin.h>
+
+using namespace DirectX;
+
+namespace MineCraft {
+#if defined(__AVX__)
+	const size_t BoxesPerIteration = 8;
+#else
+	const size_t BoxesPerIteration = 4;
+#endif
+	const size_t BoxListPadding = 8;
+
+	Frustum XM_CALLCONV Frustum::FromMatrices(FXMMATRIX view, CXMMATRIX projection) {
+		// Gribb/Hartmann plane extraction on the columns of the view-projection matrix
+		// (D3D clip space, 0 <= z <= w).
+		XMMATRIX m = XMMatrixTranspose(XMMatrixMultiply(view, projection));
+		XMVECTOR planes[6] = {
+			XMVectorAdd(m.r[3], m.r[0]),		// Left
+			XMVectorSubtract(m.r[3], m.r[0]),	// Right
+			XMVectorAdd(m.r[3], m.r[1]),		// Bottom
+			XMVectorSubtract(m.r[3], m.r[1]),	// Top
+			m.r[2],								// Near
+			XMVectorSubtract(m.r[3], m.r[2]),	// Far
+		};
+
+		Frustum frustum;
+		for (int i = 0; i < 6; i++) {
+			XMStoreFloat4(&frustum.Planes[i], XMPlaneNormalize(planes[i]));
+		}
+		return frustum;
+	}
+
+	Frustum Frustum::FromCamera(const DxCamera& camera) {
+		return FromMatrices(camera.get_ViewMatrix(), camera.get_ProjectionMatrix());
+	}
+
+	bool Frustum::IntersectsBox(const XMFLOAT3& min, const XMFLOAT3& max) const {
+		for (const XMFLOAT4& p : Planes) {
+			// Test the corner furthest along the plane normal. The terms are
+			// added in the order of BoxList::Cull, so both give the same result.
+			float d = (p.x * (p.x >= 0 ? max.x : min.x) + p.y * (p.y >= 0 ? max.y : min.y)) +
+				(p.z * (p.z >= 0 ? max.z : min.z) + p.w);
+			if (d < 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Frustum::ContainsBox(const XMFLOAT3& min, const XMFLOAT3& max) const {
+		for (const XMFLOAT4& p : Planes) {
+			// Test the corner furthest against the plane normal.
+			float d = (p.x * (p.x >= 0 ? min.x : max.x) + p.y * (p.y >= 0 ? min.y : max.y)) +
+				(p.z * (p.z >= 0 ? min.z : max.z) + p.w);
+			if (d < 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void BoxList::Clear() {
+		m_MinX.clear(); m_MinY.clear(); m_MinZ.clear();
+		m_MaxX.clear(); m_MaxY.clear(); m_MaxZ.clear();
+		m_Size = 0;
+	}
+
+	void BoxList::Add(const XMFLOAT3& min, const XMFLOAT3& max) {
+		size_t required = m_Size + BoxListPadding;
+		if (m_MinX.size() < required) {
+			size_t size = (required + 63) & ~size_t(63);
+			m_MinX.resize(size); m_MinY.resize(size); m_MinZ.resize(size);
+			m_MaxX.resize(size); m_MaxY.resize(size); m_MaxZ.resize(size);
+		}
+
+		m_MinX[m_Size] = min.x; m_MinY[m_Size] = min.y; m_MinZ[m_Size] = min.z;
+		m_MaxX[m_Size] = max.x; m_MaxY[m_Size] = max.y; m_MaxZ[m_Size] = max.z;
+		m_Size++;
+	}
+
+	size_t BoxList::Cull(const Frustum& frustum, size_t begin, size_t end, std::vector<uint32_t>& visible) const {
+		assert(end <= m_Size);
+
+		// For each plane, the coordinates of the corner furthest along its normal
+		// only depend on the sign of the normal, so select the arrays up front.
+		const float* px[6];
+		const float* py[6];
+		const float* pz[6];
+		for (int p = 0; p < 6; p++) {
+			const XMFLOAT4& plane = frustum.Planes[p];
+			px[p] = plane.x >= 0 ? m_MaxX.data() : m_MinX.data();
+			py[p] = plane.y >= 0 ? m_MaxY.data() : m_MinY.data();
+			pz[p] = plane.z >= 0 ? m_MaxZ.data() : m_MinZ.data();
+		}
+
+		size_t numVisible = 0;
+		for (size_t i = begin; i < end; i += BoxesPerIteration) {
+#if defined(__AVX__)
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++) {
+				const XMFLOAT4& plane = frustum.Planes[p];
+				__m256 d = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), _mm256_loadu_ps(px[p] + i)),
+						_mm256_mul_ps(_mm256_set1_ps(plane.y), _mm256_loadu_ps(py[p] + i))),
+					_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), _mm256_loadu_ps(pz[p] + i)),
+						_mm256_set1_ps(plane.w)));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+			int mask = _mm256_movemask_ps(inside);
+#else
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++) {
+				const XMFLOAT4& plane = frustum.Planes[p];
+				__m128 d = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(px[p] + i)),
+						_mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(py[p] + i))),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(pz[p] + i)),
+						_mm_set1_ps(plane.w)));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+			}
+			int mask = _mm_movemask_ps(inside);
+#endif
+			size_t count = end - i;
+			if (count < BoxesPerIteration) {
+				mask &= (1 << count) - 1;
+			}
+
+			for (uint32_t b = 0; mask != 0; b++, mask >>= 1) {
+				if (mask & 1) {
+					visible.push_back((uint32_t)(i + b));
+					numVisible++;
+				}
+			}
+		}
+
+		return numVisible;
+	}
+
+	void SectionCuller::Clear() {
+		m_Keys.clear();
+		m_SectionBoxes.Clear();
+		m_ChunkBoxes.Clear();
+		m_ChunkSections.clear();
+		m_RegionMin.clear();
+		m_RegionMax.clear();
+		m_RegionChunks.clear();
+		m_Built = false;
+	}
+
+	void SectionCuller::AddSection(int x, int y, int z) {
+		m_Keys.push_back(PackSectionKey(x, y, z));
+		m_Built = false;
+	}
+
+	void SectionCuller::RemoveChunk(int xChunk, int zChunk) {
+		// The key of a section without its y is the key of its chunk.
+		uint64_t chunkKey = PackSectionKey(xChunk, 0, zChunk) >> 8;
+		auto removed = std::remove_if(m_Keys.begin(), m_Keys.end(), [chunkKey](uint64_t key) {
+			return (key >> 8) == chunkKey;
+		});
+		if (m_Keys.end() != removed) {
+			m_Keys.erase(removed, m_Keys.end());
+			m_Built = false;
+		}
+	}
+
+	void SectionCuller::Build() {
+		struct SectionPosition {
+			int X, Y, Z;
+		};
+
+		std::vector<SectionPosition> positions(m_Keys.size());
+		for (size_t i = 0; i < m_Keys.size(); i++) {
+			UnpackSectionKey(m_Keys[i], positions[i].X, positions[i].Y, positions[i].Z);
+		}
+
+		std::sort(positions.begin(), positions.end(), [](const SectionPosition& a, const SectionPosition& b) {
+			if ((a.X >> 5) != (b.X >> 5)) return (a.X >> 5) < (b.X >> 5);
+			if ((a.Z >> 5) != (b.Z >> 5)) return (a.Z >> 5) < (b.Z >> 5);
+			if (a.X != b.X) return a.X < b.X;
+			if (a.Z != b.Z) return a.Z < b.Z;
+			return a.Y < b.Y;
+		});
+
+		m_SectionBoxes.Clear();
+		m_ChunkBoxes.Clear();
+		m_ChunkSections.clear();
+		m_RegionMin.clear();
+		m_RegionMax.clear();
+		m_RegionChunks.clear();
+
+		const float size = (float)SECTION_SIZE;
+		for (size_t i = 0; i < positions.size(); i++) {
+			const SectionPosition& s = positions[i];
+			m_Keys[i] = PackSectionKey(s.X, s.Y, s.Z);
+
+			XMFLOAT3 min(s.X * size, s.Y * size, s.Z * size);
+			XMFLOAT3 max(min.x + size, min.y + size, min.z + size);
+			m_SectionBoxes.Add(min, max);
+
+			bool newRegion = i == 0 || (positions[i - 1].X >> 5) != (s.X >> 5) || (positions[i - 1].Z >> 5) != (s.Z >> 5);
+			bool newChunk = newRegion || positions[i - 1].X != s.X || positions[i - 1].Z != s.Z;
+
+			if (newRegion) {
+				m_RegionChunks.push_back({ (uint32_t)m_ChunkSections.size(), (uint32_t)m_ChunkSections.size() });
+				m_RegionMin.push_back(min);
+				m_RegionMax.push_back(max);
+			}
+			if (newChunk) {
+				m_ChunkSections.push_back({ (uint32_t)i, (uint32_t)i });
+				m_RegionChunks.back().End++;
+			}
+			m_ChunkSections.back().End++;
+
+			XMFLOAT3& regionMin = m_RegionMin.back();
+			XMFLOAT3& regionMax = m_RegionMax.back();
+			regionMin = XMFLOAT3(std::min(regionMin.x, min.x), std::min(regionMin.y, min.y), std::min(regionMin.z, min.z));
+			regionMax = XMFLOAT3(std::max(regionMax.x, max.x), std::max(regionMax.y, max.y), std::max(regionMax.z, max.z));
+		}
+
+		// Chunk column bounds span the lowest to highest section that was added.
+		for (const Range& chunk : m_ChunkSections) {
+			const SectionPosition& first = positions[chunk.Begin];
+			const SectionPosition& last = positions[chunk.End - 1];
+			m_ChunkBoxes.Add(XMFLOAT3(first.X * size, first.Y * size, first.Z * size),
+				XMFLOAT3((first.X + 1) * size, (last.Y + 1) * size, (first.Z + 1) * size));
+		}
+
+		m_Built = true;
+	}
+
+	void SectionCuller::Cull(const Frustum& frustum, std::vector<uint64_t>& visibleKeys) {
+		if (!m_Built) {
+			Build();
+		}
+
+		visibleKeys.clear();
+		m_Statistics = {};
+		m_Statistics.NumSections = (uint32_t)m_Keys.size();
+
+		for (size_t r = 0; r < m_RegionChunks.size(); r++) {
+			const Range& chunks = m_RegionChunks[r];
+			m_Statistics.NumRegionsTested++;
+
+			if (!frustum.IntersectsBox(m_RegionMin[r], m_RegionMax[r])) {
+				continue;
+			}
+
+			if (frustum.ContainsBox(m_RegionMin[r], m_RegionMax[r])) {
+				// The whole region is visible.
+				uint32_t begin = m_ChunkSections[chunks.Begin].Begin;
+				uint32_t end = m_ChunkSections[chunks.End - 1].End;
+				visibleKeys.insert(visibleKeys.end(), m_Keys.begin() + begin, m_Keys.begin() + end);
+				continue;
+			}
+
+			m_VisibleChunks.clear();
+			m_ChunkBoxes.Cull(frustum, chunks.Begin, chunks.End, m_VisibleChunks);
+			m_Statistics.NumChunksTested += chunks.End - chunks.Begin;
+
+			for (uint32_t c : m_VisibleChunks) {
+				const Range& sections = m_ChunkSections[c];
+				m_VisibleSections.clear();
+				m_SectionBoxes.Cull(frustum, sections.Begin, sections.End, m_VisibleSections);
+				m_Statistics.NumSectionsTested += sections.End - sections.Begin;
+
+				for (uint32_t s : m_VisibleSections) {
+					visibleKeys.push_back(m_Keys[s]);
+				}
+			}
+		}
+
+		m_Statistics.NumVisible = (uint32_t)visibleKeys.size();
+	}
+}
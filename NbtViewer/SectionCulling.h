@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+class DxCamera;
+
+namespace MineCraft {
+	// The six planes of a view frustum, pointing inwards (ax + by + cz + d >= 0 is inside).
+	struct Frustum {
+		DirectX::XMFLOAT4 Planes[6];
+
+		// Extract the planes from a (row-vector) view and D3D projection matrix.
+		static Frustum XM_CALLCONV FromMatrices(DirectX::FXMMATRIX view, DirectX::CXMMATRIX projection);
+		static Frustum FromCamera(const DxCamera& camera);
+
+		// Scalar test of a single box.
+		bool IntersectsBox(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max) const;
+		bool ContainsBox(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max) const;
+	};
+
+	// Axis aligned boxes stored as structure of arrays so they can be tested
+	// four (SSE) or eight (AVX) at a time.
+	class BoxList {
+	public:
+		void Clear();
+		void Add(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max);
+		inline size_t Size() const { return m_Size; }
+
+		// Append the indices of the boxes in [begin, end) that intersect the frustum.
+		// Returns the number of visible boxes that were appended.
+		size_t Cull(const Frustum& frustum, size_t begin, size_t end, std::vector<uint32_t>& visible) const;
+
+	private:
+		// Each array is padded to a multiple of 8 so the SIMD loop can always read full vectors.
+		std::vector<float> m_MinX, m_MinY, m_MinZ;
+		std::vector<float> m_MaxX, m_MaxY, m_MaxZ;
+		size_t m_Size = 0;
+	};
+
+	// Frustum culling of chunk sections with a region -> chunk -> section hierarchy.
+	// Sections are added with AddSection and Build groups them so that a whole
+	// region or chunk column outside of the frustum is rejected with one test,
+	// and one completely inside is accepted without testing its children.
+	class SectionCuller {
+	public:
+		struct Statistics {
+			uint32_t NumSections;
+			uint32_t NumVisible;
+			uint32_t NumRegionsTested;
+			uint32_t NumChunksTested;
+			uint32_t NumSectionsTested;
+		};
+
+		void Clear();
+		// Add a section by its section coordinates (x and z in chunks, y in 0..15).
+		void AddSection(int x, int y, int z);
+		// Remove all sections of a chunk column.
+		void RemoveChunk(int xChunk, int zChunk);
+		// Group the sections into the hierarchy. Must be called after adding sections.
+		void Build();
+
+		// Fill visibleKeys with the PackSectionKey keys of the visible sections.
+		void Cull(const Frustum& frustum, std::vector<uint64_t>& visibleKeys);
+
+		inline const Statistics& GetStatistics() const { return m_Statistics; }
+		inline size_t Size() const { return m_Keys.size(); }
+
+	private:
+		struct Range {
+			uint32_t Begin;
+			uint32_t End;
+		};
+
+		std::vector<uint64_t> m_Keys;
+		bool m_Built = false;
+
+		// Sections, sorted by region and chunk.
+		BoxList m_SectionBoxes;
+		// Chunk columns, with the range of their sections.
+		BoxList m_ChunkBoxes;
+		std::vector<Range> m_ChunkSections;
+		// Regions, with the range of their chunks.
+		std::vector<DirectX::XMFLOAT3> m_RegionMin, m_RegionMax;
+		std::vector<Range> m_RegionChunks;
+
+		std::vector<uint32_t> m_VisibleChunks;
+		std::vector<uint32_t> m_VisibleSections;
+		Statistics m_Statistics = {};
+	};
+}
@@ -0,0 +1,121 @@
+#include "stdafx.h"
+#include "SectionSummary.h"
+#include <bitset>
+
+namespace MineCraft {
+	namespace {
+		// Block ids (1.12) that do not completely hide the blocks behind them:
+		// air, fluids, foliage, glass, and all non-cube shapes.
+		const short TransparentBlockIds[] = {
+			0, 6, 8, 9, 18, 20, 26, 27, 28, 30, 31, 32, 34, 36, 37, 38, 39, 40, 44, 50,
+			51, 53, 54, 55, 59, 60, 63, 64, 65, 66, 67, 68, 69, 70, 71, 72, 75, 76, 77, 78,
+			79, 81, 83, 85, 88, 90, 92, 93, 94, 95, 96, 101, 102, 104, 105, 106, 107, 108, 109, 111,
+			113, 114, 115, 116, 117, 118, 119, 120, 122, 126, 127, 128, 130, 131, 132, 134, 135, 136, 138, 139,
+			140, 141, 142, 143, 144, 145, 146, 147, 148, 149, 150, 151, 154, 156, 160, 161, 163, 164, 165, 166,
+			167, 171, 175, 176, 177, 178, 180, 182, 183, 184, 185, 186, 187, 188, 189, 190, 191, 192, 193, 194,
+			195, 196, 197, 198, 199, 200, 203, 205, 207, 208, 209, 212, 217, 219, 220, 221, 222, 223, 224, 225,
+			226, 227, 228, 229, 230, 231, 232, 233, 234,
+		};
+
+		struct OpacityTable {
+			std::bitset<4096> Transparent;
+
+			OpacityTable() {
+				for (short id : TransparentBlockIds) {
+					Transparent.set(id);
+				}
+			}
+		};
+
+		const OpacityTable& GetOpacityTable() {
+			static const OpacityTable table;
+			return table;
+		}
+
+		// Bits of the x = 0 and x = 15 columns in a word holding four 16-block rows.
+		const uint64_t NegativeXMask = 0x0001000100010001ull;
+		const uint64_t PositiveXMask = 0x8000800080008000ull;
+		// The first and last row of a 256-block layer (4 words).
+		const uint64_t FirstRowMask = 0x000000000000FFFFull;
+		const uint64_t LastRowMask = 0xFFFF000000000000ull;
+		const int WordsPerLayer = 4;
+		const int NumWords = SECTION_BLOCKS / 64;
+
+		inline int PopCount(uint64_t v) {
+			v = v - ((v >> 1) & 0x5555555555555555ull);
+			v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+			v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+			return (int)((v * 0x0101010101010101ull) >> 56);
+		}
+	}
+
+	bool IsOpaqueBlock(short blockId) {
+		return !GetOpacityTable().Transparent.test(blockId & 0x0FFF);
+	}
+
+	void SectionSummary::Compute(const short* blockIds) {
+		const OpacityTable& opacity = GetOpacityTable();
+
+		Clear();
+		UniformId = blockIds[0];
+
+		bool uniform = true;
+		for (int w = 0; w < NumWords; w++) {
+			const short* ids = blockIds + w * 64;
+			uint64_t bits = 0;
+			for (int b = 0; b < 64; b++) {
+				uniform &= ids[b] == UniformId;
+				if (!opacity.Transparent.test(ids[b] & 0x0FFF)) {
+					bits |= 1ull << b;
+				}
+			}
+			Solid[w] = bits;
+		}
+
+		int solidCount = 0;
+		uint64_t allX = ~0ull;
+		for (int w = 0; w < NumWords; w++) {
+			solidCount += PopCount(Solid[w]);
+			allX &= Solid[w];
+		}
+		SolidCount = (uint16_t)solidCount;
+
+		Flags = 0;
+		if (uniform) {
+			Flags |= Uniform;
+			if (UniformId == 0) {
+				Flags |= Empty;
+			}
+		}
+		if (solidCount == SECTION_BLOCKS) {
+			Flags |= FullySolid;
+			OpaqueFaces = 0x3F;
+			return;
+		}
+		if (solidCount == 0) {
+			return;
+		}
+
+		// +X / -X: the x = 15 / x = 0 column of every row.
+		if ((allX & PositiveXMask) == PositiveXMask) OpaqueFaces |= 1 << FacePositiveX;
+		if ((allX & NegativeXMask) == NegativeXMask) OpaqueFaces |= 1 << FaceNegativeX;
+
+		// +Y / -Y: the top / bottom layer.
+		bool top = true, bottom = true;
+		for (int w = 0; w < WordsPerLayer; w++) {
+			bottom &= Solid[w] == ~0ull;
+			top &= Solid[NumWords - WordsPerLayer + w] == ~0ull;
+		}
+		if (top) OpaqueFaces |= 1 << FacePositiveY;
+		if (bottom) OpaqueFaces |= 1 << FaceNegativeY;
+
+		// +Z / -Z: the last / first row of every layer.
+		bool front = true, back = true;
+		for (int y = 0; y < SECTION_SIZE; y++) {
+			back &= (Solid[y * WordsPerLayer] & FirstRowMask) == FirstRowMask;
+			front &= (Solid[y * WordsPerLayer + WordsPerLayer - 1] & LastRowMask) == LastRowMask;
+		}
+		if (front) OpaqueFaces |= 1 << FacePositiveZ;
+		if (back) OpaqueFaces |= 1 << FaceNegativeZ;
+	}
+}
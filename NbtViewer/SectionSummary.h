@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace MineCraft {
+	const int SECTION_SIZE = 16;
+	const int SECTION_BLOCKS = SECTION_SIZE * SECTION_SIZE * SECTION_SIZE;
+
+	// Blocks in a section are stored y-major: index = (y * 16 + z) * 16 + x.
+	inline int SectionBlockIndex(int x, int y, int z) {
+		return (y << 8) | (z << 4) | x;
+	}
+
+	// Packs section coordinates (x and z in sections, y in 0..15) into one integer key.
+	inline uint64_t PackSectionKey(int x, int y, int z) {
+		return ((uint64_t)(x & 0x0FFFFFFF) << 36) | ((uint64_t)(z & 0x0FFFFFFF) << 8) | (uint8_t)y;
+	}
+
+	inline void UnpackSectionKey(uint64_t key, int& x, int& y, int& z) {
+		// Shift up and back down to sign-extend the 28-bit fields.
+		x = (int)((int64_t)key >> 36);
+		z = (int)((int32_t)((uint32_t)(key >> 8) << 4) >> 4);
+		y = (int)(key & 0xFF);
+	}
+
+	// The faces of a section, in the same order as VoxelFace in DX12Lib.
+	enum SectionFace {
+		FacePositiveX = 0,
+		FaceNegativeX = 1,
+		FacePositiveY = 2,
+		FaceNegativeY = 3,
+		FacePositiveZ = 4,
+		FaceNegativeZ = 5,
+		NumSectionFaces
+	};
+
+	inline SectionFace OppositeFace(SectionFace face) {
+		return (SectionFace)(face ^ 1);
+	}
+
+	// Returns true if the block fully hides whatever is behind it.
+	bool IsOpaqueBlock(short blockId);
+
+	// Summary metadata computed once when a section is loaded or changed, so
+	// meshing, culling, lighting and raycasts can skip or short-circuit
+	// whole sections with word-level bit operations.
+	struct SectionSummary {
+		enum Flags : uint8_t {
+			Empty = 0x01,		// Every block is air.
+			Uniform = 0x02,		// Every block has the same id (UniformId).
+			FullySolid = 0x04,	// Every block is opaque.
+		};
+
+		uint8_t Flags;
+		// Bit set for every face whose 16x16 boundary layer is completely opaque.
+		uint8_t OpaqueFaces;
+		uint16_t SolidCount;
+		short UniformId;
+		// One bit per block (1 = opaque), indexed by SectionBlockIndex.
+		uint64_t Solid[SECTION_BLOCKS / 64];
+
+		SectionSummary() {
+			Clear();
+		}
+
+		void Clear() {
+			Flags = Empty | Uniform;
+			OpaqueFaces = 0;
+			SolidCount = 0;
+			UniformId = 0;
+			memset(Solid, 0, sizeof(Solid));
+		}
+
+		// Compute the summary from the 4096 block ids of a section.
+		void Compute(const short* blockIds);
+
+		inline bool IsEmpty() const { return (Flags & Empty) != 0; }
+		inline bool IsUniform() const { return (Flags & Uniform) != 0; }
+		inline bool IsFullySolid() const { return (Flags & FullySolid) != 0; }
+		inline bool IsFaceOpaque(SectionFace face) const { return (OpaqueFaces & (1 << face)) != 0; }
+		// A section that is opaque on every face cannot be seen into.
+		inline bool IsSealed() const { return OpaqueFaces == 0x3F; }
+
+		inline bool IsSolid(int x, int y, int z) const {
+			int index = SectionBlockIndex(x, y, z);
+			return (Solid[index >> 6] >> (index & 63)) & 1;
+		}
+	};
+
+	// Counts of sections that could be skipped, accumulated while loading.
+	struct SectionSummaryStatistics {
+		uint64_t NumSections = 0;
+		uint64_t NumEmpty = 0;
+		uint64_t NumUniform = 0;
+		uint64_t NumFullySolid = 0;
+		uint64_t NumSealed = 0;
+
+		void Add(const SectionSummary& summary) {
+			NumSections++;
+			NumEmpty += summary.IsEmpty() ? 1 : 0;
+			NumUniform += summary.IsUniform() ? 1 : 0;
+			NumFullySolid += summary.IsFullySolid() ? 1 : 0;
+			NumSealed += summary.IsSealed() ? 1 : 0;
+		}
+
+		// Fraction of sections that need no per-block work at all.
+		double SkippedFraction() const {
+			return NumSections > 0 ? (double)(NumEmpty + NumFullySolid) / NumSections : 0.0;
+		}
+	};
+}
@@ -0,0 +1,220 @@
+#include "stdafx.h"
+#include "SectionVisibility.h"
+#include "SectionCulling.h"
+#include <cmath>
+
+using namespace DirectX;
+
+namespace MineCraft {
+	namespace {
+		// Unit step in section coordinates for each SectionFace.
+		const int FaceOffsets[NumSectionFaces][3] = {
+			{ 1, 0, 0 }, { -1, 0, 0 },
+			{ 0, 1, 0 }, { 0, -1, 0 },
+			{ 0, 0, 1 }, { 0, 0, -1 },
+		};
+
+		struct FacePairTable {
+			int Bits[NumSectionFaces][NumSectionFaces];
+
+			FacePairTable() {
+				int bit = 0;
+				for (int a = 0; a < NumSectionFaces; a++) {
+					Bits[a][a] = -1;
+					for (int b = a + 1; b < NumSectionFaces; b++) {
+						Bits[a][b] = Bits[b][a] = bit++;
+					}
+				}
+			}
+		};
+
+		const FacePairTable& GetFacePairTable() {
+			static const FacePairTable table;
+			return table;
+		}
+	}
+
+	int FacePairBit(SectionFace a, SectionFace b) {
+		assert(a != b);
+		return GetFacePairTable().Bits[a][b];
+	}
+
+	SectionConnectivity ComputeSectionConnectivity(const SectionSummary& summary) {
+		if (summary.SolidCount == 0) {
+			return AllFacesConnected;
+		}
+		if (summary.IsFullySolid()) {
+			return 0;
+		}
+
+		// Blocks that are opaque or already filled.
+		uint64_t visited[SECTION_BLOCKS / 64];
+		memcpy(visited, summary.Solid, sizeof(visited));
+
+		uint16_t stack[SECTION_BLOCKS];
+		SectionConnectivity connectivity = 0;
+
+		for (int start = 0; start < SECTION_BLOCKS; start++) {
+			if ((visited[start >> 6] >> (start & 63)) & 1) {
+				continue;
+			}
+
+			// Fill one connected region of non-opaque blocks and record the faces it touches.
+			uint8_t faces = 0;
+			int top = 0;
+			stack[top++] = (uint16_t)start;
+			visited[start >> 6] |= 1ull << (start & 63);
+
+			while (top > 0) {
+				int index = stack[--top];
+				int x = index & 15;
+				int z = (index >> 4) & 15;
+				int y = index >> 8;
+
+				if (x == 15) faces |= 1 << FacePositiveX;
+				if (x == 0) faces |= 1 << FaceNegativeX;
+				if (y == 15) faces |= 1 << FacePositiveY;
+				if (y == 0) faces |= 1 << FaceNegativeY;
+				if (z == 15) faces |= 1 << FacePositiveZ;
+				if (z == 0) faces |= 1 << FaceNegativeZ;
+
+				int neighbours[6];
+				int count = 0;
+				if (x < 15) neighbours[count++] = index + 1;
+				if (x > 0) neighbours[count++] = index - 1;
+				if (z < 15) neighbours[count++] = index + 16;
+				if (z > 0) neighbours[count++] = index - 16;
+				if (y < 15) neighbours[count++] = index + 256;
+				if (y > 0) neighbours[count++] = index - 256;
+
+				for (int n = 0; n < count; n++) {
+					int neighbour = neighbours[n];
+					uint64_t bit = 1ull << (neighbour & 63);
+					if ((visited[neighbour >> 6] & bit) == 0) {
+						visited[neighbour >> 6] |= bit;
+						stack[top++] = (uint16_t)neighbour;
+					}
+				}
+			}
+
+			for (int a = 0; a < NumSectionFaces; a++) {
+				if ((faces & (1 << a)) == 0) continue;
+				for (int b = a + 1; b < NumSectionFaces; b++) {
+					if (faces & (1 << b)) {
+						connectivity |= 1 << FacePairBit((SectionFace)a, (SectionFace)b);
+					}
+				}
+			}
+
+			if (connectivity == AllFacesConnected) {
+				break;
+			}
+		}
+
+		return connectivity;
+	}
+
+	void SectionOcclusionCuller::Clear() {
+		m_Sections.clear();
+		m_Chunks.clear();
+	}
+
+	void SectionOcclusionCuller::AddChunk(int xChunk, int zChunk) {
+		m_Chunks.insert(ChunkKey(xChunk, zChunk));
+	}
+
+	void SectionOcclusionCuller::RemoveChunk(int xChunk, int zChunk) {
+		m_Chunks.erase(ChunkKey(xChunk, zChunk));
+		for (int y = 0; y < SECTION_SIZE; y++) {
+			m_Sections.erase(PackSectionKey(xChunk, y, zChunk));
+		}
+	}
+
+	void SectionOcclusionCuller::SetSection(int x, int y, int z, SectionConnectivity connectivity) {
+		m_Sections[PackSectionKey(x, y, z)] = connectivity;
+	}
+
+	bool SectionOcclusionCuller::GetConnectivity(int x, int y, int z, SectionConnectivity& connectivity, bool& stored) const {
+		if (y < 0 || y >= SECTION_SIZE || m_Chunks.count(ChunkKey(x, z)) == 0) {
+			return false;
+		}
+
+		auto iter = m_Sections.find(PackSectionKey(x, y, z));
+		stored = iter != m_Sections.end();
+		connectivity = stored ? iter->second : AllFacesConnected;
+		return true;
+	}
+
+	bool SectionOcclusionCuller::Cull(const XMFLOAT3& cameraPosition, const Frustum* frustum, std::vector<uint64_t>& visibleKeys) {
+		visibleKeys.clear();
+		m_Statistics = {};
+
+		int cx = (int)std::floor(cameraPosition.x / SECTION_SIZE);
+		int cy = std::min(std::max((int)std::floor(cameraPosition.y / SECTION_SIZE), 0), SECTION_SIZE - 1);
+		int cz = (int)std::floor(cameraPosition.z / SECTION_SIZE);
+
+		SectionConnectivity connectivity;
+		bool stored;
+		if (!GetConnectivity(cx, cy, cz, connectivity, stored)) {
+			return false;
+		}
+
+		m_Queue.clear();
+		m_Visited.clear();
+		m_Queue.push_back({ cx, cy, cz, -1, 0 });
+		m_Visited.insert(PackSectionKey(cx, cy, cz));
+
+		const float size = (float)SECTION_SIZE;
+		for (size_t head = 0; head < m_Queue.size(); head++) {
+			Node node = m_Queue[head];
+			m_Statistics.NumVisited++;
+
+			GetConnectivity(node.X, node.Y, node.Z, connectivity, stored);
+			if (stored) {
+				visibleKeys.push_back(PackSectionKey(node.X, node.Y, node.Z));
+			}
+
+			for (int f = 0; f < NumSectionFaces; f++) {
+				SectionFace face = (SectionFace)f;
+
+				// Never travel back towards the camera.
+				if (node.Directions & (1 << OppositeFace(face))) {
+					continue;
+				}
+				// The exit face must be reachable from the face we came in through.
+				if (node.EntryFace >= 0 && !AreFacesConnected(connectivity, (SectionFace)node.EntryFace, face)) {
+					continue;
+				}
+
+				int x = node.X + FaceOffsets[f][0];
+				int y = node.Y + FaceOffsets[f][1];
+				int z = node.Z + FaceOffsets[f][2];
+
+				SectionConnectivity neighbourConnectivity;
+				bool neighbourStored;
+				if (!GetConnectivity(x, y, z, neighbourConnectivity, neighbourStored)) {
+					continue;
+				}
+
+				uint64_t key = PackSectionKey(x, y, z);
+				if (m_Visited.count(key)) {
+					continue;
+				}
+
+				if (frustum) {
+					XMFLOAT3 min(x * size, y * size, z * size);
+					XMFLOAT3 max(min.x + size, min.y + size, min.z + size);
+					if (!frustum->IntersectsBox(min, max)) {
+						continue;
+					}
+				}
+
+				m_Visited.insert(key);
+				m_Queue.push_back({ x, y, z, OppositeFace(face), (uint8_t)(node.Directions | (1 << f)) });
+			}
+		}
+
+		m_Statistics.NumVisible = (uint32_t)visibleKeys.size();
+		return true;
+	}
+}
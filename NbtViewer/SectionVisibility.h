@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <DirectXMath.h>
+#include "SectionSummary.h"
+
+namespace MineCraft {
+	struct Frustum;
+
+	// A 15-bit mask with one bit for every pair of distinct section faces.
+	// The bit is set if the two faces are connected through non-opaque blocks.
+	using SectionConnectivity = uint16_t;
+	const SectionConnectivity AllFacesConnected = 0x7FFF;
+
+	// The bit of the face pair (a, b) in a SectionConnectivity mask. a != b.
+	int FacePairBit(SectionFace a, SectionFace b);
+
+	inline bool AreFacesConnected(SectionConnectivity connectivity, SectionFace a, SectionFace b) {
+		return (connectivity >> FacePairBit(a, b)) & 1;
+	}
+
+	// Flood fill the non-opaque blocks of a section to find which faces can see each other.
+	SectionConnectivity ComputeSectionConnectivity(const SectionSummary& summary);
+
+	// Occlusion culling of sections by a breadth-first search from the camera's
+	// section, which only passes through faces that are connected inside the
+	// section it enters, and never back towards the camera. Sections hidden
+	// behind terrain (caves seen from the surface and the surface seen from a
+	// cave) are never reached.
+	class SectionOcclusionCuller {
+	public:
+		struct Statistics {
+			uint32_t NumVisited;
+			uint32_t NumVisible;
+		};
+
+		void Clear();
+		// Mark a chunk column as loaded. Sections of a loaded chunk that
+		// have no connectivity set are treated as air.
+		void AddChunk(int xChunk, int zChunk);
+		// Unload a chunk column and forget the connectivity of its sections.
+		void RemoveChunk(int xChunk, int zChunk);
+		void SetSection(int x, int y, int z, SectionConnectivity connectivity);
+
+		// Fill visibleKeys with the PackSectionKey keys of the sections that
+		// were set with SetSection and can be seen from the camera position.
+		// If a frustum is given, sections outside of it are not traversed.
+		// Returns false (and leaves visibleKeys empty) if the camera is not in a loaded chunk.
+		bool Cull(const DirectX::XMFLOAT3& cameraPosition, const Frustum* frustum, std::vector<uint64_t>& visibleKeys);
+
+		inline const Statistics& GetStatistics() const { return m_Statistics; }
+
+	private:
+		struct Node {
+			int X, Y, Z;
+			// The face this section was entered through, or -1 for the camera section.
+			int EntryFace;
+			// The directions (SectionFace bits) that were travelled to reach this section.
+			uint8_t Directions;
+		};
+
+		static uint64_t ChunkKey(int xChunk, int zChunk) {
+			return ((uint64_t)(uint32_t)xChunk << 32) | (uint32_t)zChunk;
+		}
+
+		// Returns false if the section is outside of the loaded world.
+		bool GetConnectivity(int x, int y, int z, SectionConnectivity& connectivity, bool& stored) const;
+
+		std::unordered_map<uint64_t, SectionConnectivity> m_Sections;
+		std::unordered_set<uint64_t> m_Chunks;
+
+		std::vector<Node> m_Queue;
+		std::unordered_set<uint64_t> m_Visited;
+		Statistics m_Statistics = {};
+	};
+}
@@ -0,0 +1,36 @@
+cbuffer PerFrame : register( b0 )
+{
+    matrix ViewProjectionMatrix;
+}
+
+struct AppData
+{
+    // Per-vertex data of a unit cube centered on the origin.
+    float3 Position : POSITION;
+    float3 Normal   : NORMAL;
+    float2 TexCoord : TEXCOORD;
+    // Per-instance data, the world position of the block's center.
+    float3 InstancePosition : INSTANCEPOSITION;
+};
+
+struct VertexShaderOutput
+{
+    float4 PositionWS   : TEXCOORD1;
+    float3 NormalWS     : TEXCOORD2;
+    float2 TexCoord     : TEXCOORD0;
+    float4 Position     : SV_Position;
+};
+
+// Blocks are only translated, so the normal needs no transformation.
+VertexShaderOutput InstancedVertexShader( AppData IN )
+{
+    VertexShaderOutput OUT;
+
+    float4 positionWS = float4( IN.Position + IN.InstancePosition, 1.0f );
+    OUT.Position = mul( ViewProjectionMatrix, positionWS );
+    OUT.PositionWS = positionWS;
+    OUT.NormalWS = IN.Normal;
+    OUT.TexCoord = IN.TexCoord;
+
+    return OUT;
+}
@@ -0,0 +1,98 @@
+#include "Test.h"
+
+#include "BlockInstanceBuilder.h"
+
+#include <random>
+
+using namespace MC;
+
+TEST(BlockInstancePackedPosition)
+{
+    const int values[] = { 0, 1, 511, BlockInstanceBuilder::PositionRange - 1 };
+    for (int x : values)
+    {
+        for (int y : values)
+        {
+            for (int z : values)
+            {
+                int ux, uy, uz;
+                BlockInstanceBuilder::UnpackPosition(BlockInstanceBuilder::PackPosition(x, y, z), ux, uy, uz);
+                CHECK(ux == x && uy == y && uz == z);
+            }
+        }
+    }
+}
+
+TEST(BlockInstanceBuilderRejectsFarBlocks)
+{
+    BlockInstanceBuilder builder(-100, 0, 200);
+    CHECK(builder.Add(1, -100, 0, 200, 0));
+    CHECK(builder.Add(1, -100 + BlockInstanceBuilder::PositionRange - 1, 0, 200, 0));
+    CHECK(!builder.Add(1, -101, 0, 200, 0));
+    CHECK(!builder.Add(1, -100 + BlockInstanceBuilder::PositionRange, 0, 200, 0));
+    CHECK(!builder.Add(1, -100, -1, 200, 0));
+    CHECK(builder.GetBlockCount() == 2);
+
+    builder.Build();
+    CHECK(builder.GetBatches().size() == 1);
+
+    // An empty builder has no batches.
+    builder.SetOrigin(0, 0, 0);
+    builder.Build();
+    CHECK(builder.GetBatches().empty() && builder.GetInstances().empty());
+}
+
+TEST(BlockInstanceBuilderGroupsByBlockType)
+{
+    std::mt19937 random(40);
+    std::uniform_int_distribution<uint32_t> blockType(0, 40);
+    std::uniform_int_distribution<int> position(0, BlockInstanceBuilder::PositionRange - 1);
+
+    for (int round = 0; round < 10; ++round)
+    {
+        BlockInstanceBuilder builder(16, -64, 32);
+
+        // The blocks of every type in the order they were added.
+        std::vector<std::vector<BlockInstance>> expected(41);
+        int numBlocks = round * 500;
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            // Every other type is never used, so the sort has gaps.
+            uint32_t type = blockType(random) & ~1u;
+            int x = position(random), y = position(random), z = position(random);
+            CHECK(builder.Add(type, x + 16, y - 64, z + 32, type * 3));
+            expected[type].push_back({ BlockInstanceBuilder::PackPosition(x, y, z), type * 3 });
+        }
+        builder.Build();
+
+        const auto& instances = builder.GetInstances();
+        const auto& batches = builder.GetBatches();
+        CHECK(instances.size() == static_cast<size_t>(numBlocks));
+
+        uint32_t nextInstance = 0;
+        uint32_t previousType = 0;
+        for (size_t b = 0; b < batches.size(); ++b)
+        {
+            const auto& batch = batches[b];
+            CHECK(b == 0 || batch.BlockType > previousType);
+            CHECK(batch.FirstInstance == nextInstance);
+            CHECK(batch.InstanceCount == expected[batch.BlockType].size());
+            for (uint32_t i = 0; i < batch.InstanceCount; ++i)
+            {
+                const BlockInstance& instance = instances[batch.FirstInstance + i];
+                const BlockInstance& added = expected[batch.BlockType][i];
+                CHECK(instance.PackedPosition == added.PackedPosition && instance.TextureIndex == added.TextureIndex);
+            }
+            nextInstance += batch.InstanceCount;
+            previousType = batch.BlockType;
+        }
+        CHECK(nextInstance == instances.size());
+
+        size_t numTypes = 0;
+        for (const auto& blocks : expected)
+        {
+            numTypes += blocks.empty() ? 0 : 1;
+        }
+        CHECK(batches.size() == numTypes);
+    }
+}
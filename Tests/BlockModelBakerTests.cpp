@@ -0,0 +1,421 @@
+#include "Test.h"
+
+#include <BlockModelBaker.h>
+#include <BlockModelTable.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    // A resource pack in a temporary directory, removed with its files and the baked file.
+    struct TempAssets
+    {
+        fs::path Directory;
+        fs::path AssetDirectory;
+
+        TempAssets()
+            : Directory(fs::temp_directory_path() / (L"blockmodels-" + std::to_wstring(std::random_device()())))
+            , AssetDirectory(Directory / L"minecraft")
+        {
+            fs::create_directories(AssetDirectory / L"blockstates");
+            fs::create_directories(AssetDirectory / L"models" / L"block");
+        }
+
+        ~TempAssets()
+        {
+            std::error_code ec;
+            fs::remove_all(Directory, ec);
+        }
+
+        void WriteBlockState(const char* name, const char* json) const
+        {
+            Write(AssetDirectory / L"blockstates" / (std::string(name) + ".json"), json);
+        }
+
+        void WriteModel(const char* name, const char* json) const
+        {
+            Write(AssetDirectory / L"models" / L"block" / (std::string(name) + ".json"), json);
+        }
+
+        static void Write(const fs::path& fileName, const char* json)
+        {
+            std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+            file << json;
+        }
+    };
+
+    const uint8_t East = static_cast<uint8_t>(VoxelFace::PositiveX);
+    const uint8_t West = static_cast<uint8_t>(VoxelFace::NegativeX);
+    const uint8_t Up = static_cast<uint8_t>(VoxelFace::PositiveY);
+    const uint8_t Down = static_cast<uint8_t>(VoxelFace::NegativeY);
+    const uint8_t South = static_cast<uint8_t>(VoxelFace::PositiveZ);
+    const uint8_t North = static_cast<uint8_t>(VoxelFace::NegativeZ);
+
+    bool Near(float a, float b)
+    {
+        return std::abs(a - b) < 1e-5f;
+    }
+
+    // The quad of a state that faces a direction, nullptr if there is none or several.
+    const BakedQuad* FindQuad(const BlockModelTable& table, uint32_t state, uint8_t face)
+    {
+        const BakedQuad* found = nullptr;
+        for (uint16_t q = 0; q < table.GetState(state).NumQuads; ++q)
+        {
+            const BakedQuad& quad = table.GetQuads(state)[q];
+            if (quad.Face == face)
+            {
+                if (found)
+                {
+                    return nullptr;
+                }
+                found = &quad;
+            }
+        }
+        return found;
+    }
+
+    int CountCullFace(const BlockModelTable& table, uint32_t state, uint8_t cullFace)
+    {
+        int count = 0;
+        for (uint16_t q = 0; q < table.GetState(state).NumQuads; ++q)
+        {
+            count += table.GetQuads(state)[q].CullFace == cullFace ? 1 : 0;
+        }
+        return count;
+    }
+
+    // The range of a position (axis 0..2) or a texture coordinate (axis 3..4) over the corners of a quad.
+    void GetRange(const BakedQuad& quad, int axis, float& minimum, float& maximum)
+    {
+        minimum = 1e9f;
+        maximum = -1e9f;
+        for (int vertex = 0; vertex < 4; ++vertex)
+        {
+            float value = axis < 3 ? quad.Positions[vertex][axis] : quad.UVs[vertex][axis - 3];
+            minimum = std::min(minimum, value);
+            maximum = std::max(maximum, value);
+        }
+    }
+
+    bool HasRange(const BakedQuad& quad, int axis, float minimum, float maximum)
+    {
+        float a, b;
+        GetRange(quad, axis, a, b);
+        return Near(a, minimum) && Near(b, maximum);
+    }
+
+    // With uvlock the texture is projected onto the face in world space, like on an unrotated block.
+    bool HasWorldUVs(const BakedQuad& quad)
+    {
+        for (int vertex = 0; vertex < 4; ++vertex)
+        {
+            const float* p = quad.Positions[vertex];
+            float u, v;
+            switch (static_cast<VoxelFace>(quad.Face))
+            {
+            case VoxelFace::PositiveX: u = 1.0f - p[2]; v = 1.0f - p[1]; break;
+            case VoxelFace::NegativeX: u = p[2]; v = 1.0f - p[1]; break;
+            case VoxelFace::PositiveY: u = p[0]; v = p[2]; break;
+            case VoxelFace::NegativeY: u = p[0]; v = 1.0f - p[2]; break;
+            case VoxelFace::PositiveZ: u = p[0]; v = 1.0f - p[1]; break;
+            default: u = 1.0f - p[0]; v = 1.0f - p[1]; break;
+            }
+            if (!Near(quad.UVs[vertex][0], u) || !Near(quad.UVs[vertex][1], v))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint8_t FaceBit(uint8_t face)
+    {
+        return static_cast<uint8_t>(1u << face);
+    }
+
+    void WriteFixtures(const TempAssets& assets)
+    {
+        // Parents: block <- cube_all <- stone and glass.
+        assets.WriteModel("block", R"({ "textures": { "particle": "#all" } })");
+        assets.WriteModel("cube_all", R"({
+            "parent": "block/block",
+            "elements": [ { "from": [ 0, 0, 0 ], "to": [ 16, 16, 16 ], "faces": {
+                "down":  { "texture": "#all", "cullface": "down" },
+                "up":    { "texture": "#all", "cullface": "up" },
+                "north": { "texture": "#all", "cullface": "north" },
+                "south": { "texture": "#all", "cullface": "south" },
+                "west":  { "texture": "#all", "cullface": "west" },
+                "east":  { "texture": "#all", "cullface": "east" } } } ] })");
+        assets.WriteModel("stone", R"({ "parent": "block/cube_all", "textures": { "all": "blocks/stone" } })");
+        assets.WriteModel("glass", R"({ "parent": "minecraft:block/cube_all", "ambientocclusion": false,
+            "textures": { "all": "minecraft:blocks/glass" } })");
+
+        // Texture variables that refer to other variables, and a parent variable the child replaces.
+        assets.WriteModel("half_slab", R"({
+            "textures": { "side": "blocks/missing" },
+            "elements": [ { "from": [ 0, 0, 0 ], "to": [ 16, 8, 16 ], "faces": {
+                "down":  { "texture": "#bottom", "cullface": "down" },
+                "up":    { "texture": "#top" },
+                "north": { "texture": "#side", "cullface": "north" },
+                "south": { "texture": "#side", "cullface": "south" },
+                "west":  { "texture": "#side", "cullface": "west" },
+                "east":  { "texture": "#side", "cullface": "east" } } } ] })");
+        assets.WriteModel("planks_slab", R"({ "parent": "block/half_slab",
+            "textures": { "bottom": "#top", "top": "blocks/planks_oak", "side": "minecraft:blocks/log_oak" } })");
+
+        // The north half of a block.
+        assets.WriteModel("north_half", R"({
+            "textures": { "all": "blocks/stone" },
+            "elements": [ { "from": [ 0, 0, 0 ], "to": [ 16, 16, 8 ], "faces": {
+                "up":    { "texture": "#all", "cullface": "up" },
+                "north": { "texture": "#all", "cullface": "north" },
+                "south": { "texture": "#all" } } } ] })");
+
+        assets.WriteModel("fence_post", R"({
+            "textures": { "texture": "blocks/planks_oak" },
+            "elements": [ { "from": [ 6, 0, 6 ], "to": [ 10, 16, 10 ], "faces": {
+                "down":  { "texture": "#texture", "cullface": "down" },
+                "up":    { "texture": "#texture", "cullface": "up" },
+                "north": { "texture": "#texture" },
+                "south": { "texture": "#texture" },
+                "west":  { "texture": "#texture" },
+                "east":  { "texture": "#texture" } } } ] })");
+        assets.WriteModel("fence_side", R"({
+            "textures": { "texture": "blocks/planks_oak" },
+            "elements": [ { "from": [ 7, 12, 0 ], "to": [ 9, 15, 9 ], "faces": {
+                "down":  { "texture": "#texture" },
+                "up":    { "texture": "#texture" },
+                "north": { "texture": "#texture", "cullface": "north" },
+                "west":  { "texture": "#texture" },
+                "east":  { "texture": "#texture" } } } ] })");
+
+        assets.WriteBlockState("stone", R"({ "variants": { "normal": { "model": "stone" } } })");
+        assets.WriteBlockState("glass", R"({ "variants": { "normal": { "model": "minecraft:glass" } } })");
+        assets.WriteBlockState("planks_slab", R"({ "variants": {
+            "half=bottom": { "model": "planks_slab" },
+            "half=top": { "model": "planks_slab", "x": 180, "uvlock": true } } })");
+        assets.WriteBlockState("north_half", R"({ "variants": {
+            "facing=north": { "model": "north_half" },
+            "facing=east": { "model": "north_half", "y": 90, "uvlock": true },
+            "facing=south": [ { "model": "north_half", "y": 180 }, { "model": "stone" } ] } })");
+        assets.WriteBlockState("fence", R"({ "multipart": [
+            { "apply": { "model": "fence_post" } },
+            { "when": { "north": "true" }, "apply": { "model": "fence_side", "uvlock": true } },
+            { "when": { "east": "true" }, "apply": { "model": "fence_side", "y": 90, "uvlock": true } } ] })");
+
+        // Skipped: a variant with a missing model and a file that isn't valid JSON.
+        assets.WriteBlockState("broken", R"({ "variants": { "normal": { "model": "missing" } } })");
+        assets.WriteBlockState("garbage", R"({ "variants": )");
+    }
+}
+
+TEST(BlockModelBakerResolvesParentsAndTextures)
+{
+    TempAssets assets;
+    WriteFixtures(assets);
+
+    BlockModelBaker baker(assets.AssetDirectory.wstring(), (assets.Directory / L"baked").wstring());
+    CHECK(!baker.IsBakeCurrent());
+    CHECK(baker.Bake() == 11);
+    CHECK(baker.IsBakeCurrent());
+
+    BlockModelTable table;
+    table.Open(baker.GetBakedFileName());
+    CHECK(table.GetNumStates() == 11);
+    CHECK(table.FindState("broken", "normal") == BlockModelTable::InvalidState);
+    CHECK(table.FindState("garbage", "normal") == BlockModelTable::InvalidState);
+
+    // The elements come from cube_all, the texture from the variable of the child.
+    uint32_t stone = table.FindState("stone", "normal");
+    uint32_t glass = table.FindState("glass", "normal");
+    CHECK(stone != BlockModelTable::InvalidState && glass != BlockModelTable::InvalidState);
+    if (stone == BlockModelTable::InvalidState || glass == BlockModelTable::InvalidState)
+    {
+        return;
+    }
+    CHECK(table.GetState(stone).NumQuads == 6);
+    CHECK(table.GetState(stone).FullFaces == 0x3F);
+    CHECK(table.GetState(stone).Flags == BlockModelTable::StateAmbientOcclusion);
+    CHECK(table.GetState(glass).Flags == 0);
+    for (uint8_t face = 0; face < static_cast<uint8_t>(VoxelFace::NumFaces); ++face)
+    {
+        const BakedQuad* quad = FindQuad(table, stone, face);
+        CHECK(quad && quad->CullFace == face);
+        CHECK(quad && strcmp(table.GetTextureName(quad->Texture), "stone") == 0);
+        quad = FindQuad(table, glass, face);
+        CHECK(quad && strcmp(table.GetTextureName(quad->Texture), "glass") == 0);
+    }
+
+    // #bottom -> #top -> planks_oak, the child replaces the side of the parent.
+    uint32_t bottom = table.FindState("planks_slab", "half=bottom");
+    CHECK(bottom != BlockModelTable::InvalidState);
+    if (bottom == BlockModelTable::InvalidState)
+    {
+        return;
+    }
+    CHECK(table.GetState(bottom).NumQuads == 6);
+    const BakedQuad* down = FindQuad(table, bottom, Down);
+    const BakedQuad* up = FindQuad(table, bottom, Up);
+    const BakedQuad* north = FindQuad(table, bottom, North);
+    CHECK(down && strcmp(table.GetTextureName(down->Texture), "planks_oak") == 0);
+    CHECK(up && strcmp(table.GetTextureName(up->Texture), "planks_oak") == 0);
+    CHECK(north && strcmp(table.GetTextureName(north->Texture), "log_oak") == 0);
+    CHECK(up && up->CullFace == BlockModelTable::NoCullFace && HasRange(*up, 1, 0.5f, 0.5f));
+    CHECK(table.GetState(bottom).FullFaces == FaceBit(Down));
+}
+
+TEST(BlockModelBakerRotatesVariants)
+{
+    TempAssets assets;
+    WriteFixtures(assets);
+
+    BlockModelBaker baker(assets.AssetDirectory.wstring(), (assets.Directory / L"baked").wstring());
+    baker.Bake();
+    BlockModelTable table;
+    table.Open(baker.GetBakedFileName());
+
+    // x = 180 turns the bottom slab upside down, with the cull faces.
+    uint32_t top = table.FindState("planks_slab", "half=top");
+    CHECK(top != BlockModelTable::InvalidState);
+    if (top != BlockModelTable::InvalidState)
+    {
+        CHECK(table.GetState(top).NumQuads == 6);
+        CHECK(table.GetState(top).FullFaces == FaceBit(Up));
+        const BakedQuad* up = FindQuad(table, top, Up);
+        const BakedQuad* down = FindQuad(table, top, Down);
+        const BakedQuad* south = FindQuad(table, top, South);
+        CHECK(up && up->CullFace == Up && HasRange(*up, 1, 1.0f, 1.0f));
+        CHECK(down && down->CullFace == BlockModelTable::NoCullFace && HasRange(*down, 1, 0.5f, 0.5f));
+        CHECK(south && south->CullFace == South && HasRange(*south, 1, 0.5f, 1.0f) && HasRange(*south, 2, 1.0f, 1.0f));
+        CHECK(CountCullFace(table, top, North) == 1);
+        CHECK(CountCullFace(table, top, Down) == 0);
+        // uvlock keeps the texture of the sides on the upper half of the block.
+        for (uint16_t q = 0; q < table.GetState(top).NumQuads; ++q)
+        {
+            CHECK(HasWorldUVs(table.GetQuads(top)[q]));
+        }
+    }
+
+    // y = 90 turns the north half to the east.
+    uint32_t facingNorth = table.FindState("north_half", "facing=north");
+    uint32_t facingEast = table.FindState("north_half", "facing=east");
+    uint32_t facingSouth = table.FindState("north_half", "facing=south");
+    CHECK(facingNorth != BlockModelTable::InvalidState);
+    CHECK(facingEast != BlockModelTable::InvalidState);
+    CHECK(facingSouth != BlockModelTable::InvalidState);
+    if (facingNorth == BlockModelTable::InvalidState || facingEast == BlockModelTable::InvalidState ||
+        facingSouth == BlockModelTable::InvalidState)
+    {
+        return;
+    }
+
+    const BakedQuad* north = FindQuad(table, facingNorth, North);
+    CHECK(north && north->CullFace == North && table.GetState(facingNorth).FullFaces == FaceBit(North));
+
+    CHECK(table.GetState(facingEast).NumQuads == 3);
+    CHECK(table.GetState(facingEast).FullFaces == FaceBit(East));
+    const BakedQuad* east = FindQuad(table, facingEast, East);
+    const BakedQuad* west = FindQuad(table, facingEast, West);
+    const BakedQuad* up = FindQuad(table, facingEast, Up);
+    CHECK(east && east->CullFace == East && HasRange(*east, 0, 1.0f, 1.0f));
+    CHECK(west && west->CullFace == BlockModelTable::NoCullFace && HasRange(*west, 0, 0.5f, 0.5f));
+    CHECK(up && up->CullFace == Up && HasRange(*up, 0, 0.5f, 1.0f) && HasRange(*up, 2, 0.0f, 1.0f));
+    // With uvlock the top shows the east half of the texture, not the rotated north half.
+    CHECK(up && HasRange(*up, 3, 0.5f, 1.0f) && HasRange(*up, 4, 0.0f, 1.0f) && HasWorldUVs(*up));
+
+    // Weighted models use the first one. Without uvlock the texture turns with the model.
+    CHECK(table.GetState(facingSouth).NumQuads == 3);
+    up = FindQuad(table, facingSouth, Up);
+    CHECK(up && HasRange(*up, 2, 0.5f, 1.0f));
+    CHECK(up && HasRange(*up, 3, 0.0f, 1.0f) && HasRange(*up, 4, 0.0f, 0.5f) && !HasWorldUVs(*up));
+    CHECK(CountCullFace(table, facingSouth, South) == 1);
+}
+
+TEST(BlockModelBakerExpandsMultipartStates)
+{
+    TempAssets assets;
+    WriteFixtures(assets);
+
+    BlockModelBaker baker(assets.AssetDirectory.wstring(), (assets.Directory / L"baked").wstring());
+    baker.Bake();
+    BlockModelTable table;
+    table.Open(baker.GetBakedFileName());
+
+    // One state per combination of the tested properties, "false" is implied.
+    uint32_t post = table.FindState("fence", "east=false,north=false");
+    uint32_t northSide = table.FindState("fence", "east=false,north=true");
+    uint32_t eastSide = table.FindState("fence", "east=true,north=false");
+    uint32_t both = table.FindState("fence", "east=true,north=true");
+    CHECK(post != BlockModelTable::InvalidState && northSide != BlockModelTable::InvalidState);
+    CHECK(eastSide != BlockModelTable::InvalidState && both != BlockModelTable::InvalidState);
+    if (post == BlockModelTable::InvalidState || northSide == BlockModelTable::InvalidState ||
+        eastSide == BlockModelTable::InvalidState || both == BlockModelTable::InvalidState)
+    {
+        return;
+    }
+
+    CHECK(table.GetState(post).NumQuads == 6);
+    CHECK(table.GetState(northSide).NumQuads == 11);
+    CHECK(table.GetState(eastSide).NumQuads == 11);
+    CHECK(table.GetState(both).NumQuads == 16);
+    CHECK(table.GetState(post).FullFaces == 0);
+
+    CHECK(CountCullFace(table, post, North) == 0);
+    CHECK(CountCullFace(table, northSide, North) == 1 && CountCullFace(table, northSide, East) == 0);
+    CHECK(CountCullFace(table, eastSide, East) == 1 && CountCullFace(table, eastSide, North) == 0);
+    CHECK(CountCullFace(table, both, North) == 1 && CountCullFace(table, both, East) == 1);
+    CHECK(CountCullFace(table, both, Up) == 1 && CountCullFace(table, both, Down) == 1);
+
+    // The rotated side reaches the east boundary of the block.
+    for (uint16_t q = 0; q < table.GetState(eastSide).NumQuads; ++q)
+    {
+        const BakedQuad& quad = table.GetQuads(eastSide)[q];
+        if (quad.CullFace == East)
+        {
+            CHECK(quad.Face == East && HasRange(quad, 0, 1.0f, 1.0f) && HasRange(quad, 1, 0.75f, 0.9375f));
+        }
+    }
+}
+
+TEST(BlockModelBakerDetectsChangedSources)
+{
+    TempAssets assets;
+    WriteFixtures(assets);
+
+    BlockModelBaker baker(assets.AssetDirectory.wstring(), (assets.Directory / L"baked").wstring());
+    baker.BakeIfNeeded();
+    CHECK(baker.IsBakeCurrent());
+
+    // A rewritten model with the old write time keeps the number of files and
+    // the newest write time, only its size tells it changed.
+    fs::path stone = assets.AssetDirectory / L"models" / L"block" / L"stone.json";
+    auto writeTime = fs::last_write_time(stone);
+    TempAssets::Write(stone, R"({ "parent": "block/cube_all", "textures": { "all": "blocks/cobblestone" } })");
+    fs::last_write_time(stone, writeTime);
+    CHECK(!baker.IsBakeCurrent());
+    baker.BakeIfNeeded();
+    CHECK(baker.IsBakeCurrent());
+
+    // A renamed block state keeps its size and write time.
+    fs::rename(assets.AssetDirectory / L"blockstates" / L"glass.json", assets.AssetDirectory / L"blockstates" / L"glass_block.json");
+    CHECK(!baker.IsBakeCurrent());
+    baker.BakeIfNeeded();
+    CHECK(baker.IsBakeCurrent());
+
+    BlockModelTable table;
+    table.Open(baker.GetBakedFileName());
+    CHECK(table.FindState("glass", "normal") == BlockModelTable::InvalidState);
+    CHECK(table.FindState("glass_block", "normal") != BlockModelTable::InvalidState);
+    uint32_t state = table.FindState("stone", "normal");
+    CHECK(state != BlockModelTable::InvalidState &&
+        strcmp(table.GetTextureName(table.GetQuads(state)[0].Texture), "cobblestone") == 0);
+}
@@ -0,0 +1,112 @@
+#include "Test.h"
+
+#include <CommandRecorder.h>
+
+#include <atomic>
+#include <thread>
+
+TEST(CommandRecorderCounters)
+{
+    CommandRecorder::SetCaptureEnabled(false);
+
+    CommandRecorder recorder;
+    recorder.Record(RecordedCommandType::SetPipelineState);
+    recorder.Record(RecordedCommandType::SetRootSignature);
+    recorder.Record(RecordedCommandType::ResourceBarrier, 3);
+    recorder.Record(RecordedCommandType::SetDescriptorTables, 2, 5, 7);
+    recorder.Record(RecordedCommandType::DynamicBuffer, 0, 0, 0, 256);
+    recorder.Record(RecordedCommandType::DrawIndexed, 36, 1);
+    recorder.Record(RecordedCommandType::Draw, 3, 1);
+    recorder.Record(RecordedCommandType::CopyTexture, 1, 0, 0, 4096);
+    recorder.Record(RecordedCommandType::Dispatch, 8, 8, 1);
+
+    FrameStatistics statistics = recorder.GetStatistics();
+    CHECK(statistics.NumCommandLists == 1);
+    CHECK(statistics.NumPipelineStateChanges == 1);
+    CHECK(statistics.NumRootSignatureChanges == 1);
+    CHECK(statistics.NumBarriers == 3);
+    CHECK(statistics.NumDescriptorTables == 2);
+    CHECK(statistics.NumDescriptorsCopied == 5);
+    CHECK(statistics.NumDescriptorsReused == 7);
+    CHECK(statistics.NumDraws == 2);
+    CHECK(statistics.NumCopies == 1);
+    CHECK(statistics.NumDispatches == 1);
+    CHECK(statistics.UploadBytes == 256 + 4096);
+    // The stream is only kept while capturing.
+    CHECK(recorder.GetCommands().empty());
+
+    recorder.Reset();
+    CHECK(recorder.GetStatistics().NumDraws == 0);
+}
+
+TEST(CommandRecorderCapture)
+{
+    CommandRecorder::SetCaptureEnabled(true);
+    CHECK(CommandRecorder::IsCaptureEnabled());
+
+    CommandRecorder recorder;
+    recorder.Record(RecordedCommandType::ResourceBarrier, 1);
+    recorder.Record(RecordedCommandType::DrawIndexed, 36, 4);
+    CommandRecorder::SetCaptureEnabled(false);
+    recorder.Record(RecordedCommandType::Draw, 3, 1);
+
+    const std::vector<RecordedCommand>& commands = recorder.GetCommands();
+    CHECK(commands.size() == 2);
+    CHECK(commands[1].Type == RecordedCommandType::DrawIndexed);
+    CHECK(commands[1].Args[0] == 36 && commands[1].Args[1] == 4);
+    CHECK(recorder.GetStatistics().NumDraws == 2);
+}
+
+TEST(CommandRecorderFrameFromThreads)
+{
+    const int NumThreads = 4;
+    const int NumLists = 100;
+    const int NumDrawsPerList = 10;
+
+    // Close whatever earlier tests submitted.
+    CommandRecorder::EndFrame();
+
+    // Capturing is toggled while the workers record.
+    std::atomic<bool> done(false);
+    std::thread toggle([&done]()
+    {
+        bool enabled = false;
+        while (!done)
+        {
+            enabled = !enabled;
+            CommandRecorder::SetCaptureEnabled(enabled);
+            std::this_thread::yield();
+        }
+        CommandRecorder::SetCaptureEnabled(false);
+    });
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < NumThreads; ++t)
+    {
+        workers.emplace_back([]()
+        {
+            CommandRecorder recorder;
+            for (int l = 0; l < NumLists; ++l)
+            {
+                recorder.Reset();
+                for (int d = 0; d < NumDrawsPerList; ++d)
+                {
+                    recorder.Record(RecordedCommandType::DrawIndexed, 36, 1, 0, 16);
+                }
+                CommandRecorder::Submit(recorder.GetStatistics());
+            }
+        });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    done = true;
+    toggle.join();
+
+    CommandRecorder::EndFrame();
+    FrameStatistics frame = CommandRecorder::GetLastFrameStatistics();
+    CHECK(frame.NumCommandLists == NumThreads * NumLists);
+    CHECK(frame.NumDraws == NumThreads * NumLists * NumDrawsPerList);
+    CHECK(frame.UploadBytes == 16ull * NumThreads * NumLists * NumDrawsPerList);
+}
@@ -0,0 +1,327 @@
+#include "Test.h"
+
+#include <DirectXTex/DDSHeaderParser.h>
+
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+    const uint32_t DDSMagic = 0x20534444; // "DDS "
+    const uint32_t DDSHeaderSize = 124;
+    const uint32_t DDSPixelFormatSize = 32;
+
+    // Header flags.
+    const uint32_t DDSDCaps = 0x1, DDSDHeight = 0x2, DDSDWidth = 0x4, DDSDPixelFormat = 0x1000;
+    const uint32_t DDSDMipMapCount = 0x20000, DDSDDepth = 0x800000;
+    // Pixel format flags.
+    const uint32_t DDPFAlphaPixels = 0x1, DDPFFourCC = 0x4, DDPFRGB = 0x40;
+    // Caps2.
+    const uint32_t DDSCaps2Cubemap = 0x200, DDSCaps2AllFaces = 0xfc00;
+
+    uint32_t FourCC(const char* code)
+    {
+        return uint32_t(code[0]) | (uint32_t(code[1]) << 8) | (uint32_t(code[2]) << 16) | (uint32_t(code[3]) << 24);
+    }
+
+    // The DDS_HEADER (124 bytes) as an array of its 31 fields, and the optional DX10 extension.
+    struct DDSFile
+    {
+        uint32_t Header[31] = {};
+        bool HasDX10Header = false;
+        uint32_t DX10Header[5] = {};
+        size_t NumDataBytes = 0;
+
+        DDSFile(uint32_t width, uint32_t height, uint32_t mipCount)
+        {
+            Header[0] = DDSHeaderSize;
+            Header[1] = DDSDCaps | DDSDHeight | DDSDWidth | DDSDPixelFormat | (mipCount > 1 ? DDSDMipMapCount : 0);
+            Header[2] = height;
+            Header[3] = width;
+            Header[6] = mipCount;
+            Header[18] = DDSPixelFormatSize;
+        }
+
+        void SetRGBA8()
+        {
+            Header[19] = DDPFRGB | DDPFAlphaPixels;
+            Header[21] = 32;
+            Header[22] = 0x000000ff;
+            Header[23] = 0x0000ff00;
+            Header[24] = 0x00ff0000;
+            Header[25] = 0xff000000;
+        }
+
+        void SetFourCC(const char* code)
+        {
+            Header[19] = DDPFFourCC;
+            Header[20] = FourCC(code);
+        }
+
+        void SetDX10(DXGI_FORMAT format, uint32_t dimension, uint32_t arraySize, uint32_t miscFlag = 0, uint32_t miscFlags2 = 0)
+        {
+            SetFourCC("DX10");
+            HasDX10Header = true;
+            DX10Header[0] = format;
+            DX10Header[1] = dimension;
+            DX10Header[2] = miscFlag;
+            DX10Header[3] = arraySize;
+            DX10Header[4] = miscFlags2;
+        }
+
+        std::vector<uint8_t> Build() const
+        {
+            std::vector<uint8_t> file(sizeof(DDSMagic) + sizeof(Header) + (HasDX10Header ? sizeof(DX10Header) : 0) + NumDataBytes);
+            uint8_t* p = file.data();
+            memcpy(p, &DDSMagic, sizeof(DDSMagic));
+            p += sizeof(DDSMagic);
+            memcpy(p, Header, sizeof(Header));
+            p += sizeof(Header);
+            if (HasDX10Header)
+            {
+                memcpy(p, DX10Header, sizeof(DX10Header));
+            }
+            return file;
+        }
+    };
+
+    HRESULT Parse(const std::vector<uint8_t>& file, DDS_TEXTURE_DESC& desc)
+    {
+        return ParseDDSHeader(file.data(), file.size(), desc);
+    }
+
+    struct Subresources
+    {
+        std::vector<DDS_SUBRESOURCE_DATA> Data;
+        size_t Width = 0, Height = 0, Depth = 0, SkipMip = 0;
+    };
+
+    HRESULT GetSubresources(const std::vector<uint8_t>& file, const DDS_TEXTURE_DESC& desc, size_t maxsize, Subresources& subresources)
+    {
+        return GetDDSSubresources(desc, 1, maxsize, file.data() + desc.bitOffset, file.size() - desc.bitOffset,
+            subresources.Width, subresources.Height, subresources.Depth, subresources.SkipMip, subresources.Data);
+    }
+}
+
+TEST(DDSHeaderParserLegacyMipChain)
+{
+    // 8x4 RGBA8 with 4 mips: 128 + 32 + 8 + 4 bytes.
+    DDSFile dds(8, 4, 4);
+    dds.SetRGBA8();
+    dds.NumDataBytes = 128 + 32 + 8 + 4;
+    auto file = dds.Build();
+
+    DDS_TEXTURE_DESC desc;
+    CHECK(Parse(file, desc) == S_OK);
+    CHECK(desc.dimension == DDS_DIMENSION_TEXTURE2D);
+    CHECK(desc.format == DXGI_FORMAT_R8G8B8A8_UNORM);
+    CHECK(desc.width == 8 && desc.height == 4 && desc.depth == 1);
+    CHECK(desc.arraySize == 1 && desc.mipCount == 4);
+    CHECK(!desc.isCubeMap);
+    CHECK(desc.alphaMode == DDS_ALPHA_MODE_UNKNOWN);
+    CHECK(desc.bitOffset == 4 + 124);
+
+    Subresources subresources;
+    CHECK(GetSubresources(file, desc, 0, subresources) == S_OK);
+    CHECK(subresources.Data.size() == 4);
+    CHECK(subresources.Width == 8 && subresources.Height == 4 && subresources.Depth == 1);
+    CHECK(subresources.SkipMip == 0);
+
+    const intptr_t rowPitches[] = { 32, 16, 8, 4 };
+    const intptr_t slicePitches[] = { 128, 32, 8, 4 };
+    const uint8_t* expected = file.data() + desc.bitOffset;
+    for (size_t i = 0; i < subresources.Data.size(); ++i)
+    {
+        CHECK(subresources.Data[i].pData == expected);
+        CHECK(subresources.Data[i].RowPitch == rowPitches[i]);
+        CHECK(subresources.Data[i].SlicePitch == slicePitches[i]);
+        expected += slicePitches[i];
+    }
+}
+
+TEST(DDSHeaderParserSkipsMipsLargerThanMaxSize)
+{
+    DDSFile dds(8, 4, 4);
+    dds.SetRGBA8();
+    dds.NumDataBytes = 128 + 32 + 8 + 4;
+    auto file = dds.Build();
+
+    DDS_TEXTURE_DESC desc;
+    CHECK(Parse(file, desc) == S_OK);
+
+    // 8x4 and 4x2 are skipped, the subresources start at the 2x1 mip.
+    Subresources subresources;
+    CHECK(GetSubresources(file, desc, 2, subresources) == S_OK);
+    CHECK(subresources.Data.size() == 2);
+    CHECK(subresources.SkipMip == 2);
+    CHECK(subresources.Width == 2 && subresources.Height == 1);
+    CHECK(subresources.Data[0].pData == file.data() + desc.bitOffset + 128 + 32);
+}
+
+TEST(DDSHeaderParserBlockCompressed)
+{
+    // A 16x16 DXT1 surface is 4x4 blocks of 8 bytes.
+    DDSFile dds(16, 16, 1);
+    dds.SetFourCC("DXT1");
+    dds.NumDataBytes = 16 * 8;
+    auto file = dds.Build();
+
+    DDS_TEXTURE_DESC desc;
+    CHECK(Parse(file, desc) == S_OK);
+    CHECK(desc.format == DXGI_FORMAT_BC1_UNORM);
+    CHECK(desc.mipCount == 1);
+
+    Subresources subresources;
+    CHECK(GetSubresources(file, desc, 0, subresources) == S_OK);
+    CHECK(subresources.Data.size() == 1);
+    CHECK(subresources.Data[0].RowPitch == 4 * 8);
+    CHECK(subresources.Data[0].SlicePitch == 16 * 8);
+
+    // DXT2 and DXT4 are premultiplied.
+    dds.SetFourCC("DXT4");
+    file = dds.Build();
+    CHECK(Parse(file, desc) == S_OK);
+    CHECK(desc.format == DXGI_FORMAT_BC3_UNORM);
+    CHECK(desc.alphaMode == DDS_ALPHA_MODE_PREMULTIPLIED);
+}
+
+TEST(DDSHeaderParserDX10Extension)
+{
+    // A 2D array of three 4x4 mip chains.
+    DDSFile dds(4, 4, 3);
+    dds.SetDX10(DXGI_FORMAT_R16G16B16A16_FLOAT, DDS_DIMENSION_TEXTURE2D, 3, 0, DDS_ALPHA_MODE_STRAIGHT);
+    size_t layerSize = 8 * (16 + 4 + 1);
+    dds.NumDataBytes = 3 * layerSize;
+    auto file = dds.Build();
+
+    DDS_TEXTURE_DESC desc;
+    CHECK(Parse(file, desc) == S_OK);
+    CHECK(desc.format == DXGI_FORMAT_R16G16B16A16_FLOAT);
+    CHECK(desc.dimension == DDS_DIMENSION_TEXTURE2D);
+    CHECK(desc.arraySize == 3 && desc.mipCount == 3);
+    CHECK(desc.alphaMode == DDS_ALPHA_MODE_STRAIGHT);
+    CHECK(desc.bitOffset == 4 + 124 + 20);
+
+    // The subresources are ordered by slice, then by mip.
+    Subresources subresources;
+    CHECK(GetSubresources(file, desc, 0, subresources) == S_OK);
+    CHECK(subresources.Data.size() == 9);
+    CHECK(subresources.Data[3].pData == file.data() + desc.bitOffset + layerSize);
+    CHECK(subresources.Data[4].RowPitch == 16);
+    CHECK(subresources.Data[8].SlicePitch == 8);
+}
+
+TEST(DDSHeaderParserCubeMaps)
+{
+    // A legacy cube map needs all six faces.
+    DDSFile dds(4, 4, 1);
+    dds.SetRGBA8();
+    dds.Header[27] = DDSCaps2Cubemap | DDSCaps2AllFaces;
+    dds.NumDataBytes = 6 * 64;
+    auto file = dds.Build();
+
+    DDS_TEXTURE_DESC desc;
+    CHECK(Parse(file, desc) == S_OK);
+    CHECK(desc.isCubeMap);
+    CHECK(desc.arraySize == 6);
+
+    Subresources subresources;
+    CHECK(GetSubresources(file, desc, 0, subresources) == S_OK);
+    CHECK(subresources.Data.size() == 6);
+
+    dds.Header[27] = DDSCaps2Cubemap | 0x0600;
+    file = dds.Build();
+    CHECK(FAILED(Parse(file, desc)));
+
+    // The DX10 extension counts cubes, six slices each.
+    DDSFile dx10(4, 4, 1);
+    dx10.SetDX10(DXGI_FORMAT_R8G8B8A8_UNORM, DDS_DIMENSION_TEXTURE2D, 2, 0x4);
+    file = dx10.Build();
+    CHECK(Parse(file, desc) == S_OK);
+    CHECK(desc.isCubeMap);
+    CHECK(desc.arraySize == 12);
+}
+
+TEST(DDSHeaderParserVolume)
+{
+    DDSFile dds(4, 4, 2);
+    dds.SetRGBA8();
+    dds.Header[1] |= DDSDDepth;
+    dds.Header[5] = 4;
+    dds.NumDataBytes = 4 * 64 + 2 * 16;
+    auto file = dds.Build();
+
+    DDS_TEXTURE_DESC desc;
+    CHECK(Parse(file, desc) == S_OK);
+    CHECK(desc.dimension == DDS_DIMENSION_TEXTURE3D);
+    CHECK(desc.depth == 4);
+
+    // A mip holds all its depth slices, the second one starts after four 4x4 slices.
+    Subresources subresources;
+    CHECK(GetSubresources(file, desc, 0, subresources) == S_OK);
+    CHECK(subresources.Data.size() == 2);
+    CHECK(subresources.Depth == 4);
+    CHECK(subresources.Data[1].pData == file.data() + desc.bitOffset + 4 * 64);
+}
+
+TEST(DDSHeaderParserRejectsInvalidFiles)
+{
+    DDSFile dds(4, 4, 1);
+    dds.SetRGBA8();
+    dds.NumDataBytes = 64;
+    auto valid = dds.Build();
+
+    DDS_TEXTURE_DESC desc;
+    CHECK(ParseDDSHeader(nullptr, 0, desc) == E_INVALIDARG);
+
+    // Truncated before the end of the header.
+    CHECK(FAILED(ParseDDSHeader(valid.data(), 4 + 123, desc)));
+
+    auto file = valid;
+    file[0] = 'X';
+    CHECK(FAILED(Parse(file, desc)));
+
+    DDSFile badSize = dds;
+    badSize.Header[0] = 100;
+    CHECK(FAILED(Parse(badSize.Build(), desc)));
+
+    // More mips than any Direct3D 12 texture can have.
+    DDSFile tooManyMips = dds;
+    tooManyMips.Header[6] = 16;
+    CHECK(FAILED(Parse(tooManyMips.Build(), desc)));
+
+    // Unknown legacy format.
+    DDSFile unknownFormat = dds;
+    unknownFormat.SetFourCC("ABCD");
+    CHECK(FAILED(Parse(unknownFormat.Build(), desc)));
+
+    // The DX10 extension is missing from the file.
+    DDSFile dx10 = dds;
+    dx10.SetDX10(DXGI_FORMAT_R8G8B8A8_UNORM, DDS_DIMENSION_TEXTURE2D, 1);
+    file = dx10.Build();
+    CHECK(Parse(file, desc) == S_OK);
+    CHECK(FAILED(ParseDDSHeader(file.data(), 4 + 124 + 19, desc)));
+
+    DDSFile noSlices = dx10;
+    noSlices.DX10Header[3] = 0;
+    CHECK(FAILED(Parse(noSlices.Build(), desc)));
+
+    DDSFile buffer = dx10;
+    buffer.DX10Header[1] = 1;
+    CHECK(FAILED(Parse(buffer.Build(), desc)));
+
+    // A 1D texture must have a height of 1.
+    DDSFile texture1D = dx10;
+    texture1D.DX10Header[1] = DDS_DIMENSION_TEXTURE1D;
+    CHECK(FAILED(Parse(texture1D.Build(), desc)));
+    texture1D.Header[2] = 1;
+    CHECK(Parse(texture1D.Build(), desc) == S_OK);
+    CHECK(desc.dimension == DDS_DIMENSION_TEXTURE1D);
+
+    // The header is valid, but the surface data is cut short.
+    CHECK(Parse(valid, desc) == S_OK);
+    valid.resize(valid.size() - 1);
+    Subresources subresources;
+    CHECK(FAILED(GetSubresources(valid, desc, 0, subresources)));
+}
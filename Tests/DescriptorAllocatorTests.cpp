@@ -0,0 +1,116 @@
+#include "Test.h"
+
+#include <Application.h>
+#include <DescriptorAllocator.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // The descriptor heaps are created on the device of the Application. WARP
+    // is used, so the tests don't need a GPU. The Application is created once
+    // and kept, it registers its window class when it is created.
+    void CreateWarpApplication()
+    {
+        static bool created = (Application::Create(GetModuleHandle(nullptr), true), true);
+        (void)created;
+    }
+
+    const int NumAllocationsPerThread = 200000;
+    // The allocations a thread holds at a time, like the descriptors of a few draws.
+    const int BatchSize = 32;
+}
+
+TEST(DescriptorAllocatorReturnsPagesOfExitedThreads)
+{
+    CreateWarpApplication();
+    const uint32_t NumDescriptorsPerHeap = 16;
+    DescriptorAllocator allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, NumDescriptorsPerHeap);
+
+    // Every thread fills a page of its own and exits, the allocations are stale by then.
+    const int NumThreads = 4;
+    std::atomic<int> numAllocated(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NumThreads; ++t)
+    {
+        threads.emplace_back([&allocator, &numAllocated, NumDescriptorsPerHeap]()
+        {
+            DescriptorAllocation allocation = allocator.Allocate(NumDescriptorsPerHeap);
+            numAllocated += allocation.IsNull() ? 0 : 1;
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(numAllocated == NumThreads);
+    CHECK(allocator.GetNumPages() == NumThreads);
+    CHECK(allocator.GetNumFreePages() == NumThreads);
+
+    // Once the frame completed, the next thread that needs a page takes one of them.
+    allocator.ReleaseStaleDescriptors(Application::GetFrameCount());
+    DescriptorAllocation allocation = allocator.Allocate(NumDescriptorsPerHeap);
+    CHECK(!allocation.IsNull());
+    CHECK(allocator.GetNumPages() == NumThreads);
+    CHECK(allocator.GetNumFreePages() == NumThreads - 1);
+
+    // The calling thread's page is full, so the next allocation takes another free page.
+    DescriptorAllocation second = allocator.Allocate(1);
+    CHECK(!second.IsNull());
+    CHECK(allocator.GetNumPages() == NumThreads);
+    CHECK(allocator.GetNumFreePages() == NumThreads - 2);
+}
+
+BENCHMARK(DescriptorAllocatorContention)
+{
+    CreateWarpApplication();
+    printf("  %u hardware threads, %d allocations of 1-4 descriptors per thread\n",
+        std::thread::hardware_concurrency(), NumAllocationsPerThread);
+
+    for (int numThreads : { 1, 2, 4, 8, 16 })
+    {
+        DescriptorAllocator allocator(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        std::atomic<int> numRunning(numThreads);
+        std::vector<std::thread> threads;
+
+        auto start = Tests::Clock::now();
+        for (int t = 0; t < numThreads; ++t)
+        {
+            threads.emplace_back([&allocator, &numRunning, t]()
+            {
+                std::vector<DescriptorAllocation> batch;
+                batch.reserve(BatchSize);
+                for (int i = 0; i < NumAllocationsPerThread; i += BatchSize)
+                {
+                    for (int b = 0; b < BatchSize; ++b)
+                    {
+                        batch.push_back(allocator.Allocate(1 + (b + t) % 4));
+                    }
+                    batch.clear();
+                }
+                numRunning--;
+            });
+        }
+
+        // The render thread releases the stale descriptors while the other threads allocate.
+        uint64_t numReleases = 0;
+        while (numRunning > 0)
+        {
+            allocator.ReleaseStaleDescriptors(Application::GetFrameCount());
+            numReleases++;
+            std::this_thread::yield();
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        double milliseconds = Tests::MillisecondsSince(start);
+
+        double allocationsPerSecond = numThreads * static_cast<double>(NumAllocationsPerThread) / (milliseconds / 1000.0);
+        printf("  %2d threads: %8.1f ms, %7.2f M allocations/s, %3zu pages, %llu releases\n",
+            numThreads, milliseconds, allocationsPerSecond / 1e6, allocator.GetNumPages(),
+            static_cast<unsigned long long>(numReleases));
+    }
+}
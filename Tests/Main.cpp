@@ -0,0 +1,67 @@
+#include "Test.h"
+
+#include <cstring>
+#include <exception>
+
+namespace
+{
+    int g_NumFailures = 0;
+}
+
+std::vector<Tests::TestCase>& Tests::GetTestCases()
+{
+    static std::vector<TestCase> testCases;
+    return testCases;
+}
+
+void Tests::ReportFailure(const char* file, int line, const char* expression)
+{
+    printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+    g_NumFailures++;
+}
+
+// Usage: Tests [-benchmark] [name]
+// Runs the tests, or the benchmarks, whose name contains name.
+int main(int argc, char* argv[])
+{
+    bool runBenchmarks = false;
+    const char* filter = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-benchmark") == 0)
+        {
+            runBenchmarks = true;
+        }
+        else
+        {
+            filter = argv[i];
+        }
+    }
+
+    int numRun = 0;
+    int numFailed = 0;
+    for (const Tests::TestCase& testCase : Tests::GetTestCases())
+    {
+        if (testCase.IsBenchmark != runBenchmarks || (filter && !strstr(testCase.Name, filter)))
+        {
+            continue;
+        }
+
+        printf("%s\n", testCase.Name);
+        int numFailures = g_NumFailures;
+        try
+        {
+            testCase.Function();
+        }
+        catch (const std::exception& e)
+        {
+            printf("  Unexpected exception: %s\n", e.what());
+            g_NumFailures++;
+        }
+        numRun++;
+        numFailed += g_NumFailures != numFailures ? 1 : 0;
+    }
+
+    printf("%d of %d %s passed.\n", numRun - numFailed, numRun, runBenchmarks ? "benchmarks" : "tests");
+    return numFailed == 0 ? 0 : 1;
+}
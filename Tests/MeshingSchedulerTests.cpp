@@ -0,0 +1,246 @@
+#include "Test.h"
+
+#include <MeshingScheduler.h>
+#include <VoxelMesher.h>
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+
+using namespace DirectX;
+
+namespace
+{
+    // Rolling hills of stone, with the surface in the sections at y = 0 and 1.
+    void GenerateSection(const MeshingScheduler::SectionKey& key, uint16_t* blocks)
+    {
+        for (int z = 0; z < VoxelMesher::SectionSize; ++z)
+        {
+            for (int x = 0; x < VoxelMesher::SectionSize; ++x)
+            {
+                float wx = static_cast<float>(key.X * VoxelMesher::SectionSize + x);
+                float wz = static_cast<float>(key.Z * VoxelMesher::SectionSize + z);
+                float surface = 16.0f + 6.0f * std::sin(wx * 0.13f) + 5.0f * std::cos(wz * 0.17f);
+                int height = static_cast<int>(surface) - key.Y * VoxelMesher::SectionSize;
+                for (int y = 0; y < VoxelMesher::SectionSize; ++y)
+                {
+                    blocks[VoxelMesher::BlockIndex(x, y, z)] = y < height ? 1 : VoxelMesher::Air;
+                }
+            }
+        }
+    }
+
+    VoxelMesher CreateMesher()
+    {
+        return VoxelMesher(std::vector<VoxelMesher::BlockType>(2, VoxelMesher::BlockType{}));
+    }
+}
+
+TEST(MeshingSchedulerIntegratesEveryRequest)
+{
+    VoxelMesher mesher = CreateMesher();
+    MeshingScheduler scheduler([&mesher](const MeshingScheduler::SectionKey& key, MeshingScheduler::ScratchBuffer& scratch)
+    {
+        uint16_t blocks[VoxelMesher::NumBlocks];
+        GenerateSection(key, blocks);
+        mesher.Build(blocks, scratch.Vertices, scratch.Indices);
+    }, 4);
+
+    for (int z = 0; z < 8; ++z)
+    {
+        for (int x = 0; x < 8; ++x)
+        {
+            scheduler.Request({ x, 1, z });
+            // Requesting a pending section again doesn't mesh it twice.
+            scheduler.Request({ x, 1, z });
+        }
+    }
+    scheduler.Wait();
+
+    std::set<std::pair<int, int>> integrated;
+    size_t numIntegrated = scheduler.Integrate([&integrated](MeshingScheduler::MeshResult& result)
+    {
+        CHECK(result.Key.Y == 1);
+        CHECK(result.Indices.size() * 4 == result.Vertices.size() * 6);
+        integrated.insert({ result.Key.X, result.Key.Z });
+    }, 1e9);
+
+    CHECK(numIntegrated == 64);
+    CHECK(integrated.size() == 64);
+
+    MeshingScheduler::Statistics statistics = scheduler.GetStatistics();
+    CHECK(statistics.NumIntegrated + statistics.NumSuperseded == statistics.NumMeshed);
+    CHECK(statistics.NumPending == 0);
+}
+
+TEST(MeshingSchedulerNearestFirst)
+{
+    // The first job blocks the only worker until all requests are queued.
+    std::mutex mutex;
+    std::condition_variable released;
+    bool isReleased = false;
+    MeshingScheduler scheduler([&](const MeshingScheduler::SectionKey& key, MeshingScheduler::ScratchBuffer& scratch)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        released.wait(lock, [&] { return isReleased; });
+    }, 1);
+
+    scheduler.Request({ 100, 0, 100 });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    for (int x = 0; x < 16; ++x)
+    {
+        scheduler.Request({ x, 0, 0 });
+    }
+    // Looking down +x from the far end: the sections with a high x are nearest.
+    scheduler.SetView(XMVectorSet(16 * 16.0f, 8.0f, 8.0f, 1.0f), XMVectorSet(-1.0f, 0.0f, 0.0f, 0.0f));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isReleased = true;
+    }
+    released.notify_all();
+    scheduler.Wait();
+
+    std::vector<int> order;
+    scheduler.Integrate([&order](MeshingScheduler::MeshResult& result)
+    {
+        if (result.Key.X < 100)
+        {
+            order.push_back(result.Key.X);
+        }
+    }, 1e9);
+
+    CHECK(order.size() == 16);
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        CHECK(order[i] == 15 - static_cast<int>(i));
+    }
+}
+
+TEST(MeshingSchedulerBudget)
+{
+    MeshingScheduler scheduler([](const MeshingScheduler::SectionKey&, MeshingScheduler::ScratchBuffer& scratch)
+    {
+        scratch.Vertices.resize(4);
+        scratch.Indices.resize(6);
+    }, 2);
+
+    for (int x = 0; x < 10; ++x)
+    {
+        scheduler.Request({ x, 0, 0 });
+    }
+    scheduler.Wait();
+
+    // Every call makes progress, but a result that uses up the budget ends the call.
+    size_t numIntegrated = scheduler.Integrate([](MeshingScheduler::MeshResult&)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }, 1.0);
+    CHECK(numIntegrated == 1);
+    CHECK(scheduler.Integrate([](MeshingScheduler::MeshResult&) {}, 1e9) == 9);
+}
+
+TEST(MeshingSchedulerRecyclesResults)
+{
+    MeshingScheduler scheduler([](const MeshingScheduler::SectionKey& key, MeshingScheduler::ScratchBuffer& scratch)
+    {
+        scratch.Vertices.resize(4 * (key.X + 1));
+        scratch.Indices.resize(6 * (key.X + 1));
+    }, 2);
+
+    // The same sections every round. The results of the first round are all
+    // held at once, later rounds only take nodes from the free list.
+    const int NumSections = 16;
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int x = 0; x < NumSections; ++x)
+        {
+            scheduler.Request({ x, 0, 0 });
+        }
+        scheduler.Wait();
+
+        bool sizesMatch = true;
+        size_t numIntegrated = scheduler.Integrate([&sizesMatch](MeshingScheduler::MeshResult& result)
+        {
+            // Recycled buffers never leak the previous mesh into the result.
+            sizesMatch = sizesMatch && result.Vertices.size() == 4u * (result.Key.X + 1) &&
+                result.Indices.size() == 6u * (result.Key.X + 1);
+        }, 1e9);
+        CHECK(numIntegrated == NumSections);
+        CHECK(sizesMatch);
+        CHECK(scheduler.GetStatistics().NumResultNodes == NumSections);
+    }
+}
+
+// Meshes a 32x32x2 grid of terrain sections with a growing number of workers,
+// while a simulated 60 Hz frame loop integrates the results with a 2 ms budget.
+BENCHMARK(MeshingSchedulerThroughput)
+{
+    const int GridSize = 32;
+    const double FrameMilliseconds = 1000.0 / 60.0;
+    const double BudgetMilliseconds = 2.0;
+
+    VoxelMesher mesher = CreateMesher();
+
+    uint32_t numHardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> threadCounts = { 1, 2, 4 };
+    if (numHardwareThreads > 4)
+    {
+        threadCounts.push_back(numHardwareThreads - 1);
+    }
+
+    printf("  %7s %10s %14s %14s %12s %16s %8s\n",
+        "Threads", "Sections", "Total ms", "Sections/s", "Mesh ms", "Avg latency ms", "Frames");
+    for (uint32_t numThreads : threadCounts)
+    {
+        MeshingScheduler scheduler([&mesher](const MeshingScheduler::SectionKey& key, MeshingScheduler::ScratchBuffer& scratch)
+        {
+            uint16_t blocks[VoxelMesher::NumBlocks];
+            GenerateSection(key, blocks);
+            mesher.Build(blocks, scratch.Vertices, scratch.Indices);
+        }, numThreads);
+        scheduler.SetView(XMVectorSet(GridSize * 8.0f, 24.0f, GridSize * 8.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f));
+
+        auto start = Tests::Clock::now();
+        for (int y = 0; y < 2; ++y)
+        {
+            for (int z = 0; z < GridSize; ++z)
+            {
+                for (int x = 0; x < GridSize; ++x)
+                {
+                    scheduler.Request({ x, y, z });
+                }
+            }
+        }
+
+        const size_t numSections = GridSize * GridSize * 2;
+        size_t numIntegrated = 0;
+        size_t numVertices = 0;
+        int numFrames = 0;
+        while (numIntegrated < numSections)
+        {
+            auto frameStart = Tests::Clock::now();
+            numIntegrated += scheduler.Integrate([&numVertices](MeshingScheduler::MeshResult& result)
+            {
+                numVertices += result.Vertices.size();
+            }, BudgetMilliseconds);
+            numFrames++;
+
+            double remaining = FrameMilliseconds - Tests::MillisecondsSince(frameStart);
+            if (remaining > 0.0)
+            {
+                std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(remaining));
+            }
+        }
+        double totalMilliseconds = Tests::MillisecondsSince(start);
+
+        MeshingScheduler::Statistics statistics = scheduler.GetStatistics();
+        CHECK(statistics.NumIntegrated == numSections);
+        printf("  %7u %10zu %14.1f %14.1f %12.1f %16.1f %8d\n",
+            numThreads, numSections, totalMilliseconds, numSections * 1000.0 / totalMilliseconds,
+            statistics.TotalMeshMilliseconds, statistics.AverageLatencyMilliseconds, numFrames);
+    }
+}
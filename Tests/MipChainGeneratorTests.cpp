@@ -0,0 +1,200 @@
+#include "Test.h"
+
+#include <DirectXTex/MipChainGenerator.h>
+#include <WorkerPool.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    // An R8G8B8A8 image with room for its full mip chain.
+    struct TestImage
+    {
+        TestImage(uint32_t width, uint32_t height)
+            : Width(width)
+            , Height(height)
+            , MipLevels(CountMipLevels(width, height))
+            , Pixels(ComputeMipChainSize(width, height, MipLevels))
+        {}
+
+        uint8_t* Pixel(uint32_t x, uint32_t y)
+        {
+            return &Pixels[(static_cast<size_t>(y) * Width + x) * 4];
+        }
+
+        // The offset of the first byte of a mip level.
+        size_t LevelOffset(uint32_t mip) const
+        {
+            return ComputeMipChainSize(Width, Height, mip);
+        }
+
+        MipChainImage Get()
+        {
+            return { Pixels.data(), Width, Height, MipLevels };
+        }
+
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t MipLevels;
+        std::vector<uint8_t> Pixels;
+    };
+
+    // The number of pixels of a mip level that pass an alpha test at 0.5.
+    int CountCovered(const TestImage& image, uint32_t mip)
+    {
+        uint32_t width = std::max(image.Width >> mip, 1u);
+        uint32_t height = std::max(image.Height >> mip, 1u);
+        const uint8_t* level = image.Pixels.data() + image.LevelOffset(mip);
+
+        int covered = 0;
+        for (uint32_t i = 0; i < width * height; ++i)
+        {
+            covered += level[i * 4 + 3] > 127 ? 1 : 0;
+        }
+        return covered;
+    }
+}
+
+TEST(MipChainSizes)
+{
+    CHECK(CountMipLevels(1, 1) == 1);
+    CHECK(CountMipLevels(16, 16) == 5);
+    CHECK(CountMipLevels(1, 8) == 4);
+    CHECK(CountMipLevels(5, 3) == 3);
+    CHECK(ComputeMipChainSize(16, 16, 5) == 4 * (256 + 64 + 16 + 4 + 1));
+    CHECK(ComputeMipChainSize(5, 3, 3) == 4 * (15 + 2 + 1));
+}
+
+TEST(MipChainRejectsInvalidImages)
+{
+    TestImage image(4, 4);
+    MipChainImage tooManyLevels = image.Get();
+    tooManyLevels.mipLevels = 4;
+    CHECK(GenerateMipChain(tooManyLevels, MIP_FILTER_BOX) == E_INVALIDARG);
+
+    MipChainImage noPixels = image.Get();
+    noPixels.pixels = nullptr;
+    CHECK(GenerateMipChain(noPixels, MIP_FILTER_BOX) == E_INVALIDARG);
+}
+
+TEST(MipChainKeepsConstantImages)
+{
+    const unsigned int filters[] = {
+        MIP_FILTER_BOX, MIP_FILTER_KAISER, MIP_FILTER_SRGB, MIP_FILTER_KAISER | MIP_FILTER_SRGB,
+        MIP_FILTER_KAISER | MIP_FILTER_SRGB | MIP_FILTER_WRAP };
+
+    for (unsigned int filter : filters)
+    {
+        // Odd sizes, so the last column and row of a level are clamped or wrapped.
+        TestImage image(13, 7);
+        for (uint32_t y = 0; y < image.Height; ++y)
+        {
+            for (uint32_t x = 0; x < image.Width; ++x)
+            {
+                uint8_t* pixel = image.Pixel(x, y);
+                pixel[0] = 100;
+                pixel[1] = 150;
+                pixel[2] = 200;
+                pixel[3] = 255;
+            }
+        }
+        CHECK(GenerateMipChain(image.Get(), filter) == S_OK);
+
+        for (size_t i = image.LevelOffset(1); i < image.Pixels.size(); i += 4)
+        {
+            CHECK(std::abs(image.Pixels[i] - 100) <= 1);
+            CHECK(std::abs(image.Pixels[i + 1] - 150) <= 1);
+            CHECK(std::abs(image.Pixels[i + 2] - 200) <= 1);
+            CHECK(image.Pixels[i + 3] == 255);
+        }
+    }
+}
+
+TEST(MipChainFiltersInLinearSpace)
+{
+    // A black and white checkerboard. Averaged in linear space the mips are
+    // 50% grey, which is 188 in sRGB (not 128).
+    TestImage image(4, 4);
+    for (uint32_t y = 0; y < image.Height; ++y)
+    {
+        for (uint32_t x = 0; x < image.Width; ++x)
+        {
+            uint8_t* pixel = image.Pixel(x, y);
+            pixel[0] = pixel[1] = pixel[2] = (x + y) % 2 ? 255 : 0;
+            pixel[3] = 255;
+        }
+    }
+    TestImage unorm = image;
+
+    CHECK(GenerateMipChain(image.Get(), MIP_FILTER_SRGB) == S_OK);
+    CHECK(GenerateMipChain(unorm.Get(), MIP_FILTER_BOX) == S_OK);
+
+    for (uint32_t mip = 1; mip < image.MipLevels; ++mip)
+    {
+        CHECK(std::abs(image.Pixels[image.LevelOffset(mip)] - 188) <= 1);
+        CHECK(std::abs(unorm.Pixels[unorm.LevelOffset(mip)] - 128) <= 1);
+    }
+}
+
+TEST(MipChainPreservesAlphaCoverage)
+{
+    // A sparse cutout, like leaves: about 40% of the pixels pass the alpha test.
+    TestImage plain(16, 16);
+    for (uint32_t y = 0; y < plain.Height; ++y)
+    {
+        for (uint32_t x = 0; x < plain.Width; ++x)
+        {
+            plain.Pixel(x, y)[3] = (x * 7 + y * 13 + x * y) % 10 < 4 ? 255 : 0;
+        }
+    }
+    TestImage preserved = plain;
+
+    CHECK(GenerateMipChain(plain.Get(), MIP_FILTER_BOX) == S_OK);
+    CHECK(GenerateMipChain(preserved.Get(), MIP_FILTER_ALPHA_COVERAGE) == S_OK);
+
+    float topCoverage = CountCovered(plain, 0) / 256.0f;
+    for (uint32_t mip = 1; mip < 3; ++mip)
+    {
+        float numPixels = static_cast<float>((16 >> mip) * (16 >> mip));
+        float plainError = std::abs(CountCovered(plain, mip) / numPixels - topCoverage);
+        float preservedError = std::abs(CountCovered(preserved, mip) / numPixels - topCoverage);
+        CHECK(preservedError <= plainError);
+        CHECK(preservedError <= 1.0f / numPixels + 0.001f);
+    }
+}
+
+TEST(MipChainsOfManyImages)
+{
+    std::vector<TestImage> images(50, TestImage(16, 16));
+    std::vector<MipChainImage> chains;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        for (uint8_t& value : images[i].Pixels)
+        {
+            value = static_cast<uint8_t>(i * 5);
+        }
+        chains.push_back(images[i].Get());
+    }
+
+    // On the threads of a pool and on the calling thread alone.
+    WorkerPool pool(3);
+    for (WorkerPool* p : { &pool, static_cast<WorkerPool*>(nullptr) })
+    {
+        CHECK(GenerateMipChains(chains.data(), chains.size(), MIP_FILTER_KAISER | MIP_FILTER_SRGB | MIP_FILTER_WRAP, 0.5f, p) == S_OK);
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            for (uint8_t value : images[i].Pixels)
+            {
+                CHECK(std::abs(value - static_cast<int>(i * 5)) <= 1);
+            }
+        }
+    }
+
+    // A failure is reported, the other images are still processed.
+    chains[7].mipLevels = 10;
+    CHECK(GenerateMipChains(chains.data(), chains.size(), MIP_FILTER_BOX, 0.5f, &pool) == E_INVALIDARG);
+}
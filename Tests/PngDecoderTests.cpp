@@ -0,0 +1,559 @@
+#include "Test.h"
+
+#include <PngDecoder.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    const uint8_t PngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    // The Adam7 passes, as in the PNG specification.
+    const uint32_t Adam7X[7] = { 0, 4, 0, 2, 0, 1, 0 };
+    const uint32_t Adam7Y[7] = { 0, 0, 4, 0, 2, 0, 1 };
+    const uint32_t Adam7DX[7] = { 8, 8, 4, 4, 2, 2, 1 };
+    const uint32_t Adam7DY[7] = { 8, 8, 8, 4, 4, 2, 2 };
+
+    // A bitwise CRC-32, independent of the zlib one the decoder uses.
+    uint32_t Crc32(const uint8_t* data, size_t size)
+    {
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc ^= data[i];
+            for (int k = 0; k < 8; ++k)
+            {
+                crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+            }
+        }
+        return ~crc;
+    }
+
+    uint32_t Adler32(const std::vector<uint8_t>& data)
+    {
+        uint32_t a = 1, b = 0;
+        for (uint8_t byte : data)
+        {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    void WriteUInt32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void WriteChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+    {
+        WriteUInt32(out, static_cast<uint32_t>(data.size()));
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        WriteUInt32(out, Crc32(out.data() + start, out.size() - start));
+    }
+
+    // A zlib stream of stored (uncompressed) deflate blocks.
+    std::vector<uint8_t> ZlibStore(const std::vector<uint8_t>& data)
+    {
+        std::vector<uint8_t> out = { 0x78, 0x01 };
+        size_t offset = 0;
+        do
+        {
+            size_t size = std::min<size_t>(data.size() - offset, 65535);
+            bool final = offset + size == data.size();
+            out.push_back(final ? 1 : 0);
+            out.push_back(static_cast<uint8_t>(size));
+            out.push_back(static_cast<uint8_t>(size >> 8));
+            out.push_back(static_cast<uint8_t>(~size));
+            out.push_back(static_cast<uint8_t>(~size >> 8));
+            out.insert(out.end(), data.begin() + offset, data.begin() + offset + size);
+            offset += size;
+        } while (offset < data.size());
+        WriteUInt32(out, Adler32(data));
+        return out;
+    }
+
+    uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+    }
+
+    /**
+     * A minimal PNG encoder. The image is given as samples (one per channel,
+     * at the bit depth of the image), the rows use the five filter types in
+     * turn, and the image data is split over two IDAT chunks.
+     */
+    struct PngImage
+    {
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        uint32_t BitDepth = 8;
+        uint32_t ColorType = 6;
+        bool Interlaced = false;
+        bool SRGB = false;
+        std::vector<uint16_t> Samples;
+        std::vector<uint8_t> Palette;
+        std::vector<uint8_t> Transparency;
+
+        uint32_t NumChannels() const
+        {
+            const uint32_t channels[] = { 1, 0, 3, 1, 2, 0, 4 };
+            return channels[ColorType];
+        }
+
+        // Pack the samples of a row of a pass, without the filter type byte.
+        std::vector<uint8_t> PackRow(uint32_t y, uint32_t x0, uint32_t dx) const
+        {
+            std::vector<uint8_t> row;
+            uint32_t bitOffset = 0;
+            for (uint32_t x = x0; x < Width; x += dx)
+            {
+                for (uint32_t c = 0; c < NumChannels(); ++c)
+                {
+                    uint16_t sample = Samples[(y * Width + x) * NumChannels() + c];
+                    if (BitDepth == 16)
+                    {
+                        row.push_back(static_cast<uint8_t>(sample >> 8));
+                        row.push_back(static_cast<uint8_t>(sample));
+                    }
+                    else if (BitDepth == 8)
+                    {
+                        row.push_back(static_cast<uint8_t>(sample));
+                    }
+                    else
+                    {
+                        if (bitOffset % 8 == 0)
+                        {
+                            row.push_back(0);
+                        }
+                        row.back() |= static_cast<uint8_t>(sample << (8 - BitDepth - bitOffset % 8));
+                        bitOffset += BitDepth;
+                    }
+                }
+            }
+            return row;
+        }
+
+        std::vector<uint8_t> FilterData() const
+        {
+            const size_t bytesPerPixel = std::max<size_t>(1, NumChannels() * BitDepth / 8);
+            std::vector<uint8_t> data;
+            int numRows = 0;
+            for (int p = 0; p < (Interlaced ? 7 : 1); ++p)
+            {
+                uint32_t x0 = Interlaced ? Adam7X[p] : 0, y0 = Interlaced ? Adam7Y[p] : 0;
+                uint32_t dx = Interlaced ? Adam7DX[p] : 1, dy = Interlaced ? Adam7DY[p] : 1;
+                if (x0 >= Width || y0 >= Height)
+                {
+                    continue;
+                }
+
+                std::vector<uint8_t> prior;
+                for (uint32_t y = y0; y < Height; y += dy)
+                {
+                    std::vector<uint8_t> row = PackRow(y, x0, dx);
+                    uint8_t filterType = static_cast<uint8_t>(numRows++ % 5);
+                    data.push_back(filterType);
+                    for (size_t i = 0; i < row.size(); ++i)
+                    {
+                        uint8_t left = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+                        uint8_t up = prior.empty() ? 0 : prior[i];
+                        uint8_t upLeft = (prior.empty() || i < bytesPerPixel) ? 0 : prior[i - bytesPerPixel];
+                        const uint8_t predictions[] = { 0, left, up, static_cast<uint8_t>((left + up) >> 1), Paeth(left, up, upLeft) };
+                        data.push_back(static_cast<uint8_t>(row[i] - predictions[filterType]));
+                    }
+                    prior = row;
+                }
+            }
+            return data;
+        }
+
+        std::vector<uint8_t> Encode() const
+        {
+            std::vector<uint8_t> file(PngSignature, PngSignature + sizeof(PngSignature));
+
+            std::vector<uint8_t> header;
+            WriteUInt32(header, Width);
+            WriteUInt32(header, Height);
+            header.push_back(static_cast<uint8_t>(BitDepth));
+            header.push_back(static_cast<uint8_t>(ColorType));
+            header.push_back(0);
+            header.push_back(0);
+            header.push_back(Interlaced ? 1 : 0);
+            WriteChunk(file, "IHDR", header);
+
+            if (SRGB)
+            {
+                WriteChunk(file, "sRGB", { 0 });
+            }
+            if (!Palette.empty())
+            {
+                WriteChunk(file, "PLTE", Palette);
+            }
+            if (!Transparency.empty())
+            {
+                WriteChunk(file, "tRNS", Transparency);
+            }
+
+            std::vector<uint8_t> stream = ZlibStore(FilterData());
+            size_t half = stream.size() / 2;
+            WriteChunk(file, "IDAT", std::vector<uint8_t>(stream.begin(), stream.begin() + half));
+            WriteChunk(file, "IDAT", std::vector<uint8_t>(stream.begin() + half, stream.end()));
+            WriteChunk(file, "IEND", {});
+            return file;
+        }
+    };
+
+    PngImage RandomImage(uint32_t width, uint32_t height, uint32_t colorType, uint32_t bitDepth, uint32_t seed)
+    {
+        PngImage image;
+        image.Width = width;
+        image.Height = height;
+        image.ColorType = colorType;
+        image.BitDepth = bitDepth;
+        image.Samples.resize(width * height * image.NumChannels());
+
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<uint32_t> sample(0, (1u << bitDepth) - 1);
+        for (auto& s : image.Samples)
+        {
+            s = static_cast<uint16_t>(sample(random));
+        }
+        return image;
+    }
+
+    bool Decode(const std::vector<uint8_t>& file, DecodedImage& decoded)
+    {
+        PngDecoder decoder;
+        return decoder.Decode(file.data(), file.size(), decoded);
+    }
+
+    // Compare an RGBA8 or RGBA16 image with the decoded pixels, 16-bit samples reduced to their high byte.
+    bool MatchesRGBA(const PngImage& image, const DecodedImage& decoded)
+    {
+        if (!decoded.Pixels || decoded.Width != image.Width || decoded.Height != image.Height ||
+            decoded.RowPitch != image.Width * 4 || decoded.SlicePitch != decoded.RowPitch * image.Height)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < image.Samples.size(); ++i)
+        {
+            uint8_t expected = static_cast<uint8_t>(image.BitDepth == 16 ? image.Samples[i] >> 8 : image.Samples[i]);
+            if (decoded.Pixels[i] != expected)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const uint8_t* Pixel(const DecodedImage& decoded, uint32_t x, uint32_t y)
+    {
+        return decoded.Pixels.get() + y * decoded.RowPitch + x * 4;
+    }
+
+    // Encoded files in a temporary directory, removed with the directory.
+    struct TempFiles
+    {
+        fs::path Directory;
+        std::vector<std::wstring> FileNames;
+
+        TempFiles()
+            : Directory(fs::temp_directory_path() / (L"pngdecoder-" + std::to_wstring(std::random_device()())))
+        {
+            fs::create_directories(Directory);
+        }
+
+        ~TempFiles()
+        {
+            std::error_code ec;
+            fs::remove_all(Directory, ec);
+        }
+
+        void Write(const std::vector<uint8_t>& data)
+        {
+            fs::path fileName = Directory / (std::to_wstring(FileNames.size()) + L".png");
+            std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(data.data()), data.size());
+            FileNames.push_back(fileName.wstring());
+        }
+    };
+
+    // The size of most block textures.
+    const uint32_t BlockTextureSize = 16;
+    const uint32_t NumBenchmarkTextures = 1000;
+}
+
+TEST(PngDecoderFilters)
+{
+    for (uint32_t bitDepth : { 8, 16 })
+    {
+        PngImage image = RandomImage(9, 7, 6, bitDepth, bitDepth);
+        DecodedImage decoded;
+        CHECK(Decode(image.Encode(), decoded));
+        CHECK(MatchesRGBA(image, decoded));
+        CHECK(decoded.HasAlpha);
+        CHECK(!decoded.IsSRGB);
+        CHECK(decoded.SourceBitDepth == bitDepth);
+    }
+
+    // Gray and alpha, with the sRGB chunk.
+    PngImage grayAlpha = RandomImage(5, 4, 4, 8, 1);
+    grayAlpha.SRGB = true;
+    DecodedImage decoded;
+    CHECK(Decode(grayAlpha.Encode(), decoded));
+    CHECK(decoded.IsSRGB);
+    for (uint32_t i = 0; i < 5 * 4; ++i)
+    {
+        const uint8_t* p = decoded.Pixels.get() + i * 4;
+        CHECK(p[0] == grayAlpha.Samples[i * 2] && p[1] == p[0] && p[2] == p[0]);
+        CHECK(p[3] == grayAlpha.Samples[i * 2 + 1]);
+    }
+}
+
+TEST(PngDecoderAdam7)
+{
+    // Sizes where some of the seven passes are empty, and where they are all partial.
+    const uint32_t sizes[][2] = { { 1, 1 }, { 3, 2 }, { 7, 5 }, { 8, 8 }, { 9, 9 }, { 17, 3 }, { 2, 19 } };
+    for (auto& size : sizes)
+    {
+        for (uint32_t bitDepth : { 8, 16 })
+        {
+            PngImage image = RandomImage(size[0], size[1], 6, bitDepth, size[0] * 100 + size[1]);
+            image.Interlaced = true;
+            DecodedImage decoded;
+            CHECK(Decode(image.Encode(), decoded));
+            CHECK(MatchesRGBA(image, decoded));
+        }
+    }
+
+    // Packed 1 and 4 bit gray: each pass row starts on a byte boundary.
+    for (uint32_t bitDepth : { 1, 4 })
+    {
+        PngImage image = RandomImage(13, 11, 0, bitDepth, bitDepth);
+        image.Interlaced = true;
+        DecodedImage decoded;
+        CHECK(Decode(image.Encode(), decoded));
+        CHECK(decoded.Pixels != nullptr);
+        bool matches = decoded.Pixels != nullptr;
+        for (uint32_t y = 0; matches && y < 11; ++y)
+        {
+            for (uint32_t x = 0; x < 13; ++x)
+            {
+                uint32_t gray = image.Samples[y * 13 + x] * (255 / ((1u << bitDepth) - 1));
+                matches = matches && Pixel(decoded, x, y)[0] == gray && Pixel(decoded, x, y)[3] == 255;
+            }
+        }
+        CHECK(matches);
+        CHECK(!decoded.HasAlpha);
+    }
+}
+
+TEST(PngDecoderPaletteAndTransparency)
+{
+    // A 2 bit palette of four colors. tRNS covers only the first two entries,
+    // the others stay opaque.
+    PngImage image = RandomImage(7, 3, 3, 2, 3);
+    image.Palette = { 255, 0, 0, 0, 255, 0, 0, 0, 255, 10, 20, 30 };
+    image.Transparency = { 0, 128 };
+    DecodedImage decoded;
+    CHECK(Decode(image.Encode(), decoded));
+    CHECK(decoded.HasAlpha);
+    const uint8_t alphas[] = { 0, 128, 255, 255 };
+    for (uint32_t i = 0; i < 7 * 3; ++i)
+    {
+        uint32_t index = image.Samples[i];
+        const uint8_t* p = decoded.Pixels.get() + i * 4;
+        CHECK(memcmp(p, &image.Palette[index * 3], 3) == 0);
+        CHECK(p[3] == alphas[index]);
+    }
+
+    // Indices past the end of a short palette decode as opaque black.
+    PngImage shortPalette = image;
+    shortPalette.Palette.resize(2 * 3);
+    shortPalette.Transparency.clear();
+    shortPalette.Samples = { 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0 };
+    CHECK(Decode(shortPalette.Encode(), decoded));
+    CHECK(!decoded.HasAlpha);
+    const uint8_t black[] = { 0, 0, 0, 255 };
+    CHECK(memcmp(Pixel(decoded, 2, 0), black, 4) == 0);
+    CHECK(memcmp(Pixel(decoded, 3, 0), black, 4) == 0);
+
+    // More transparency entries than palette entries, or no palette at all.
+    PngImage tooManyAlphas = shortPalette;
+    tooManyAlphas.Transparency = { 1, 2, 3 };
+    CHECK(!Decode(tooManyAlphas.Encode(), decoded));
+    PngImage noPalette = shortPalette;
+    noPalette.Palette.clear();
+    CHECK(!Decode(noPalette.Encode(), decoded));
+
+    // Color keys of gray and RGB images.
+    PngImage gray = RandomImage(4, 4, 0, 8, 4);
+    gray.Samples[5] = 77;
+    gray.Transparency = { 0, 77 };
+    CHECK(Decode(gray.Encode(), decoded));
+    CHECK(decoded.HasAlpha);
+    CHECK(Pixel(decoded, 1, 1)[3] == 0 && Pixel(decoded, 1, 1)[0] == 77);
+
+    PngImage rgb = RandomImage(4, 4, 2, 16, 5);
+    rgb.Samples[0] = 0x1234;
+    rgb.Samples[1] = 0x5678;
+    rgb.Samples[2] = 0x9ABC;
+    rgb.Transparency = { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC };
+    CHECK(Decode(rgb.Encode(), decoded));
+    const uint8_t transparent[] = { 0x12, 0x56, 0x9A, 0 };
+    CHECK(memcmp(Pixel(decoded, 0, 0), transparent, 4) == 0);
+    for (uint32_t i = 1; i < 16; ++i)
+    {
+        bool isKey = rgb.Samples[i * 3] == 0x1234 && rgb.Samples[i * 3 + 1] == 0x5678 && rgb.Samples[i * 3 + 2] == 0x9ABC;
+        CHECK(decoded.Pixels[i * 4 + 3] == (isKey ? 0 : 255));
+    }
+}
+
+TEST(PngDecoderChecksCRC)
+{
+    PngImage image = RandomImage(6, 6, 3, 8, 6);
+    for (auto& s : image.Samples)
+    {
+        s %= 4;
+    }
+    image.Samples[0] = 0;
+    image.Palette = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+    image.Transparency = { 5 };
+    image.SRGB = true;
+    std::vector<uint8_t> file = image.Encode();
+
+    DecodedImage decoded;
+    CHECK(Decode(file, decoded));
+
+    // Any flipped bit after the signature lands in a chunk (length, type, data
+    // or CRC) and must be rejected, critical and ancillary chunks alike.
+    int numAccepted = 0;
+    for (size_t i = sizeof(PngSignature); i < file.size(); ++i)
+    {
+        std::vector<uint8_t> corrupt = file;
+        corrupt[i] ^= 0x10;
+        if (Decode(corrupt, decoded) || decoded.Pixels)
+        {
+            numAccepted++;
+        }
+    }
+    CHECK(numAccepted == 0);
+
+    // A changed chunk with a matching CRC is accepted: the palette is read from the file.
+    std::vector<uint8_t> repaired = file;
+    size_t palette = sizeof(PngSignature) + 25 + 13;
+    CHECK(memcmp(&repaired[palette + 4], "PLTE", 4) == 0);
+    repaired[palette + 8] = 200;
+    uint32_t crc = Crc32(&repaired[palette + 4], 4 + 12);
+    for (int b = 0; b < 4; ++b)
+    {
+        repaired[palette + 8 + 12 + b] = static_cast<uint8_t>(crc >> (24 - 8 * b));
+    }
+    CHECK(Decode(repaired, decoded));
+    CHECK(decoded.Pixels[0] == 200);
+
+    // Truncated files, including one that stops before IEND.
+    for (size_t size = 0; size < file.size(); ++size)
+    {
+        PngDecoder decoder;
+        CHECK(!decoder.Decode(file.data(), size, decoded));
+    }
+}
+
+TEST(PngDecoderDecodeFilesOnWorkers)
+{
+    // Images of different sizes, so the workers finish them out of order, with
+    // a corrupt and a missing file among them.
+    TempFiles files;
+    std::vector<PngImage> images;
+    for (uint32_t i = 0; i < 40; ++i)
+    {
+        images.push_back(RandomImage(1 + i % 7 * 5, 1 + i % 5 * 9, 6, 8, i));
+        std::vector<uint8_t> file = images.back().Encode();
+        if (i == 13)
+        {
+            file[sizeof(PngSignature) + 10] ^= 0x10;
+        }
+        files.Write(file);
+    }
+    files.FileNames[29] = (files.Directory / L"missing.png").wstring();
+
+    for (uint32_t numWorkers : { 1, 4 })
+    {
+        ImageBatchDecoder decoder(numWorkers);
+        std::vector<DecodedImage> decoded;
+        ImageBatchDecoder::Statistics statistics = decoder.DecodeFiles(files.FileNames, decoded);
+        CHECK(statistics.NumImages == 40);
+        CHECK(statistics.NumDecoded == 38);
+        CHECK(decoded.size() == 40);
+
+        // Every image is decoded into the entry of its file.
+        for (size_t i = 0; i < decoded.size(); ++i)
+        {
+            if (i == 13 || i == 29)
+            {
+                CHECK(!decoded[i].Pixels);
+            }
+            else
+            {
+                CHECK(MatchesRGBA(images[i], decoded[i]));
+            }
+        }
+    }
+}
+
+BENCHMARK(PngDecoderThroughput)
+{
+    // Block textures as the texture array baker sees them.
+    TempFiles files;
+    std::vector<std::vector<uint8_t> > encoded;
+    uint64_t numBytes = 0;
+    for (uint32_t i = 0; i < NumBenchmarkTextures; ++i)
+    {
+        encoded.push_back(RandomImage(BlockTextureSize, BlockTextureSize, 6, 8, i).Encode());
+        files.Write(encoded.back());
+        numBytes += encoded.back().size();
+    }
+    printf("  %u hardware threads, %u %ux%u RGBA textures, %.1f KB\n", std::thread::hardware_concurrency(),
+        NumBenchmarkTextures, BlockTextureSize, BlockTextureSize, numBytes / 1024.0);
+
+    // Decoding alone, from memory on the calling thread.
+    PngDecoder pngDecoder;
+    DecodedImage decoded;
+    uint32_t numDecoded = 0;
+    auto start = Tests::Clock::now();
+    for (auto& file : encoded)
+    {
+        numDecoded += pngDecoder.Decode(file.data(), file.size(), decoded) ? 1 : 0;
+    }
+    double milliseconds = Tests::MillisecondsSince(start);
+    CHECK(numDecoded == NumBenchmarkTextures);
+    printf("  in memory:  %8.1f ms, %9.0f textures/s\n", milliseconds, numDecoded / (milliseconds / 1000.0));
+
+    // Reading and decoding the files on the workers of a batch.
+    for (uint32_t numWorkers : { 1, 2, 4, 8 })
+    {
+        ImageBatchDecoder decoder(numWorkers);
+        std::vector<DecodedImage> images;
+        ImageBatchDecoder::Statistics statistics = decoder.DecodeFiles(files.FileNames, images);
+        CHECK(statistics.NumDecoded == NumBenchmarkTextures);
+        printf("  %u workers: %8.1f ms, %9.0f textures/s\n", numWorkers, statistics.Seconds * 1000.0, statistics.ImagesPerSecond);
+    }
+}
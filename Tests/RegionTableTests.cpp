@@ -0,0 +1,151 @@
+#include "Test.h"
+
+#include <RegionTable.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+
+using namespace MineCraft;
+
+namespace
+{
+    struct FakeRegion
+    {
+        int X;
+        int Z;
+    };
+
+    using Table = RegionTable<FakeRegion>;
+
+    void InsertRegion(Table& table, int x, int z)
+    {
+        table.Insert(x, z) = std::unique_ptr<FakeRegion>(new FakeRegion{ x, z });
+    }
+
+    bool HasRegion(Table& table, int x, int z)
+    {
+        auto* value = table.Find(x, z);
+        return value != nullptr && *value != nullptr && (*value)->X == x && (*value)->Z == z;
+    }
+}
+
+TEST(RegionTableKeepsSignedCoordinatesApart)
+{
+    Table table;
+    const int coordinates[][2] = { { 0, 0 }, { -1, 0 }, { 0, -1 }, { 1, 0 }, { 0, 1 }, { -1, -1 },
+        { INT32_MIN, 0 }, { 0, INT32_MIN }, { INT32_MAX, -1 } };
+    for (auto& c : coordinates)
+    {
+        CHECK(table.Find(c[0], c[1]) == nullptr);
+        InsertRegion(table, c[0], c[1]);
+    }
+    CHECK(table.Size() == 9);
+    for (auto& c : coordinates)
+    {
+        CHECK(HasRegion(table, c[0], c[1]));
+    }
+    CHECK(table.Find(1, 1) == nullptr);
+    CHECK(Table::Key(-1, 0) != Table::Key(0, -1));
+}
+
+TEST(RegionTableMissingRegions)
+{
+    // A region without a file stays in the table with a nullptr, so it is not looked up again.
+    Table table;
+    table.Insert(3, 4);
+    auto* value = table.Find(3, 4);
+    CHECK(value != nullptr && *value == nullptr);
+    CHECK(table.Size() == 1);
+
+    // Inserting an existing key returns the same value.
+    InsertRegion(table, 3, 4);
+    CHECK(table.Size() == 1);
+    CHECK(HasRegion(table, 3, 4));
+}
+
+TEST(RegionTableProbesWrapAround)
+{
+    // Keys whose home slot is the last one: the later ones probe into the
+    // first slots of the table.
+    Table table;
+    const size_t lastSlot = table.NumSlots() - 1;
+    std::vector<std::pair<int, int>> colliding;
+    for (int x = -64; x < 64 && colliding.size() < 3; ++x)
+    {
+        for (int z = -64; z < 64 && colliding.size() < 3; ++z)
+        {
+            if ((Table::Hash(Table::Key(x, z)) & lastSlot) == lastSlot)
+            {
+                colliding.emplace_back(x, z);
+            }
+        }
+    }
+    CHECK(colliding.size() == 3);
+
+    for (auto& c : colliding)
+    {
+        InsertRegion(table, c.first, c.second);
+    }
+    for (size_t i = 0; i < colliding.size(); ++i)
+    {
+        CHECK(HasRegion(table, colliding[i].first, colliding[i].second));
+        CHECK(table.ProbeLength(colliding[i].first, colliding[i].second) == i + 1);
+    }
+}
+
+TEST(RegionTableGrows)
+{
+    // A square of regions around the origin, inserted in a random order and
+    // checked against a std::map after every growth.
+    std::vector<std::pair<int, int>> coordinates;
+    for (int x = -20; x < 20; ++x)
+    {
+        for (int z = -20; z < 20; ++z)
+        {
+            coordinates.emplace_back(x, z);
+        }
+    }
+    std::shuffle(coordinates.begin(), coordinates.end(), std::mt19937(49));
+
+    Table table;
+    std::map<std::pair<int, int>, FakeRegion*> inserted;
+    size_t numSlots = table.NumSlots();
+    for (auto& c : coordinates)
+    {
+        InsertRegion(table, c.first, c.second);
+        inserted[c] = table.Find(c.first, c.second)->get();
+
+        // At most half full.
+        CHECK(table.Size() * 2 <= table.NumSlots());
+        if (table.NumSlots() != numSlots)
+        {
+            CHECK(table.NumSlots() == numSlots * 2);
+            numSlots = table.NumSlots();
+
+            // The regions keep their address when the table grows.
+            for (auto& entry : inserted)
+            {
+                auto* value = table.Find(entry.first.first, entry.first.second);
+                CHECK(value != nullptr && value->get() == entry.second);
+            }
+        }
+    }
+    CHECK(table.Size() == coordinates.size());
+
+    size_t numVisited = 0, longestProbe = 0;
+    table.ForEach([&](std::unique_ptr<FakeRegion>& region)
+    {
+        numVisited++;
+        longestProbe = std::max(longestProbe, table.ProbeLength(region->X, region->Z));
+    });
+    CHECK(numVisited == coordinates.size());
+    // Neighbouring regions spread well, no probe sequence gets long.
+    CHECK(longestProbe <= 8);
+
+    table.Clear();
+    CHECK(table.Size() == 0);
+    CHECK(table.NumSlots() == Table::InitialSlots);
+    CHECK(table.Find(0, 0) == nullptr);
+}
@@ -0,0 +1,209 @@
+#include "Test.h"
+
+#include <RenderQueueSort.h>
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    // Stand-ins for the pipeline states, root signatures, textures and meshes
+    // of a queue, the filter only compares their addresses.
+    int PipelineStates[2];
+    int RootSignatures[2];
+    int Textures[3];
+    int Meshes[4];
+
+    struct Packet
+    {
+        uint32_t PipelineState;
+        uint32_t RootSignature;
+        uint32_t Texture;
+        uint32_t Material;
+        uint32_t Mesh;
+        float Depth;
+    };
+
+    DrawStatistics DrawPackets(const std::vector<Packet>& packets, const std::vector<DrawSortEntry>& order)
+    {
+        DrawStateFilter filter;
+        for (auto& entry : order)
+        {
+            const Packet& packet = packets[entry.PacketIndex];
+            filter.Draw(&PipelineStates[packet.PipelineState], &RootSignatures[packet.RootSignature],
+                &Textures[packet.Texture], packet.Material, &Meshes[packet.Mesh]);
+        }
+        return filter.GetStatistics();
+    }
+}
+
+TEST(DrawSortKeyPacksFields)
+{
+    uint64_t key = DrawSortKey::Pack(3, 2, 5, 7, 9, 1.5f);
+    CHECK(DrawSortKey::GetField(key, DrawSortKey::PipelineStateShift, DrawSortKey::PipelineStateBits) == 3);
+    CHECK(DrawSortKey::GetField(key, DrawSortKey::RootSignatureShift, DrawSortKey::RootSignatureBits) == 2);
+    CHECK(DrawSortKey::GetField(key, DrawSortKey::TextureShift, DrawSortKey::TextureBits) == 5);
+    CHECK(DrawSortKey::GetField(key, DrawSortKey::MaterialShift, DrawSortKey::MaterialBits) == 7);
+    CHECK(DrawSortKey::GetField(key, DrawSortKey::MeshShift, DrawSortKey::MeshBits) == 9);
+    CHECK(DrawSortKey::GetField(key, DrawSortKey::DepthShift, DrawSortKey::DepthBits) == DrawSortKey::QuantizeDepth(1.5f));
+
+    // Ids wrap around within their field and never reach the neighbouring fields.
+    CHECK(DrawSortKey::Pack((1ull << DrawSortKey::PipelineStateBits) + 1, 0, 0, 0, 0, 0.0f) == DrawSortKey::Pack(1, 0, 0, 0, 0, 0.0f));
+    CHECK(DrawSortKey::Pack(0, UINT64_MAX, 0, 0, 0, 0.0f) == ((1ull << DrawSortKey::RootSignatureBits) - 1) << DrawSortKey::RootSignatureShift);
+    CHECK(DrawSortKey::Pack(0, 0, 0, 0, UINT64_MAX, 0.0f) == ((1ull << DrawSortKey::MeshBits) - 1) << DrawSortKey::MeshShift);
+    CHECK(DrawSortKey::Pack(0, 0, 0, 0, 0, 0.0f) == 0);
+
+    // Depth increases with the distance, negative depths are clamped.
+    CHECK(DrawSortKey::QuantizeDepth(-4.0f) == 0);
+    CHECK(DrawSortKey::QuantizeDepth(0.5f) < DrawSortKey::QuantizeDepth(1.0f));
+    CHECK(DrawSortKey::QuantizeDepth(1.0f) < DrawSortKey::QuantizeDepth(100.0f));
+    CHECK(DrawSortKey::QuantizeDepth(100.0f) < DrawSortKey::QuantizeDepth(1e30f));
+    CHECK(DrawSortKey::QuantizeDepth(1e30f) < (1ull << DrawSortKey::DepthBits));
+
+    // A more significant field decides the order regardless of the others.
+    CHECK(DrawSortKey::Pack(1, 5, 5, 5, 5, 1e30f) < DrawSortKey::Pack(2, 0, 0, 0, 0, 0.0f));
+    CHECK(DrawSortKey::Pack(1, 1, 9, 9, 9, 1e30f) < DrawSortKey::Pack(1, 2, 0, 0, 0, 0.0f));
+    CHECK(DrawSortKey::Pack(1, 1, 1, 9, 9, 1e30f) < DrawSortKey::Pack(1, 1, 2, 0, 0, 0.0f));
+    CHECK(DrawSortKey::Pack(1, 1, 1, 1, 9, 1e30f) < DrawSortKey::Pack(1, 1, 1, 2, 0, 0.0f));
+    CHECK(DrawSortKey::Pack(1, 1, 1, 1, 1, 1e30f) < DrawSortKey::Pack(1, 1, 1, 1, 2, 0.0f));
+    CHECK(DrawSortKey::Pack(1, 1, 1, 1, 1, 2.0f) < DrawSortKey::Pack(1, 1, 1, 1, 1, 3.0f));
+}
+
+TEST(RadixSortDrawKeysSortsStably)
+{
+    std::vector<DrawSortEntry> entries;
+    std::vector<DrawSortEntry> scratch;
+    CHECK(RadixSortDrawKeys(entries, scratch) == 0);
+
+    // Random keys with many duplicates.
+    std::mt19937_64 random(39);
+    for (uint32_t i = 0; i < 5000; ++i)
+    {
+        entries.push_back({ random() & 0xFF00FF00000F00FFull, i });
+    }
+    std::vector<DrawSortEntry> expected = entries;
+    std::stable_sort(expected.begin(), expected.end(), [](const DrawSortEntry& a, const DrawSortEntry& b)
+    {
+        return a.Key < b.Key;
+    });
+
+    // Only the digits that differ between the keys are sorted.
+    CHECK(RadixSortDrawKeys(entries, scratch) == 4);
+    CHECK(entries.size() == expected.size());
+    bool same = true;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        same = same && entries[i].Key == expected[i].Key && entries[i].PacketIndex == expected[i].PacketIndex;
+    }
+    CHECK(same);
+
+    // Keys that are all the same need no pass, and keep their order.
+    entries.assign(100, { 0x0123456789ABCDEFull, 0 });
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        entries[i].PacketIndex = i;
+    }
+    CHECK(RadixSortDrawKeys(entries, scratch) == 0);
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        CHECK(entries[i].PacketIndex == i);
+    }
+
+    // Keys that differ only in the top and bottom digits take two passes.
+    entries.clear();
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        entries.push_back({ 0x0012345678ABCD00ull | static_cast<uint64_t>((i * 7) & 0xF) << 56 | ((i * 13) & 0xFF), i });
+    }
+    CHECK(RadixSortDrawKeys(entries, scratch) == 2);
+    for (size_t i = 1; i < entries.size(); ++i)
+    {
+        CHECK(entries[i - 1].Key < entries[i].Key ||
+            (entries[i - 1].Key == entries[i].Key && entries[i - 1].PacketIndex < entries[i].PacketIndex));
+    }
+}
+
+TEST(DrawStateFilterBindsChangedState)
+{
+    DrawStateFilter filter;
+    const uint32_t all = DrawStateFilter::PipelineStateChange | DrawStateFilter::RootSignatureChange |
+        DrawStateFilter::TextureChange | DrawStateFilter::MaterialChange | DrawStateFilter::MeshChange;
+
+    // The first draw of a range binds everything.
+    CHECK(filter.Draw(&PipelineStates[0], &RootSignatures[0], &Textures[0], 0, &Meshes[0]) == all);
+    CHECK(filter.Draw(&PipelineStates[0], &RootSignatures[0], &Textures[0], 0, &Meshes[0]) == 0);
+    CHECK(filter.Draw(&PipelineStates[0], &RootSignatures[0], &Textures[0], 0, &Meshes[1]) == DrawStateFilter::MeshChange);
+    CHECK(filter.Draw(&PipelineStates[0], &RootSignatures[0], &Textures[1], 1, &Meshes[1]) ==
+        (DrawStateFilter::TextureChange | DrawStateFilter::MaterialChange));
+    CHECK(filter.Draw(&PipelineStates[1], &RootSignatures[0], &Textures[1], 1, &Meshes[1]) == DrawStateFilter::PipelineStateChange);
+    // A new root signature binds the texture and the material again, even if they are the same.
+    CHECK(filter.Draw(&PipelineStates[1], &RootSignatures[1], &Textures[1], 1, &Meshes[1]) ==
+        (DrawStateFilter::RootSignatureChange | DrawStateFilter::TextureChange | DrawStateFilter::MaterialChange));
+
+    const DrawStatistics& statistics = filter.GetStatistics();
+    CHECK(statistics.NumDraws == 6);
+    CHECK(statistics.NumPipelineStateChanges == 2);
+    CHECK(statistics.NumRootSignatureChanges == 2);
+    CHECK(statistics.NumTextureChanges == 3);
+    CHECK(statistics.NumMaterialChanges == 3);
+    CHECK(statistics.NumMeshChanges == 2);
+
+    DrawStatistics sum;
+    sum.NumPackets = 6;
+    sum += statistics;
+    sum += statistics;
+    CHECK(sum.NumPackets == 6 && sum.NumDraws == 12 && sum.NumTextureChanges == 6 && sum.NumMeshChanges == 4);
+}
+
+TEST(RenderQueueSortGroupsState)
+{
+    // Every combination of pipeline state, texture and mesh twice, at different depths, shuffled.
+    std::vector<Packet> packets;
+    for (uint32_t pipelineState = 0; pipelineState < 2; ++pipelineState)
+    {
+        for (uint32_t texture = 0; texture < 3; ++texture)
+        {
+            for (uint32_t mesh = 0; mesh < 4; ++mesh)
+            {
+                packets.push_back({ pipelineState, 0, texture, 0, mesh, 10.0f });
+                packets.push_back({ pipelineState, 0, texture, 0, mesh, 2.0f });
+            }
+        }
+    }
+    std::shuffle(packets.begin(), packets.end(), std::mt19937(39));
+
+    std::vector<DrawSortEntry> entries;
+    for (uint32_t i = 0; i < packets.size(); ++i)
+    {
+        const Packet& packet = packets[i];
+        entries.push_back({ DrawSortKey::Pack(packet.PipelineState, packet.RootSignature, packet.Texture,
+            packet.Material, packet.Mesh, packet.Depth), i });
+    }
+    DrawStatistics unsorted = DrawPackets(packets, entries);
+
+    std::vector<DrawSortEntry> scratch;
+    RadixSortDrawKeys(entries, scratch);
+    DrawStatistics sorted = DrawPackets(packets, entries);
+
+    // Each state is bound once per group of the states above it in the key.
+    CHECK(sorted.NumDraws == 48);
+    CHECK(sorted.NumPipelineStateChanges == 2);
+    CHECK(sorted.NumRootSignatureChanges == 1);
+    CHECK(sorted.NumTextureChanges == 6);
+    CHECK(sorted.NumMaterialChanges == 1);
+    CHECK(sorted.NumMeshChanges == 24);
+    CHECK(unsorted.NumDraws == 48);
+    CHECK(unsorted.NumPipelineStateChanges > sorted.NumPipelineStateChanges);
+    CHECK(unsorted.NumMeshChanges > sorted.NumMeshChanges);
+
+    // Draws with the same state are front to back.
+    for (size_t i = 1; i < entries.size(); ++i)
+    {
+        const Packet& previous = packets[entries[i - 1].PacketIndex];
+        const Packet& packet = packets[entries[i].PacketIndex];
+        if (previous.PipelineState == packet.PipelineState && previous.Texture == packet.Texture && previous.Mesh == packet.Mesh)
+        {
+            CHECK(previous.Depth < packet.Depth);
+        }
+    }
+}
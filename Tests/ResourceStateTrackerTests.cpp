@@ -0,0 +1,198 @@
+#include "Test.h"
+
+#include <ResourceStateTracker.h>
+
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace
+{
+    // Stand-ins for resources. The tracker only uses the addresses, spaced
+    // like heap allocated resources.
+    struct alignas(64) FakeResource
+    {
+        char Padding[64];
+    };
+
+    const size_t NumFakeResources = 1024;
+    FakeResource g_FakeResources[NumFakeResources];
+
+    ID3D12Resource* GetFakeResource(size_t index)
+    {
+        return reinterpret_cast<ID3D12Resource*>(&g_FakeResources[index]);
+    }
+
+    void Transition(ResourceStateTracker& tracker, ID3D12Resource* resource, D3D12_RESOURCE_STATES stateAfter,
+        UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+    {
+        tracker.ResourceBarrier(CD3DX12_RESOURCE_BARRIER::Transition(resource, D3D12_RESOURCE_STATE_COMMON, stateAfter, subresource));
+    }
+
+    // Resolve and commit a command list the way the command queue does.
+    std::vector<D3D12_RESOURCE_BARRIER> Resolve(ResourceStateTracker& tracker)
+    {
+        uint32_t shards = tracker.GetGlobalStateShards();
+        ResourceStateTracker::LockGlobalState(shards);
+        auto barriers = tracker.ResolvePendingResourceBarriers();
+        tracker.CommitFinalResourceStates();
+        ResourceStateTracker::UnlockGlobalState(shards);
+        return barriers;
+    }
+}
+
+TEST(ResourceStateTrackerResolvesAgainstGlobalState)
+{
+    ID3D12Resource* texture = GetFakeResource(0);
+    ID3D12Resource* buffer = GetFakeResource(1);
+    ResourceStateTracker::AddGlobalResourceState(texture, D3D12_RESOURCE_STATE_COPY_DEST);
+    ResourceStateTracker::AddGlobalResourceState(buffer, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+    ResourceStateTracker tracker;
+    Transition(tracker, texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, 2);
+    Transition(tracker, buffer, D3D12_RESOURCE_STATE_GENERIC_READ);
+    Transition(tracker, texture, D3D12_RESOURCE_STATE_RENDER_TARGET, 3);
+
+    // Only the texture's first use needs a pending barrier, from its global state.
+    auto barriers = Resolve(tracker);
+    CHECK(barriers.size() == 1);
+    CHECK(barriers[0].Transition.pResource == texture);
+    CHECK(barriers[0].Transition.Subresource == 2);
+    CHECK(barriers[0].Transition.StateBefore == D3D12_RESOURCE_STATE_COPY_DEST);
+
+    // The next command list sees the committed subresource states.
+    tracker.Reset();
+    Transition(tracker, texture, D3D12_RESOURCE_STATE_COPY_SOURCE, 3);
+    barriers = Resolve(tracker);
+    CHECK(barriers.size() == 1);
+    CHECK(barriers[0].Transition.StateBefore == D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+    ResourceStateTracker::RemoveGlobalResourceState(texture);
+    ResourceStateTracker::RemoveGlobalResourceState(buffer);
+}
+
+TEST(ResourceStateTrackerCrossQueueResolveIsAtomic)
+{
+    // Two queues ping-pong a pair of resources between states. Every command
+    // list moves both resources to the same state, so if a resolve on one
+    // queue saw the other queue's batch half committed, the before states of
+    // the pair would differ.
+    ID3D12Resource* first = GetFakeResource(2);
+    ID3D12Resource* second = GetFakeResource(3 + 7 * 16);
+    ResourceStateTracker::AddGlobalResourceState(first, D3D12_RESOURCE_STATE_COMMON);
+    ResourceStateTracker::AddGlobalResourceState(second, D3D12_RESOURCE_STATE_COMMON);
+
+    const D3D12_RESOURCE_STATES states[] = { D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_SOURCE };
+    std::atomic<int> numMismatches(0);
+    auto queue = [&](int q)
+    {
+        ResourceStateTracker tracker;
+        for (int i = 0; i < 20000; ++i)
+        {
+            tracker.Reset();
+            D3D12_RESOURCE_STATES state = states[(i + q) % 2];
+            Transition(tracker, first, state);
+            Transition(tracker, second, state);
+            auto barriers = Resolve(tracker);
+            if (barriers.size() == 2 && barriers[0].Transition.StateBefore != barriers[1].Transition.StateBefore)
+            {
+                numMismatches++;
+            }
+            if (barriers.size() == 1)
+            {
+                numMismatches++;
+            }
+        }
+    };
+    std::thread other(queue, 1);
+    queue(0);
+    other.join();
+
+    CHECK(numMismatches == 0);
+
+    ResourceStateTracker::RemoveGlobalResourceState(first);
+    ResourceStateTracker::RemoveGlobalResourceState(second);
+}
+
+BENCHMARK(ResourceStateTrackerResolve)
+{
+    // Three queues (direct, compute and copy) each submit command lists that
+    // transition a few resources. Most resources belong to one queue, some
+    // are shared. The shard locks are compared with one cross-queue lock.
+    const int NumQueues = 3;
+    const int NumSubmissions = 100000;
+    const int NumTransitions = 6;
+    const size_t NumResourcesPerQueue = 256;
+
+    for (size_t i = 0; i < NumFakeResources; ++i)
+    {
+        ResourceStateTracker::AddGlobalResourceState(GetFakeResource(i), D3D12_RESOURCE_STATE_COMMON);
+    }
+
+    const D3D12_RESOURCE_STATES states[] = {
+        D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_SOURCE,
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS };
+
+    std::mutex crossQueueMutex;
+    auto run = [&](bool shardLocks)
+    {
+        auto queue = [&](int q)
+        {
+            std::mt19937 random(q);
+            std::uniform_int_distribution<size_t> own(q * NumResourcesPerQueue, (q + 1) * NumResourcesPerQueue - 1);
+            std::uniform_int_distribution<size_t> shared(NumQueues * NumResourcesPerQueue, NumFakeResources - 1);
+            std::uniform_int_distribution<int> sharedChance(0, 9);
+
+            ResourceStateTracker tracker;
+            for (int i = 0; i < NumSubmissions; ++i)
+            {
+                tracker.Reset();
+                for (int t = 0; t < NumTransitions; ++t)
+                {
+                    size_t resource = sharedChance(random) == 0 ? shared(random) : own(random);
+                    Transition(tracker, GetFakeResource(resource), states[(i + t) % 4]);
+                }
+
+                if (shardLocks)
+                {
+                    Resolve(tracker);
+                }
+                else
+                {
+                    uint32_t shards = tracker.GetGlobalStateShards();
+                    std::lock_guard<std::mutex> lock(crossQueueMutex);
+                    ResourceStateTracker::LockGlobalState(shards);
+                    tracker.ResolvePendingResourceBarriers();
+                    tracker.CommitFinalResourceStates();
+                    ResourceStateTracker::UnlockGlobalState(shards);
+                }
+            }
+        };
+
+        auto start = Tests::Clock::now();
+        std::vector<std::thread> queues;
+        for (int q = 1; q < NumQueues; ++q)
+        {
+            queues.emplace_back(queue, q);
+        }
+        queue(0);
+        for (auto& thread : queues)
+        {
+            thread.join();
+        }
+        return Tests::MillisecondsSince(start);
+    };
+
+    double crossQueue = run(false);
+    double sharded = run(true);
+
+    for (size_t i = 0; i < NumFakeResources; ++i)
+    {
+        ResourceStateTracker::RemoveGlobalResourceState(GetFakeResource(i));
+    }
+
+    printf("  %d queues, %d command lists each, %d transitions per command list\n", NumQueues, NumSubmissions, NumTransitions);
+    printf("  %-24s %8.1f ns per command list\n", "One cross-queue lock", crossQueue * 1e6 / (NumQueues * NumSubmissions));
+    printf("  %-24s %8.1f ns per command list\n", "Shard locks", sharded * 1e6 / (NumQueues * NumSubmissions));
+}
@@ -0,0 +1,282 @@
+#include "Test.h"
+
+#include "SectionCulling.h"
+#include "SectionSummary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+using namespace MineCraft;
+
+namespace
+{
+    const float SectionExtent = static_cast<float>(SECTION_SIZE);
+
+    XMFLOAT4 Plane(float x, float y, float z, float px, float py, float pz)
+    {
+        float length = std::sqrt(x * x + y * y + z * z);
+        x /= length;
+        y /= length;
+        z /= length;
+        return XMFLOAT4(x, y, z, -(x * px + y * py + z * pz));
+    }
+
+    // A frustum with a 90 degree field of view, looking horizontally from
+    // (x, y, z) at yaw radians from +z towards +x.
+    Frustum LookFrom(float x, float y, float z, float yaw, float farDistance)
+    {
+        float forwardX = std::sin(yaw), forwardZ = std::cos(yaw);
+        float rightX = forwardZ, rightZ = -forwardX;
+
+        Frustum frustum;
+        frustum.Planes[0] = Plane(forwardX + rightX, 0.0f, forwardZ + rightZ, x, y, z);
+        frustum.Planes[1] = Plane(forwardX - rightX, 0.0f, forwardZ - rightZ, x, y, z);
+        frustum.Planes[2] = Plane(forwardX, 1.0f, forwardZ, x, y, z);
+        frustum.Planes[3] = Plane(forwardX, -1.0f, forwardZ, x, y, z);
+        frustum.Planes[4] = Plane(forwardX, 0.0f, forwardZ, x + forwardX * 0.1f, y, z + forwardZ * 0.1f);
+        frustum.Planes[5] = Plane(-forwardX, 0.0f, -forwardZ, x + forwardX * farDistance, y, z + forwardZ * farDistance);
+        return frustum;
+    }
+
+    bool IsSectionInFrustum(const Frustum& frustum, uint64_t key)
+    {
+        int x, y, z;
+        UnpackSectionKey(key, x, y, z);
+        XMFLOAT3 min(x * SectionExtent, y * SectionExtent, z * SectionExtent);
+        XMFLOAT3 max(min.x + SectionExtent, min.y + SectionExtent, min.z + SectionExtent);
+        return frustum.IntersectsBox(min, max);
+    }
+
+    // The sections of a square of chunk columns centered on the origin.
+    std::vector<uint64_t> AddColumns(SectionCuller& culler, int radius, int height)
+    {
+        std::vector<uint64_t> keys;
+        for (int z = -radius; z < radius; ++z)
+        {
+            for (int x = -radius; x < radius; ++x)
+            {
+                for (int y = 0; y < height; ++y)
+                {
+                    culler.AddSection(x, y, z);
+                    keys.push_back(PackSectionKey(x, y, z));
+                }
+            }
+        }
+        return keys;
+    }
+}
+
+TEST(SectionKeyRoundTrip)
+{
+    const int coordinates[] = { 0, 1, -1, 31, -32, 1875000, -1875000 };
+    for (int x : coordinates)
+    {
+        for (int z : coordinates)
+        {
+            for (int y = 0; y < 16; ++y)
+            {
+                int ux, uy, uz;
+                UnpackSectionKey(PackSectionKey(x, y, z), ux, uy, uz);
+                CHECK(ux == x && uy == y && uz == z);
+            }
+        }
+    }
+}
+
+TEST(FrustumBoxTests)
+{
+    Frustum frustum = LookFrom(0.0f, 0.0f, 0.0f, 0.0f, 100.0f);
+
+    CHECK(frustum.IntersectsBox(XMFLOAT3(-1, -1, 10), XMFLOAT3(1, 1, 12)));
+    CHECK(frustum.ContainsBox(XMFLOAT3(-1, -1, 10), XMFLOAT3(1, 1, 12)));
+    // Behind the camera, beyond the far plane and off to the side.
+    CHECK(!frustum.IntersectsBox(XMFLOAT3(-1, -1, -12), XMFLOAT3(1, 1, -10)));
+    CHECK(!frustum.IntersectsBox(XMFLOAT3(-1, -1, 110), XMFLOAT3(1, 1, 112)));
+    CHECK(!frustum.IntersectsBox(XMFLOAT3(30, -1, 10), XMFLOAT3(32, 1, 12)));
+    // Straddling the right plane.
+    CHECK(frustum.IntersectsBox(XMFLOAT3(9, -1, 10), XMFLOAT3(11, 1, 12)));
+    CHECK(!frustum.ContainsBox(XMFLOAT3(9, -1, 10), XMFLOAT3(11, 1, 12)));
+}
+
+TEST(BoxListMatchesScalarTest)
+{
+    std::mt19937 random(29);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> size(0.5f, 20.0f);
+    std::uniform_real_distribution<float> yaw(0.0f, 6.2831853f);
+
+    // Odd sizes, so the ranges end in the middle of a SIMD batch.
+    for (size_t numBoxes : { 1, 3, 7, 9, 1001 })
+    {
+        BoxList boxes;
+        std::vector<XMFLOAT3> mins, maxs;
+        for (size_t i = 0; i < numBoxes; ++i)
+        {
+            XMFLOAT3 min(position(random), position(random) * 0.25f, position(random));
+            XMFLOAT3 max(min.x + size(random), min.y + size(random), min.z + size(random));
+            boxes.Add(min, max);
+            mins.push_back(min);
+            maxs.push_back(max);
+        }
+        CHECK(boxes.Size() == numBoxes);
+
+        for (int f = 0; f < 8; ++f)
+        {
+            Frustum frustum = LookFrom(position(random) * 0.1f, 0.0f, position(random) * 0.1f, yaw(random), 150.0f);
+            size_t begin = numBoxes / 3;
+            std::vector<uint32_t> visible;
+            size_t numVisible = boxes.Cull(frustum, begin, numBoxes, visible);
+            CHECK(numVisible == visible.size());
+
+            std::vector<uint32_t> expected;
+            for (size_t i = begin; i < numBoxes; ++i)
+            {
+                if (frustum.IntersectsBox(mins[i], maxs[i]))
+                {
+                    expected.push_back(static_cast<uint32_t>(i));
+                }
+            }
+            CHECK(visible == expected);
+        }
+    }
+}
+
+TEST(SectionCullerMatchesBruteForce)
+{
+    // Scattered sections across several regions, on both sides of the origin.
+    std::mt19937 random(1029);
+    std::uniform_int_distribution<int> chunk(-80, 80);
+    std::uniform_int_distribution<int> sectionY(0, 15);
+    std::uniform_real_distribution<float> yaw(0.0f, 6.2831853f);
+
+    SectionCuller culler;
+    std::vector<uint64_t> keys;
+    for (int i = 0; i < 20000; ++i)
+    {
+        int x = chunk(random), y = sectionY(random), z = chunk(random);
+        uint64_t key = PackSectionKey(x, y, z);
+        if (std::find(keys.begin(), keys.end(), key) == keys.end())
+        {
+            culler.AddSection(x, y, z);
+            keys.push_back(key);
+        }
+    }
+    CHECK(culler.Size() == keys.size());
+
+    for (int f = 0; f < 16; ++f)
+    {
+        Frustum frustum = LookFrom(0.0f, 64.0f, 0.0f, yaw(random), f < 8 ? 300.0f : 2000.0f);
+        std::vector<uint64_t> visible;
+        culler.Cull(frustum, visible);
+
+        std::vector<uint64_t> expected;
+        for (uint64_t key : keys)
+        {
+            if (IsSectionInFrustum(frustum, key))
+            {
+                expected.push_back(key);
+            }
+        }
+
+        std::sort(visible.begin(), visible.end());
+        std::sort(expected.begin(), expected.end());
+        CHECK(!expected.empty());
+        CHECK(visible == expected);
+        CHECK(culler.GetStatistics().NumVisible == visible.size());
+        CHECK(culler.GetStatistics().NumSections == keys.size());
+    }
+}
+
+TEST(SectionCullerRemoveChunk)
+{
+    SectionCuller culler;
+    AddColumns(culler, 4, 4);
+
+    Frustum frustum = LookFrom(0.0f, 32.0f, -100.0f, 0.0f, 1000.0f);
+    std::vector<uint64_t> visible;
+    culler.Cull(frustum, visible);
+    size_t numVisible = visible.size();
+
+    culler.RemoveChunk(0, 0);
+    culler.RemoveChunk(-3, 2);
+    CHECK(culler.Size() == 8 * 8 * 4 - 2 * 4);
+
+    culler.Cull(frustum, visible);
+    CHECK(visible.size() == numVisible - 2 * 4);
+    for (uint64_t key : visible)
+    {
+        int x, y, z;
+        UnpackSectionKey(key, x, y, z);
+        CHECK(!(x == 0 && z == 0) && !(x == -3 && z == 2));
+    }
+}
+
+BENCHMARK(SectionCullerHundredThousandSections)
+{
+    // 160 x 160 chunk columns of 4 sections, 102400 sections in 36 regions.
+    const int Radius = 80;
+    const int Height = 4;
+    const int NumFrames = 200;
+
+    SectionCuller culler;
+    std::vector<uint64_t> keys = AddColumns(culler, Radius, Height);
+
+    BoxList flat;
+    for (uint64_t key : keys)
+    {
+        int x, y, z;
+        UnpackSectionKey(key, x, y, z);
+        flat.Add(XMFLOAT3(x * SectionExtent, y * SectionExtent, z * SectionExtent),
+            XMFLOAT3((x + 1) * SectionExtent, (y + 1) * SectionExtent, (z + 1) * SectionExtent));
+    }
+
+    std::vector<Frustum> frustums;
+    for (int f = 0; f < NumFrames; ++f)
+    {
+        frustums.push_back(LookFrom(0.0f, 40.0f, 0.0f, f * 6.2831853f / NumFrames, 256.0f));
+    }
+
+    // Built outside of the timings, like the viewer does once after the chunks changed.
+    std::vector<uint64_t> visible;
+    culler.Cull(frustums[0], visible);
+
+    size_t numVisible = 0;
+    auto start = Tests::Clock::now();
+    for (const Frustum& frustum : frustums)
+    {
+        culler.Cull(frustum, visible);
+        numVisible += visible.size();
+    }
+    double hierarchical = Tests::MillisecondsSince(start) / NumFrames;
+    const SectionCuller::Statistics& statistics = culler.GetStatistics();
+
+    std::vector<uint32_t> visibleIndices;
+    size_t numFlatVisible = 0;
+    start = Tests::Clock::now();
+    for (const Frustum& frustum : frustums)
+    {
+        visibleIndices.clear();
+        numFlatVisible += flat.Cull(frustum, 0, flat.Size(), visibleIndices);
+    }
+    double simd = Tests::MillisecondsSince(start) / NumFrames;
+
+    size_t numScalarVisible = 0;
+    start = Tests::Clock::now();
+    for (const Frustum& frustum : frustums)
+    {
+        for (uint64_t key : keys)
+        {
+            numScalarVisible += IsSectionInFrustum(frustum, key) ? 1 : 0;
+        }
+    }
+    double scalar = Tests::MillisecondsSince(start) / NumFrames;
+
+    CHECK(numVisible == numFlatVisible && numVisible == numScalarVisible);
+    printf("  %zu sections, %zu visible on average\n", keys.size(), numVisible / NumFrames);
+    printf("  %-28s %8.3f ms per cull\n", "Scalar, every section", scalar);
+    printf("  %-28s %8.3f ms per cull\n", "BoxList, every section", simd);
+    printf("  %-28s %8.3f ms per cull (last: %u regions, %u chunks, %u sections tested)\n", "SectionCuller hierarchy",
+        hierarchical, statistics.NumRegionsTested, statistics.NumChunksTested, statistics.NumSectionsTested);
+}
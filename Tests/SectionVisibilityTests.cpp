@@ -0,0 +1,89 @@
+#include "Test.h"
+
+#include "SectionSummary.h"
+#include "SectionVisibility.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+using namespace MineCraft;
+
+namespace
+{
+    const short Stone = 1;
+
+    // The camera in the middle of section (0, 4, 0).
+    const XMFLOAT3 CameraPosition(8.0f, 72.0f, 8.0f);
+
+    bool Contains(const std::vector<uint64_t>& keys, int x, int y, int z)
+    {
+        return std::find(keys.begin(), keys.end(), PackSectionKey(x, y, z)) != keys.end();
+    }
+}
+
+TEST(SectionConnectivityOfSlab)
+{
+    // A stone floor through the middle of the section.
+    short blockIds[SECTION_BLOCKS] = {};
+    for (int z = 0; z < SECTION_SIZE; ++z)
+    {
+        for (int x = 0; x < SECTION_SIZE; ++x)
+        {
+            blockIds[SectionBlockIndex(x, 8, z)] = Stone;
+        }
+    }
+    SectionSummary summary;
+    summary.Compute(blockIds);
+    SectionConnectivity connectivity = ComputeSectionConnectivity(summary);
+
+    CHECK(!AreFacesConnected(connectivity, FacePositiveY, FaceNegativeY));
+    CHECK(AreFacesConnected(connectivity, FacePositiveX, FaceNegativeX));
+    CHECK(AreFacesConnected(connectivity, FacePositiveY, FacePositiveZ));
+    CHECK(AreFacesConnected(connectivity, FaceNegativeY, FaceNegativeZ));
+
+    SectionSummary empty;
+    CHECK(ComputeSectionConnectivity(empty) == AllFacesConnected);
+}
+
+TEST(OcclusionCullerSkipsEmptySections)
+{
+    // Only one section of the two chunks is not air. The empty sections are
+    // traversed, but never reported.
+    SectionOcclusionCuller culler;
+    culler.AddChunk(0, 0);
+    culler.AddChunk(1, 0);
+    culler.SetSection(1, 4, 0, AllFacesConnected);
+
+    std::vector<uint64_t> visible;
+    CHECK(culler.Cull(CameraPosition, nullptr, visible));
+    CHECK(visible.size() == 1);
+    CHECK(Contains(visible, 1, 4, 0));
+    CHECK(culler.GetStatistics().NumVisited == 2 * SECTION_SIZE);
+
+    // Outside of the loaded chunks nothing is culled.
+    CHECK(!culler.Cull(XMFLOAT3(-100.0f, 72.0f, 8.0f), nullptr, visible));
+    CHECK(visible.empty());
+}
+
+TEST(OcclusionCullerStopsAtOpaqueSections)
+{
+    // A wall of solid sections at x = 1 hides the sections behind it.
+    SectionOcclusionCuller culler;
+    for (int x = 0; x < 3; ++x)
+    {
+        culler.AddChunk(x, 0);
+    }
+    for (int y = 0; y < SECTION_SIZE; ++y)
+    {
+        culler.SetSection(1, y, 0, 0);
+        culler.SetSection(2, y, 0, AllFacesConnected);
+    }
+
+    std::vector<uint64_t> visible;
+    CHECK(culler.Cull(CameraPosition, nullptr, visible));
+    CHECK(Contains(visible, 1, 4, 0));
+    for (int y = 0; y < SECTION_SIZE; ++y)
+    {
+        CHECK(!Contains(visible, 2, y, 0));
+    }
+}
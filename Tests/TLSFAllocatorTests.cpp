@@ -0,0 +1,318 @@
+#include "Test.h"
+
+#include <TLSFAllocator.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+
+namespace
+{
+    struct LiveAllocation
+    {
+        TLSFAllocator<>::Allocation Allocation;
+        uint32_t Size;
+    };
+
+    // The longest run of free units in the occupancy model.
+    uint32_t LargestFreeRun(const std::vector<uint8_t>& used)
+    {
+        uint32_t largest = 0, run = 0;
+        for (uint8_t u : used)
+        {
+            run = u ? 0 : run + 1;
+            largest = std::max(largest, run);
+        }
+        return largest;
+    }
+
+    /**
+     * The free lists the descriptor pages used before the TLSFAllocator: the
+     * free blocks by offset in a std::map and by size in a std::multimap,
+     * best fit with coalescing.
+     */
+    class FreeListAllocator
+    {
+    public:
+        explicit FreeListAllocator(uint32_t capacity)
+            : m_FreeSize(capacity)
+        {
+            AddBlock(0, capacity);
+        }
+
+        // Returns the offset, or UINT32_MAX if the request cannot be satisfied.
+        uint32_t Allocate(uint32_t size)
+        {
+            if (size > m_FreeSize)
+            {
+                return UINT32_MAX;
+            }
+            auto bySize = m_FreeBySize.lower_bound(size);
+            if (bySize == m_FreeBySize.end())
+            {
+                return UINT32_MAX;
+            }
+
+            uint32_t blockSize = bySize->first;
+            auto byOffset = bySize->second;
+            uint32_t offset = byOffset->first;
+            m_FreeBySize.erase(bySize);
+            m_FreeByOffset.erase(byOffset);
+            if (blockSize > size)
+            {
+                AddBlock(offset + size, blockSize - size);
+            }
+            m_FreeSize -= size;
+            return offset;
+        }
+
+        void Free(uint32_t offset, uint32_t size)
+        {
+            m_FreeSize += size;
+
+            auto next = m_FreeByOffset.upper_bound(offset);
+            auto prev = next;
+            if (prev != m_FreeByOffset.begin())
+            {
+                --prev;
+                if (prev->first + prev->second.Size == offset)
+                {
+                    offset = prev->first;
+                    size += prev->second.Size;
+                    m_FreeBySize.erase(prev->second.SizeEntry);
+                    m_FreeByOffset.erase(prev);
+                }
+            }
+            if (next != m_FreeByOffset.end() && offset + size == next->first)
+            {
+                size += next->second.Size;
+                m_FreeBySize.erase(next->second.SizeEntry);
+                m_FreeByOffset.erase(next);
+            }
+            AddBlock(offset, size);
+        }
+
+    private:
+        struct Block;
+        using ByOffset = std::map<uint32_t, Block>;
+        using BySize = std::multimap<uint32_t, ByOffset::iterator>;
+
+        struct Block
+        {
+            uint32_t Size;
+            BySize::iterator SizeEntry;
+        };
+
+        void AddBlock(uint32_t offset, uint32_t size)
+        {
+            auto byOffset = m_FreeByOffset.emplace(offset, Block{ size, BySize::iterator() }).first;
+            byOffset->second.SizeEntry = m_FreeBySize.emplace(size, byOffset);
+        }
+
+        ByOffset m_FreeByOffset;
+        BySize m_FreeBySize;
+        uint32_t m_FreeSize;
+    };
+}
+
+TEST(TLSFAllocatorExhaustAndCoalesce)
+{
+    TLSFAllocator<> allocator(64, 64);
+
+    auto a = allocator.Allocate(16);
+    auto b = allocator.Allocate(16);
+    auto c = allocator.Allocate(32);
+    CHECK(a.IsValid() && b.IsValid() && c.IsValid());
+    CHECK(a.Offset == 0 && b.Offset == 16 && c.Offset == 32);
+    CHECK(allocator.GetFreeSize() == 0);
+    CHECK(!allocator.Allocate(1).IsValid());
+    CHECK(!allocator.Allocate(0).IsValid());
+    CHECK(allocator.GetAllocationSize(c.Node) == 32);
+
+    // Freed out of order, the blocks merge back into one.
+    allocator.Free(b);
+    allocator.Free(a);
+    CHECK(allocator.Allocate(32).Offset == 0);
+    allocator.Free(c);
+    CHECK(!allocator.Allocate(64).IsValid());
+    CHECK(allocator.GetFreeSize() == 32);
+
+    allocator.Reset();
+    auto all = allocator.Allocate(64);
+    CHECK(all.IsValid() && all.Offset == 0);
+}
+
+TEST(TLSFAllocatorRequestInItsOwnBin)
+{
+    // Only a free block in the size class of the request (36-39) is left. The
+    // search rounds 37 up to the next class, then falls back to that bin's head.
+    TLSFAllocator<> allocator(100, 100);
+    auto first = allocator.Allocate(39);
+    auto rest = allocator.Allocate(61);
+    allocator.Free(first);
+
+    auto fit = allocator.Allocate(37);
+    CHECK(fit.IsValid() && fit.Offset == 0);
+    allocator.Free(fit);
+    allocator.Free(rest);
+}
+
+TEST(TLSFAllocatorRandomized)
+{
+    const uint32_t Capacity = 4096;
+    const int NumOperations = 200000;
+
+    TLSFAllocator<> allocator(Capacity, Capacity);
+    std::vector<uint8_t> used(Capacity, 0);
+    std::vector<LiveAllocation> live;
+    uint32_t numUsed = 0;
+
+    std::mt19937 random(32);
+    std::uniform_int_distribution<int> operation(0, 99);
+    // Mostly small tables, sometimes a large range.
+    std::uniform_int_distribution<uint32_t> smallSize(1, 16);
+    std::uniform_int_distribution<uint32_t> largeSize(17, 512);
+
+    for (int i = 0; i < NumOperations; ++i)
+    {
+        bool allocate = live.empty() || operation(random) < 52;
+        if (allocate)
+        {
+            uint32_t size = operation(random) < 90 ? smallSize(random) : largeSize(random);
+            auto allocation = allocator.Allocate(size);
+            if (!allocation.IsValid())
+            {
+                // Good fit may skip a block that is barely large enough, never one twice the size.
+                CHECK(LargestFreeRun(used) < 2 * size);
+                continue;
+            }
+
+            CHECK(allocation.Offset + size <= Capacity);
+            CHECK(allocator.GetAllocationSize(allocation.Node) == size);
+            for (uint32_t u = allocation.Offset; u < allocation.Offset + size && u < Capacity; ++u)
+            {
+                CHECK(!used[u]);
+                used[u] = 1;
+            }
+            numUsed += size;
+            live.push_back({ allocation, size });
+        }
+        else
+        {
+            size_t index = std::uniform_int_distribution<size_t>(0, live.size() - 1)(random);
+            LiveAllocation freed = live[index];
+            live[index] = live.back();
+            live.pop_back();
+
+            allocator.Free(freed.Allocation);
+            for (uint32_t u = freed.Allocation.Offset; u < freed.Allocation.Offset + freed.Size; ++u)
+            {
+                used[u] = 0;
+            }
+            numUsed -= freed.Size;
+        }
+        CHECK(allocator.GetFreeSize() == Capacity - numUsed);
+    }
+
+    // Everything coalesces back into a single block.
+    for (const LiveAllocation& allocation : live)
+    {
+        allocator.Free(allocation.Allocation);
+    }
+    CHECK(allocator.GetFreeSize() == Capacity);
+    CHECK(allocator.Allocate(Capacity).IsValid());
+}
+
+BENCHMARK(TLSFAllocatorVersusFreeLists)
+{
+    // A descriptor heap page under a steady churn of descriptor tables.
+    const uint32_t Capacity = 4096;
+    const int NumOperations = 2000000;
+
+    std::mt19937 random(321);
+    std::uniform_int_distribution<uint32_t> size(1, 32);
+    std::vector<uint32_t> sizes(NumOperations);
+    std::vector<uint32_t> picks(NumOperations);
+    for (int i = 0; i < NumOperations; ++i)
+    {
+        sizes[i] = size(random);
+        picks[i] = random();
+    }
+
+    // Keep the heap about half full: allocate below the target, free above it.
+    const uint32_t TargetUsed = Capacity / 2;
+
+    size_t numFailedTLSF = 0;
+    double tlsfMilliseconds;
+    {
+        TLSFAllocator<> allocator(Capacity, Capacity);
+        std::vector<TLSFAllocator<>::Allocation> live;
+        live.reserve(Capacity);
+
+        auto start = Tests::Clock::now();
+        for (int i = 0; i < NumOperations; ++i)
+        {
+            if (Capacity - allocator.GetFreeSize() < TargetUsed || live.empty())
+            {
+                auto allocation = allocator.Allocate(sizes[i]);
+                if (allocation.IsValid())
+                {
+                    live.push_back(allocation);
+                }
+                else
+                {
+                    numFailedTLSF++;
+                }
+            }
+            else
+            {
+                size_t index = picks[i] % live.size();
+                allocator.Free(live[index]);
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+        tlsfMilliseconds = Tests::MillisecondsSince(start);
+    }
+
+    size_t numFailedFreeList = 0;
+    double freeListMilliseconds;
+    {
+        FreeListAllocator allocator(Capacity);
+        struct Live { uint32_t Offset, Size; };
+        std::vector<Live> live;
+        live.reserve(Capacity);
+        uint32_t numUsed = 0;
+
+        auto start = Tests::Clock::now();
+        for (int i = 0; i < NumOperations; ++i)
+        {
+            if (numUsed < TargetUsed || live.empty())
+            {
+                uint32_t offset = allocator.Allocate(sizes[i]);
+                if (offset != UINT32_MAX)
+                {
+                    live.push_back({ offset, sizes[i] });
+                    numUsed += sizes[i];
+                }
+                else
+                {
+                    numFailedFreeList++;
+                }
+            }
+            else
+            {
+                size_t index = picks[i] % live.size();
+                allocator.Free(live[index].Offset, live[index].Size);
+                numUsed -= live[index].Size;
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+        freeListMilliseconds = Tests::MillisecondsSince(start);
+    }
+
+    printf("  %d operations on a %u descriptor page, 1-32 descriptors, half full\n", NumOperations, Capacity);
+    printf("  %-22s %8.1f ns per operation, %zu failed\n", "std::map free lists", freeListMilliseconds * 1e6 / NumOperations, numFailedFreeList);
+    printf("  %-22s %8.1f ns per operation, %zu failed\n", "TLSFAllocator", tlsfMilliseconds * 1e6 / NumOperations, numFailedTLSF);
+}
@@ -0,0 +1,56 @@
+/**
+ * A minimal harness for the tests of the CPU side of the libraries.
+ *
+ * TEST(Name) { ... } defines a test, CHECK(condition) records a failure and
+ * lets the test continue. BENCHMARK(Name) { ... } defines a benchmark, which
+ * only runs when the tests are started with -benchmark and prints its own
+ * timings. Tests and benchmarks run in the order of their definition within
+ * a file.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace Tests
+{
+    struct TestCase
+    {
+        const char* Name;
+        void (*Function)();
+        bool IsBenchmark;
+    };
+
+    std::vector<TestCase>& GetTestCases();
+
+    void ReportFailure(const char* file, int line, const char* expression);
+
+    struct Registration
+    {
+        Registration(const char* name, void (*function)(), bool isBenchmark)
+        {
+            GetTestCases().push_back({ name, function, isBenchmark });
+        }
+    };
+
+    // Milliseconds since an earlier Now().
+    using Clock = std::chrono::high_resolution_clock;
+    inline double MillisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+}
+
+#define TEST(name) \
+    static void name(); \
+    static Tests::Registration name##Registration(#name, name, false); \
+    static void name()
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static Tests::Registration name##Registration(#name, name, true); \
+    static void name()
+
+#define CHECK(condition) \
+    do { if (!(condition)) Tests::ReportFailure(__FILE__, __LINE__, #condition); } while (false)
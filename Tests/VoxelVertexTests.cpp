@@ -0,0 +1,277 @@
+#include "Test.h"
+
+#include <VoxelMesher.h>
+#include <VoxelVertex.h>
+
+#include <cstdlib>
+
+namespace
+{
+    VoxelVertexAttributes RandomAttributes()
+    {
+        VoxelVertexAttributes a;
+        a.X = uint8_t(rand() % 17);
+        a.Y = uint8_t(rand() % 17);
+        a.Z = uint8_t(rand() % 17);
+        a.Face = static_cast<VoxelFace>(rand() % static_cast<int>(VoxelFace::NumFaces));
+        a.AO = uint8_t(rand() % 4);
+        a.Corner = uint8_t(rand() % 4);
+        a.BlockLight = uint8_t(rand() % 16);
+        a.SkyLight = uint8_t(rand() % 16);
+        a.TextureLayer = uint16_t(rand() % 65536);
+        a.RepeatU = uint8_t(1 + rand() % 16);
+        a.RepeatV = uint8_t(1 + rand() % 16);
+        return a;
+    }
+
+    const uint16_t Stone = 1;
+    const uint16_t Torch = 2;
+
+    VoxelMesher CreateMesher()
+    {
+        std::vector<VoxelMesher::BlockType> types(3, VoxelMesher::BlockType{});
+        for (int face = 0; face < static_cast<int>(VoxelFace::NumFaces); ++face)
+        {
+            types[Stone].Layers[face] = uint16_t(10 + face);
+        }
+        types[Torch].Emission = 14;
+        return VoxelMesher(types);
+    }
+}
+
+TEST(VoxelVertexRoundTrip)
+{
+    srand(26);
+    for (int i = 0; i < 100000; ++i)
+    {
+        VoxelVertexAttributes a = RandomAttributes();
+        CHECK(VoxelVertex(a).Decode() == a);
+    }
+}
+
+TEST(VoxelVertexExtremes)
+{
+    VoxelVertexAttributes low = {};
+    low.RepeatU = 1;
+    low.RepeatV = 1;
+    VoxelVertex packedLow(low);
+    CHECK(packedLow.m_Packed[0] == 0 && packedLow.m_Packed[1] == 0);
+    CHECK(packedLow.Decode() == low);
+
+    VoxelVertexAttributes high;
+    high.X = high.Y = high.Z = 16;
+    high.Face = VoxelFace::NegativeZ;
+    high.AO = 3;
+    high.Corner = 3;
+    high.BlockLight = 15;
+    high.SkyLight = 15;
+    high.TextureLayer = 0xFFFF;
+    high.RepeatU = 16;
+    high.RepeatV = 16;
+    VoxelVertex packedHigh(high);
+    CHECK(packedHigh.Decode() == high);
+    // The reserved bits stay zero.
+    CHECK((packedHigh.m_Packed[0] & 0xC0000000u) == 0);
+    CHECK((packedHigh.m_Packed[1] & 0xFF000000u) == 0);
+}
+
+TEST(VoxelVertexBitLayout)
+{
+    // The layout that VoxelVS decodes.
+    VoxelVertexAttributes a = {};
+    a.X = 3;
+    a.Y = 5;
+    a.Z = 7;
+    a.Face = VoxelFace::PositiveZ;
+    a.AO = 2;
+    a.Corner = 1;
+    a.BlockLight = 9;
+    a.SkyLight = 12;
+    a.TextureLayer = 1234;
+    a.RepeatU = 4;
+    a.RepeatV = 2;
+    VoxelVertex v(a);
+
+    uint32_t word0 = v.m_Packed[0];
+    uint32_t word1 = v.m_Packed[1];
+    CHECK((word0 & 0x1F) == 3);
+    CHECK(((word0 >> 5) & 0x1F) == 5);
+    CHECK(((word0 >> 10) & 0x1F) == 7);
+    CHECK(((word0 >> 15) & 0x7) == 4);
+    CHECK(((word0 >> 18) & 0x3) == 2);
+    CHECK(((word0 >> 20) & 0x3) == 1);
+    CHECK(((word0 >> 22) & 0xF) == 9);
+    CHECK(((word0 >> 26) & 0xF) == 12);
+    CHECK((word1 & 0xFFFF) == 1234);
+    CHECK(((word1 >> 16) & 0xF) == 3);
+    CHECK(((word1 >> 20) & 0xF) == 1);
+}
+
+TEST(VoxelMesherSingleBlock)
+{
+    VoxelMesher mesher = CreateMesher();
+    std::vector<uint16_t> blocks(VoxelMesher::NumBlocks, VoxelMesher::Air);
+    blocks[VoxelMesher::BlockIndex(4, 5, 6)] = Stone;
+
+    VoxelVertexCollection vertices;
+    std::vector<uint32_t> indices;
+    mesher.Build(blocks.data(), vertices, indices);
+    CHECK(vertices.size() == 6 * 4);
+    CHECK(indices.size() == 6 * 6);
+
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        VoxelVertexAttributes a = vertices[i].Decode();
+        CHECK(a.X >= 4 && a.X <= 5 && a.Y >= 5 && a.Y <= 6 && a.Z >= 6 && a.Z <= 7);
+        CHECK(a.AO == 3);
+        // The sky light reaches below the block from the sides.
+        CHECK(a.SkyLight == (a.Face == VoxelFace::NegativeY ? 14 : 15));
+        CHECK(a.TextureLayer == 10 + static_cast<int>(a.Face));
+        CHECK(a.Corner == i % 4);
+    }
+
+    // The corners of every face lie in the plane of the face.
+    for (size_t quad = 0; quad < vertices.size(); quad += 4)
+    {
+        VoxelVertexAttributes a = vertices[quad].Decode();
+        for (size_t corner = 1; corner < 4; ++corner)
+        {
+            VoxelVertexAttributes b = vertices[quad + corner].Decode();
+            switch (a.Face)
+            {
+            case VoxelFace::PositiveX: CHECK(b.X == 5); break;
+            case VoxelFace::NegativeX: CHECK(b.X == 4); break;
+            case VoxelFace::PositiveY: CHECK(b.Y == 6); break;
+            case VoxelFace::NegativeY: CHECK(b.Y == 5); break;
+            case VoxelFace::PositiveZ: CHECK(b.Z == 7); break;
+            case VoxelFace::NegativeZ: CHECK(b.Z == 6); break;
+            default: CHECK(false); break;
+            }
+        }
+    }
+}
+
+TEST(VoxelMesherWinding)
+{
+    // Every triangle must be clockwise when seen from the side its face points to.
+    VoxelMesher mesher = CreateMesher();
+    std::vector<uint16_t> blocks(VoxelMesher::NumBlocks, VoxelMesher::Air);
+    blocks[VoxelMesher::BlockIndex(8, 8, 8)] = Stone;
+
+    VoxelVertexCollection vertices;
+    std::vector<uint32_t> indices;
+    mesher.Build(blocks.data(), vertices, indices);
+
+    static const int Normals[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        VoxelVertexAttributes a = vertices[indices[i]].Decode();
+        VoxelVertexAttributes b = vertices[indices[i + 1]].Decode();
+        VoxelVertexAttributes c = vertices[indices[i + 2]].Decode();
+        int e1[3] = { b.X - a.X, b.Y - a.Y, b.Z - a.Z };
+        int e2[3] = { c.X - a.X, c.Y - a.Y, c.Z - a.Z };
+        int cross[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        const int* n = Normals[static_cast<int>(a.Face)];
+        // Seen from the outside in a left-handed system, a clockwise triangle has (b - a) x (c - a) along the normal.
+        CHECK(cross[0] * n[0] + cross[1] * n[1] + cross[2] * n[2] > 0);
+    }
+}
+
+TEST(VoxelMesherHiddenFaces)
+{
+    VoxelMesher mesher = CreateMesher();
+    std::vector<uint16_t> blocks(VoxelMesher::NumBlocks, VoxelMesher::Air);
+    blocks[VoxelMesher::BlockIndex(4, 4, 4)] = Stone;
+    blocks[VoxelMesher::BlockIndex(5, 4, 4)] = Stone;
+
+    VoxelVertexCollection vertices;
+    std::vector<uint32_t> indices;
+    mesher.Build(blocks.data(), vertices, indices);
+    CHECK(vertices.size() == 10 * 4);
+
+    // A full section only shows its outside.
+    std::fill(blocks.begin(), blocks.end(), Stone);
+    mesher.Build(blocks.data(), vertices, indices);
+    CHECK(vertices.size() == 6 * 16 * 16 * 4);
+}
+
+TEST(VoxelMesherAmbientOcclusion)
+{
+    // A block on a floor, next to a wall: the top face corners touching the wall are occluded.
+    VoxelMesher mesher = CreateMesher();
+    std::vector<uint16_t> blocks(VoxelMesher::NumBlocks, VoxelMesher::Air);
+    for (int z = 0; z < VoxelMesher::SectionSize; ++z)
+    {
+        for (int x = 0; x < VoxelMesher::SectionSize; ++x)
+        {
+            blocks[VoxelMesher::BlockIndex(x, 0, z)] = Stone;
+        }
+    }
+    blocks[VoxelMesher::BlockIndex(5, 1, 5)] = Stone;
+
+    VoxelVertexCollection vertices;
+    std::vector<uint32_t> indices;
+    mesher.Build(blocks.data(), vertices, indices);
+
+    int numChecked = 0;
+    for (const VoxelVertex& vertex : vertices)
+    {
+        VoxelVertexAttributes a = vertex.Decode();
+        if (a.Face == VoxelFace::PositiveY && a.Y == 1)
+        {
+            // The floor around the block: the corners touching the block are darker.
+            bool touchesBlock = (a.X == 5 || a.X == 6) && (a.Z == 5 || a.Z == 6);
+            bool nextToEdge = ((a.X == 4 || a.X == 7) && (a.Z >= 4 && a.Z <= 7)) ||
+                ((a.Z == 4 || a.Z == 7) && (a.X >= 4 && a.X <= 7));
+            if (touchesBlock)
+            {
+                CHECK(a.AO < 3);
+                numChecked++;
+            }
+            else if (!nextToEdge)
+            {
+                CHECK(a.AO == 3);
+            }
+        }
+        if (a.Face == VoxelFace::PositiveY && a.Y == 2)
+        {
+            // The top of the block is not occluded.
+            CHECK(a.AO == 3);
+        }
+    }
+    CHECK(numChecked > 0);
+}
+
+TEST(VoxelMesherLight)
+{
+    VoxelMesher mesher = CreateMesher();
+    std::vector<uint16_t> blocks(VoxelMesher::NumBlocks, VoxelMesher::Air);
+    // A roof over the whole section at y = 10 makes everything below it dark.
+    for (int z = 0; z < VoxelMesher::SectionSize; ++z)
+    {
+        for (int x = 0; x < VoxelMesher::SectionSize; ++x)
+        {
+            blocks[VoxelMesher::BlockIndex(x, 10, z)] = Stone;
+        }
+    }
+    // A hole in the roof lets the sky in, and a torch lights its surroundings.
+    blocks[VoxelMesher::BlockIndex(8, 10, 8)] = VoxelMesher::Air;
+    blocks[VoxelMesher::BlockIndex(2, 2, 2)] = Torch;
+
+    std::vector<uint8_t> skyLight(VoxelMesher::NumBlocks);
+    std::vector<uint8_t> blockLight(VoxelMesher::NumBlocks);
+    mesher.ComputeLight(blocks.data(), skyLight.data(), blockLight.data());
+
+    CHECK(skyLight[VoxelMesher::BlockIndex(0, 15, 0)] == 15);
+    CHECK(skyLight[VoxelMesher::BlockIndex(8, 9, 8)] == 15);
+    // Below the roof the light falls off by one per block from the hole.
+    CHECK(skyLight[VoxelMesher::BlockIndex(9, 9, 8)] == 14);
+    CHECK(skyLight[VoxelMesher::BlockIndex(12, 9, 8)] == 11);
+    CHECK(skyLight[VoxelMesher::BlockIndex(0, 0, 0)] < skyLight[VoxelMesher::BlockIndex(8, 0, 8)]);
+    CHECK(skyLight[VoxelMesher::BlockIndex(3, 10, 3)] == 0);
+
+    CHECK(blockLight[VoxelMesher::BlockIndex(2, 2, 2)] == 14);
+    CHECK(blockLight[VoxelMesher::BlockIndex(3, 2, 2)] == 13);
+    CHECK(blockLight[VoxelMesher::BlockIndex(2, 5, 3)] == 10);
+    CHECK(blockLight[VoxelMesher::BlockIndex(15, 15, 15)] == 0);
+}
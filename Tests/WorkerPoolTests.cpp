@@ -0,0 +1,151 @@
+#include "Test.h"
+
+#include <WorkerPool.h>
+
+#include <atomic>
+#include <stdexcept>
+
+namespace
+{
+    // Busy work that the compiler cannot remove, roughly a few microseconds per 1000 iterations.
+    uint64_t Spin(uint64_t iterations)
+    {
+        uint64_t x = iterations;
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+        }
+        return x;
+    }
+
+    // The way CommandQueue::RecordCommandLists worked before: a thread per range, joined on every call.
+    void SpawnFor(size_t numTasks, const WorkerPool::Task& task)
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(numTasks - 1);
+        for (size_t i = 1; i < numTasks; ++i)
+        {
+            threads.emplace_back(task, i);
+        }
+        task(0);
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+}
+
+TEST(WorkerPoolRunsEveryTaskOnce)
+{
+    WorkerPool pool(3);
+    CHECK(pool.GetNumThreads() == 3);
+
+    for (size_t numTasks : { 0, 1, 2, 3, 4, 17, 1000 })
+    {
+        std::vector<std::atomic<int>> counts(numTasks);
+        for (auto& count : counts)
+        {
+            count = 0;
+        }
+        pool.ParallelFor(numTasks, [&counts](size_t index)
+        {
+            counts[index]++;
+        });
+        for (auto& count : counts)
+        {
+            CHECK(count == 1);
+        }
+    }
+}
+
+TEST(WorkerPoolRethrowsTaskExceptions)
+{
+    WorkerPool pool(2);
+
+    std::atomic<int> numRun(0);
+    bool caught = false;
+    try
+    {
+        pool.ParallelFor(8, [&numRun](size_t index)
+        {
+            numRun++;
+            if (index == 5)
+            {
+                throw std::runtime_error("Task failed.");
+            }
+        });
+    }
+    catch (const std::runtime_error&)
+    {
+        caught = true;
+    }
+    CHECK(caught);
+    CHECK(numRun == 8);
+
+    // The pool is still usable afterwards.
+    numRun = 0;
+    pool.ParallelFor(4, [&numRun](size_t)
+    {
+        numRun++;
+    });
+    CHECK(numRun == 4);
+}
+
+TEST(WorkerPoolLoopsFromSeveralThreads)
+{
+    WorkerPool pool(2);
+
+    std::atomic<uint64_t> sum(0);
+    auto loop = [&pool, &sum]()
+    {
+        for (int i = 0; i < 200; ++i)
+        {
+            pool.ParallelFor(5, [&sum](size_t index)
+            {
+                sum += index + 1;
+            });
+        }
+    };
+    std::thread a(loop), b(loop);
+    loop();
+    a.join();
+    b.join();
+
+    CHECK(sum == 3 * 200 * 15);
+}
+
+BENCHMARK(WorkerPoolVersusThreadPerRange)
+{
+    // Recording a frame: a handful of ranges with little work each, every frame.
+    const int NumFrames = 2000;
+    const uint64_t WorkPerFrame = 200000;
+
+    WorkerPool pool;
+    printf("  %u hardware threads, %u pool threads, %d frames, %llu iterations of work per frame\n",
+        std::thread::hardware_concurrency(), pool.GetNumThreads(), NumFrames, static_cast<unsigned long long>(WorkPerFrame));
+
+    for (size_t numRanges : { 1, 2, 4, 8 })
+    {
+        std::atomic<uint64_t> result(0);
+        auto task = [&result, numRanges, WorkPerFrame](size_t)
+        {
+            result += Spin(WorkPerFrame / numRanges);
+        };
+
+        auto start = Tests::Clock::now();
+        for (int f = 0; f < NumFrames; ++f)
+        {
+            SpawnFor(numRanges, task);
+        }
+        double spawn = Tests::MillisecondsSince(start) / NumFrames;
+
+        start = Tests::Clock::now();
+        for (int f = 0; f < NumFrames; ++f)
+        {
+            pool.ParallelFor(numRanges, task);
+        }
+        double pooled = Tests::MillisecondsSince(start) / NumFrames;
+
+        printf("  %zu ranges: %8.3f ms per frame with a thread per range, %8.3f ms with the pool\n", numRanges, spawn, pooled);
+    }
+}
@@ -0,0 +1,186 @@
+#include "Test.h"
+
+#include <windows.h>
+#include <sys/stat.h>
+#include <WorldManifest.h>
+
+#include <random>
+
+using namespace MC;
+
+namespace
+{
+    const int RegionChunks = WorldManifest::REGION_CHUNKS;
+
+    // A temporary level directory with a region directory, removed with its files.
+    struct TempLevel
+    {
+        FS::path Directory;
+        FS::path RegionPath;
+
+        TempLevel()
+            : Directory(FS::temp_directory_path() / FS::unique_path(L"manifest-%%%%-%%%%"))
+            , RegionPath(Directory / L"region")
+        {
+            FS::create_directories(RegionPath);
+        }
+
+        ~TempLevel()
+        {
+            boost::system::error_code ec;
+            FS::remove_all(Directory, ec);
+        }
+
+        FS::path RegionFile(int regionX, int regionZ) const
+        {
+            wchar_t fileName[64];
+            swprintf_s(fileName, L"r.%d.%d.mca", regionX, regionZ);
+            return RegionPath / fileName;
+        }
+
+        FS::path ManifestFile() const
+        {
+            return Directory / L"region.manifest";
+        }
+    };
+
+    void AppendBigEndian32(std::vector<char>& out, int32_t value)
+    {
+        out.push_back(static_cast<char>(value >> 24));
+        out.push_back(static_cast<char>(value >> 16));
+        out.push_back(static_cast<char>(value >> 8));
+        out.push_back(static_cast<char>(value));
+    }
+
+    // Write the header of a region file, big-endian like Minecraft writes it.
+    // Only the header is written, the manifest never reads the chunks.
+    void WriteRegionHeader(const FS::path& file, const int32_t* locations, const int32_t* timestamps, size_t size = RegionChunks * 8)
+    {
+        std::vector<char> header;
+        header.reserve(RegionChunks * 8);
+        for (int i = 0; i < RegionChunks; ++i)
+        {
+            AppendBigEndian32(header, locations[i]);
+        }
+        for (int i = 0; i < RegionChunks; ++i)
+        {
+            AppendBigEndian32(header, timestamps[i]);
+        }
+        FS::ofstream ofs(file, std::ios_base::binary | std::ios_base::trunc);
+        ofs.write(header.data(), size);
+    }
+
+    // Every chunk with (relX + relZ) % 3 == 0 exists, its location and timestamp encode its index.
+    void FillHeader(int seed, int32_t* locations, int32_t* timestamps)
+    {
+        for (int i = 0; i < RegionChunks; ++i)
+        {
+            bool exists = ((i & 31) + (i >> 5)) % 3 == 0;
+            locations[i] = exists ? ((2 + i) << 8) | 1 : 0;
+            timestamps[i] = exists ? 1500000000 + seed * RegionChunks + i : 0;
+        }
+    }
+}
+
+TEST(WorldManifestAnswersFromTheRegionHeaders)
+{
+    TempLevel level;
+    int32_t locations[2][RegionChunks];
+    int32_t timestamps[2][RegionChunks];
+    FillHeader(0, locations[0], timestamps[0]);
+    FillHeader(1, locations[1], timestamps[1]);
+    WriteRegionHeader(level.RegionFile(0, 0), locations[0], timestamps[0]);
+    WriteRegionHeader(level.RegionFile(-1, 2), locations[1], timestamps[1]);
+    // A file shorter than the header is not a region file.
+    WriteRegionHeader(level.RegionFile(5, 5), locations[0], timestamps[0], 100);
+
+    WorldManifest manifest(level.ManifestFile());
+    CHECK(manifest.getRegions().empty());
+    CHECK(manifest.update(level.RegionPath) == 2);
+    CHECK(manifest.getRegions().size() == 2);
+    CHECK(manifest.getRegion(5, 5) == nullptr);
+
+    auto checkChunks = [&](const WorldManifest& m)
+    {
+        for (int i = 0; i < RegionChunks; ++i)
+        {
+            int relX = i & 31, relZ = i >> 5;
+            CHECK(m.getChunkLocation(relX, relZ) == locations[0][i]);
+            CHECK(m.getChunkTimestamp(relX, relZ) == timestamps[0][i]);
+            CHECK(m.hasChunk(relX, relZ) == (locations[0][i] != 0));
+            CHECK(m.getChunkLocation(-32 + relX, 64 + relZ) == locations[1][i]);
+            CHECK(m.getChunkTimestamp(-32 + relX, 64 + relZ) == timestamps[1][i]);
+        }
+        CHECK(m.getChunkLocation(5 * 32, 5 * 32) == 0);
+    };
+    checkChunks(manifest);
+
+    // The saved manifest answers the same without reading a region file.
+    CHECK(manifest.save());
+    WorldManifest loaded(level.ManifestFile());
+    CHECK(!loaded.isDirty());
+    checkChunks(loaded);
+    CHECK(loaded.update(level.RegionPath) == 0);
+    CHECK(!loaded.isDirty());
+
+    // Removed region files are dropped on the next update.
+    FS::remove(level.RegionFile(-1, 2));
+    CHECK(loaded.update(level.RegionPath) == 0);
+    CHECK(loaded.isDirty());
+    CHECK(loaded.getRegion(-1, 2) == nullptr);
+    CHECK(loaded.getChunkLocation(-32, 64) == 0);
+}
+
+BENCHMARK(WorldManifestTenThousandRegions)
+{
+    // A 100 x 100 region world, about 10k region files with a third of their chunks.
+    const int NumRegionsPerSide = 100;
+    TempLevel level;
+    std::mt19937 random(48);
+    int32_t locations[RegionChunks];
+    int32_t timestamps[RegionChunks];
+    for (int rz = 0; rz < NumRegionsPerSide; ++rz)
+    {
+        for (int rx = 0; rx < NumRegionsPerSide; ++rx)
+        {
+            FillHeader(static_cast<int>(random() & 0xFFFF), locations, timestamps);
+            WriteRegionHeader(level.RegionFile(rx - NumRegionsPerSide / 2, rz - NumRegionsPerSide / 2), locations, timestamps);
+        }
+    }
+
+    auto start = Tests::Clock::now();
+    {
+        WorldManifest manifest(level.ManifestFile());
+        int numRead = manifest.update(level.RegionPath);
+        manifest.save();
+        printf("  cold: %d region headers read and saved in %8.1f ms\n", numRead, Tests::MillisecondsSince(start));
+    }
+
+    start = Tests::Clock::now();
+    WorldManifest manifest(level.ManifestFile());
+    double load = Tests::MillisecondsSince(start);
+    start = Tests::Clock::now();
+    int numRead = manifest.update(level.RegionPath);
+    double update = Tests::MillisecondsSince(start);
+    printf("  warm: %zu regions loaded in %8.1f ms, updated in %8.1f ms (%d headers read)\n",
+        manifest.getRegions().size(), load, update, numRead);
+
+    // Every chunk of the world, from memory.
+    start = Tests::Clock::now();
+    int64_t checksum = 0;
+    int minChunk = -NumRegionsPerSide / 2 * 32, maxChunk = NumRegionsPerSide / 2 * 32;
+    for (int z = minChunk; z < maxChunk; ++z)
+    {
+        for (int x = minChunk; x < maxChunk; ++x)
+        {
+            checksum += manifest.getChunkLocation(x, z) + manifest.getChunkTimestamp(x, z);
+        }
+    }
+    double lookups = Tests::MillisecondsSince(start);
+
+    start = Tests::Clock::now();
+    ChunkPosArray chunks = manifest.getChunksInRadius(0, 0, maxChunk * 2);
+    double enumerate = Tests::MillisecondsSince(start);
+    printf("  %d chunk lookups in %8.1f ms (checksum %lld), %zu chunks enumerated in %8.1f ms\n",
+        (maxChunk - minChunk) * (maxChunk - minChunk), lookups, static_cast<long long>(checksum), chunks.size(), enumerate);
+}